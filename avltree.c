@@ -85,7 +85,52 @@ cleanupAVL(ppAVLTREE ppRoot) {
 /* Insertion */
 
 int insertAvl(ppAVLTREE ppRoot, pAVLTREE pNewAvl) {
+  return insertStatsAvl(ppRoot, pNewAvl, (pAVLSTATS) 0);
+}
+
+static int insertDescentAvl(ppAVLTREE ppRoot, pAVLTREE pNewAvl, pAVLSTATS pStats
+                           , AVLLCPCOMPARATOR lcpComparator, size_t lcpLow, size_t lcpHigh);
+
+/* Insertion, with optional counters (pStats may be null) */
+int insertStatsAvl(ppAVLTREE ppRoot, pAVLTREE pNewAvl, pAVLSTATS pStats) {
+  return insertDescentAvl(ppRoot, pNewAvl, pStats, (AVLLCPCOMPARATOR) 0, 0, 0);
+}
+
+/* Common prefix lengths of a key with the smallest and largest keys of
+ * a tree, which bound every node below the root as the nearest smaller
+ * and larger keys do on the way down; without them, descent along
+ * either edge of the tree (e.g. appending keys in order) would skip no
+ * bytes at all
+ */
+static void seedLcpAvl(pAVLTREE pRoot, void *pPayloadWithKey, AVLLCPCOMPARATOR lcpComparator
+                      , size_t* pLcpLow, size_t* pLcpHigh) {
+pAVLTREE pMin = pRoot;
+pAVLTREE pMax = pRoot;
+  *pLcpLow = *pLcpHigh = 0;
+  if (!pRoot) return;
+  while (pMin->pLeft) pMin = pMin->pLeft;
+  while (pMax->pRight) pMax = pMax->pRight;
+  lcpComparator(pPayloadWithKey, pMin->payload, pLcpLow);
+  lcpComparator(pPayloadWithKey, pMax->payload, pLcpHigh);
+  return;
+}
+
+/* Insertion with LCP-aware descent; see getLcpAvl */
+int insertLcpAvl(ppAVLTREE ppRoot, pAVLTREE pNewAvl, AVLLCPCOMPARATOR lcpComparator, pAVLSTATS pStats) {
+size_t lcpLow;
+size_t lcpHigh;
+  seedLcpAvl(*ppRoot, pNewAvl->payload, lcpComparator, &lcpLow, &lcpHigh);
+  return insertDescentAvl(ppRoot, pNewAvl, pStats, lcpComparator, lcpLow, lcpHigh);
+}
+
+/* Insertion; with lcpComparator, lcpLow and lcpHigh are the common
+ * prefix lengths of the new key with the nearest smaller and larger
+ * keys passed on the way down (from seedLcpAvl at the root)
+ */
+static int insertDescentAvl(ppAVLTREE ppRoot, pAVLTREE pNewAvl, pAVLSTATS pStats
+                           , AVLLCPCOMPARATOR lcpComparator, size_t lcpLow, size_t lcpHigh) {
 pAVLTREE pRoot = *ppRoot;
+size_t lcp = 0;
 int comp;
 
   /* If pRoot (*ppRoot) is null, add pNewAvl there */
@@ -94,11 +139,17 @@ int comp;
     pNewAvl->balance = 0;
     pNewAvl->ppSelf = ppRoot;
     *ppRoot = pNewAvl;
+    AVLSTAT(pStats, ++pStats->inserts);
     return 1;
   }
 
   /* Compare pNewAvl to pRoot (ie. to *ppRoot) */
-  comp = pNewAvl->comparator(pNewAvl->payload, pRoot->payload);
+  if (lcpComparator) {
+    lcp = lcpLow < lcpHigh ? lcpLow : lcpHigh;
+    comp = lcpComparator(pNewAvl->payload, pRoot->payload, &lcp);
+  } else {
+    comp = AVLCOMPARE(pNewAvl, pNewAvl->payload, pRoot->payload);
+  }
 
   if (comp==0) {
     /* *pNewAVL is equal to *pRoot; replace *pRoot with *pNewAvl */
@@ -127,12 +178,14 @@ int comp;
 
     pRoot->pLeft = pRoot->pRight = 0;
     cleanupAVL(&pRoot);
+    AVLSTAT(pStats, ++pStats->replacements);
 
     return 0;
   }
 
   /* *pNewAVL is less or greater than *pRoot; add to, or as, pLeft or pRight */
-  if (insertAvl(comp < 0 ? &pRoot->pLeft : &pRoot->pRight, pNewAvl)) {
+  if (insertDescentAvl(comp < 0 ? &pRoot->pLeft : &pRoot->pRight, pNewAvl, pStats, lcpComparator
+                      , comp < 0 ? lcpLow : lcp, comp < 0 ? lcp : lcpHigh)) {
 
     /* To here, we just added pNewAvl as pRoot->pLeft or ->pRight */
     /* - update pNewAvl parent */
@@ -150,12 +203,14 @@ int comp;
             pRoot->balance = (pNewAvl->pRight->balance==1) ? -1 : 0;
             pNewAvl->pRight->balance = 0;
             rotateLeftAvl(pNewAvl);
+            AVLSTAT(pStats, ++pStats->rotations);
           } else {
             pNewAvl->balance =
             pRoot->balance = 0;
           }
           /* Balance Left-Left case */
           rotateRightAvl(pRoot);
+          AVLSTAT(pStats, ++pStats->rotations);
           break;
         }
 
@@ -170,12 +225,14 @@ int comp;
             pRoot->balance = (pNewAvl->pLeft->balance==-1) ? 1 : 0;
             pNewAvl->pLeft->balance = 0;
             rotateRightAvl(pNewAvl);
+            AVLSTAT(pStats, ++pStats->rotations);
           } else {
             pNewAvl->balance =
             pRoot->balance = 0;
           }
           /* Balance Right-Right case */
           rotateLeftAvl(pRoot);
+          AVLSTAT(pStats, ++pStats->rotations);
           break;
         }
 
@@ -198,12 +255,248 @@ void* getAVL(pAVLTREE pRoot, void *pPayloadWithKey, int* pCount) {
 int comp;
   if (pCount) ++*pCount;
   if (!pRoot) return (void*) NULL;
-  comp = pRoot->comparator(pPayloadWithKey, pRoot->payload);
+  comp = AVLCOMPARE(pRoot, pPayloadWithKey, pRoot->payload);
   if (comp==0) return pRoot->payload;
   if (comp>0) return getAVL(pRoot->pRight, pPayloadWithKey, pCount);
   return getAVL(pRoot->pLeft, pPayloadWithKey, pCount);
 }
 
+/*****************************************************************/
+/* Find item matching key, with LCP-aware descent
+ * - every node below a node lies between the nearest smaller and larger
+ *   keys passed on the way down to it, so shares with the search key
+ *   at least the shorter of the search key's common prefixes with
+ *   those two; lcpComparator starts comparing after that prefix
+ * - lcpComparator must order keys as the tree's comparator does
+ */
+
+void* getLcpAvl(pAVLTREE pRoot, void *pPayloadWithKey, AVLLCPCOMPARATOR lcpComparator, int* pCount) {
+size_t lcpLow;
+size_t lcpHigh;
+size_t lcp;
+int comp;
+  seedLcpAvl(pRoot, pPayloadWithKey, lcpComparator, &lcpLow, &lcpHigh);
+  for (;;) {
+    if (pCount) ++*pCount;
+    if (!pRoot) return (void*) NULL;
+    lcp = lcpLow < lcpHigh ? lcpLow : lcpHigh;
+    comp = lcpComparator(pPayloadWithKey, pRoot->payload, &lcp);
+    if (comp==0) return pRoot->payload;
+    if (comp>0) {
+      lcpLow = lcp;
+      pRoot = pRoot->pRight;
+    } else {
+      lcpHigh = lcp;
+      pRoot = pRoot->pLeft;
+    }
+  }
+}
+
+/*************************************************/
+/* Ordered iteration:  leftmost (smallest) node */
+
+pAVLTREE firstAvl(pAVLTREE pRoot) {
+  if (!pRoot) return pRoot;
+  while (pRoot->pLeft) pRoot = pRoot->pLeft;
+  return pRoot;
+}
+
+/*************************************************/
+/* Ordered iteration:  in-order successor, or NULL */
+
+pAVLTREE nextAvl(pAVLTREE pAvl) {
+  if (!pAvl) return pAvl;
+  if (pAvl->pRight) return firstAvl(pAvl->pRight);
+  /* Climb while pAvl is its parent's right child */
+  while (pAvl->pParent && pAvl->ppSelf == &pAvl->pParent->pRight) {
+    pAvl = pAvl->pParent;
+  }
+  return pAvl->pParent;
+}
+
+/*************************************************************/
+/* Find first node not less than key, for ordered range scans */
+
+pAVLTREE lowerBoundAvl(pAVLTREE pRoot, void *pPayloadWithKey) {
+pAVLTREE pBest = 0;
+int comp;
+  while (pRoot) {
+    comp = AVLCOMPARE(pRoot, pPayloadWithKey, pRoot->payload);
+    if (comp == 0) return pRoot;
+    if (comp < 0) {
+      pBest = pRoot;
+      pRoot = pRoot->pLeft;
+    } else {
+      pRoot = pRoot->pRight;
+    }
+  }
+  return pBest;
+}
+
+/*******************************************************************/
+/* Convert subtree to a sorted list, linked through pRight, and
+ * prepend it to the list at *ppHead
+ */
+
+static void listifyAvl(pAVLTREE pRoot, ppAVLTREE ppHead) {
+pAVLTREE pLeft;
+  while (pRoot) {
+    listifyAvl(pRoot->pRight, ppHead);
+    pLeft = pRoot->pLeft;
+    pRoot->pLeft = 0;
+    pRoot->pRight = *ppHead;
+    *ppHead = pRoot;
+    pRoot = pLeft;
+  }
+  return;
+}
+
+/*******************************************************************/
+/* Build perfectly balanced subtree from the first n nodes of a sorted
+ * list linked through pRight; advance *ppHead past them
+ */
+
+static pAVLTREE buildBalancedAvl(ppAVLTREE ppHead, size_t n, int* pHeight) {
+pAVLTREE pRoot;
+pAVLTREE pLeft;
+int hLeft;
+int hRight;
+
+  if (!n) { *pHeight = 0; return 0; }
+
+  pLeft = buildBalancedAvl(ppHead, (n-1)/2, &hLeft);
+  pRoot = *ppHead;
+  *ppHead = pRoot->pRight;
+  pRoot->pRight = buildBalancedAvl(ppHead, n - 1 - (n-1)/2, &hRight);
+  pRoot->pLeft = pLeft;
+
+  if (pRoot->pLeft) {
+    pRoot->pLeft->pParent = pRoot;
+    pRoot->pLeft->ppSelf = &pRoot->pLeft;
+  }
+  if (pRoot->pRight) {
+    pRoot->pRight->pParent = pRoot;
+    pRoot->pRight->ppSelf = &pRoot->pRight;
+  }
+  pRoot->balance = hLeft - hRight;
+  *pHeight = 1 + (hLeft > hRight ? hLeft : hRight);
+  return pRoot;
+}
+
+/*******************************************************************/
+/* Merge trees, reusing their nodes, into one balanced tree
+ * - pRoots[0..nRoots-1] are the input roots; each is set to null, as
+ *   the nodes now belong to *ppOut
+ * - equal keys are resolved by precedence; the losing nodes are
+ *   cleaned up via their cleanupPayload
+ * - *ppOut is overwritten; to merge into an existing tree, pass it as
+ *   one of the inputs
+ * - time is O(n * nRoots), with no allocation and no rotations
+ * - returns number of nodes in the merged tree
+ */
+
+int mergeAvl(pAVLTREE* pRoots, int nRoots, ppAVLTREE ppOut, AVLMERGE precedence) {
+pAVLTREE pMergedHead = 0;
+ppAVLTREE ppMergedTail = &pMergedHead;
+pAVLTREE pLoser;
+size_t n = 0;
+int height;
+int iMin;
+int comp;
+int i;
+
+  if (!ppOut) return 0;
+
+  /* Convert each input tree to a sorted list, in place */
+  for (i=0; pRoots && i<nRoots; ++i) {
+  pAVLTREE pRoot = pRoots[i];
+    pRoots[i] = 0;
+    listifyAvl(pRoot, pRoots + i);
+  }
+
+  /* Merge lists; pRoots[i] is now the head of list i */
+  for (;;) {
+    iMin = -1;
+    for (i=0; i<nRoots; ++i) {
+      if (!pRoots[i]) continue;
+      if (iMin < 0) { iMin = i; continue; }
+      comp = pRoots[i]->comparator(pRoots[i]->payload, pRoots[iMin]->payload);
+      if (comp > 0) continue;
+      if (comp == 0) {
+        /* Equal keys:  drop the node with lower precedence */
+        if (precedence == AVL_MERGE_FIRST_WINS) {
+          pLoser = pRoots[i];
+          pRoots[i] = pLoser->pRight;
+        } else {
+          pLoser = pRoots[iMin];
+          pRoots[iMin] = pLoser->pRight;
+          iMin = i;
+        }
+        pLoser->pRight = 0;
+        cleanupAVL(&pLoser);
+        continue;
+      }
+      iMin = i;
+    }
+    if (iMin < 0) break;
+
+    *ppMergedTail = pRoots[iMin];
+    ppMergedTail = &pRoots[iMin]->pRight;
+    pRoots[iMin] = pRoots[iMin]->pRight;
+    ++n;
+  }
+  *ppMergedTail = 0;
+
+  /* Rebuild as one balanced tree */
+  *ppOut = buildBalancedAvl(&pMergedHead, n, &height);
+  if (*ppOut) {
+    (*ppOut)->pParent = 0;
+    (*ppOut)->ppSelf = ppOut;
+  }
+  return (int) n;
+}
+
+/*****************************************************************/
+/* Record one lookup depth, e.g. *pCount after a getAVL() call */
+
+void countLookupAvl(pAVLSTATS pStats, int count) {
+  if (!pStats) return;
+  ++pStats->lookups;
+  if (count < 0) count = 0;
+  if (count >= AVL_DEPTH_HIST_SIZE) count = AVL_DEPTH_HIST_SIZE - 1;
+  ++pStats->depthHist[count];
+  return;
+}
+
+/*******************************************************************/
+/* Check tree invariants; returns height, or -1 on the first violation:
+ * - balance is height(left) - height(right), and is -1, 0 or 1
+ * - each child's pParent and ppSelf point back to its parent's link
+ * - each payload compares greater than every payload to its left
+ */
+
+static int verifySubtreeAvl(pAVLTREE pRoot, void** ppPrev) {
+int hLeft;
+int hRight;
+  if (!pRoot) return 0;
+  if (pRoot->pLeft && (pRoot->pLeft->pParent != pRoot || pRoot->pLeft->ppSelf != &pRoot->pLeft)) return -1;
+  if (pRoot->pRight && (pRoot->pRight->pParent != pRoot || pRoot->pRight->ppSelf != &pRoot->pRight)) return -1;
+  if ((hLeft = verifySubtreeAvl(pRoot->pLeft, ppPrev)) < 0) return -1;
+  if (*ppPrev && pRoot->comparator(*ppPrev, pRoot->payload) >= 0) return -1;
+  *ppPrev = pRoot->payload;
+  if ((hRight = verifySubtreeAvl(pRoot->pRight, ppPrev)) < 0) return -1;
+  if (pRoot->balance != hLeft - hRight) return -1;
+  if (pRoot->balance < -1 || pRoot->balance > 1) return -1;
+  return 1 + (hLeft > hRight ? hLeft : hRight);
+}
+
+int verifyAvl(ppAVLTREE ppRoot) {
+void* pPrev = 0;
+  if (!ppRoot || !*ppRoot) return 0;
+  if ((*ppRoot)->pParent || (*ppRoot)->ppSelf != ppRoot) return -1;
+  return verifySubtreeAvl(*ppRoot, &pPrev);
+}
+
 /********************************/
 /* Traverse tree, right to left, call handler for each pointer,
  * whether null or not
@@ -1,5 +1,7 @@
 #ifndef __AVLTREE_H__
 #define __AVLTREE_H__
+#include <stddef.h>
+
 typedef struct AVLTREEstr {
   int balance;
   struct AVLTREEstr* pLeft;
@@ -18,10 +20,65 @@ typedef struct AVLTREEstr {
   void (*cleanupPayload)(void* payload);
 } AVLTREE, *pAVLTREE, **ppAVLTREE;
 
+/* Comparator for LCP-aware descent (getLcpAvl, insertLcpAvl), for keys
+ * that are byte strings
+ * - on entry *pLcp bytes of the two keys are known to be equal, and
+ *   need not be compared again
+ * - returns as AVLTREE.comparator, and sets *pLcp to the length of the
+ *   common prefix of the two keys
+ */
+typedef int (*AVLLCPCOMPARATOR)(const void* payload1, const void* payload2, size_t* pLcp);
+
+/* Optional insertion and lookup counters
+ * - Pass a null pAVLSTATS to disable counting
+ * - Compile with -DAVL_NO_STATS to remove the counting code entirely
+ */
+#define AVL_DEPTH_HIST_SIZE 64
+typedef struct AVLSTATSstr {
+  unsigned long inserts;       // new nodes linked into a tree
+  unsigned long replacements;  // nodes that replaced an equal-key node
+  unsigned long rotations;     // single rotations (a double counts as 2)
+  unsigned long lookups;       // lookups recorded via countLookupAvl()
+  unsigned long depthHist[AVL_DEPTH_HIST_SIZE];  // lookups by getAVL *pCount
+} AVLSTATS, *pAVLSTATS;
+
+/* Precedence for mergeAvl when several inputs hold equal keys */
+typedef enum
+{ AVL_MERGE_LAST_WINS=0  // Later input replaces earlier, as with insertAvl
+, AVL_MERGE_FIRST_WINS   // Earlier input is kept
+} AVLMERGE;
+
+#ifdef AVL_NO_STATS
+#define AVLSTAT(P,STMT) do { } while (0)
+#else
+#define AVLSTAT(P,STMT) do { if (P) { STMT; } } while (0)
+#endif
+
+/* Comparator calls from inserts and lookups
+ * - define AVL_INLINE_COMPARATOR as the name of a comparator, declared
+ *   before avltree.c is compiled (e.g. in a unity build), to call it
+ *   directly, so it can be inlined, for nodes whose comparator it is
+ */
+#ifdef AVL_INLINE_COMPARATOR
+#define AVLCOMPARE(PAVL,P1,P2) ((PAVL)->comparator == AVL_INLINE_COMPARATOR \
+                               ? AVL_INLINE_COMPARATOR(P1,P2) : (PAVL)->comparator(P1,P2))
+#else
+#define AVLCOMPARE(PAVL,P1,P2) ((PAVL)->comparator(P1,P2))
+#endif
+
 void rotateRightAVL(pAVLTREE pRoot);
 void rotateLeftAVL(pAVLTREE pRoot);
 int insertAvl(ppAVLTREE ppRoot, pAVLTREE pNewAvl);
+int insertStatsAvl(ppAVLTREE ppRoot, pAVLTREE pNewAvl, pAVLSTATS pStats);
+int insertLcpAvl(ppAVLTREE ppRoot, pAVLTREE pNewAvl, AVLLCPCOMPARATOR lcpComparator, pAVLSTATS pStats);
+void countLookupAvl(pAVLSTATS pStats, int count);
 void* getAVL(pAVLTREE pRoot, void *pPayloadWithKey, int* pCount);
+void* getLcpAvl(pAVLTREE pRoot, void *pPayloadWithKey, AVLLCPCOMPARATOR lcpComparator, int* pCount);
+pAVLTREE firstAvl(pAVLTREE pRoot);
+pAVLTREE nextAvl(pAVLTREE pAvl);
+pAVLTREE lowerBoundAvl(pAVLTREE pRoot, void *pPayloadWithKey);
+int verifyAvl(ppAVLTREE ppRoot);
+int mergeAvl(pAVLTREE* pRoots, int nRoots, ppAVLTREE ppOut, AVLMERGE precedence);
 void traverseFromRightAvl(pAVLTREE pRoot, int level, void (*func)(pAVLTREE, int, void**), void** args);
 void cleanupAVL(ppAVLTREE ppRoot);
 #endif
@@ -3,6 +3,13 @@
 #include <string.h>
 #include "buffer_file.h"
 
+#ifdef BUFFILE_GZIP
+#include <zlib.h>
+#endif
+#ifdef BUFFILE_ZSTD
+#include <zstd.h>
+#endif
+
 
 /***********************************************************************
  * Free pBuffile structure plus  data
@@ -18,7 +25,8 @@ uint8_t* pRtn_data = 0;
 
   if (!pBuf_len && pBuffile->data) {
     /* Free buffer if data length is not requested */
-    free(pBuffile->data);
+    orx_free(pBuffile->pAlloc, pBuffile->data);
+    pBuffile->data = 0;
   } else if (pBuf_len) {
     /* Save data and pointer if data length is requested */
     pRtn_data = pBuffile->data;
@@ -36,11 +44,24 @@ uint8_t* pRtn_data = 0;
  *   malloc or realloc or calloc call.
  */
 void buffile_init(pBUFFILE pBuffile, int malloced) {
+  buffile_init_alloc(pBuffile, malloced, (pORXALLOC) 0);
+  return;
+}
+
+/***********************************************************************
+ * Same as buffile_init, with data (re)allocated, and freed by
+ * buffile_free, via pAlloc; the caller frees data returned by
+ * buffile_free or buffile_file_to_puint8 with orx_free(pAlloc, ...)
+ * - the BUFFILE structure itself, if malloced, still uses malloc/free
+ */
+void buffile_init_alloc(pBUFFILE pBuffile, int malloced, pORXALLOC pAlloc) {
   if (!pBuffile) return;
   pBuffile->malloced = malloced;
   pBuffile->data = 0;
   pBuffile->len = 0;
   pBuffile->limit = 0;
+  pBuffile->reallocs = 0;
+  pBuffile->pAlloc = pAlloc;
   return;
 }
 
@@ -71,9 +92,17 @@ size_t new_limit;
            );
   }
 
-  /* Re-allocate data if limit will increase */
+  /* Re-allocate data if limit will increase; at least double the limit,
+   * so appending n bytes costs O(n) copying and O(log n) reallocations
+   */
   if (new_limit > pBuffile->limit) {
-  uint8_t* new_data = new_limit > BUFFILE_UPPER_LIMIT ? 0 : realloc(pBuffile->data, new_limit);
+  uint8_t* new_data;
+    if (new_limit <= BUFFILE_UPPER_LIMIT && new_limit < (pBuffile->limit << 1)) {
+      new_limit = pBuffile->limit << 1;
+      if (new_limit > BUFFILE_UPPER_LIMIT) { new_limit = BUFFILE_UPPER_LIMIT; }
+    }
+    new_data = new_limit > BUFFILE_UPPER_LIMIT ? 0
+             : orx_realloc(pBuffile->pAlloc, pBuffile->data, pBuffile->limit, new_limit);
     if (!new_data) {
       /* Free BUFFILE structure and allocated data if realloc failed */
       buffile_free(pBuffile, 0);
@@ -82,8 +111,9 @@ size_t new_limit;
     /* Update BUFFILE data pointer and limit */
     pBuffile->data = new_data;
     pBuffile->limit = new_limit;
-    /* Put null terminator at limit */
-    new_data[pBuffile->limit-1] = '\0';
+    ++pBuffile->reallocs;
+    /* Put null terminator after data */
+    new_data[pBuffile->len] = '\0';
   }
   return pBuffile;
 }
@@ -112,40 +142,249 @@ size_t to_add = memb_size * n_memb;
    */
   memcpy(pBuffile->data + pBuffile->len, pSource, to_add);
   pBuffile->len += to_add;
+  pBuffile->data[pBuffile->len] = '\0';
 
   /* Return BUFFILE pointer */
   return pBuffile;
 }
 
 
+/***********************************************************************
+ * Open filename ("-" for stdin) for reading with buffile_read, and
+ * detect its format from the first bytes
+ * - Return 0 on success; on failure, pSrc needs no buffile_close
+ */
+int buffile_open(pBUFFILESRC pSrc, char* filename) {
+static const uint8_t gzipMagic[2] = { 0x1f, 0x8b };
+static const uint8_t zstdMagic[4] = { 0x28, 0xb5, 0x2f, 0xfd };
+
+  if (!pSrc) return 1;
+  memset(pSrc, 0, sizeof *pSrc);
+  pSrc->pFile = filename ? (strcmp(filename,"-") ? fopen(filename,"rb") : stdin) : 0;
+  if (!pSrc->pFile) return 1;
+
+  pSrc->headLen = fread(pSrc->head, 1, sizeof(pSrc->head), pSrc->pFile);
+  if (ferror(pSrc->pFile)) {
+    buffile_close(pSrc);
+    return 1;
+  }
+  if (pSrc->headLen >= 2 && !memcmp(pSrc->head, gzipMagic, 2)) {
+    pSrc->format = BUFFILE_FMT_GZIP;
+  } else if (pSrc->headLen == 4 && !memcmp(pSrc->head, zstdMagic, 4)) {
+    pSrc->format = BUFFILE_FMT_ZSTD;
+  }
+  if (pSrc->format == BUFFILE_FMT_PLAIN) return 0;
+
+  /* Compressed:  head bytes are the start of the input */
+  if (!(pSrc->inBuf = malloc(BUFFILE_IN_SIZE))) {
+    buffile_close(pSrc);
+    return 1;
+  }
+  memcpy(pSrc->inBuf, pSrc->head, pSrc->headLen);
+  pSrc->inLen = pSrc->headLen;
+  pSrc->inFrame = 1;
+
+  switch (pSrc->format) {
+#ifdef BUFFILE_GZIP
+  case BUFFILE_FMT_GZIP:
+    if ((pSrc->pStream = calloc(1, sizeof(z_stream)))
+     && inflateInit2((z_streamp) pSrc->pStream, 16 + MAX_WBITS) != Z_OK) {
+      free(pSrc->pStream);
+      pSrc->pStream = 0;
+    }
+    break;
+#endif
+#ifdef BUFFILE_ZSTD
+  case BUFFILE_FMT_ZSTD:
+    pSrc->pStream = ZSTD_createDStream();
+    if (pSrc->pStream && ZSTD_isError(ZSTD_initDStream((ZSTD_DStream*) pSrc->pStream))) {
+      ZSTD_freeDStream((ZSTD_DStream*) pSrc->pStream);
+      pSrc->pStream = 0;
+    }
+    break;
+#endif
+  default:
+    fprintf(stderr, "buffile_open():  %s is %s-compressed; rebuild with -DBUFFILE_%s\n"
+           , filename
+           , pSrc->format == BUFFILE_FMT_GZIP ? "gzip" : "zstd"
+           , pSrc->format == BUFFILE_FMT_GZIP ? "GZIP" : "ZSTD");
+    break;
+  }
+  if (!pSrc->pStream) {
+    buffile_close(pSrc);
+    return 1;
+  }
+  return 0;
+}
+
+
+/***********************************************************************
+ * Refill compressed input once all of it has been used
+ * - Return number of bytes available; 0 at EOF or on error
+ */
+static size_t buffile_fill(pBUFFILESRC pSrc) {
+  if (pSrc->inPos < pSrc->inLen) return pSrc->inLen - pSrc->inPos;
+  pSrc->inPos = 0;
+  pSrc->inLen = fread(pSrc->inBuf, 1, BUFFILE_IN_SIZE, pSrc->pFile);
+  if (ferror(pSrc->pFile)) { pSrc->error = 1; pSrc->inLen = 0; }
+  if (!pSrc->inLen) {
+    /* End of input inside a member or frame:  file is truncated */
+    if (pSrc->inFrame && !pSrc->error) {
+      fprintf(stderr, "%s\n", "buffile_read():  compressed input is truncated");
+      pSrc->error = 1;
+    }
+    pSrc->eof = 1;
+  }
+  return pSrc->inLen;
+}
+
+
+/***********************************************************************
+ * Read up to n bytes, decompressed if need be, into pDest
+ * - Return number of bytes read; n unless at EOF or on error
+ * - Return 0 at EOF, and on error, which also sets pSrc->error
+ */
+size_t buffile_read(pBUFFILESRC pSrc, uint8_t* pDest, size_t n) {
+size_t n_read = 0;
+
+  if (!pSrc || !pSrc->pFile || !pDest || pSrc->eof || pSrc->error) return 0;
+
+  switch (pSrc->format) {
+
+  case BUFFILE_FMT_PLAIN:
+    /* Replay bytes read by buffile_open, then read file */
+    while (n_read < n && pSrc->headPos < pSrc->headLen) {
+      pDest[n_read++] = pSrc->head[pSrc->headPos++];
+    }
+    n_read += fread(pDest + n_read, 1, n - n_read, pSrc->pFile);
+    if (ferror(pSrc->pFile)) { pSrc->error = 1; return 0; }
+    if (n_read < n) { pSrc->eof = 1; }
+    return n_read;
+
+#ifdef BUFFILE_GZIP
+  case BUFFILE_FMT_GZIP:
+    {
+    z_streamp pZ = (z_streamp) pSrc->pStream;
+    int z_rtn;
+      /* Inflate first, as output may be pending with no input left */
+      for (;;) {
+        pZ->next_in = pSrc->inBuf + pSrc->inPos;
+        pZ->avail_in = (uInt) (pSrc->inLen - pSrc->inPos);
+        pZ->next_out = pDest + n_read;
+        pZ->avail_out = (uInt) (n - n_read);
+        z_rtn = inflate(pZ, Z_NO_FLUSH);
+        if (pZ->avail_in < pSrc->inLen - pSrc->inPos) { pSrc->inFrame = 1; }
+        pSrc->inPos = pSrc->inLen - pZ->avail_in;
+        n_read = n - pZ->avail_out;
+        if (z_rtn == Z_STREAM_END) {
+          /* End of member; another may follow */
+          pSrc->inFrame = 0;
+          inflateReset(pZ);
+        } else if (z_rtn != Z_OK && z_rtn != Z_BUF_ERROR) {
+          fprintf(stderr, "buffile_read():  gzip error (%s)\n", pZ->msg ? pZ->msg : "?");
+          pSrc->error = 1;
+          return 0;
+        }
+        if (n_read == n) break;
+        if (pSrc->inPos == pSrc->inLen && !buffile_fill(pSrc)) break;
+      }
+    }
+    return pSrc->error ? 0 : n_read;
+#endif
+
+#ifdef BUFFILE_ZSTD
+  case BUFFILE_FMT_ZSTD:
+    {
+    ZSTD_inBuffer in;
+    ZSTD_outBuffer out;
+    size_t z_rtn;
+      out.dst = pDest;
+      out.size = n;
+      out.pos = 0;
+      /* Decompress first, as output may be pending with no input left */
+      for (;;) {
+        in.src = pSrc->inBuf;
+        in.size = pSrc->inLen;
+        in.pos = pSrc->inPos;
+        z_rtn = ZSTD_decompressStream((ZSTD_DStream*) pSrc->pStream, &out, &in);
+        if (ZSTD_isError(z_rtn)) {
+          fprintf(stderr, "buffile_read():  zstd error (%s)\n", ZSTD_getErrorName(z_rtn));
+          pSrc->error = 1;
+          return 0;
+        }
+        /* 0 means end of frame; another may follow */
+        if (!z_rtn) { pSrc->inFrame = 0; }
+        else if (in.pos > pSrc->inPos) { pSrc->inFrame = 1; }
+        pSrc->inPos = in.pos;
+        if (out.pos == out.size) break;
+        if (pSrc->inPos == pSrc->inLen && !buffile_fill(pSrc)) break;
+      }
+      n_read = out.pos;
+    }
+    return pSrc->error ? 0 : n_read;
+#endif
+
+  default:
+    pSrc->error = 1;
+    return 0;
+  }
+}
+
+
+/***********************************************************************
+ * Close file, and free decompressor
+ */
+void buffile_close(pBUFFILESRC pSrc) {
+  if (!pSrc) return;
+  if (pSrc->pStream) {
+#ifdef BUFFILE_GZIP
+    if (pSrc->format == BUFFILE_FMT_GZIP) {
+      inflateEnd((z_streamp) pSrc->pStream);
+      free(pSrc->pStream);
+    }
+#endif
+#ifdef BUFFILE_ZSTD
+    if (pSrc->format == BUFFILE_FMT_ZSTD) { ZSTD_freeDStream((ZSTD_DStream*) pSrc->pStream); }
+#endif
+  }
+  if (pSrc->inBuf) { free(pSrc->inBuf); }
+  if (pSrc->pFile && pSrc->pFile != stdin) { fclose(pSrc->pFile); }
+  pSrc->pStream = 0;
+  pSrc->inBuf = 0;
+  pSrc->pFile = 0;
+  return;
+}
+
+
 /***********************************************************************
  * Read from file named filename into data buffer, return pointer to buffer
  * and set *pBuf_len to buffer length
+ * - A compressed file (see buffile_open) is decompressed as it is read
  * ***N.B. If calling with a non-zero pBuffile pointer, call
  *           buffile_init(pBuffile, malloced)
  *         first
  */
 uint8_t* buffile_file_to_puint8(char* filename, size_t* pBuf_len, pBUFFILE pBuffile) {
-FILE* pFile = filename ? (strcmp(filename,"-") ? fopen(filename,"rb") : stdin) : 0;
-char read_buffer[BUFSIZ];
+BUFFILESRC src;
+uint8_t read_buffer[BUFSIZ];
 size_t n_read;
 
-  if (!pFile) return 0;
+  if (buffile_open(&src, filename)) return 0;
 
   while (pBuf_len) {
 
     /* Read next chunk; check for error */
-    n_read = fread(read_buffer, 1, sizeof(read_buffer), pFile);
-    if (ferror(pFile)) { pBuf_len = 0; break; }
+    n_read = buffile_read(&src, read_buffer, sizeof(read_buffer));
+    if (src.error) { pBuf_len = 0; break; }
 
     /* Check for [no more data in file && EOF] */
-    if (!n_read && feof(pFile)) { break; }
+    if (!n_read && src.eof) { break; }
 
     /* Append chunk to pBuffile data; break on failure */
     if (!(pBuffile = buffile_write(pBuffile, 1, n_read, read_buffer))) { pBuf_len = 0; break; };
   }
 
-  if (pFile != stdin) fclose(pFile);
+  buffile_close(&src);
 
   return buffile_free(pBuffile, pBuf_len);
 }
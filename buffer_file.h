@@ -1,17 +1,61 @@
 #ifndef __BUFFER_FILE__
 #define __BUFFER_FILE__
+#include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "orx_alloc.h"
+
 typedef struct BUFFILEstr {
   int malloced;
   uint8_t* data;
   size_t len;
   size_t limit;
+  unsigned long reallocs;  // Count of data (re)allocations, for statistics
+  pORXALLOC pAlloc;        // Allocator for data; null for malloc
 } *pBUFFILE, **ppBUFFILE, BUFFILE;
 
+/* Input stream:  a plain file, or a compressed file decompressed as it
+ * is read
+ * - format is detected from the first bytes (magic number), so plain
+ *   files are read as before
+ * - gzip needs zlib, enabled with -DBUFFILE_GZIP and -lz; zstd needs
+ *   libzstd, enabled with -DBUFFILE_ZSTD and -lzstd
+ * - concatenated gzip members and zstd frames are read as one stream
+ */
+typedef enum
+{ BUFFILE_FMT_PLAIN=0
+, BUFFILE_FMT_GZIP
+, BUFFILE_FMT_ZSTD
+} BUFFILEFMT;
+
+typedef struct BUFFILESRCstr {
+  FILE* pFile;
+  BUFFILEFMT format;
+  int eof;                 // No more data
+  int error;               // Open, read or decompression failed
+  int inFrame;             // Compressed:  a member/frame is incomplete
+  uint8_t head[4];         // First bytes of file, read to detect format
+  size_t headLen;
+  size_t headPos;          // Plain:  head bytes already returned
+  void* pStream;           // Compressed:  decompressor state
+  uint8_t* inBuf;          // Compressed:  input read from file
+  size_t inLen;
+  size_t inPos;
+} BUFFILESRC, *pBUFFILESRC;
+
+/* Size of compressed input reads */
+#ifndef BUFFILE_IN_SIZE
+#define BUFFILE_IN_SIZE 65536
+#endif
+
+int buffile_open(pBUFFILESRC pSrc, char* filename);
+size_t buffile_read(pBUFFILESRC pSrc, uint8_t* pDest, size_t n);
+void buffile_close(pBUFFILESRC pSrc);
+
 uint8_t* buffile_free(pBUFFILE pBuffile, size_t* pBuf_len);
 void buffile_init(pBUFFILE pBuffile, int malloced);
+void buffile_init_alloc(pBUFFILE pBuffile, int malloced, pORXALLOC pAlloc);
 pBUFFILE buffile_size(pBUFFILE pBuffile, size_t to_add);
 pBUFFILE buffile_write(void* pVoidBuffile, size_t memb_size, size_t n_memb, void* pSource);
 uint8_t* buffile_file_to_puint8(char* filename, size_t* pBuf_len, pBUFFILE pBuffile);
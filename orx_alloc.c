@@ -0,0 +1,141 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "orx_alloc.h"
+
+
+/**********************************************************************/
+/**********************************************************************/
+/*** Arena allocator; see orx_alloc.h */
+/**********************************************************************/
+/**********************************************************************/
+
+/* All allocations are aligned, and rounded up, to ORXARENA_ALIGN */
+#define ORXARENA_ALIGN 16
+#define ORXARENA_ROUND(N) (((N) + (ORXARENA_ALIGN-1)) & ~(size_t)(ORXARENA_ALIGN-1))
+
+typedef struct ORXARENABLOCKstr {
+  struct ORXARENABLOCKstr* pNext;
+  size_t size;             // Bytes available after the header
+  size_t used;
+} ORXARENABLOCK, *pORXARENABLOCK;
+
+#define ORXARENA_HEADER ORXARENA_ROUND(sizeof(ORXARENABLOCK))
+#define ORXARENA_DATA(PBLOCK) ((char*)(PBLOCK) + ORXARENA_HEADER)
+
+static void*
+allocateArena(pORXALLOC pAlloc, size_t size) {
+pORXARENA pArena = (pORXARENA) pAlloc->arg;
+pORXARENABLOCK pBlock = pArena->pBlocks;
+size_t rounded = ORXARENA_ROUND(size ? size : 1);
+size_t blockSize;
+void* ptr;
+
+  if (!pBlock || pBlock->size - pBlock->used < rounded) {
+    blockSize = rounded > pArena->blockSize ? rounded : pArena->blockSize;
+    if (!(pBlock = orx_malloc(pArena->pBacking, ORXARENA_HEADER + blockSize))) return 0;
+    pBlock->pNext = pArena->pBlocks;
+    pBlock->size = blockSize;
+    pBlock->used = 0;
+    pArena->pBlocks = pBlock;
+    pArena->bytesReserved += blockSize;
+  }
+
+  ptr = ORXARENA_DATA(pBlock) + pBlock->used;
+  pBlock->used += rounded;
+  pArena->bytesUsed += rounded;
+  pArena->pLast = ptr;
+  return ptr;
+}
+
+static void*
+reallocateArena(pORXALLOC pAlloc, void* ptr, size_t oldSize, size_t newSize) {
+pORXARENA pArena = (pORXARENA) pAlloc->arg;
+pORXARENABLOCK pBlock = pArena->pBlocks;
+size_t oldRounded = ORXARENA_ROUND(oldSize ? oldSize : 1);
+size_t newRounded = ORXARENA_ROUND(newSize ? newSize : 1);
+void* newPtr;
+
+  if (!ptr) return allocateArena(pAlloc, newSize);
+
+  /* Grow or shrink the most recent allocation in place */
+  if (ptr == pArena->pLast && pBlock
+   && (char*) ptr + oldRounded == ORXARENA_DATA(pBlock) + pBlock->used
+   && (size_t) ((char*) ptr - ORXARENA_DATA(pBlock)) + newRounded <= pBlock->size) {
+    pBlock->used = (size_t) ((char*) ptr - ORXARENA_DATA(pBlock)) + newRounded;
+    pArena->bytesUsed = pArena->bytesUsed - oldRounded + newRounded;
+    return ptr;
+  }
+
+  if (!(newPtr = allocateArena(pAlloc, newSize))) return 0;
+  memcpy(newPtr, ptr, oldSize < newSize ? oldSize : newSize);
+  return newPtr;
+}
+
+static void
+releaseArena(pORXALLOC pAlloc, void* ptr) {
+  /* Memory is returned by cleanupArenaOrx */
+  (void) pAlloc;
+  (void) ptr;
+  return;
+}
+
+
+/**********************************************************************/
+/* Initialize arena; returns the pORXALLOC to pass to loads */
+pORXALLOC
+initArenaOrx(pORXARENA pArena, size_t blockSize, pORXALLOC pBacking) {
+  if (!pArena) return 0;
+  pArena->alloc.allocate = allocateArena;
+  pArena->alloc.reallocate = reallocateArena;
+  pArena->alloc.release = releaseArena;
+  pArena->alloc.arg = (void*) pArena;
+  pArena->pBacking = pBacking;
+  pArena->blockSize = blockSize ? ORXARENA_ROUND(blockSize) : (size_t) 1 << 20;
+  pArena->pBlocks = 0;
+  pArena->pLast = 0;
+  pArena->bytesUsed = 0;
+  pArena->bytesReserved = 0;
+  return &pArena->alloc;
+}
+
+/* Make all arena memory available again, keeping it allocated
+ * - everything allocated from the arena becomes invalid
+ * - several blocks are replaced by one block of their total size, so an
+ *   arena reset between loads of similar size stops calling pBacking
+ */
+void
+resetArenaOrx(pORXARENA pArena) {
+pORXARENABLOCK pBlock;
+size_t total;
+  if (!pArena) return;
+  if (pArena->pBlocks && pArena->pBlocks->pNext) {
+    total = pArena->bytesReserved;
+    cleanupArenaOrx(pArena);
+    if ((pBlock = orx_malloc(pArena->pBacking, ORXARENA_HEADER + total))) {
+      pBlock->pNext = 0;
+      pBlock->size = total;
+      pArena->pBlocks = pBlock;
+      pArena->bytesReserved = total;
+    }
+  }
+  if (pArena->pBlocks) { pArena->pBlocks->used = 0; }
+  pArena->pLast = 0;
+  pArena->bytesUsed = 0;
+  return;
+}
+
+/* Free all blocks; everything allocated from the arena becomes invalid */
+void
+cleanupArenaOrx(pORXARENA pArena) {
+pORXARENABLOCK pBlock;
+  if (!pArena) return;
+  while ((pBlock = pArena->pBlocks)) {
+    pArena->pBlocks = pBlock->pNext;
+    orx_free(pArena->pBacking, pBlock);
+  }
+  pArena->pLast = 0;
+  pArena->bytesUsed = 0;
+  pArena->bytesReserved = 0;
+  return;
+}
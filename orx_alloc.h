@@ -0,0 +1,65 @@
+////////////////////////////////////////////////////////////////////////
+// Pluggable allocator interface
+//
+// An ORXALLOC is a small vtable; a null pORXALLOC means the C library
+// malloc, realloc and free.  It is passed through BUFFILE (buffile_init_alloc),
+// newOjiAlloc, and OJIOPTS.pAlloc for readOjiAvl*, so that file data,
+// tokens, key-prefix scratch and OJITEMs of one load all come from one
+// allocator, e.g. a per-thread pool, a huge-page arena or a jemalloc
+// arena; loads with different allocators share no allocator state.
+//
+// - reallocate is given the old size, so arena-style allocators can copy
+// - release may be a no-op, e.g. for an arena freed as a whole
+// - OJITEMs remember their allocator, so cleanupOji frees them with it
+//
+// ORXARENA is a simple bump allocator built on this interface.  It is
+// not thread-safe; use one arena per thread or per load.
+//
+////////////////////////////////////////////////////////////////////////
+#ifndef __ORX_ALLOC_H__
+#define __ORX_ALLOC_H__
+
+#include <stdlib.h>
+
+typedef struct ORXALLOCstr {
+  void* (*allocate)(struct ORXALLOCstr* pAlloc, size_t size);
+  void* (*reallocate)(struct ORXALLOCstr* pAlloc, void* ptr, size_t oldSize, size_t newSize);
+  void (*release)(struct ORXALLOCstr* pAlloc, void* ptr);
+  void* arg;               // Allocator state
+} ORXALLOC, *pORXALLOC;
+
+static inline void*
+orx_malloc(pORXALLOC pAlloc, size_t size) {
+  return pAlloc ? pAlloc->allocate(pAlloc, size) : malloc(size);
+}
+
+static inline void*
+orx_realloc(pORXALLOC pAlloc, void* ptr, size_t oldSize, size_t newSize) {
+  return pAlloc ? pAlloc->reallocate(pAlloc, ptr, oldSize, newSize) : realloc(ptr, newSize);
+}
+
+static inline void
+orx_free(pORXALLOC pAlloc, void* ptr) {
+  if (!ptr) return;
+  if (pAlloc) { pAlloc->release(pAlloc, ptr); } else { free(ptr); }
+}
+
+////////////////////////////////////////////////////////////////////////
+// Arena:  allocations are carved from blocks of at least blockSize
+// bytes, taken from pBacking (null for malloc); release does nothing,
+// resetArenaOrx recycles all blocks, cleanupArenaOrx frees them
+typedef struct ORXARENAstr {
+  ORXALLOC alloc;          // Pass &arena.alloc as the pORXALLOC
+  pORXALLOC pBacking;
+  size_t blockSize;
+  struct ORXARENABLOCKstr* pBlocks;  // Most recent block first
+  void* pLast;             // Most recent allocation, which can grow in place
+  size_t bytesUsed;        // Statistics:  bytes handed out
+  size_t bytesReserved;    // Statistics:  bytes in blocks
+} ORXARENA, *pORXARENA;
+
+pORXALLOC initArenaOrx(pORXARENA pArena, size_t blockSize, pORXALLOC pBacking);
+void resetArenaOrx(pORXARENA pArena);
+void cleanupArenaOrx(pORXARENA pArena);
+
+#endif // __ORX_ALLOC_H__
@@ -0,0 +1,968 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "orx_art.h"
+
+
+/**********************************************************************/
+/**********************************************************************/
+/*** Adaptive radix tree of OJI leaves; see orx_art.h */
+/**********************************************************************/
+/**********************************************************************/
+
+typedef struct OJIARTNODE4str {
+  OJIARTNODE n;
+  uint8_t keys[4];         // Sorted
+  void* children[4];
+} OJIARTNODE4, *pOJIARTNODE4;
+
+typedef struct OJIARTNODE16str {
+  OJIARTNODE n;
+  uint8_t keys[16];        // Sorted
+  void* children[16];
+} OJIARTNODE16, *pOJIARTNODE16;
+
+typedef struct OJIARTNODE48str {
+  OJIARTNODE n;
+  uint8_t childIndex[256]; // 1 + index into children; 0 if none
+  void* children[48];
+} OJIARTNODE48, *pOJIARTNODE48;
+
+typedef struct OJIARTNODE256str {
+  OJIARTNODE n;
+  void* children[256];
+} OJIARTNODE256, *pOJIARTNODE256;
+
+static const size_t artNodeSizes[5] =
+  { 0, sizeof(OJIARTNODE4), sizeof(OJIARTNODE16), sizeof(OJIARTNODE48), sizeof(OJIARTNODE256) };
+
+/* Child links:  leaves are tagged in the low bit */
+#define IS_LEAF_ART(P)  (((uintptr_t)(P)) & 1)
+#define LEAF_ART(P)     ((pOJIARTLEAF)(((uintptr_t)(P)) & ~(uintptr_t)1))
+#define TAG_LEAF_ART(P) ((void*)(((uintptr_t)(P)) | 1))
+
+#define MIN_ART(A,B) ((A) < (B) ? (A) : (B))
+
+
+/**********************************************************************/
+/* Node and leaf allocation, with byte counts for statistics */
+static pOJIARTNODE
+newNodeArt(pOJIART pTree, OJIARTTYPE type) {
+pOJIARTNODE pNode = orx_malloc(pTree->pAlloc, artNodeSizes[type]);
+  if (!pNode) return pNode;
+  memset(pNode, 0, artNodeSizes[type]);
+  pNode->type = (uint8_t) type;
+  pTree->nodeBytes += artNodeSizes[type];
+  ++pTree->nodeCounts[type];
+  return pNode;
+}
+
+static void
+freeNodeArt(pOJIART pTree, pOJIARTNODE pNode) {
+  pTree->nodeBytes -= artNodeSizes[pNode->type];
+  --pTree->nodeCounts[pNode->type];
+  orx_free(pTree->pAlloc, pNode);
+  return;
+}
+
+static size_t
+leafSizeArt(pOJIARTLEAF pLeaf) {
+  return sizeof(OJIARTLEAF) + pLeaf->keyLen + 1 + (pLeaf->hasText ? pLeaf->textLen + 1 : 0);
+}
+
+static void
+freeLeafArt(pOJIART pTree, pOJIARTLEAF pLeaf) {
+  pTree->leafBytes -= leafSizeArt(pLeaf);
+  orx_free(pTree->pAlloc, pLeaf);
+  return;
+}
+
+
+/**********************************************************************/
+/* Initialize an empty tree; pAlloc is null for malloc */
+void
+initOjiArt(pOJIART pTree, pORXALLOC pAlloc) {
+  if (!pTree) return;
+  memset(pTree, 0, sizeof *pTree);
+  pTree->pAlloc = pAlloc;
+  return;
+}
+
+
+/**********************************************************************/
+/* Allocate new leaf from an OJITEM, as newOjic
+ * - pSource->keyString is the null-terminated key
+ * - pSource->sPayload holds lenStrJson characters of payload text, which
+ *   are kept only for OJI_STRING and OJI_UNKNOWN payloads
+ */
+pOJIARTLEAF
+newOjiArtLeaf(pOJIART pTree, pOJITEM pSource, int lenStrJson) {
+pOJIARTLEAF rtn;
+size_t lenKey;
+int hasText;
+
+  if (!pTree || !pSource || !pSource->keyString) return 0;
+  if (lenStrJson < 0) return 0;
+
+  hasText = (pSource->payloadType == OJI_STRING || pSource->payloadType == OJI_UNKNOWN)
+          && pSource->sPayload;
+  lenKey = strlen(pSource->keyString);
+
+  rtn = orx_malloc(pTree->pAlloc, sizeof(OJIARTLEAF) + lenKey + 1 + (hasText ? (lenStrJson + 1) : 0));
+  if (!rtn) return rtn;
+
+  rtn->uPayload.anInteger = 0;
+  if (pSource->payloadType == OJI_SCALAR) { rtn->uPayload.aScalar = pSource->uPayload.aScalar; }
+  if (pSource->payloadType == OJI_INTEGER) { rtn->uPayload.anInteger = pSource->uPayload.anInteger; }
+  if (pSource->payloadType == OJI_BOOLEAN) { rtn->uPayload.aBool = pSource->uPayload.aBool; }
+  rtn->payloadType = (uint8_t) pSource->payloadType;
+  rtn->keyLen = (uint32_t) lenKey;
+  rtn->hasText = (uint8_t) hasText;
+  rtn->textLen = hasText ? (uint32_t) lenStrJson : 0;
+
+  memcpy(rtn->keyString, pSource->keyString, lenKey + 1);
+  if (hasText) {
+    memcpy(rtn->keyString + lenKey + 1, pSource->sPayload, lenStrJson);
+    rtn->keyString[lenKey + 1 + lenStrJson] = '\0';
+  }
+
+  pTree->leafBytes += leafSizeArt(rtn);
+  return rtn;
+} /* newOjiArtLeaf(pOJIART pTree, pOJITEM pSource, int lenStrJson) */
+
+
+/**********************************************************************/
+/* Link to child for key byte c, or null */
+static void**
+findChildArt(pOJIARTNODE pNode, uint8_t c) {
+int i;
+  switch (pNode->type) {
+  case OJIART_NODE4:
+    for (i=0; i<pNode->nChildren; ++i) {
+      if (((pOJIARTNODE4) pNode)->keys[i] == c) return ((pOJIARTNODE4) pNode)->children + i;
+    }
+    return 0;
+  case OJIART_NODE16:
+    for (i=0; i<pNode->nChildren && ((pOJIARTNODE16) pNode)->keys[i] < c; ++i) ;
+    if (i < pNode->nChildren && ((pOJIARTNODE16) pNode)->keys[i] == c) return ((pOJIARTNODE16) pNode)->children + i;
+    return 0;
+  case OJIART_NODE48:
+    i = ((pOJIARTNODE48) pNode)->childIndex[c];
+    return i ? ((pOJIARTNODE48) pNode)->children + (i - 1) : (void**) 0;
+  default:
+    return ((pOJIARTNODE256) pNode)->children[c] ? ((pOJIARTNODE256) pNode)->children + c : (void**) 0;
+  }
+}
+
+
+/**********************************************************************/
+/* Leaf with the smallest key below a link */
+static pOJIARTLEAF
+minimumArt(void* p) {
+int i;
+  while (p && !IS_LEAF_ART(p)) {
+    switch (((pOJIARTNODE) p)->type) {
+    case OJIART_NODE4:
+      p = ((pOJIARTNODE4) p)->children[0];
+      break;
+    case OJIART_NODE16:
+      p = ((pOJIARTNODE16) p)->children[0];
+      break;
+    case OJIART_NODE48:
+      for (i=0; !((pOJIARTNODE48) p)->childIndex[i]; ++i) ;
+      p = ((pOJIARTNODE48) p)->children[((pOJIARTNODE48) p)->childIndex[i] - 1];
+      break;
+    default:
+      for (i=0; !((pOJIARTNODE256) p)->children[i]; ++i) ;
+      p = ((pOJIARTNODE256) p)->children[i];
+      break;
+    }
+  }
+  return p ? LEAF_ART(p) : (pOJIARTLEAF) 0;
+}
+
+
+/**********************************************************************/
+/* Add child for key byte c, which is not yet present
+ * - a full node is replaced by the next larger size, and *ppLink, the
+ *   link to it, updated
+ * - returns 0 on success, 1 if allocation failed (tree is unchanged)
+ */
+static int
+addChildArt(pOJIART pTree, pOJIARTNODE pNode, void** ppLink, uint8_t c, void* pChild) {
+pOJIARTNODE pNew;
+int n = pNode->nChildren;
+int i;
+
+  switch (pNode->type) {
+
+  case OJIART_NODE4:
+  case OJIART_NODE16:
+    {
+    uint8_t* keys = pNode->type == OJIART_NODE4 ? ((pOJIARTNODE4) pNode)->keys : ((pOJIARTNODE16) pNode)->keys;
+    void** children = pNode->type == OJIART_NODE4 ? ((pOJIARTNODE4) pNode)->children : ((pOJIARTNODE16) pNode)->children;
+      if (n < (pNode->type == OJIART_NODE4 ? 4 : 16)) {
+        /* Insert in byte order */
+        for (i=0; i<n && keys[i] < c; ++i) ;
+        memmove(keys + i + 1, keys + i, n - i);
+        memmove(children + i + 1, children + i, (n - i) * sizeof(void*));
+        keys[i] = c;
+        children[i] = pChild;
+        ++pNode->nChildren;
+        return 0;
+      }
+      if (pNode->type == OJIART_NODE4) {
+        if (!(pNew = newNodeArt(pTree, OJIART_NODE16))) return 1;
+        memcpy(((pOJIARTNODE16) pNew)->keys, keys, n);
+        memcpy(((pOJIARTNODE16) pNew)->children, children, n * sizeof(void*));
+      } else {
+        if (!(pNew = newNodeArt(pTree, OJIART_NODE48))) return 1;
+        for (i=0; i<n; ++i) {
+          ((pOJIARTNODE48) pNew)->childIndex[keys[i]] = (uint8_t) (i + 1);
+          ((pOJIARTNODE48) pNew)->children[i] = children[i];
+        }
+      }
+    }
+    break;
+
+  case OJIART_NODE48:
+    if (n < 48) {
+      /* Nothing is ever removed, so slots 0..n-1 are in use */
+      ((pOJIARTNODE48) pNode)->childIndex[c] = (uint8_t) (n + 1);
+      ((pOJIARTNODE48) pNode)->children[n] = pChild;
+      ++pNode->nChildren;
+      return 0;
+    }
+    if (!(pNew = newNodeArt(pTree, OJIART_NODE256))) return 1;
+    for (i=0; i<256; ++i) {
+      if (((pOJIARTNODE48) pNode)->childIndex[i]) {
+        ((pOJIARTNODE256) pNew)->children[i] = ((pOJIARTNODE48) pNode)->children[((pOJIARTNODE48) pNode)->childIndex[i] - 1];
+      }
+    }
+    break;
+
+  default:
+    ((pOJIARTNODE256) pNode)->children[c] = pChild;
+    ++pNode->nChildren;
+    return 0;
+  }
+
+  /* Grown:  move header to new node, replace old, and add there */
+  pNew->nChildren = pNode->nChildren;
+  pNew->prefixLen = pNode->prefixLen;
+  memcpy(pNew->prefix, pNode->prefix, OJIART_MAX_PREFIX);
+  *ppLink = pNew;
+  freeNodeArt(pTree, pNode);
+  return addChildArt(pTree, pNew, ppLink, c, pChild);
+} /* addChildArt(...) */
+
+
+/**********************************************************************/
+/* Index of the first byte of pNode's compressed path that differs from
+ * key[depth...]; prefixLen or more if none differs
+ * - bytes beyond the OJIART_MAX_PREFIX kept in the node are compared
+ *   against the smallest key below it, which shares them
+ */
+static uint32_t
+prefixMismatchArt(pOJIARTNODE pNode, const uint8_t* key, uint32_t len1, uint32_t depth) {
+uint32_t maxCmp = MIN_ART(MIN_ART(pNode->prefixLen, OJIART_MAX_PREFIX), len1 - depth);
+uint32_t i;
+pOJIARTLEAF pMin;
+
+  for (i=0; i<maxCmp; ++i) {
+    if (pNode->prefix[i] != key[depth + i]) return i;
+  }
+  if (pNode->prefixLen > OJIART_MAX_PREFIX) {
+    pMin = minimumArt(pNode);
+    maxCmp = MIN_ART(pMin->keyLen + 1, len1) - depth;
+    for ( ; i<maxCmp; ++i) {
+      if ((uint8_t) pMin->keyString[depth + i] != key[depth + i]) return i;
+    }
+  }
+  return i;
+}
+
+
+/**********************************************************************/
+/* Insert leaf into tree; the tree owns the leaf from here on
+ * - a leaf with an equal key is replaced and freed
+ * - returns 1 if leaf was added, 0 if it replaced a leaf, -1 if an
+ *   allocation failed (the leaf is freed; the tree is unchanged)
+ */
+int
+insertOjiArt(pOJIART pTree, pOJIARTLEAF pLeaf) {
+const uint8_t* key;
+uint32_t len1;
+uint32_t depth = 0;
+uint32_t lcp;
+void** ppLink;
+void* p;
+void** ppChild;
+pOJIARTNODE pNode;
+pOJIARTNODE pNew;
+pOJIARTLEAF pOld;
+
+  if (!pTree || !pLeaf) return -1;
+
+  key = (const uint8_t*) pLeaf->keyString;
+  len1 = pLeaf->keyLen + 1;
+  ppLink = &pTree->pRoot;
+
+  for (;;) {
+    p = *ppLink;
+
+    /* Empty link:  add leaf there */
+    if (!p) {
+      *ppLink = TAG_LEAF_ART(pLeaf);
+      ++pTree->count;
+      return 1;
+    }
+
+    /* Leaf:  replace it, or split into a node with both leaves */
+    if (IS_LEAF_ART(p)) {
+      pOld = LEAF_ART(p);
+      if (pOld->keyLen + 1 == len1 && !memcmp(pOld->keyString, key, len1)) {
+        *ppLink = TAG_LEAF_ART(pLeaf);
+        freeLeafArt(pTree, pOld);
+        return 0;
+      }
+      if (!(pNew = newNodeArt(pTree, OJIART_NODE4))) break;
+      for (lcp=0; (uint8_t) pOld->keyString[depth + lcp] == key[depth + lcp]; ++lcp) ;
+      pNew->prefixLen = lcp;
+      memcpy(pNew->prefix, key + depth, MIN_ART(lcp, OJIART_MAX_PREFIX));
+      addChildArt(pTree, pNew, ppLink, (uint8_t) pOld->keyString[depth + lcp], p);
+      addChildArt(pTree, pNew, ppLink, key[depth + lcp], TAG_LEAF_ART(pLeaf));
+      *ppLink = pNew;
+      ++pTree->count;
+      return 1;
+    }
+
+    /* Inner node:  split its compressed path where the key leaves it */
+    pNode = (pOJIARTNODE) p;
+    if (pNode->prefixLen) {
+    uint32_t diff = prefixMismatchArt(pNode, key, len1, depth);
+      if (diff < pNode->prefixLen) {
+        if (!(pNew = newNodeArt(pTree, OJIART_NODE4))) break;
+        pNew->prefixLen = diff;
+        memcpy(pNew->prefix, pNode->prefix, MIN_ART(diff, OJIART_MAX_PREFIX));
+        if (pNode->prefixLen <= OJIART_MAX_PREFIX) {
+          addChildArt(pTree, pNew, ppLink, pNode->prefix[diff], pNode);
+          pNode->prefixLen -= diff + 1;
+          memmove(pNode->prefix, pNode->prefix + diff + 1, MIN_ART(pNode->prefixLen, OJIART_MAX_PREFIX));
+        } else {
+        pOJIARTLEAF pMin = minimumArt(pNode);
+          addChildArt(pTree, pNew, ppLink, (uint8_t) pMin->keyString[depth + diff], pNode);
+          pNode->prefixLen -= diff + 1;
+          memcpy(pNode->prefix, pMin->keyString + depth + diff + 1, MIN_ART(pNode->prefixLen, OJIART_MAX_PREFIX));
+        }
+        addChildArt(pTree, pNew, ppLink, key[depth + diff], TAG_LEAF_ART(pLeaf));
+        *ppLink = pNew;
+        ++pTree->count;
+        return 1;
+      }
+      depth += pNode->prefixLen;
+    }
+
+    /* Descend, or add leaf as a new child */
+    if ((ppChild = findChildArt(pNode, key[depth]))) {
+      ppLink = ppChild;
+      ++depth;
+      continue;
+    }
+    if (addChildArt(pTree, pNode, ppLink, key[depth], TAG_LEAF_ART(pLeaf))) break;
+    ++pTree->count;
+    return 1;
+  }
+
+  /* To here, a node could not be allocated */
+  freeLeafArt(pTree, pLeaf);
+  return -1;
+} /* insertOjiArt(pOJIART pTree, pOJIARTLEAF pLeaf) */
+
+
+/**********************************************************************/
+/* Find leaf matching key, or return NULL
+ * - only the first OJIART_MAX_PREFIX bytes of each compressed path are
+ *   compared on the way down; the leaf's full key is compared at the end
+ */
+pOJIARTLEAF
+getOjiArt(pOJIART pTree, const char* searchKeyString) {
+const uint8_t* key = (const uint8_t*) searchKeyString;
+size_t len1;
+size_t depth = 0;
+size_t n;
+void* p;
+void** ppChild;
+pOJIARTNODE pNode;
+pOJIARTLEAF pLeaf;
+
+  if (!pTree || !searchKeyString) return 0;
+  len1 = strlen(searchKeyString) + 1;
+
+  for (p = pTree->pRoot; p; p = *ppChild, ++depth) {
+    if (IS_LEAF_ART(p)) {
+      pLeaf = LEAF_ART(p);
+      return (pLeaf->keyLen + 1 == len1 && !memcmp(pLeaf->keyString, key, len1)) ? pLeaf : (pOJIARTLEAF) 0;
+    }
+    pNode = (pOJIARTNODE) p;
+    if (pNode->prefixLen) {
+      n = MIN_ART(pNode->prefixLen, OJIART_MAX_PREFIX);
+      if (depth + n > len1 || memcmp(pNode->prefix, key + depth, n)) return 0;
+      depth += pNode->prefixLen;
+    }
+    if (depth >= len1) return 0;
+    if (!(ppChild = findChildArt(pNode, key[depth]))) return 0;
+  }
+  return 0;
+}
+
+
+/**********************************************************************/
+/* Traverse tree in key order, calling handler per leaf with its depth
+ * in inner nodes
+ */
+static void
+traverseOneArt(void* p, int level, void (*handler)(pOJIARTLEAF, int, void**), void** args) {
+pOJIARTNODE pNode = (pOJIARTNODE) p;
+int i;
+  if (!p) return;
+  if (IS_LEAF_ART(p)) {
+    handler(LEAF_ART(p), level, args);
+    return;
+  }
+  switch (pNode->type) {
+  case OJIART_NODE4:
+    for (i=0; i<pNode->nChildren; ++i) traverseOneArt(((pOJIARTNODE4) p)->children[i], level+1, handler, args);
+    break;
+  case OJIART_NODE16:
+    for (i=0; i<pNode->nChildren; ++i) traverseOneArt(((pOJIARTNODE16) p)->children[i], level+1, handler, args);
+    break;
+  case OJIART_NODE48:
+    for (i=0; i<256; ++i) {
+      if (((pOJIARTNODE48) p)->childIndex[i]) {
+        traverseOneArt(((pOJIARTNODE48) p)->children[((pOJIARTNODE48) p)->childIndex[i] - 1], level+1, handler, args);
+      }
+    }
+    break;
+  default:
+    for (i=0; i<256; ++i) traverseOneArt(((pOJIARTNODE256) p)->children[i], level+1, handler, args);
+    break;
+  }
+  return;
+}
+void
+traverseOjiArt(pOJIART pTree, void (*handler)(pOJIARTLEAF, int, void**), void** args) {
+  if (!pTree || !handler) return;
+  traverseOneArt(pTree->pRoot, 0, handler, args);
+  return;
+}
+
+
+/**********************************************************************/
+/* Free all nodes and leaves in tree */
+static void
+cleanupOneArt(pOJIART pTree, void* p) {
+pOJIARTNODE pNode = (pOJIARTNODE) p;
+int i;
+  if (!p) return;
+  if (IS_LEAF_ART(p)) {
+    freeLeafArt(pTree, LEAF_ART(p));
+    return;
+  }
+  switch (pNode->type) {
+  case OJIART_NODE4:
+    for (i=0; i<pNode->nChildren; ++i) cleanupOneArt(pTree, ((pOJIARTNODE4) p)->children[i]);
+    break;
+  case OJIART_NODE16:
+    for (i=0; i<pNode->nChildren; ++i) cleanupOneArt(pTree, ((pOJIARTNODE16) p)->children[i]);
+    break;
+  case OJIART_NODE48:
+    for (i=0; i<pNode->nChildren; ++i) cleanupOneArt(pTree, ((pOJIARTNODE48) p)->children[i]);
+    break;
+  default:
+    for (i=0; i<256; ++i) cleanupOneArt(pTree, ((pOJIARTNODE256) p)->children[i]);
+    break;
+  }
+  freeNodeArt(pTree, pNode);
+  return;
+}
+void
+cleanupOjiArt(pOJIART pTree) {
+  if (!pTree) return;
+  cleanupOneArt(pTree, pTree->pRoot);
+  pTree->pRoot = 0;
+  pTree->count = 0;
+  return;
+}
+
+
+/**********************************************************************/
+/* OJISINK leaf handler:  add one flattened leaf to the tree */
+static int
+sinkLeafOjiArt(pOJISINK pSink, pOJITEM pLocalOji, int lenStrJson) {
+pOJIART pTree = (pOJIART) pSink->arg;
+pOJIARTLEAF pLeaf = newOjiArtLeaf(pTree, pLocalOji, lenStrJson);
+  if (!pLeaf) return -1;
+  return insertOjiArt(pTree, pLeaf) < 0 ? -1 : 1;
+}
+
+
+/**********************************************************************/
+/* Read JSON file, or in-memory JSON, directly into a radix tree
+ * - pTree must have been initialized, e.g. by initOjiArt()
+ * - pOpts as for readOjiAvlOpts, less pSink; may be null
+ * - returns 0 on success, else a readOjiAvl error code; 8 if a leaf or
+ *   node could not be allocated, leaving the tree incomplete
+ */
+static void
+sinkOptsOjiArt(pOJIART pTree, pOJIOPTS pOpts, pOJIOPTS pLocalOpts, pOJISINK pSink) {
+  if (pOpts) { *pLocalOpts = *pOpts; } else { memset(pLocalOpts, 0, sizeof *pLocalOpts); }
+  pSink->leaf = sinkLeafOjiArt;
+  pSink->container = 0;
+  pSink->arg = (void*) pTree;
+  pLocalOpts->pSink = pSink;
+  return;
+}
+int
+readOjiArt(char* filepath, pOJIART pTree, char* pfx, pOJIOPTS pOpts) {
+OJISINK sink;
+OJIOPTS opts;
+  if (!pTree) return 1;
+  sinkOptsOjiArt(pTree, pOpts, &opts, &sink);
+  return readOjiAvlOpts(filepath, 0, pfx, 0, &opts);
+}
+int
+readOjiArtBuffer(const uint8_t* json_buffer, size_t json_len, pOJIART pTree, char* pfx, pOJIOPTS pOpts) {
+OJISINK sink;
+OJIOPTS opts;
+  if (!pTree) return 1;
+  sinkOptsOjiArt(pTree, pOpts, &opts, &sink);
+  return readOjiAvlBuffer(json_buffer, json_len, 0, pfx, &opts);
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// Get one value from radix tree; arguments as for orx_getAnyOji
+void
+orx_getAnyOjiArt(pOJIART pTree, char* searchKeyString
+                , void *pOut, int *pFound
+                , OJIENUM requestedOjiType, int stringOutSize) {
+pOJIARTLEAF pLeaf;
+
+  if (!pFound) return;
+  *pFound = 0;
+
+  if (!searchKeyString) return;
+  if (!pOut) return;
+
+  if (!(pLeaf = getOjiArt(pTree, searchKeyString))) return;
+  *pFound = orx_copyOutOji(pLeaf->payloadType, &pLeaf->uPayload, OJIART_TEXT(pLeaf)
+                          , pOut, requestedOjiType, stringOutSize);
+  return;
+} /* orx_getAnyOjiArt(...) */
+
+
+// Convenience wrappers for orx_getAnyOjiArt
+void
+orx_getNullOjiArt(pOJIART pTree, char* searchKeyString, int *pFound) {
+void* pOut = (void*) 1;
+  orx_getAnyOjiArt(pTree, searchKeyString, pOut, pFound, OJI_NULL, 0);
+  return;
+}
+void
+orx_getDoubleOjiArt(pOJIART pTree, char* searchKeyString, double *pOut, int *pFound) {
+  orx_getAnyOjiArt(pTree, searchKeyString, (void*)pOut, pFound, OJI_SCALAR, 0);
+  return;
+}
+void
+orx_getInt64OjiArt(pOJIART pTree, char* searchKeyString, int64_t *pOut, int *pFound) {
+  orx_getAnyOjiArt(pTree, searchKeyString, (void*)pOut, pFound, OJI_INTEGER, 0);
+  return;
+}
+void
+orx_getBooleanOjiArt(pOJIART pTree, char* searchKeyString, OJIBOOL *pOut, int *pFound) {
+  orx_getAnyOjiArt(pTree, searchKeyString, (void*)pOut, pFound, OJI_BOOLEAN, 0);
+  return;
+}
+void
+orx_getStringOjiArt(pOJIART pTree, char* searchKeyString, int stringOutSize, char *pOut, int *pFound) {
+  orx_getAnyOjiArt(pTree, searchKeyString, (void*)pOut, pFound, OJI_STRING, stringOutSize);
+  return;
+}
+/**********************************************************************/
+/*** End of library functions ****************************************/
+/**********************************************************************/
+
+
+#ifdef DO_MAIN
+/**********************************************************************/
+/*** Test program ***/
+/*
+ * Usage:
+ *
+ *   ./test_orx_art a.json [b.json ...]
+ *
+ * - Load each file into both an OJI AVL tree and a radix tree, and
+ *   compare key order and all values
+ * - Check node growth, long compressed paths and replacement with
+ *   generated keys
+ * - Benchmark both backends on synthetic corpora:  build time, lookup
+ *   latency and bytes per key
+ *
+ * Compile and link:
+ *
+ *  % gcc -DDO_MAIN orx_art.c -o test_orx_art -pthread -lm
+ *
+ */
+#include "jsmn.c"
+#include "avltree.c"
+#include "synth_json.c"
+#define main MAIN_BUFFILE
+#include "buffer_file.c"
+#undef main
+#undef DO_MAIN
+#include "orx_parsejson.c"
+#define DO_MAIN
+
+#include "orx_test.h"
+
+/* Traversal callback:  leaf must match the next OJITEM in the AVL tree */
+static void
+compareOneArt(pOJIARTLEAF pLeaf, int level, void** args) {
+pAVLTREE* ppNext = (pAVLTREE*) args[0];
+pOJITEM pOji = *ppNext ? (pOJITEM) (*ppNext)->payload : (pOJITEM) 0;
+char* pText = OJIART_TEXT(pLeaf);
+  (void) level;
+  CHECK(pOji && !strcmp(pOji->keyString, pLeaf->keyString));
+  if (!pOji) return;
+  CHECK(pLeaf->payloadType == pOji->payloadType);
+  CHECK(!pText || !strcmp(pText, pOji->sPayload));
+  *ppNext = nextAvl(*ppNext);
+  ++*(size_t*) args[1];
+  return;
+}
+
+/* Compare values of every key of an AVL tree with the radix tree */
+static void
+compareValuesArt(pAVLTREE pAvlRoot, pOJIART pTree) {
+pAVLTREE pAvl;
+pOJITEM pOji;
+char s[BUFSIZ];
+double d;
+int64_t i64;
+OJIBOOL b;
+int found;
+  for (pAvl = firstAvl(pAvlRoot); pAvl; pAvl = nextAvl(pAvl)) {
+    pOji = (pOJITEM) pAvl->payload;
+    found = 0;
+    switch (pOji->payloadType) {
+    case OJI_NULL:
+      orx_getNullOjiArt(pTree, pOji->keyString, &found);
+      break;
+    case OJI_BOOLEAN:
+      orx_getBooleanOjiArt(pTree, pOji->keyString, &b, &found);
+      found &= (b == pOji->uPayload.aBool);
+      break;
+    case OJI_SCALAR:
+      orx_getDoubleOjiArt(pTree, pOji->keyString, &d, &found);
+      found &= (d == pOji->uPayload.aScalar);
+      break;
+    case OJI_INTEGER:
+      orx_getInt64OjiArt(pTree, pOji->keyString, &i64, &found);
+      found &= (i64 == pOji->uPayload.anInteger);
+      orx_getDoubleOjiArt(pTree, pOji->keyString, &d, &found);
+      found &= (d == (double) pOji->uPayload.anInteger);
+      break;
+    case OJI_STRING:
+      orx_getStringOjiArt(pTree, pOji->keyString, sizeof s, s, &found);
+      found &= !strcmp(s, pOji->uPayload.aString);
+      break;
+    default:
+      found = getOjiArt(pTree, pOji->keyString) ? 1 : 0;
+      break;
+    }
+    if (!found) {
+      fprintf(stderr, "Mismatch at key [%s]\n", pOji->keyString);
+      ++errors;
+    }
+  }
+  return;
+}
+
+/* Load json both ways; compare order, count and values */
+static void
+compareLoadsArt(const char* json, size_t len, pAVLTREE* ppAvlTree, pOJIART pTree) {
+void* args[2];
+pAVLTREE pNext;
+size_t n = 0;
+  CHECK(!readOjiAvlBuffer((const uint8_t*) json, len, ppAvlTree, 0, 0));
+  CHECK(!readOjiArtBuffer((const uint8_t*) json, len, pTree, 0, 0));
+  pNext = firstAvl(*ppAvlTree);
+  args[0] = (void*) &pNext;
+  args[1] = (void*) &n;
+  traverseOjiArt(pTree, compareOneArt, args);
+  CHECK(!pNext && n == pTree->count);
+  compareValuesArt(*ppAvlTree, pTree);
+  CHECK(!getOjiArt(pTree, "json.no_such_key") && !getOjiArt(pTree, "") && !getOjiArt(pTree, "js"));
+  return;
+}
+
+/* Generated keys:  every node size, long shared paths, replacement */
+static int
+compareKeysArt(const void* p1, const void* p2) {
+  return strcmp(*(char**) p1, *(char**) p2);
+}
+static void
+orderOneArt(pOJIARTLEAF pLeaf, int level, void** args) {
+char*** pppKey = (char***) args[0];
+  (void) level;
+  CHECK(!strcmp(**pppKey, pLeaf->keyString));
+  ++*pppKey;
+  return;
+}
+static void
+testKeysArt(void) {
+enum { NKEYS = 600 };
+static char store[NKEYS][80];
+char* keys[NKEYS];
+char** ppKey;
+void* args[1];
+OJIART tree;
+OJITEM oji;
+pOJIARTLEAF pLeaf;
+char longPath[41];
+int i;
+int n = 0;
+int64_t i64;
+int found;
+
+  initOjiArt(&tree, 0);
+  memset(longPath, 'p', 40);
+  longPath[40] = '\0';
+
+  /* Every byte value after a shared prefix:  NODE4 ... NODE256 */
+  for (i=1; i<256; ++i) { sprintf(store[n++], "json.byte%c", i); }
+  /* Long compressed paths, split before, within, and past the kept part */
+  for (i=0; i<40; ++i) { sprintf(store[n++], "json.%.*sX%d", i, longPath, i); }
+  for (i=0; i<40; ++i) { sprintf(store[n++], "json.%s.%d", longPath, i); }
+  sprintf(store[n++], "json.%s", longPath);
+  /* Numbered keys, as from arrays */
+  for (i=0; n<NKEYS; ++i) { sprintf(store[n++], "json.array[%d]", i); }
+
+  memset(&oji, 0, sizeof oji);
+  oji.payloadType = OJI_INTEGER;
+  oji.sPayload = "";
+  for (i=0; i<NKEYS; ++i) {
+    keys[i] = store[(i * 7) % NKEYS];
+    oji.keyString = keys[i];
+    oji.uPayload.anInteger = i;
+    CHECK(insertOjiArt(&tree, newOjiArtLeaf(&tree, &oji, 0)) == 1);
+  }
+  CHECK(tree.count == NKEYS);
+  CHECK(tree.nodeCounts[OJIART_NODE256] >= 1);
+
+  /* Replace:  count unchanged, new value */
+  oji.keyString = keys[3];
+  oji.uPayload.anInteger = -1;
+  CHECK(insertOjiArt(&tree, newOjiArtLeaf(&tree, &oji, 0)) == 0);
+  orx_getInt64OjiArt(&tree, keys[3], &i64, &found);
+  CHECK(found && i64 == -1 && tree.count == NKEYS);
+
+  for (i=0; i<NKEYS; ++i) {
+    CHECK((pLeaf = getOjiArt(&tree, keys[i])) && !strcmp(pLeaf->keyString, keys[i]));
+  }
+  CHECK(!getOjiArt(&tree, "json.pppp") && !getOjiArt(&tree, "json.byte") && !getOjiArt(&tree, "json.array[600]"));
+
+  qsort(keys, NKEYS, sizeof(char*), compareKeysArt);
+  ppKey = keys;
+  args[0] = (void*) &ppKey;
+  traverseOjiArt(&tree, orderOneArt, args);
+  CHECK(ppKey == keys + NKEYS);
+
+  cleanupOjiArt(&tree);
+  CHECK(tree.nodeBytes == 0 && tree.leafBytes == 0);
+  return;
+}
+
+/* Allocator over malloc that fails once *(long*) arg allocations have
+ * been made; arg counts down
+ */
+static void* budgetAllocArt(pORXALLOC pAlloc, size_t size) {
+  if (*(long*) pAlloc->arg <= 0) return (void*) 0;
+  --*(long*) pAlloc->arg;
+  return malloc(size);
+}
+static void* budgetReallocArt(pORXALLOC pAlloc, void* ptr, size_t oldSize, size_t newSize) {
+  (void) oldSize;
+  if (*(long*) pAlloc->arg <= 0) return (void*) 0;
+  --*(long*) pAlloc->arg;
+  return realloc(ptr, newSize);
+}
+static void budgetReleaseArt(pORXALLOC pAlloc, void* ptr) {
+  (void) pAlloc;
+  free(ptr);
+}
+
+/* Each leaf or node allocation that fails leaves the tree short, and
+ * the load returns 8
+ */
+static void
+testAllocFailArt(void) {
+static const char* json = "{\"a\":1,\"ab\":[true,\"x\"],\"b\":{\"c\":null}}";
+ORXALLOC budget = { budgetAllocArt, budgetReallocArt, budgetReleaseArt, 0 };
+OJIART tree;
+long left = 1L << 30;
+long used;
+size_t count;
+long i;
+
+  budget.arg = (void*) &left;
+  initOjiArt(&tree, &budget);
+  CHECK(!readOjiArtBuffer((const uint8_t*) json, strlen(json), &tree, 0, 0));
+  used = (1L << 30) - left;
+  count = tree.count;
+  cleanupOjiArt(&tree);
+  CHECK(used > 0 && count == 5);
+
+  for (i=0; i<used; ++i) {
+    left = i;
+    initOjiArt(&tree, &budget);
+    CHECK(readOjiArtBuffer((const uint8_t*) json, strlen(json), &tree, 0, 0) == 8);
+    CHECK(tree.count < count);
+    cleanupOjiArt(&tree);
+  }
+  return;
+}
+
+/* Bytes per key of an OJI AVL tree, as in test_orx_compact */
+static size_t
+avlBytesArt(pAVLTREE pAvlRoot) {
+pAVLTREE pAvl;
+pOJITEM pOji;
+size_t bytes = 0;
+  for (pAvl = firstAvl(pAvlRoot); pAvl; pAvl = nextAvl(pAvl)) {
+    pOji = (pOJITEM) pAvl->payload;
+    bytes += sizeof(OJITEM) + strlen(pOji->keyString) + strlen(pOji->sPayload) + 2;
+  }
+  return bytes;
+}
+
+/* Build, lookup and memory per key, AVL versus radix tree */
+static void
+benchArt(const char* name, const char* json, size_t len) {
+pAVLTREE pAvlTree = 0;
+pAVLTREE pAvl;
+OJIART tree;
+char** keys;
+char* swap;
+size_t n;
+size_t i;
+size_t j;
+unsigned long rng = 12345;
+double tAvlBuild;
+double tArtBuild;
+double tAvlGet;
+double tArtGet;
+int misses = 0;
+
+  initOjiArt(&tree, 0);
+  tAvlBuild = ojiSeconds();
+  CHECK(!readOjiAvlBuffer((const uint8_t*) json, len, &pAvlTree, 0, 0));
+  tAvlBuild = ojiSeconds() - tAvlBuild;
+  tArtBuild = ojiSeconds();
+  CHECK(!readOjiArtBuffer((const uint8_t*) json, len, &tree, 0, 0));
+  tArtBuild = ojiSeconds() - tArtBuild;
+
+  /* Look up every key, in shuffled order */
+  n = tree.count;
+  if (!(keys = malloc((n ? n : 1) * sizeof(char*)))) { ++errors; return; }
+  for (i=0, pAvl=firstAvl(pAvlTree); pAvl && i<n; pAvl=nextAvl(pAvl)) { keys[i++] = ((pOJITEM) pAvl->payload)->keyString; }
+  CHECK(i == n && !pAvl);
+  for (i=n; i>1; --i) {
+    rng = rng * 6364136223846793005UL + 1442695040888963407UL;
+    j = (rng >> 33) % i;
+    swap = keys[i-1]; keys[i-1] = keys[j]; keys[j] = swap;
+  }
+  tAvlGet = ojiSeconds();
+  for (i=0; i<n; ++i) { misses += !orx_getOji(pAvlTree, keys[i]); }
+  tAvlGet = ojiSeconds() - tAvlGet;
+  tArtGet = ojiSeconds();
+  for (i=0; i<n; ++i) { misses += !getOjiArt(&tree, keys[i]); }
+  tArtGet = ojiSeconds() - tArtGet;
+  CHECK(!misses);
+
+  fprintf(stdout, "%-12s %7lu keys; build AVL %.4fs, ART %.4fs; lookup AVL %.0fns, ART %.0fns"
+                  "; bytes/key AVL %.1f, ART %.1f (nodes %.1f; %lu/%lu/%lu/%lu)\n"
+         , name, (unsigned long) n, tAvlBuild, tArtBuild
+         , n ? 1e9 * tAvlGet / n : 0.0, n ? 1e9 * tArtGet / n : 0.0
+         , n ? (double) avlBytesArt(pAvlTree) / n : 0.0
+         , n ? (double) (tree.nodeBytes + tree.leafBytes) / n : 0.0
+         , n ? (double) tree.nodeBytes / n : 0.0
+         , (unsigned long) tree.nodeCounts[OJIART_NODE4], (unsigned long) tree.nodeCounts[OJIART_NODE16]
+         , (unsigned long) tree.nodeCounts[OJIART_NODE48], (unsigned long) tree.nodeCounts[OJIART_NODE256]);
+
+  free(keys);
+  cleanupAVL(&pAvlTree);
+  cleanupOjiArt(&tree);
+  return;
+}
+
+int
+main(int argc, char** argv) {
+SYNTHJSON synth;
+pAVLTREE pAvlTree = 0;
+OJIART tree;
+uint8_t* file;
+char* json;
+size_t len;
+int fileErrors;
+
+  while (--argc > 0) {
+    fileErrors = errors;
+    if (!(file = buffile_file_to_puint8(argv[argc], &len, 0))) {
+      fprintf(stderr, "Cannot read %s\n", argv[argc]);
+      ++errors;
+      continue;
+    }
+    initOjiArt(&tree, 0);
+    compareLoadsArt((const char*) file, len, &pAvlTree, &tree);
+    fprintf(stdout, "%s:  %s; %lu keys\n", argv[argc], errors > fileErrors ? "FAILED" : "OK", (unsigned long) tree.count);
+    cleanupAVL(&pAvlTree);
+    cleanupOjiArt(&tree);
+    free(file);
+  }
+
+  testKeysArt();
+  testAllocFailArt();
+
+  /* Synthetic corpora:  compare, then benchmark */
+  memset(&synth, 0, sizeof synth);
+  synth.seed = 42;
+  synth.targetBytes = 1 << 18;
+  if ((json = synthJson(&synth, &len))) {
+    initOjiArt(&tree, 0);
+    compareLoadsArt(json, len, &pAvlTree, &tree);
+    cleanupAVL(&pAvlTree);
+    cleanupOjiArt(&tree);
+    benchArt("synth", json, len);
+    free(json);
+  } else {
+    ++errors;
+  }
+
+  synth.seed = 7;
+  synth.maxDepth = 16;
+  synth.maxWidth = 3;
+  synth.targetBytes = 1 << 17;
+  if ((json = synthJson(&synth, &len))) {
+    benchArt("synth deep", json, len);
+    free(json);
+  } else {
+    ++errors;
+  }
+
+  fprintf(stdout, "test_orx_art:  %s\n", errors ? "FAILED" : "OK");
+  return errors ? 1 : 0;
+}
+#endif // DO_MAIN
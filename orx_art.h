@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////
+// Adaptive radix tree (ART) of flattened JSON keys:  an alternative to
+// OJITEM + AVLTREE
+//
+// Flattened keys are long and share long prefixes ("json.a.b[12].c"),
+// which a comparison tree compares again at every level.  A radix tree
+// reads each key byte once on the way down:
+//
+// - inner nodes branch on one key byte, and grow through four sizes as
+//   children are added:  4 and 16 (sorted byte list), 48 (byte index
+//   into a child list), and 256 (direct child array)
+// - a run of bytes shared by every key below a node is stored once, in
+//   the node (path compression); up to OJIART_MAX_PREFIX bytes are kept
+//   in the node, and longer runs are checked against the key of a leaf
+// - leaves (OJIARTLEAF) hold the full key, the decoded payload and, for
+//   strings and unknowns, the payload text
+// - the key terminator '\0' is the last byte of every key, so no key is
+//   a prefix of another, and byte order gives the same order as strcmp
+//
+// Load with readOjiArt or readOjiArtBuffer in place of readOjiAvl*,
+// then use orx_get*OjiArt, getOjiArt and traverseOjiArt as orx_get*Oji,
+// orx_getOji and traverseFromRightAvl.
+//
+// Child links to leaves are tagged in their low bit, so allocations must
+// be at least 2-byte aligned.
+//
+////////////////////////////////////////////////////////////////////////
+#ifndef __ORX_ART_H__
+#define __ORX_ART_H__
+
+#include <stdint.h>
+
+#include "orx_parsejson.h"
+#include "orx_alloc.h"
+
+#define OJIART_MAX_PREFIX 16
+
+typedef enum
+{ OJIART_NODE4=1
+, OJIART_NODE16
+, OJIART_NODE48
+, OJIART_NODE256
+} OJIARTTYPE;
+
+/* Inner node header; a 24-byte prefix of every inner node */
+typedef struct OJIARTNODEstr {
+  uint8_t type;            // OJIARTTYPE
+  uint8_t unused;
+  uint16_t nChildren;
+  uint32_t prefixLen;      // Bytes of compressed path below parent's byte
+  uint8_t prefix[OJIART_MAX_PREFIX];  // First of those bytes
+} OJIARTNODE, *pOJIARTNODE;
+
+typedef struct OJIARTLEAFstr {
+  union {                  // uPayload:  as in OJITEM, less string pointer
+    OJIBOOL aBool;
+    double aScalar;
+    int64_t anInteger;
+  } uPayload;
+  uint32_t keyLen;         // strlen(keyString)
+  uint32_t textLen;        // Length of payload text, if kept
+  uint8_t payloadType;     // OJIENUM
+  uint8_t hasText;         // Set if payload text follows key
+  char keyString[];        // Key, '\0', then payload text and '\0' if any
+} OJIARTLEAF, *pOJIARTLEAF;
+
+typedef struct OJIARTstr {
+  void* pRoot;             // Inner node, or tagged leaf, or null
+  size_t count;            // Number of leaves
+  size_t nodeBytes;        // Statistics:  bytes in inner nodes
+  size_t leafBytes;        // Statistics:  bytes in leaves
+  size_t nodeCounts[5];    // Statistics:  inner nodes by OJIARTTYPE
+  pORXALLOC pAlloc;        // Nodes and leaves; null for malloc
+} OJIART, *pOJIART;
+
+/* Payload text of a leaf, or null */
+#define OJIART_TEXT(P) ((P)->hasText ? ((P)->keyString + (P)->keyLen + 1) : (char*)0)
+
+void initOjiArt(pOJIART pTree, pORXALLOC pAlloc);
+pOJIARTLEAF newOjiArtLeaf(pOJIART pTree, pOJITEM pSource, int lenStrJson);
+int insertOjiArt(pOJIART pTree, pOJIARTLEAF pLeaf);
+pOJIARTLEAF getOjiArt(pOJIART pTree, const char* searchKeyString);
+void traverseOjiArt(pOJIART pTree, void (*handler)(pOJIARTLEAF, int, void**), void** args);
+void cleanupOjiArt(pOJIART pTree);
+
+int readOjiArt(char* filepath, pOJIART pTree, char* pfx, pOJIOPTS pOpts);
+int readOjiArtBuffer(const uint8_t* json_buffer, size_t json_len, pOJIART pTree, char* pfx, pOJIOPTS pOpts);
+
+void orx_getAnyOjiArt(pOJIART pTree, char* searchKeyString, void *pOut, int *pFound, OJIENUM requestedOjiType, int stringOutSize);
+void orx_getNullOjiArt(pOJIART pTree, char* searchKeyString, int* pFound);
+void orx_getDoubleOjiArt(pOJIART pTree, char* searchKeyString, double* pOut, int* pFound);
+void orx_getInt64OjiArt(pOJIART pTree, char* searchKeyString, int64_t* pOut, int* pFound);
+void orx_getBooleanOjiArt(pOJIART pTree, char* searchKeyString, OJIBOOL* pOut, int* pFound);
+void orx_getStringOjiArt(pOJIART pTree, char* searchKeyString, int stringOutSize, char* pOut, int* pFound);
+
+#endif // __ORX_ART_H__
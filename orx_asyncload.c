@@ -0,0 +1,553 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "jsmn.h"
+#include "buffer_file.h"
+#include "orx_asyncload.h"
+
+
+/**********************************************************************/
+/* Handle for one asynchronous load */
+struct ORXASYNCstr {
+  char* filepath;                  // Copy of file path argument
+  char* pfx;                       // Copy of key prefix argument, or null
+  OJIOPTS opts;                    // Copy of caller's load settings
+  ORXASYNCCALLBACK callback;       // Completion callback, or null
+  void* cbArg;                     // Argument for callback
+
+  pthread_t loader;                // Tokenizes and flattens
+  pthread_t reader;                // Reads file into chunk[]
+  pthread_mutex_t mutex;           // Guards all fields below
+  pthread_cond_t cond;             // Signals chunk and state changes
+
+  uint8_t chunk[2][ORXASYNC_CHUNK_SIZE];  // Double-buffered file data
+  size_t chunkLen[2];              // Bytes in each chunk
+  int chunkFull[2];                // Set by reader, cleared by loader
+  int readDone;                    // Reader reached EOF or failed
+  int readError;                   // Reader failed to open or read
+  int abort;                       // Loader failed; reader should stop
+
+  ORXASYNCSTATE state;             // Pending/done/failed
+  int rtn;                         // readOjiAvl-style return code
+  pAVLTREE pAvlTree;               // Result tree
+};
+
+
+/**********************************************************************/
+/* Free handle resources; threads must have been joined */
+static void
+asyncFree(pORXASYNC pAsync) {
+  if (!pAsync) return;
+  cleanupAVL(&pAsync->pAvlTree);
+  pthread_cond_destroy(&pAsync->cond);
+  pthread_mutex_destroy(&pAsync->mutex);
+  if (pAsync->filepath) { free(pAsync->filepath); }
+  if (pAsync->pfx) { free(pAsync->pfx); }
+  free(pAsync);
+  return;
+}
+
+
+/**********************************************************************/
+/* Reader thread:  fill chunk[0], chunk[1], chunk[0], ... from the file
+ * - a compressed file is decompressed here, so decompressing chunk N+1
+ *   overlaps with tokenizing chunk N
+ * - a chunk with zero length marks EOF
+ */
+static void*
+asyncReader(void* pVoid) {
+pORXASYNC pAsync = (pORXASYNC) pVoid;
+BUFFILESRC src;
+int opened = !buffile_open(&src, pAsync->filepath);
+int k = 0;
+int stop;
+size_t n_read;
+
+  while (opened) {
+
+    /* Wait for loader to release chunk k */
+    pthread_mutex_lock(&pAsync->mutex);
+    while (pAsync->chunkFull[k] && !pAsync->abort) {
+      pthread_cond_wait(&pAsync->cond, &pAsync->mutex);
+    }
+    stop = pAsync->abort;
+    pthread_mutex_unlock(&pAsync->mutex);
+    if (stop) break;
+
+    /* Read outside the lock; loader may be tokenizing the other chunk */
+    n_read = buffile_read(&src, pAsync->chunk[k], ORXASYNC_CHUNK_SIZE);
+
+    pthread_mutex_lock(&pAsync->mutex);
+    if (src.error) { pAsync->readError = 1; n_read = 0; }
+    pAsync->chunkLen[k] = n_read;
+    pAsync->chunkFull[k] = 1;
+    pthread_cond_broadcast(&pAsync->cond);
+    pthread_mutex_unlock(&pAsync->mutex);
+
+    if (!n_read) break;
+    k ^= 1;
+  }
+
+  pthread_mutex_lock(&pAsync->mutex);
+  if (!opened) { pAsync->readError = 1; }
+  pAsync->readDone = 1;
+  pthread_cond_broadcast(&pAsync->cond);
+  pthread_mutex_unlock(&pAsync->mutex);
+
+  if (opened) buffile_close(&src);
+  return pVoid;
+} /* asyncReader(void* pVoid) */
+
+
+/**********************************************************************/
+/* Length of the leading part of a partly-read JSON buffer that jsmn can
+ * tokenize without mistaking a truncated primitive for a complete one
+ * - i.e. up to and including the last delimiter; truncated strings are
+ *   already handled by jsmn, which rewinds and returns JSMN_ERROR_PART
+ */
+static size_t
+asyncSafeLength(const uint8_t* data, size_t len) {
+  while (len > 0) {
+    switch (data[len-1]) {
+    case ' ': case '\t': case '\r': case '\n':
+    case ',': case ':': case ']': case '}': case '[': case '{':
+      return len;
+    default:
+      --len;
+    }
+  }
+  return 0;
+}
+
+
+/**********************************************************************/
+/* Run jsmn_parse over json_len bytes, growing token array as needed */
+static int
+asyncTokenize(jsmn_parser* pJp, const uint8_t* json_buffer, size_t json_len
+             , jsmntok_t** ppToks, size_t* pTokcount, pOJISTATS pStats, pORXALLOC pAlloc) {
+int parse_rtn;
+
+  while (JSMN_ERROR_NOMEM == (parse_rtn = jsmn_parse(pJp, (const char*) json_buffer, json_len, *ppToks, *pTokcount))) {
+  jsmntok_t* pNew = orx_realloc(pAlloc, *ppToks, sizeof(jsmntok_t) * *pTokcount, sizeof(jsmntok_t) * (*pTokcount << 1));
+    OJISTAT(pStats, ++pStats->parsePasses; ++pStats->reallocCount;
+                    pStats->allocBytes += sizeof(jsmntok_t) * (*pTokcount << 1));
+    if (!pNew) return JSMN_ERROR_NOMEM;
+    *ppToks = pNew;
+    *pTokcount <<= 1;
+  }
+  OJISTAT(pStats, ++pStats->parsePasses);
+  return parse_rtn;
+}
+
+
+/**********************************************************************/
+/* Loader thread:  append chunks to buffer, tokenize completed data
+ * while next chunk is read, then flatten tokens into OJI AVL tree
+ */
+static void*
+asyncLoader(void* pVoid) {
+pORXASYNC pAsync = (pORXASYNC) pVoid;
+pOJISTATS pStats = pAsync->opts.pStats;
+pORXALLOC pAlloc = pAsync->opts.pAlloc;
+BUFFILE buffile;
+pBUFFILE pBuffile = &buffile;
+size_t tokcount = 64;
+jsmntok_t* pToks = orx_malloc(pAlloc, sizeof(jsmntok_t) * tokcount);
+jsmn_parser jp;
+int parse_rtn = 0;
+int rtn = 0;
+int k = 0;
+int eof = 0;
+int readerStarted = 0;
+size_t safe_len;
+
+  buffile_init_alloc(&buffile, 0, pAlloc);
+  jsmn_init(&jp);
+  OJISTAT(pStats, ++pStats->mallocCount; pStats->allocBytes += sizeof(jsmntok_t) * tokcount);
+  if (!pToks) { rtn = 3; }
+
+  if (!rtn) {
+    if (pthread_create(&pAsync->reader, 0, asyncReader, pAsync)) { rtn = 2; }
+    else { readerStarted = 1; }
+  }
+
+  while (!rtn && !eof) {
+
+    /* Wait for chunk k, append it to buffer, release it to reader */
+    pthread_mutex_lock(&pAsync->mutex);
+    while (!pAsync->chunkFull[k] && !pAsync->readDone) {
+      pthread_cond_wait(&pAsync->cond, &pAsync->mutex);
+    }
+    if (pAsync->readError) {
+      rtn = 2;
+    } else if (!pAsync->chunkFull[k] || !pAsync->chunkLen[k]) {
+      eof = 1;
+    } else if (!(pBuffile = buffile_write(pBuffile, 1, pAsync->chunkLen[k], pAsync->chunk[k]))) {
+      rtn = 2;
+    }
+    pAsync->chunkFull[k] = 0;
+    pthread_cond_broadcast(&pAsync->cond);
+    pthread_mutex_unlock(&pAsync->mutex);
+    k ^= 1;
+
+    if (rtn || eof) break;
+
+    /* Tokenize what has arrived so far; containers are still open so
+     * JSMN_ERROR_PART is expected here
+     */
+    safe_len = asyncSafeLength(buffile.data, buffile.len);
+    if (safe_len > jp.pos) {
+      parse_rtn = asyncTokenize(&jp, buffile.data, safe_len, &pToks, &tokcount, pStats, pAlloc);
+      if (parse_rtn == JSMN_ERROR_NOMEM) { rtn = 3; }
+      if (parse_rtn == JSMN_ERROR_INVAL) { rtn = 4; }
+    }
+  }
+
+  /* Stop the reader, e.g. after a failure, and wait for it */
+  pthread_mutex_lock(&pAsync->mutex);
+  pAsync->abort = 1;
+  pthread_cond_broadcast(&pAsync->cond);
+  pthread_mutex_unlock(&pAsync->mutex);
+  if (readerStarted) { pthread_join(pAsync->reader, 0); }
+
+  /* Tokenize the remainder, and build the tree */
+  if (!rtn && !buffile.len) { rtn = 2; }
+  if (!rtn) {
+    OJISTAT(pStats, pStats->bytesRead += buffile.len;
+                    pStats->reallocCount += buffile.reallocs;
+                    pStats->allocBytes += buffile.limit);
+    parse_rtn = asyncTokenize(&jp, buffile.data, buffile.len, &pToks, &tokcount, pStats, pAlloc);
+    if (parse_rtn == JSMN_ERROR_NOMEM) {
+      rtn = 3;
+    } else {
+      rtn = dumpTokensOjiAvl(&pAsync->pAvlTree, buffile.data, pToks, jp.toknext, parse_rtn, pAsync->pfx, &pAsync->opts);
+    }
+  }
+
+  if (buffile.data) { orx_free(pAlloc, buffile.data); }
+  if (pToks) { orx_free(pAlloc, pToks); }
+
+  pthread_mutex_lock(&pAsync->mutex);
+  pAsync->rtn = rtn;
+  pAsync->state = rtn ? ORXASYNC_FAILED : ORXASYNC_DONE;
+  pthread_cond_broadcast(&pAsync->cond);
+  pthread_mutex_unlock(&pAsync->mutex);
+
+  if (pAsync->callback) { pAsync->callback(pAsync, rtn, pAsync->cbArg); }
+
+  return pVoid;
+} /* asyncLoader(void* pVoid) */
+
+
+/**********************************************************************/
+/* Start loading filepath asynchronously
+ * - pfx, pOpts, callback and cbArg may be null
+ * - *pOpts is copied, but anything it points to (e.g. *pOpts->pStats)
+ *   must remain valid, and not be read, until the load is complete
+ * - returns handle, or null if the load could not be started
+ */
+pORXASYNC
+orx_asyncLoad(char* filepath, char* pfx, pOJIOPTS pOpts, ORXASYNCCALLBACK callback, void* cbArg) {
+pORXASYNC pAsync;
+
+  if (!filepath) return 0;
+  if (!(pAsync = calloc(1, sizeof(ORXASYNC)))) return 0;
+
+  pthread_mutex_init(&pAsync->mutex, 0);
+  pthread_cond_init(&pAsync->cond, 0);
+  if (pOpts) { pAsync->opts = *pOpts; }
+  pAsync->callback = callback;
+  pAsync->cbArg = cbArg;
+  pAsync->state = ORXASYNC_PENDING;
+
+  pAsync->filepath = strdup(filepath);
+  pAsync->pfx = pfx ? strdup(pfx) : 0;
+
+  if (!pAsync->filepath || (pfx && !pAsync->pfx)
+   || pthread_create(&pAsync->loader, 0, asyncLoader, pAsync)) {
+    asyncFree(pAsync);
+    return 0;
+  }
+  return pAsync;
+}
+
+
+/**********************************************************************/
+/* Return current state of load without blocking */
+ORXASYNCSTATE
+orx_asyncPoll(pORXASYNC pAsync) {
+ORXASYNCSTATE state;
+  if (!pAsync) return ORXASYNC_FAILED;
+  pthread_mutex_lock(&pAsync->mutex);
+  state = pAsync->state;
+  pthread_mutex_unlock(&pAsync->mutex);
+  return state;
+}
+
+
+/**********************************************************************/
+/* Block until load is complete; return final state */
+ORXASYNCSTATE
+orx_asyncWait(pORXASYNC pAsync) {
+ORXASYNCSTATE state;
+  if (!pAsync) return ORXASYNC_FAILED;
+  pthread_mutex_lock(&pAsync->mutex);
+  while (pAsync->state == ORXASYNC_PENDING) {
+    pthread_cond_wait(&pAsync->cond, &pAsync->mutex);
+  }
+  state = pAsync->state;
+  pthread_mutex_unlock(&pAsync->mutex);
+  return state;
+}
+
+
+/**********************************************************************/
+/* Wait for load, hand tree to caller, and free the handle
+ * - on success, the loaded items are inserted into *ppAvlTree, which may
+ *   already hold other items; on failure *ppAvlTree is left unchanged
+ * - returns 0 on success, else a readOjiAvl error code
+ */
+int
+orx_asyncFinish(pORXASYNC pAsync, ppAVLTREE ppAvlTree) {
+int rtn;
+
+  if (!pAsync) return 1;
+  pthread_join(pAsync->loader, 0);
+  rtn = pAsync->rtn;
+
+  if (!rtn && ppAvlTree) {
+    if (!*ppAvlTree) {
+      /* Hand over whole tree; re-point root link at caller's pointer */
+      if ((*ppAvlTree = pAsync->pAvlTree)) { (*ppAvlTree)->ppSelf = ppAvlTree; }
+      pAsync->pAvlTree = 0;
+    } else {
+      /* Move items one at a time into caller's non-empty tree */
+      while (pAsync->pAvlTree) {
+      pAVLTREE pMove = pAsync->pAvlTree;
+        while (pMove->pLeft) pMove = pMove->pLeft;
+        /* Unlink leftmost node; it has no left child */
+        *pMove->ppSelf = pMove->pRight;
+        if (pMove->pRight) {
+          pMove->pRight->ppSelf = pMove->ppSelf;
+          pMove->pRight->pParent = pMove->pParent;
+        }
+        insertAvl(ppAvlTree, pMove);
+      }
+    }
+  }
+
+  asyncFree(pAsync);
+  return rtn;
+} /* orx_asyncFinish(pORXASYNC pAsync, ppAVLTREE ppAvlTree) */
+/**********************************************************************/
+/*** End of library functions ****************************************/
+/**********************************************************************/
+
+
+#ifdef DO_MAIN
+/**********************************************************************/
+/*** Test program ***/
+/*
+ * Usage:
+ *
+ *   ./test_orx_asyncload a.json [b.json ...]
+ *
+ * - Load each file synchronously and asynchronously, and compare trees
+ * - Also generate and compare a multi-chunk temporary file
+ * - With BUFFILE_GZIP, also load gzip-compressed copies (one and two
+ *   members) both ways and compare them with the plain file, and check
+ *   that a truncated copy fails
+ *
+ * Compile and link:
+ *
+ *  % gcc -DDO_MAIN orx_asyncload.c -o test_orx_asyncload -pthread
+ *  % gcc -DDO_MAIN -DBUFFILE_GZIP orx_asyncload.c -o test_orx_asyncload -pthread -lz
+ *
+ */
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "jsmn.c"
+#include "avltree.c"
+#define main MAIN_BUFFILE
+#include "buffer_file.c"
+#undef main
+#undef DO_MAIN
+#include "orx_parsejson.c"
+#define DO_MAIN
+
+/* Traversal callback:  count items in args[0] tree missing from args[1] */
+static void
+asyncCompareOne(pAVLTREE pAvl, int level, void** args) {
+pOJITEM pOji = (pOJITEM) pAvl->payload;
+pOJITEM pOther = orx_getOji(*(ppAVLTREE)args[1], pOji->keyString);
+  (void) level;
+  if (!pOther || pOther->payloadType != pOji->payloadType
+      || strcmp(pOther->sPayload, pOji->sPayload)) {
+    fprintf(stderr, "Mismatch at key [%s]\n", pOji->keyString);
+    ++*(int*)args[0];
+  }
+  return;
+}
+
+static void
+asyncCallback(pORXASYNC pAsync, int rtn, void* cbArg) {
+  (void) pAsync;
+  *(int*)cbArg = 1 + rtn;
+  return;
+}
+
+static int
+asyncCompareFile(char* filepath) {
+pAVLTREE pSync = 0;
+pAVLTREE pAsyncTree = 0;
+pORXASYNC pAsync;
+int called = 0;
+int errors = 0;
+int polls = 0;
+void* args[2];
+
+  if (readOjiAvl(filepath, &pSync, 0, 0)) return 1;
+
+  if (!(pAsync = orx_asyncLoad(filepath, 0, 0, asyncCallback, &called))) return 1;
+  while (orx_asyncPoll(pAsync) == ORXASYNC_PENDING) { ++polls; usleep(1000); }
+  if (orx_asyncFinish(pAsync, &pAsyncTree)) { ++errors; }
+  if (called != 1) { fprintf(stderr, "Callback not called\n"); ++errors; }
+
+  /* Compare both ways */
+  args[0] = &errors; args[1] = &pAsyncTree;
+  traverseFromRightAvl(pSync, 0, asyncCompareOne, args);
+  args[1] = &pSync;
+  traverseFromRightAvl(pAsyncTree, 0, asyncCompareOne, args);
+
+  fprintf(stdout, "%s:  %s (%d polls)\n", filepath, errors ? "FAILED" : "OK", polls);
+  cleanupAVL(&pSync);
+  cleanupAVL(&pAsyncTree);
+  return errors ? 1 : 0;
+}
+
+#ifdef BUFFILE_GZIP
+/* Write plain file to gzPath, as one gzip member or two, less the last
+ * dropBytes bytes; returns 0 on success
+ */
+static int
+asyncWriteGzip(char* plainPath, char* gzPath, int members, int dropBytes) {
+size_t len;
+size_t half;
+uint8_t* data = buffile_file_to_puint8(plainPath, &len, 0);
+gzFile gz;
+int rtn = 0;
+
+  if (!data) return 1;
+  half = members > 1 ? len / 2 : len;
+  if (!(gz = gzopen(gzPath, "wb")) || gzwrite(gz, data, (unsigned) half) != (int) half || gzclose(gz) != Z_OK) { rtn = 1; }
+  if (!rtn && half < len) {
+    if (!(gz = gzopen(gzPath, "ab")) || gzwrite(gz, data + half, (unsigned) (len - half)) != (int) (len - half)
+     || gzclose(gz) != Z_OK) { rtn = 1; }
+  }
+  if (!rtn && dropBytes) {
+  struct stat st;
+    rtn = stat(gzPath, &st) || dropBytes >= st.st_size || truncate(gzPath, st.st_size - dropBytes);
+  }
+  free(data);
+  return rtn;
+}
+
+/* Compressed copies load, both ways, the same as the plain file */
+static int
+asyncCompareGzip(char* plainPath) {
+char gzName[] = "/tmp/test_orx_asyncload_gzXXXXXX";
+pAVLTREE pPlain = 0;
+pAVLTREE pGz = 0;
+pORXASYNC pAsync;
+int members;
+int errors = 0;
+int fd;
+void* args[2];
+double tPlain;
+double tSync;
+double tAsync;
+
+  if ((fd = mkstemp(gzName)) < 0) return 1;
+  close(fd);
+  tPlain = ojiSeconds();
+  if (readOjiAvl(plainPath, &pPlain, 0, 0)) { unlink(gzName); return 1; }
+  tPlain = ojiSeconds() - tPlain;
+
+  for (members=1; members<=2; ++members) {
+    if (asyncWriteGzip(plainPath, gzName, members, 0)) { ++errors; break; }
+    errors += asyncCompareFile(gzName);
+
+    tSync = ojiSeconds();
+    if (readOjiAvl(gzName, &pGz, 0, 0)) { ++errors; }
+    tSync = ojiSeconds() - tSync;
+    args[0] = &errors; args[1] = &pGz;
+    traverseFromRightAvl(pPlain, 0, asyncCompareOne, args);
+    args[1] = &pPlain;
+    traverseFromRightAvl(pGz, 0, asyncCompareOne, args);
+    cleanupAVL(&pGz);
+
+    tAsync = ojiSeconds();
+    if (!(pAsync = orx_asyncLoad(gzName, 0, 0, 0, 0)) || orx_asyncFinish(pAsync, &pGz)) { ++errors; }
+    tAsync = ojiSeconds() - tAsync;
+    cleanupAVL(&pGz);
+
+    fprintf(stdout, "%s, gzip %d member%s:  %s; plain %.4fs, gzip readOjiAvl %.4fs, gzip orx_asyncLoad %.4fs\n"
+           , plainPath, members, members > 1 ? "s" : "", errors ? "FAILED" : "OK", tPlain, tSync, tAsync);
+  }
+
+  /* Truncated:  both ways fail */
+  if (asyncWriteGzip(plainPath, gzName, 1, 6)) { ++errors; }
+  if (!errors) {
+    if (!readOjiAvl(gzName, &pGz, 0, 0)) { fprintf(stderr, "Truncated gzip did not fail\n"); ++errors; }
+    if (!(pAsync = orx_asyncLoad(gzName, 0, 0, 0, 0)) || !orx_asyncFinish(pAsync, &pGz)) {
+      fprintf(stderr, "Truncated gzip did not fail asynchronously\n");
+      ++errors;
+    }
+    cleanupAVL(&pGz);
+  }
+
+  cleanupAVL(&pPlain);
+  unlink(gzName);
+  return errors ? 1 : 0;
+}
+#endif
+
+int
+main(int argc, char** argv) {
+char tmpName[] = "/tmp/test_orx_asyncloadXXXXXX";
+FILE* fTmp;
+int fd;
+int i;
+int rtn = 0;
+pORXASYNC pAsync;
+
+  while (--argc) { rtn |= asyncCompareFile(argv[argc]); }
+
+  /* Multi-chunk file, with primitives and strings straddling chunks */
+  if ((fd = mkstemp(tmpName)) < 0 || !(fTmp = fdopen(fd, "w"))) return 1;
+  fprintf(fTmp, "{ \"records\":\n  [");
+  for (i=0; i<3000; ++i) {
+    fprintf(fTmp, "%s { \"id\": %d, \"x\": %.17g, \"name\": \"rec\\\"%d\", \"ok\": %s }\n"
+           , i ? "," : "", i, i * 0.125e-3, i, (i & 1) ? "true" : "null");
+  }
+  fprintf(fTmp, "  ]\n}\n");
+  fclose(fTmp);
+  rtn |= asyncCompareFile(tmpName);
+#ifdef BUFFILE_GZIP
+  rtn |= asyncCompareGzip(tmpName);
+#endif
+  unlink(tmpName);
+
+  /* Missing file must fail, not hang */
+  if (!(pAsync = orx_asyncLoad("/nonexistent/file.json", 0, 0, 0, 0))
+   || orx_asyncFinish(pAsync, 0) == 0) {
+    fprintf(stderr, "Missing file did not fail\n");
+    rtn = 1;
+  }
+
+  return rtn;
+}
+#endif // DO_MAIN
@@ -0,0 +1,46 @@
+////////////////////////////////////////////////////////////////////////
+// Asynchronous loading of JSON files into OJI AVL trees
+//
+// - orx_asyncLoad() returns a handle immediately; a loader thread reads,
+//   tokenizes and flattens the file while the caller carries on
+// - The file is read by a second thread into two alternating chunk
+//   buffers, so reading chunk N+1 overlaps with tokenizing chunk N; a
+//   compressed file (see BUFFILESRC in buffer_file.h) is decompressed
+//   by that thread, so decompression overlaps with tokenizing too
+// - Completion is reported by orx_asyncPoll(), and/or by a callback
+//   invoked on the loader thread
+// - orx_asyncFinish() waits if necessary, hands over the tree, and
+//   frees the handle
+//
+////////////////////////////////////////////////////////////////////////
+#ifndef __ORX_ASYNCLOAD_H__
+#define __ORX_ASYNCLOAD_H__
+
+#include "avltree.h"
+#include "orx_parsejson.h"
+
+/* Size of each of the two read chunks */
+#ifndef ORXASYNC_CHUNK_SIZE
+#define ORXASYNC_CHUNK_SIZE 65536
+#endif
+
+typedef enum
+{ ORXASYNC_PENDING=0   // Load in progress
+, ORXASYNC_DONE        // Load complete; tree is ready
+, ORXASYNC_FAILED      // Load failed; see orx_asyncFinish return value
+} ORXASYNCSTATE;
+
+typedef struct ORXASYNCstr ORXASYNC, *pORXASYNC;
+
+// Completion callback, called once on the loader thread
+// - rtn is 0 on success, else a readOjiAvl error code
+// - do not call orx_asyncFinish() from inside the callback; signal the
+//   owning thread (e.g. via a pipe or eventfd) and finish there
+typedef void (*ORXASYNCCALLBACK)(pORXASYNC pAsync, int rtn, void* cbArg);
+
+pORXASYNC orx_asyncLoad(char* filepath, char* pfx, pOJIOPTS pOpts, ORXASYNCCALLBACK callback, void* cbArg);
+ORXASYNCSTATE orx_asyncPoll(pORXASYNC pAsync);
+ORXASYNCSTATE orx_asyncWait(pORXASYNC pAsync);
+int orx_asyncFinish(pORXASYNC pAsync, ppAVLTREE ppAvlTree);
+
+#endif // __ORX_ASYNCLOAD_H__
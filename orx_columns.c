@@ -0,0 +1,395 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "jsmn.h"
+#include "orx_columns.h"
+
+
+/**********************************************************************/
+/* Free one column set */
+static void
+cleanupColumnSetOji(pOJICOLSET pSet) {
+int i;
+pOJICOLUMN pCol;
+  if (!pSet) return;
+  for (i=0; pSet->columns && i<pSet->nColumns; ++i) {
+    pCol = pSet->columns + i;
+    if (pCol->name) { free(pCol->name); }
+    if (pCol->scalars) { free(pCol->scalars); }
+    if (pCol->booleans) { free(pCol->booleans); }
+    if (pCol->stringOffsets) { free(pCol->stringOffsets); }
+    if (pCol->strings) { free(pCol->strings); }
+    if (pCol->nullBitmap) { free(pCol->nullBitmap); }
+  }
+  if (pSet->columns) { free(pSet->columns); }
+  if (pSet->keyString) { free(pSet->keyString); }
+  free(pSet);
+  return;
+}
+
+
+/**********************************************************************/
+/* Free all extracted column sets */
+void
+cleanupColumnsOji(pOJICOLUMNS pColumns) {
+pOJICOLSET pSet;
+  if (!pColumns) return;
+  while ((pSet = pColumns->pSets)) {
+    pColumns->pSets = pSet->pNext;
+    cleanupColumnSetOji(pSet);
+  }
+  pColumns->ppLastNext = &pColumns->pSets;
+  return;
+}
+
+
+/**********************************************************************/
+/* Find extracted column set by array key, or column by field name */
+pOJICOLSET
+getColumnSetOji(pOJICOLUMNS pColumns, const char* keyString) {
+pOJICOLSET pSet;
+  if (!pColumns || !keyString) return 0;
+  for (pSet = pColumns->pSets; pSet; pSet = pSet->pNext) {
+    if (!strcmp(pSet->keyString, keyString)) return pSet;
+  }
+  return pSet;
+}
+pOJICOLUMN
+getColumnOji(pOJICOLSET pSet, const char* name) {
+int i;
+  if (!pSet || !name) return 0;
+  for (i=0; i<pSet->nColumns; ++i) {
+    if (!strcmp(pSet->columns[i].name, name)) return pSet->columns + i;
+  }
+  return 0;
+}
+
+
+/**********************************************************************/
+/* Per-column scratch data for the discovery pass */
+typedef struct COLSCANstr {
+  const char* name;        // Field name in JSON buffer; not terminated
+  int lenName;
+  unsigned types;          // Bit (1<<OJIENUM) set per type seen
+  size_t textBytes;        // Text length + 1, summed over rows
+} COLSCAN, *pCOLSCAN;
+
+
+/**********************************************************************/
+/* Find column matching key token, trying column iHint first */
+static int
+findColumnOji(pCOLSCAN pScan, int nColumns, int iHint, const uint8_t* json_buffer, const jsmntok_t* pKey) {
+int lenName = pKey->end - pKey->start;
+const char* name = (const char*) json_buffer + pKey->start;
+int i;
+  if (iHint < nColumns && pScan[iHint].lenName == lenName
+   && !memcmp(pScan[iHint].name, name, lenName)) return iHint;
+  for (i=0; i<nColumns; ++i) {
+    if (pScan[i].lenName == lenName && !memcmp(pScan[i].name, name, lenName)) return i;
+  }
+  return -1;
+}
+
+
+/**********************************************************************/
+/* Extract array at pToks[0] into a new column set
+ * - requireUniform:  every element must have the same fields
+ * - returns null if array is not an array of objects with leaf values
+ */
+static pOJICOLSET
+extractColumnSetOji(const char* keyString, const uint8_t* json_buffer, const jsmntok_t* pToks, int requireUniform) {
+pCOLSCAN pScan = 0;
+int nColumns = 0;
+int limit = 0;
+size_t nRows = pToks->size;
+size_t iRow;
+int iKey;
+int iCol;
+int t;
+int pass;
+pOJICOLSET pSet = 0;
+pOJICOLUMN pCol;
+OJITEM localOji;
+size_t lenText;
+
+  /* Pass 0 discovers columns and types; pass 1 fills them */
+  for (pass=0; pass<2; ++pass) {
+
+    for (t=1, iRow=0; iRow<nRows; ++iRow) {
+    const jsmntok_t* pElem = pToks + t;
+
+      if (pElem->type != JSMN_OBJECT) goto fail;
+      if (requireUniform && iRow > 0 && pElem->size != nColumns) goto fail;
+      ++t;
+
+      for (iKey=0; iKey<pElem->size; ++iKey, t+=2) {
+      const jsmntok_t* pVal = pToks + t + 1;
+
+        if (pVal->type == JSMN_OBJECT || pVal->type == JSMN_ARRAY) goto fail;
+
+        iCol = findColumnOji(pScan, nColumns, iKey, json_buffer, pToks + t);
+
+        localOji.sPayload = (char*) json_buffer + pVal->start;
+        decodeLeafOji(&localOji, pVal->type == JSMN_STRING, pVal->end - pVal->start);
+        if (localOji.payloadType == OJI_INTEGER) {
+        double widened = (double) localOji.uPayload.anInteger;
+          /* Numeric columns are double; integers widen */
+          localOji.payloadType = OJI_SCALAR;
+          localOji.uPayload.aScalar = widened;
+        }
+        lenText = pVal->end - pVal->start;
+
+        if (pass == 0) {
+          if (iCol < 0) {
+            if (requireUniform && iRow > 0) goto fail;
+            if (nColumns == limit) {
+            pCOLSCAN pNew = realloc(pScan, (limit = limit ? 2*limit : 8) * sizeof(COLSCAN));
+              if (!pNew) goto fail;
+              pScan = pNew;
+            }
+            iCol = nColumns++;
+            pScan[iCol].name = (const char*) json_buffer + pToks[t].start;
+            pScan[iCol].lenName = pToks[t].end - pToks[t].start;
+            pScan[iCol].types = 0;
+            pScan[iCol].textBytes = 0;
+          }
+          pScan[iCol].types |= 1u << localOji.payloadType;
+          pScan[iCol].textBytes += lenText + 1;
+          continue;
+        }
+
+        /* Pass 1:  store value, clear null bit */
+        pCol = pSet->columns + iCol;
+        if (localOji.payloadType == OJI_NULL) continue;
+        pCol->nullBitmap[iRow>>3] &= (uint8_t) ~(1u << (iRow&7));
+        switch (pCol->type) {
+        case OJI_SCALAR:
+          pCol->scalars[iRow] = localOji.uPayload.aScalar;
+          break;
+        case OJI_BOOLEAN:
+          pCol->booleans[iRow] = (uint8_t) localOji.uPayload.aBool;
+          break;
+        default:
+          /* Text rows are written in row order; see offsets below */
+          memcpy(pCol->strings + pCol->stringOffsets[iRow], localOji.sPayload, lenText);
+          pCol->strings[pCol->stringOffsets[iRow] + lenText] = '\0';
+          pCol->stringOffsets[iRow+1] = pCol->stringOffsets[iRow] + lenText + 1;
+          break;
+        }
+      }
+
+      /* Pass 1:  text columns without a value in this row get "" */
+      for (iCol=0; pass == 1 && iCol<nColumns; ++iCol) {
+        pCol = pSet->columns + iCol;
+        if (pCol->stringOffsets && OJICOL_ISNULL(pCol, iRow)) {
+          pCol->strings[pCol->stringOffsets[iRow]] = '\0';
+          pCol->stringOffsets[iRow+1] = pCol->stringOffsets[iRow] + 1;
+        }
+      }
+    }
+
+    if (pass == 1) break;
+
+    /* Allocate column set and buffers, with all rows null */
+    if (!nColumns) goto fail;
+    if (!(pSet = calloc(1, sizeof(OJICOLSET)))) goto fail;
+    if (!(pSet->keyString = strdup(keyString))) goto fail;
+    if (!(pSet->columns = calloc(nColumns, sizeof(OJICOLUMN)))) goto fail;
+    pSet->nColumns = nColumns;
+    pSet->nRows = nRows;
+
+    for (iCol=0; iCol<nColumns; ++iCol) {
+    unsigned types = pScan[iCol].types & ~(1u << OJI_NULL);
+      pCol = pSet->columns + iCol;
+      if (!(pCol->name = malloc(pScan[iCol].lenName + 1))) goto fail;
+      memcpy(pCol->name, pScan[iCol].name, pScan[iCol].lenName);
+      pCol->name[pScan[iCol].lenName] = '\0';
+
+      if (!(pCol->nullBitmap = malloc((nRows+7)>>3))) goto fail;
+      memset(pCol->nullBitmap, 0xff, (nRows+7)>>3);
+
+      if (!types || types == (1u << OJI_SCALAR)) {
+        pCol->type = OJI_SCALAR;
+        if (!(pCol->scalars = malloc(nRows * sizeof(double)))) goto fail;
+        for (iRow=0; iRow<nRows; ++iRow) { pCol->scalars[iRow] = NAN; }
+      } else if (types == (1u << OJI_BOOLEAN)) {
+        pCol->type = OJI_BOOLEAN;
+        if (!(pCol->booleans = calloc(nRows, 1))) goto fail;
+      } else {
+        pCol->type = (types == (1u << OJI_STRING)) ? OJI_STRING : OJI_UNKNOWN;
+        if (!(pCol->stringOffsets = calloc(nRows+1, sizeof(size_t)))) goto fail;
+        if (!(pCol->strings = malloc(pScan[iCol].textBytes + nRows))) goto fail;
+      }
+    }
+  }
+
+  free(pScan);
+  return pSet;
+
+fail:
+  if (pScan) { free(pScan); }
+  cleanupColumnSetOji(pSet);
+  return 0;
+} /* extractColumnSetOji(...) */
+
+
+/**********************************************************************/
+/* OJISINK container handler:  extract selected arrays as columns */
+static int
+columnsContainerOji(pOJISINK pSink, const char* keyString, const uint8_t* json_buffer, const void* pVoidToks) {
+pOJICOLUMNS pColumns = (pOJICOLUMNS) pSink->arg;
+const jsmntok_t* pToks = (const jsmntok_t*) pVoidToks;
+pOJICOLSET pSet;
+char** ppKey;
+int listed = 0;
+
+  if (pToks->type != JSMN_ARRAY) return 0;
+  if (pToks->size < 1) return 0;
+
+  for (ppKey = pColumns->keyStrings; ppKey && *ppKey && !listed; ++ppKey) {
+    listed = !strcmp(*ppKey, keyString);
+  }
+  if (!listed && !(pColumns->autoDetect && (size_t) pToks->size >= pColumns->minRows)) return 0;
+
+  if (!(pSet = extractColumnSetOji(keyString, json_buffer, pToks, !listed))) return 0;
+
+  /* Append to result list */
+  if (!pColumns->ppLastNext) { pColumns->ppLastNext = &pColumns->pSets; }
+  while (*pColumns->ppLastNext) { pColumns->ppLastNext = &(*pColumns->ppLastNext)->pNext; }
+  *pColumns->ppLastNext = pSet;
+  pColumns->ppLastNext = &pSet->pNext;
+
+  return (pColumns->mode == OJICOL_INSTEAD) ? countTokensOji(pToks) : 0;
+}
+
+
+/**********************************************************************/
+/* Set up pSink for columnar extraction into *pColumns
+ * - caller fills in pColumns->mode, ->keyStrings, ->autoDetect and
+ *   ->minRows, then passes pSink via OJIOPTS.pSink to readOjiAvlOpts
+ * - leaves that are not extracted go into the OJI AVL tree as usual
+ */
+void
+initColumnsSinkOji(pOJISINK pSink, pOJICOLUMNS pColumns) {
+  if (!pSink || !pColumns) return;
+  pSink->leaf = 0;
+  pSink->container = columnsContainerOji;
+  pSink->arg = (void*) pColumns;
+  pColumns->pSets = 0;
+  pColumns->ppLastNext = &pColumns->pSets;
+  return;
+}
+/**********************************************************************/
+/*** End of library functions ****************************************/
+/**********************************************************************/
+
+
+#ifdef DO_MAIN
+/**********************************************************************/
+/*** Test program ***/
+/*
+ * Usage:
+ *
+ *   ./test_orx_columns
+ *
+ * Compile and link:
+ *
+ *  % gcc -DDO_MAIN orx_columns.c -o test_orx_columns -lm
+ *
+ */
+#include "jsmn.c"
+#include "avltree.c"
+#define main MAIN_BUFFILE
+#include "buffer_file.c"
+#undef main
+#undef DO_MAIN
+#include "orx_parsejson.c"
+#define DO_MAIN
+
+#include "orx_test.h"
+
+int
+main(int argc, char** argv) {
+char json[65536];
+char* p;
+int i;
+double sum;
+pAVLTREE pOjiAvlTree = 0;
+OJISINK sink;
+OJIOPTS opts;
+OJICOLUMNS columns;
+char* keys[] = { "json.mixed", 0 };
+pOJICOLSET pSet;
+pOJICOLUMN pCol;
+double d;
+int found;
+
+  /* Built-in document only; no file arguments */
+  (void) argc;
+  (void) argv;
+  p = json + sprintf(json, "{\"obs\":[");
+  for (i=0; i<1000; ++i) {
+    p += sprintf(p, "%s{\"time\":%d.5,\"residual\":%s,\"frame\":\"F%d\",\"ok\":%s}"
+                , i ? "," : "", i, (i % 7) ? "0.25" : "null", i % 3, (i & 1) ? "true" : "false");
+  }
+  p += sprintf(p, "],\"mixed\":[{\"a\":1},{\"b\":\"x\",\"a\":\"y\"}]");
+  p += sprintf(p, ",\"short\":[{\"a\":1}],\"nested\":[{\"a\":[1]}]}");
+
+  /* Auto-detect, instead of tree nodes; explicit "json.mixed" */
+  memset(&columns, 0, sizeof columns);
+  columns.mode = OJICOL_INSTEAD;
+  columns.keyStrings = keys;
+  columns.autoDetect = 1;
+  columns.minRows = 2;
+  initColumnsSinkOji(&sink, &columns);
+  memset(&opts, 0, sizeof opts);
+  opts.pSink = &sink;
+  CHECK(!readOjiAvlBuffer((uint8_t*) json, strlen(json), &pOjiAvlTree, 0, &opts));
+
+  CHECK((pSet = getColumnSetOji(&columns, "json.obs")) && pSet->nRows == 1000 && pSet->nColumns == 4);
+  CHECK((pCol = getColumnOji(pSet, "time")) && pCol->type == OJI_SCALAR);
+  for (sum=0.0, i=0; pCol && i<1000; ++i) { sum += pCol->scalars[i]; }
+  CHECK(sum == 500000.0);
+  CHECK((pCol = getColumnOji(pSet, "residual")) && OJICOL_ISNULL(pCol, 0) && isnan(pCol->scalars[0])
+        && !OJICOL_ISNULL(pCol, 1) && pCol->scalars[1] == 0.25);
+  CHECK((pCol = getColumnOji(pSet, "frame")) && pCol->type == OJI_STRING
+        && !strcmp(pCol->strings + pCol->stringOffsets[5], "F2"));
+  CHECK((pCol = getColumnOji(pSet, "ok")) && pCol->type == OJI_BOOLEAN && pCol->booleans[3]);
+
+  /* Explicit array need not be uniform; missing fields are null */
+  CHECK((pSet = getColumnSetOji(&columns, "json.mixed")) && pSet->nColumns == 2);
+  CHECK((pCol = getColumnOji(pSet, "a")) && pCol->type == OJI_UNKNOWN
+        && !strcmp(pCol->strings + pCol->stringOffsets[1], "y"));
+  CHECK((pCol = getColumnOji(pSet, "b")) && OJICOL_ISNULL(pCol, 0)
+        && !strcmp(pCol->strings + pCol->stringOffsets[1], "x"));
+
+  /* Too short, or nested:  flattened as usual */
+  CHECK(!getColumnSetOji(&columns, "json.short") && !getColumnSetOji(&columns, "json.nested"));
+  orx_getDoubleOji(pOjiAvlTree, "json.short[0].a", &d, &found);
+  CHECK(found && d == 1.0);
+  orx_getDoubleOji(pOjiAvlTree, "json.nested[0].a[0]", &d, &found);
+  CHECK(found && d == 1.0);
+
+  /* Extracted instead of tree nodes */
+  orx_getDoubleOji(pOjiAvlTree, "json.obs[1].time", &d, &found);
+  CHECK(!found);
+
+  cleanupColumnsOji(&columns);
+  cleanupAVL(&pOjiAvlTree);
+
+  /* Alongside tree nodes */
+  columns.mode = OJICOL_ALONGSIDE;
+  initColumnsSinkOji(&sink, &columns);
+  CHECK(!readOjiAvlBuffer((uint8_t*) json, strlen(json), &pOjiAvlTree, 0, &opts));
+  CHECK((pSet = getColumnSetOji(&columns, "json.obs")) && pSet->nRows == 1000);
+  orx_getDoubleOji(pOjiAvlTree, "json.obs[999].time", &d, &found);
+  CHECK(found && d == 999.5);
+  cleanupColumnsOji(&columns);
+  cleanupAVL(&pOjiAvlTree);
+
+  fprintf(stdout, "test_orx_columns:  %s\n", errors ? "FAILED" : "OK");
+  return errors ? 1 : 0;
+}
+#endif // DO_MAIN
@@ -0,0 +1,72 @@
+////////////////////////////////////////////////////////////////////////
+// Columnar extraction of arrays of objects
+//
+// An array of records such as
+//
+//   "obs": [ {"time": 1.5, "residual": 0.02, "frame": "J2000"}, ... ]
+//
+// is normally flattened into one tree node per field per record.  With
+// an OJISINK from initColumnsSinkOji() in OJIOPTS.pSink, such arrays are
+// instead, or also, extracted as one contiguous buffer per field:
+//
+//   - OJI_SCALAR columns:   double[nRows]
+//   - OJI_BOOLEAN columns:  uint8_t[nRows]
+//   - OJI_STRING columns, and columns of mixed type (OJI_UNKNOWN):
+//     string offsets size_t[nRows+1] into one text buffer; row i text is
+//     strings + stringOffsets[i], null-terminated
+//   - every column:  null bitmap, bit (i&7) of nullBitmap[i>>3] is set if
+//     row i is null or lacks the field; scalar rows that are null hold NaN
+//
+// Arrays are selected by key (e.g. "json.obs"), and/or detected:  with
+// autoDetect set, any array of at least minRows objects that all have
+// the same fields, all with leaf values, is extracted.  An array whose
+// elements are not all objects with leaf values is flattened as usual.
+//
+////////////////////////////////////////////////////////////////////////
+#ifndef __ORX_COLUMNS_H__
+#define __ORX_COLUMNS_H__
+
+#include <stdint.h>
+
+#include "orx_parsejson.h"
+
+typedef enum
+{ OJICOL_ALONGSIDE=0   // Extract columns, and also build tree nodes
+, OJICOL_INSTEAD       // Extract columns; no tree nodes for the array
+} OJICOLMODE;
+
+typedef struct OJICOLUMNstr {
+  char* name;              // Field name, as in the JSON text
+  OJIENUM type;            // OJI_SCALAR, _BOOLEAN, _STRING, or _UNKNOWN
+  double* scalars;         // OJI_SCALAR:  [nRows]
+  uint8_t* booleans;       // OJI_BOOLEAN:  [nRows]
+  size_t* stringOffsets;   // OJI_STRING, OJI_UNKNOWN:  [nRows+1]
+  char* strings;           // OJI_STRING, OJI_UNKNOWN:  text of all rows
+  uint8_t* nullBitmap;     // [(nRows+7)/8]; set bits are null rows
+} OJICOLUMN, *pOJICOLUMN;
+
+typedef struct OJICOLSETstr {
+  char* keyString;         // Key of the array, e.g. "json.obs"
+  size_t nRows;            // Number of array elements
+  int nColumns;
+  OJICOLUMN* columns;      // [nColumns], in order of first appearance
+  struct OJICOLSETstr* pNext;
+} OJICOLSET, *pOJICOLSET;
+
+typedef struct OJICOLUMNSstr {
+  OJICOLMODE mode;
+  char** keyStrings;       // Arrays to extract; null-terminated list, or null
+  int autoDetect;          // Non-zero to also detect uniform arrays
+  size_t minRows;          // Smallest array to auto-detect
+  pOJICOLSET pSets;        // Result:  extracted arrays, in document order
+  pOJICOLSET* ppLastNext;  // Internal:  append point for pSets
+} OJICOLUMNS, *pOJICOLUMNS;
+
+#define OJICOL_ISNULL(PCOL,ROW) (((PCOL)->nullBitmap[(ROW)>>3] >> ((ROW)&7)) & 1)
+
+void initColumnsSinkOji(pOJISINK pSink, pOJICOLUMNS pColumns);
+pOJICOLSET getColumnSetOji(pOJICOLUMNS pColumns, const char* keyString);
+pOJICOLUMN getColumnOji(pOJICOLSET pSet, const char* name);
+void cleanupColumnsOji(pOJICOLUMNS pColumns);
+
+#endif // __ORX_COLUMNS_H__
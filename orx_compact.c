@@ -0,0 +1,551 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "orx_compact.h"
+
+
+/**********************************************************************/
+/**********************************************************************/
+/*** Compact OJI tree; see orx_compact.h */
+/**********************************************************************/
+/**********************************************************************/
+
+/***************************************/
+/* Default per-tree node cleanup; freeNodeOjic releases the node to
+ * the tree's allocator instead of calling it
+ */
+static void
+cleanupOneOjic(pOJICNODE pNode) {
+  free(pNode);
+  return;
+}
+
+static void
+freeNodeOjic(pOJICTREE pTree, pOJICNODE pNode) {
+  if (pTree->cleanupNode == cleanupOneOjic) { orx_free(pTree->pAlloc, pNode); }
+  else if (pTree->cleanupNode) { pTree->cleanupNode(pNode); }
+  return;
+}
+
+
+/**********************************************************************/
+/* Initialize an empty tree with default comparator and cleanup; nodes
+ * are malloced unless pTree->pAlloc is set before the first insert
+ */
+void
+initOjic(pOJICTREE pTree) {
+  if (!pTree) return;
+  pTree->pRoot = 0;
+  pTree->count = 0;
+  pTree->comparator = strcmp;
+  pTree->cleanupNode = cleanupOneOjic;
+  pTree->pAlloc = 0;
+  return;
+}
+
+
+/**********************************************************************/
+/* Allocate new OJICNODE from an OJITEM
+ * - pSource->keyString is the null-terminated key
+ * - pSource->sPayload holds lenStrJson characters of payload text, which
+ *   are kept only for OJI_STRING and OJI_UNKNOWN payloads
+ */
+pOJICNODE
+newOjic(pOJITEM pSource, int lenStrJson) {
+  return newOjicAlloc(pSource, lenStrJson, (pORXALLOC) 0);
+}
+
+/* Same as newOjic, allocating from pAlloc (null for malloc); a tree
+ * holding the node must have the same pAlloc
+ */
+pOJICNODE
+newOjicAlloc(pOJITEM pSource, int lenStrJson, pORXALLOC pAlloc) {
+pOJICNODE rtn;
+size_t lenKey;
+int hasText;
+
+  if (!pSource) return 0;
+  if (!pSource->keyString) return 0;
+  if (lenStrJson < 0) return 0;
+
+  hasText = (pSource->payloadType == OJI_STRING || pSource->payloadType == OJI_UNKNOWN)
+          && pSource->sPayload;
+  lenKey = strlen(pSource->keyString);
+
+  rtn = orx_malloc(pAlloc, sizeof(OJICNODE) + lenKey + 1 + (hasText ? (lenStrJson + 1) : 0));
+  if (!rtn) return rtn;
+
+  rtn->pLeft = rtn->pRight = 0;
+  rtn->balance = 0;
+  rtn->typeFlags = (uint8_t) (pSource->payloadType & OJIC_TYPE_MASK);
+  rtn->uPayload.aScalar = 0.0;
+  if (pSource->payloadType == OJI_SCALAR) { rtn->uPayload.aScalar = pSource->uPayload.aScalar; }
+  if (pSource->payloadType == OJI_INTEGER) { rtn->uPayload.anInteger = pSource->uPayload.anInteger; }
+  if (pSource->payloadType == OJI_BOOLEAN) { rtn->uPayload.aBool = pSource->uPayload.aBool; }
+
+  memcpy(rtn->keyString, pSource->keyString, lenKey + 1);
+
+  rtn->textOffset = 0;
+  if (hasText) {
+    rtn->typeFlags |= OJIC_HAS_TEXT;
+    rtn->textOffset = (uint32_t) (lenKey + 1);
+    memcpy(rtn->keyString + rtn->textOffset, pSource->sPayload, lenStrJson);
+    rtn->keyString[rtn->textOffset + lenStrJson] = '\0';
+  }
+  return rtn;
+} /* newOjicAlloc(pOJITEM pSource, int lenStrJson, pORXALLOC pAlloc) */
+
+
+/**********************************************************************/
+/* Rebalance subtree at pNode, with balance of +2 or -2 after an insert
+ * - returns new subtree root, which replaces pNode in its parent link
+ */
+static pOJICNODE
+rebalanceOjic(pOJICNODE pNode) {
+pOJICNODE pChild;
+pOJICNODE pGrand;
+
+  if (pNode->balance > 0) {
+    pChild = pNode->pLeft;
+    if (pChild->balance >= 0) {
+      /* Left-Left case:  rotate right */
+      pNode->pLeft = pChild->pRight;
+      pChild->pRight = pNode;
+      pNode->balance = pChild->balance = 0;
+      return pChild;
+    }
+    /* Left-Right case:  rotate left at child, then right at node */
+    pGrand = pChild->pRight;
+    pChild->pRight = pGrand->pLeft;
+    pNode->pLeft = pGrand->pRight;
+    pGrand->pLeft = pChild;
+    pGrand->pRight = pNode;
+    pNode->balance = (pGrand->balance == 1) ? -1 : 0;
+    pChild->balance = (pGrand->balance == -1) ? 1 : 0;
+    pGrand->balance = 0;
+    return pGrand;
+  }
+
+  pChild = pNode->pRight;
+  if (pChild->balance <= 0) {
+    /* Right-Right case:  rotate left */
+    pNode->pRight = pChild->pLeft;
+    pChild->pLeft = pNode;
+    pNode->balance = pChild->balance = 0;
+    return pChild;
+  }
+  /* Right-Left case:  rotate right at child, then left at node */
+  pGrand = pChild->pLeft;
+  pChild->pLeft = pGrand->pRight;
+  pNode->pRight = pGrand->pLeft;
+  pGrand->pRight = pChild;
+  pGrand->pLeft = pNode;
+  pNode->balance = (pGrand->balance == -1) ? 1 : 0;
+  pChild->balance = (pGrand->balance == 1) ? -1 : 0;
+  pGrand->balance = 0;
+  return pGrand;
+} /* rebalanceOjic(pOJICNODE pNode) */
+
+
+/**********************************************************************/
+/* Insert node into tree
+ * - an existing node with an equal key is replaced and cleaned up
+ * - returns 1 if node was added, 0 if it replaced a node
+ */
+int
+insertOjic(pOJICTREE pTree, pOJICNODE pNewNode) {
+pOJICNODE* path[OJIC_MAX_HEIGHT];
+int depth = 0;
+pOJICNODE* ppLink;
+pOJICNODE pChild;
+pOJICNODE pNode;
+int comp;
+
+  if (!pTree || !pNewNode) return 0;
+
+  pNewNode->pLeft = pNewNode->pRight = 0;
+  pNewNode->balance = 0;
+
+  /* Descend, saving the address of each link followed */
+  ppLink = &pTree->pRoot;
+  while (*ppLink) {
+    comp = pTree->comparator(pNewNode->keyString, (*ppLink)->keyString);
+    if (comp == 0) {
+      /* Replace equal node in place */
+      pNode = *ppLink;
+      pNewNode->pLeft = pNode->pLeft;
+      pNewNode->pRight = pNode->pRight;
+      pNewNode->balance = pNode->balance;
+      *ppLink = pNewNode;
+      freeNodeOjic(pTree, pNode);
+      return 0;
+    }
+    path[depth++] = ppLink;
+    ppLink = (comp < 0) ? &(*ppLink)->pLeft : &(*ppLink)->pRight;
+  }
+  *ppLink = pNewNode;
+  ++pTree->count;
+
+  /* Retrace path upward, updating balances, until height is unchanged */
+  pChild = pNewNode;
+  while (depth > 0) {
+    ppLink = path[--depth];
+    pNode = *ppLink;
+    pNode->balance += (pChild == pNode->pLeft) ? 1 : -1;
+    if (pNode->balance == 0) break;
+    if (pNode->balance == 2 || pNode->balance == -2) {
+      *ppLink = rebalanceOjic(pNode);
+      break;
+    }
+    pChild = pNode;
+  }
+  return 1;
+} /* insertOjic(pOJICTREE pTree, pOJICNODE pNewNode) */
+
+
+/**********************************************************************/
+/* Find node matching key, or return NULL */
+pOJICNODE
+getOjic(pOJICTREE pTree, const char* searchKeyString) {
+pOJICNODE pNode;
+int comp;
+  if (!pTree || !searchKeyString) return 0;
+  pNode = pTree->pRoot;
+  while (pNode) {
+    comp = pTree->comparator(searchKeyString, pNode->keyString);
+    if (comp == 0) return pNode;
+    pNode = (comp < 0) ? pNode->pLeft : pNode->pRight;
+  }
+  return pNode;
+}
+
+
+/**********************************************************************/
+/* Traverse tree in key order, left to right, calling handler per node */
+static void
+traverseOneOjic(pOJICNODE pNode, int level, void (*handler)(pOJICNODE, int, void**), void** args) {
+  if (!pNode) return;
+  traverseOneOjic(pNode->pLeft, level+1, handler, args);
+  handler(pNode, level, args);
+  traverseOneOjic(pNode->pRight, level+1, handler, args);
+  return;
+}
+void
+traverseOjic(pOJICTREE pTree, void (*handler)(pOJICNODE, int, void**), void** args) {
+  if (!pTree || !handler) return;
+  traverseOneOjic(pTree->pRoot, 0, handler, args);
+  return;
+}
+
+
+/**********************************************************************/
+/* Delete all nodes in tree */
+static void
+cleanupOneSubtreeOjic(pOJICTREE pTree, pOJICNODE pNode) {
+  if (!pNode) return;
+  cleanupOneSubtreeOjic(pTree, pNode->pLeft);
+  cleanupOneSubtreeOjic(pTree, pNode->pRight);
+  freeNodeOjic(pTree, pNode);
+  return;
+}
+void
+cleanupOjic(pOJICTREE pTree) {
+  if (!pTree) return;
+  cleanupOneSubtreeOjic(pTree, pTree->pRoot);
+  pTree->pRoot = 0;
+  pTree->count = 0;
+  return;
+}
+
+
+/**********************************************************************/
+/* OJISINK leaf handler:  add one flattened leaf to compact tree */
+static int
+sinkLeafOjic(pOJISINK pSink, pOJITEM pLocalOji, int lenStrJson) {
+pOJICTREE pTree = (pOJICTREE) pSink->arg;
+pOJICNODE pNode = newOjicAlloc(pLocalOji, lenStrJson, pTree->pAlloc);
+  if (!pNode) return -1;
+  insertOjic(pTree, pNode);
+  return 1;
+}
+
+
+/**********************************************************************/
+/* Read JSON file directly into compact tree, without building OJITEMs
+ * - pTree must have been initialized, e.g. by initOjic(); the load
+ *   allocates its buffers, and the nodes, from pTree->pAlloc
+ * - returns 0 on success, else a readOjiAvl error code; 8 if a node
+ *   could not be allocated, leaving the tree incomplete
+ */
+int
+readOjicTree(char* filepath, pOJICTREE pTree, char* pfx, pOJISTATS pStats) {
+OJISINK sink;
+OJIOPTS opts;
+  if (!pTree) return 1;
+  sink.leaf = sinkLeafOjic;
+  sink.container = 0;
+  sink.arg = (void*) pTree;
+  memset(&opts, 0, sizeof opts);
+  opts.pStats = pStats;
+  opts.pSink = &sink;
+  opts.pAlloc = pTree->pAlloc;
+  return readOjiAvlOpts(filepath, 0, pfx, 0, &opts);
+}
+
+
+/**********************************************************************/
+/* Copy every OJITEM in an OJI AVL tree into a compact tree
+ * - returns 0 on success, non-zero if any allocation failed
+ */
+static void
+copyOneOjiAvlToOjic(pAVLTREE pAvl, int level, void** args) {
+pOJITEM pOji = (pOJITEM) pAvl->payload;
+pOJICNODE pNode;
+  (void) level;
+  if (!pOji) return;
+  pNode = newOjicAlloc(pOji, pOji->sPayload ? strlen(pOji->sPayload) : 0, ((pOJICTREE) args[0])->pAlloc);
+  if (pNode) { insertOjic((pOJICTREE) args[0], pNode); }
+  else { *(int*)args[1] = 1; }
+  return;
+}
+int
+copyOjiAvlToOjic(pAVLTREE pAvlRoot, pOJICTREE pTree) {
+int failed = 0;
+void* args[2];
+  if (!pTree) return 1;
+  args[0] = (void*) pTree;
+  args[1] = (void*) &failed;
+  traverseFromRightAvl(pAvlRoot, 0, copyOneOjiAvlToOjic, args);
+  return failed;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// Get one value from compact tree; arguments as for orx_getAnyOji
+void
+orx_getAnyOjic(pOJICTREE pTree, char* searchKeyString
+              , void *pOut, int *pFound
+              , OJIENUM requestedOjiType, int stringOutSize) {
+pOJICNODE pNode;
+
+  if (!pFound) return;
+  *pFound = 0;
+
+  if (!searchKeyString) return;
+  if (!pOut) return;
+
+  if (!(pNode = getOjic(pTree, searchKeyString))) return;
+  *pFound = orx_copyOutOji(OJIC_TYPE(pNode), &pNode->uPayload, OJIC_TEXT(pNode)
+                          , pOut, requestedOjiType, stringOutSize);
+  return;
+} /* orx_getAnyOjic(...) */
+
+
+// Convenience wrappers for orx_getAnyOjic
+void
+orx_getNullOjic(pOJICTREE pTree, char* searchKeyString, int *pFound) {
+void* pOut = (void*) 1;
+  orx_getAnyOjic(pTree, searchKeyString, pOut, pFound, OJI_NULL, 0);
+  return;
+}
+void
+orx_getDoubleOjic(pOJICTREE pTree, char* searchKeyString, double *pOut, int *pFound) {
+  orx_getAnyOjic(pTree, searchKeyString, (void*)pOut, pFound, OJI_SCALAR, 0);
+  return;
+}
+void
+orx_getInt64Ojic(pOJICTREE pTree, char* searchKeyString, int64_t *pOut, int *pFound) {
+  orx_getAnyOjic(pTree, searchKeyString, (void*)pOut, pFound, OJI_INTEGER, 0);
+  return;
+}
+void
+orx_getBooleanOjic(pOJICTREE pTree, char* searchKeyString, OJIBOOL *pOut, int *pFound) {
+  orx_getAnyOjic(pTree, searchKeyString, (void*)pOut, pFound, OJI_BOOLEAN, 0);
+  return;
+}
+void
+orx_getStringOjic(pOJICTREE pTree, char* searchKeyString, int stringOutSize, char *pOut, int *pFound) {
+  orx_getAnyOjic(pTree, searchKeyString, (void*)pOut, pFound, OJI_STRING, stringOutSize);
+  return;
+}
+/**********************************************************************/
+/*** End of library functions ****************************************/
+/**********************************************************************/
+
+
+#ifdef DO_MAIN
+/**********************************************************************/
+/*** Test program ***/
+/*
+ * Usage:
+ *
+ *   ./test_orx_compact a.json [b.json ...]
+ *
+ * - Load each file into both an OJI AVL tree and a compact tree, check
+ *   compact tree order and balance, compare all values, and report
+ *   bytes per key for each layout
+ *
+ * Compile and link:
+ *
+ *  % gcc -DDO_MAIN orx_compact.c -o test_orx_compact
+ *
+ */
+#include "jsmn.c"
+#include "avltree.c"
+#define main MAIN_BUFFILE
+#include "buffer_file.c"
+#undef main
+#undef DO_MAIN
+#include "orx_parsejson.c"
+#define DO_MAIN
+
+/* Return height of subtree, or -1 if out of order or unbalanced */
+static int
+checkOjic(pOJICNODE pNode, const char* lo, const char* hi) {
+int hl;
+int hr;
+  if (!pNode) return 0;
+  if ((lo && strcmp(lo, pNode->keyString) >= 0)
+   || (hi && strcmp(pNode->keyString, hi) >= 0)) return -1;
+  if ((hl = checkOjic(pNode->pLeft, lo, pNode->keyString)) < 0) return -1;
+  if ((hr = checkOjic(pNode->pRight, pNode->keyString, hi)) < 0) return -1;
+  if (hl - hr != pNode->balance) return -1;
+  if (hl - hr > 1 || hr - hl > 1) return -1;
+  return 1 + (hl > hr ? hl : hr);
+}
+
+/* Traversal callback:  compare one OJITEM with compact tree, sum sizes */
+static void
+compareOneOjic(pAVLTREE pAvl, int level, void** args) {
+pOJITEM pOji = (pOJITEM) pAvl->payload;
+pOJICTREE pTree = (pOJICTREE) args[0];
+pOJICNODE pNode = getOjic(pTree, pOji->keyString);
+size_t* sizes = (size_t*) args[2];
+char* pText = pNode ? OJIC_TEXT(pNode) : (char*) 0;
+char s[BUFSIZ];
+double d = 0.0;
+int64_t i64 = 0;
+OJIBOOL b = OJI_FALSE;
+int found = 0;
+
+  (void) level;
+  sizes[0] += sizeof(OJITEM) + strlen(pOji->keyString) + strlen(pOji->sPayload) + 2;
+  if (pNode) {
+    sizes[1] += sizeof(OJICNODE) + strlen(pNode->keyString) + 1
+              + (pText ? strlen(pText) + 1 : 0);
+  }
+
+  switch (pOji->payloadType) {
+  case OJI_NULL:
+    orx_getNullOjic(pTree, pOji->keyString, &found);
+    break;
+  case OJI_BOOLEAN:
+    orx_getBooleanOjic(pTree, pOji->keyString, &b, &found);
+    found &= (b == pOji->uPayload.aBool);
+    break;
+  case OJI_SCALAR:
+    orx_getDoubleOjic(pTree, pOji->keyString, &d, &found);
+    found &= (d == pOji->uPayload.aScalar);
+    break;
+  case OJI_INTEGER:
+    orx_getInt64Ojic(pTree, pOji->keyString, &i64, &found);
+    found &= (i64 == pOji->uPayload.anInteger);
+    break;
+  case OJI_STRING:
+    orx_getStringOjic(pTree, pOji->keyString, sizeof s, s, &found);
+    found &= !strcmp(s, pOji->uPayload.aString);
+    break;
+  default:
+    found = pNode ? 1 : 0;
+    break;
+  }
+  if (!found) {
+    fprintf(stderr, "Mismatch at key [%s]\n", pOji->keyString);
+    ++*(int*)args[1];
+  }
+  return;
+}
+
+/* Allocator over malloc that fails once *(long*) arg allocations have
+ * been made; arg counts down
+ */
+static void* budgetAllocOjic(pORXALLOC pAlloc, size_t size) {
+  if (*(long*) pAlloc->arg <= 0) return (void*) 0;
+  --*(long*) pAlloc->arg;
+  return malloc(size);
+}
+static void* budgetReallocOjic(pORXALLOC pAlloc, void* ptr, size_t oldSize, size_t newSize) {
+  (void) oldSize;
+  if (*(long*) pAlloc->arg <= 0) return (void*) 0;
+  --*(long*) pAlloc->arg;
+  return realloc(ptr, newSize);
+}
+static void budgetReleaseOjic(pORXALLOC pAlloc, void* ptr) {
+  (void) pAlloc;
+  free(ptr);
+}
+
+int
+main(int argc, char** argv) {
+pAVLTREE pOjiAvlTree = 0;
+OJICTREE tree;
+OJICTREE treeCopy;
+OJICTREE treeBudget;
+ORXALLOC budget = { budgetAllocOjic, budgetReallocOjic, budgetReleaseOjic, 0 };
+long left;
+long used;
+int errors;
+int rtn = 0;
+size_t sizes[2];
+void* args[3];
+
+  while (--argc) {
+    errors = 0;
+    sizes[0] = sizes[1] = 0;
+    initOjic(&tree);
+    initOjic(&treeCopy);
+
+    if (readOjiAvl(argv[argc], &pOjiAvlTree, 0, 0)) { ++errors; }
+    if (readOjicTree(argv[argc], &tree, 0, 0)) { ++errors; }
+    if (copyOjiAvlToOjic(pOjiAvlTree, &treeCopy)) { ++errors; }
+
+    if (checkOjic(tree.pRoot, 0, 0) < 0) { fprintf(stderr, "Bad compact tree\n"); ++errors; }
+    if (tree.count != treeCopy.count) { fprintf(stderr, "Count mismatch\n"); ++errors; }
+
+    /* Same load from a counting allocator, then one allocation short:
+     * the last node is missing, and the load returns 8
+     */
+    budget.arg = (void*) &left;
+    left = used = 1L << 30;
+    initOjic(&treeBudget);
+    treeBudget.pAlloc = &budget;
+    if (readOjicTree(argv[argc], &treeBudget, 0, 0) || treeBudget.count != tree.count) { ++errors; }
+    used -= left;
+    cleanupOjic(&treeBudget);
+    left = used - 1;
+    if (readOjicTree(argv[argc], &treeBudget, 0, 0) != 8 || treeBudget.count >= tree.count) {
+      fprintf(stderr, "Node allocation failure not reported\n");
+      ++errors;
+    }
+    cleanupOjic(&treeBudget);
+
+    args[0] = (void*) &tree;
+    args[1] = (void*) &errors;
+    args[2] = (void*) sizes;
+    traverseFromRightAvl(pOjiAvlTree, 0, compareOneOjic, args);
+
+    fprintf(stdout, "%s:  %s; %lu keys; bytes/key OJITEM=%.1f compact=%.1f\n"
+           , argv[argc], errors ? "FAILED" : "OK", (unsigned long) tree.count
+           , tree.count ? (double) sizes[0] / tree.count : 0.0
+           , tree.count ? (double) sizes[1] / tree.count : 0.0
+           );
+
+    cleanupAVL(&pOjiAvlTree);
+    cleanupOjic(&tree);
+    cleanupOjic(&treeCopy);
+    if (errors) rtn = 1;
+  }
+  return rtn;
+}
+#endif // DO_MAIN
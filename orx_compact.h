@@ -0,0 +1,73 @@
+////////////////////////////////////////////////////////////////////////
+// Compact OJI tree:  a memory-lean alternative to OJITEM + AVLTREE
+//
+// - Comparator and node cleanup are held once per tree (OJICTREE), not
+//   once per node
+// - Nodes have no parent, self or payload back-pointers; insertion keeps
+//   its own path stack instead
+// - Key and payload text are stored inline after the node; the payload
+//   text is located by a relative offset, and is kept only for strings
+// - Payload type and flags are packed into a single byte
+//
+// On a 64-bit build an OJICNODE header is 32 bytes, versus 112 bytes
+// for an OJITEM with its embedded AVLTREE.
+//
+////////////////////////////////////////////////////////////////////////
+#ifndef __ORX_COMPACT_H__
+#define __ORX_COMPACT_H__
+
+#include <stdint.h>
+
+#include "orx_parsejson.h"
+
+#define OJIC_TYPE_MASK  0x0F   // typeFlags bits holding the OJIENUM type
+#define OJIC_HAS_TEXT   0x10   // typeFlags bit:  payload text follows key
+
+/* Upper limit on tree height; an AVL tree of height 64 holds > 2^44 nodes */
+#define OJIC_MAX_HEIGHT 64
+
+typedef struct OJICNODEstr {
+  struct OJICNODEstr* pLeft;
+  struct OJICNODEstr* pRight;
+  union {                  // uPayload:  as in OJITEM, less string pointer
+    OJIBOOL aBool;
+    double aScalar;
+    int64_t anInteger;
+  } uPayload;
+  uint32_t textOffset;     // Offset of payload text from keyString[0]
+  uint8_t typeFlags;       // OJIENUM payload type | OJIC_* flags
+  int8_t balance;          // height(pLeft) - height(pRight)
+  char keyString[];        // Key, '\0', then payload text and '\0' if any
+} OJICNODE, *pOJICNODE;
+
+typedef struct OJICTREEstr {
+  pOJICNODE pRoot;
+  size_t count;                                          // Number of nodes
+  int (*comparator)(const char* key1, const char* key2); // e.g. strcmp
+  void (*cleanupNode)(pOJICNODE pNode);                  // e.g. free
+  pORXALLOC pAlloc;        // Nodes, if cleanupNode is the default; null for malloc
+} OJICTREE, *pOJICTREE;
+
+/* Payload type, and payload text or null, of a node */
+#define OJIC_TYPE(P) ((OJIENUM)((P)->typeFlags & OJIC_TYPE_MASK))
+#define OJIC_TEXT(P) (((P)->typeFlags & OJIC_HAS_TEXT) ? ((P)->keyString + (P)->textOffset) : (char*)0)
+
+void initOjic(pOJICTREE pTree);
+pOJICNODE newOjic(pOJITEM pSource, int lenStrJson);
+pOJICNODE newOjicAlloc(pOJITEM pSource, int lenStrJson, pORXALLOC pAlloc);
+int insertOjic(pOJICTREE pTree, pOJICNODE pNewNode);
+pOJICNODE getOjic(pOJICTREE pTree, const char* searchKeyString);
+void traverseOjic(pOJICTREE pTree, void (*handler)(pOJICNODE, int, void**), void** args);
+void cleanupOjic(pOJICTREE pTree);
+
+int readOjicTree(char* filepath, pOJICTREE pTree, char* pfx, pOJISTATS pStats);
+int copyOjiAvlToOjic(pAVLTREE pAvlRoot, pOJICTREE pTree);
+
+void orx_getAnyOjic(pOJICTREE pTree, char* searchKeyString, void *pOut, int *pFound, OJIENUM requestedOjiType, int stringOutSize);
+void orx_getNullOjic(pOJICTREE pTree, char* searchKeyString, int* pFound);
+void orx_getDoubleOjic(pOJICTREE pTree, char* searchKeyString, double* pOut, int* pFound);
+void orx_getInt64Ojic(pOJICTREE pTree, char* searchKeyString, int64_t* pOut, int* pFound);
+void orx_getBooleanOjic(pOJICTREE pTree, char* searchKeyString, OJIBOOL* pOut, int* pFound);
+void orx_getStringOjic(pOJICTREE pTree, char* searchKeyString, int stringOutSize, char* pOut, int* pFound);
+
+#endif // __ORX_COMPACT_H__
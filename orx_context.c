@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jsmn.h"
+#include "orx_context.h"
+
+/* Initial token array; doubled as needed */
+#define OJICONTEXT_TOKENS 64
+
+
+/**********************************************************************/
+/* Set up context; nothing is allocated until the first parse
+ * - arenaBlockSize:  smallest arena block; 0 for 64kB
+ * - pBacking:  allocator for tokens, key buffer and arena blocks; null
+ *   for malloc
+ * - returns 0 on success
+ */
+int
+initOjiContext(pOJICONTEXT pCtx, size_t arenaBlockSize, pORXALLOC pBacking) {
+  if (!pCtx) return 1;
+  memset(pCtx, 0, sizeof *pCtx);
+  pCtx->pBacking = pBacking;
+  pCtx->opts.pAlloc = initArenaOrx(&pCtx->arena, arenaBlockSize ? arenaBlockSize : 65536, pBacking);
+  return 0;
+}
+
+
+/**********************************************************************/
+/* Parse an in-memory JSON document into pCtx->pAvlTree
+ * - json_buffer need not be null-terminated; it is not modified
+ * - the previous tree, and all its OJITEMs, are discarded
+ * - returns 0 on success, non-zero on failure (same codes as readOjiAvl)
+ */
+int
+parseOjiContext(pOJICONTEXT pCtx, const uint8_t* json_buffer, size_t json_len) {
+pOJISTATS pStats;
+jsmntok_t* pToks;
+jsmn_parser jp;
+int parse_rtn;
+double t0;
+
+  if (!pCtx) return 1;
+  pStats = pCtx->opts.pStats;
+  t0 = pStats ? ojiSeconds() : 0.0;
+
+  /* Discard previous tree; its OJITEMs are all in the arena */
+  pCtx->pAvlTree = 0;
+  resetArenaOrx(&pCtx->arena);
+  ++pCtx->parses;
+
+  if (!json_buffer) {
+    fprintf(stderr, "%s\n", "parseOjiContext(...) null JSON buffer");
+    return 2;
+  }
+
+  if (!pCtx->pToks) {
+    if (!(pCtx->pToks = orx_malloc(pCtx->pBacking, sizeof(jsmntok_t) * OJICONTEXT_TOKENS))) {
+      fprintf(stderr, "%s\n", "parseOjiContext(...) failed to allocate tokens");
+      return 3;
+    }
+    pCtx->tokCount = OJICONTEXT_TOKENS;
+    OJISTAT(pStats, ++pStats->mallocCount; pStats->allocBytes += sizeof(jsmntok_t) * pCtx->tokCount);
+  }
+
+  /* Tokenize, doubling the kept token array as needed */
+  jsmn_init(&jp);
+  while (JSMN_ERROR_NOMEM == (parse_rtn = jsmn_parse(&jp, (const char*) json_buffer, json_len, (jsmntok_t*) pCtx->pToks, pCtx->tokCount))) {
+    OJISTAT(pStats, ++pStats->parsePasses);
+    if (!(pToks = orx_realloc(pCtx->pBacking, pCtx->pToks, sizeof(jsmntok_t) * pCtx->tokCount
+                                                         , sizeof(jsmntok_t) * (pCtx->tokCount << 1)))) {
+      fprintf(stderr, "%s\n", "parseOjiContext(...) failed to allocate tokens");
+      return 3;
+    }
+    pCtx->pToks = pToks;
+    pCtx->tokCount <<= 1;
+    OJISTAT(pStats, ++pStats->reallocCount; pStats->allocBytes += sizeof(jsmntok_t) * pCtx->tokCount);
+  }
+  OJISTAT(pStats, ++pStats->parsePasses;
+                  pStats->bytesRead += json_len;
+                  pStats->tokenizeSeconds += ojiSeconds() - t0);
+
+  return dumpTokensOjiKeyBuf(&pCtx->pAvlTree, json_buffer, (jsmntok_t*) pCtx->pToks, jp.toknext, parse_rtn
+                            , &pCtx->keyBuf, &pCtx->keySize, pCtx->pBacking, &pCtx->opts);
+}
+
+
+/**********************************************************************/
+/* Free everything kept by the context, including the last tree */
+void
+cleanupOjiContext(pOJICONTEXT pCtx) {
+  if (!pCtx) return;
+  pCtx->pAvlTree = 0;
+  cleanupArenaOrx(&pCtx->arena);
+  orx_free(pCtx->pBacking, pCtx->pToks);
+  orx_free(pCtx->pBacking, pCtx->keyBuf);
+  pCtx->pToks = 0;
+  pCtx->keyBuf = 0;
+  pCtx->tokCount = pCtx->keySize = 0;
+  return;
+}
+/**********************************************************************/
+/*** End of library functions ****************************************/
+/**********************************************************************/
+
+
+#ifdef DO_MAIN
+/**********************************************************************/
+/*** Test program ***/
+/*
+ * Usage:
+ *
+ *   ./test_orx_context file.json [file2.json ...]
+ *
+ * Compile and link:
+ *
+ *  % gcc -DDO_MAIN orx_context.c -o test_orx_context -lm
+ *
+ */
+#include "jsmn.c"
+#include "avltree.c"
+#define main MAIN_BUFFILE
+#include "buffer_file.c"
+#undef main
+#undef DO_MAIN
+#include "orx_parsejson.c"
+#include "orx_alloc.c"
+#define DO_MAIN
+
+#include "orx_test.h"
+
+/* Backing allocator over malloc that counts calls */
+static unsigned long heapCalls = 0;
+static void* countingAllocate(pORXALLOC pAlloc, size_t size) {
+  (void) pAlloc;
+  ++heapCalls;
+  return malloc(size);
+}
+static void* countingReallocate(pORXALLOC pAlloc, void* ptr, size_t oldSize, size_t newSize) {
+  (void) pAlloc;
+  (void) oldSize;
+  ++heapCalls;
+  return realloc(ptr, newSize);
+}
+static void countingRelease(pORXALLOC pAlloc, void* ptr) {
+  (void) pAlloc;
+  ++heapCalls;
+  free(ptr);
+}
+
+/* Messages of varying size, as from a telemetry stream */
+static size_t
+makeMessage(char* json, int i) {
+  return sprintf(json, "{\"seq\":%d,\"kind\":\"%s\",\"t\":%d.25,\"ok\":%s,\"v\":[%d,%d,%d]%s}"
+                , i, (i & 1) ? "range" : "doppler", i, (i % 3) ? "true" : "false"
+                , i, i + 1, i + 2
+                , (i % 5) ? "" : ",\"extra\":{\"note\":\"every fifth message is longer\",\"w\":[1,2,3,4,5,6]}");
+}
+
+int
+main(int argc, char** argv) {
+ORXALLOC counting = { countingAllocate, countingReallocate, countingRelease, 0 };
+OJICONTEXT ctx;
+char json[512];
+size_t len;
+uint8_t* file;
+double d;
+int found;
+int i;
+int n = 20000;
+unsigned long warmCalls;
+pAVLTREE pAvlTree = 0;
+double tContext;
+double tBuffer;
+
+  /* Files:  context result matches readOjiAvl */
+  CHECK(!initOjiContext(&ctx, 0, &counting));
+  while (--argc > 0) {
+    if (!(file = buffile_file_to_puint8(argv[argc], &len, 0))) {
+      fprintf(stderr, "Cannot read %s\n", argv[argc]);
+      ++errors;
+      continue;
+    }
+    CHECK(!parseOjiContext(&ctx, file, len));
+    CHECK(!readOjiAvl(argv[argc], &pAvlTree, 0, 0));
+    CHECK(verifyAvl(&ctx.pAvlTree) >= 0);
+    {
+    pAVLTREE p1 = firstAvl(ctx.pAvlTree);
+    pAVLTREE p2 = firstAvl(pAvlTree);
+      for ( ; p1 && p2; p1 = nextAvl(p1), p2 = nextAvl(p2)) {
+        CHECK(!strcmp(((pOJITEM) p1->payload)->keyString, ((pOJITEM) p2->payload)->keyString));
+        CHECK(!strcmp(((pOJITEM) p1->payload)->sPayload, ((pOJITEM) p2->payload)->sPayload));
+      }
+      CHECK(!p1 && !p2);
+    }
+    cleanupAVL(&pAvlTree);
+    free(file);
+    fprintf(stdout, "%s:  %s\n", argv[argc], errors ? "FAILED" : "OK");
+  }
+
+  /* Steady state:  no heap calls once the largest message has been seen */
+  for (i=0; i<10; ++i) {
+    len = makeMessage(json, i);
+    CHECK(!parseOjiContext(&ctx, (uint8_t*) json, len));
+  }
+  warmCalls = heapCalls;
+  tContext = ojiSeconds();
+  for (i=0; i<n; ++i) {
+    len = makeMessage(json, i);
+    if (parseOjiContext(&ctx, (uint8_t*) json, len)) {
+      ++errors;
+      break;
+    }
+    orx_getDoubleOji(ctx.pAvlTree, "json.v[2]", &d, &found);
+    if (!found || d != (double) (i + 2)) {
+      ++errors;
+      break;
+    }
+  }
+  tContext = ojiSeconds() - tContext;
+  warmCalls = heapCalls - warmCalls;
+  CHECK(warmCalls == 0);
+
+  /* Same messages with readOjiAvlBuffer */
+  tBuffer = ojiSeconds();
+  for (i=0; i<n; ++i) {
+    len = makeMessage(json, i);
+    CHECK(!readOjiAvlBuffer((uint8_t*) json, len, &pAvlTree, 0, 0));
+    orx_getDoubleOji(pAvlTree, "json.v[2]", &d, &found);
+    CHECK(found && d == (double) (i + 2));
+    cleanupAVL(&pAvlTree);
+  }
+  tBuffer = ojiSeconds() - tBuffer;
+
+  /* A deeper document grows the key buffer */
+  memset(json, '[', 40);
+  json[40] = '1';
+  memset(json + 41, ']', 40);
+  len = 81;
+  CHECK(!parseOjiContext(&ctx, (uint8_t*) json, len));
+  for (i=0, len=sprintf(json, "json"); i<40; ++i) { len += sprintf(json + len, "[0]"); }
+  orx_getDoubleOji(ctx.pAvlTree, json, &d, &found);
+  CHECK(found && d == 1.0 && ctx.keySize > len);
+
+  cleanupOjiContext(&ctx);
+
+  fprintf(stdout, "test_orx_context:  %s; %d messages, %lu heap calls after warm-up;"
+                  " context %.2fus/message, readOjiAvlBuffer %.2fus/message\n"
+         , errors ? "FAILED" : "OK", n, warmCalls
+         , 1e6 * tContext / n, 1e6 * tBuffer / n);
+  return errors ? 1 : 0;
+}
+#endif // DO_MAIN
@@ -0,0 +1,47 @@
+////////////////////////////////////////////////////////////////////////
+// Reusable parser context, for parsing many small JSON documents
+//
+// readOjiAvl* allocate a token array, a file buffer, and every OJITEM
+// anew for each document.  An OJICONTEXT keeps, between parses:
+//
+//   - the JSMN token array, grown (doubled) as needed
+//   - the key path buffer, grown (doubled) as needed
+//   - an arena (ORXARENA) for the OJITEMs, recycled by each parse
+//
+// so once the context has seen a document of a given size, parsing
+// another no larger does no heap allocation at all.
+//
+// The tree from parseOjiContext lives in the arena:  it is valid until
+// the next parse, or cleanupOjiContext, which replace it; do not pass
+// it to cleanupAVL, and copy out (e.g. copyWholeOjiAvlTree) anything
+// needed for longer.
+//
+// Before parsing, the caller may set pStats, pSink and the key filters
+// in ctx.opts; opts.pAlloc is the arena, and must not be changed.
+//
+////////////////////////////////////////////////////////////////////////
+#ifndef __ORX_CONTEXT_H__
+#define __ORX_CONTEXT_H__
+
+#include <stdint.h>
+
+#include "orx_parsejson.h"
+#include "orx_alloc.h"
+
+typedef struct OJICONTEXTstr {
+  OJIOPTS opts;            // Load options; opts.pAlloc is &arena.alloc
+  ORXARENA arena;          // OJITEMs of the current parse
+  pORXALLOC pBacking;      // Tokens, key buffer, arena blocks; null for malloc
+  void* pToks;             // JSMN tokens (jsmntok_t[tokCount])
+  size_t tokCount;
+  char* keyBuf;            // Key path scratch
+  size_t keySize;
+  pAVLTREE pAvlTree;       // Tree from the last parse
+  unsigned long parses;    // Statistics:  parseOjiContext calls
+} OJICONTEXT, *pOJICONTEXT;
+
+int initOjiContext(pOJICONTEXT pCtx, size_t arenaBlockSize, pORXALLOC pBacking);
+int parseOjiContext(pOJICONTEXT pCtx, const uint8_t* json_buffer, size_t json_len);
+void cleanupOjiContext(pOJICONTEXT pCtx);
+
+#endif // __ORX_CONTEXT_H__
@@ -0,0 +1,565 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "orx_export.h"
+
+
+/**********************************************************************/
+/**********************************************************************/
+/*** Fast export of OJI trees; see orx_export.h */
+/**********************************************************************/
+/**********************************************************************/
+
+/**********************************************************************/
+/* Buffered output */
+
+/* Write all of bytes to fd; return 0 on success */
+static int
+writeAllFd(int fd, const char* bytes, size_t n) {
+ssize_t nWritten;
+  while (n) {
+    nWritten = write(fd, bytes, n);
+    if (nWritten < 0) {
+      if (errno == EINTR) continue;
+      return 1;
+    }
+    bytes += nWritten;
+    n -= (size_t) nWritten;
+  }
+  return 0;
+}
+
+int
+initFdWriterOji(pOJIWRITER pWriter, int fd) {
+  if (!pWriter) return 1;
+  pWriter->len = 0;
+  pWriter->fd = fd;
+  pWriter->failed = 0;
+  pWriter->size = OJIWRITER_BUFSIZE;
+  if (!(pWriter->buf = malloc(pWriter->size))) {
+    pWriter->size = 0;
+    pWriter->failed = 1;
+  }
+  return pWriter->failed;
+}
+
+int
+initBufferWriterOji(pOJIWRITER pWriter) {
+  return initFdWriterOji(pWriter, -1);
+}
+
+/* Return pointer to at least n free bytes at pWriter->buf + pWriter->len,
+ * or null on failure; the caller adds the bytes used to pWriter->len
+ */
+char*
+reserveWriterOji(pOJIWRITER pWriter, size_t n) {
+size_t newSize;
+char* newBuf;
+
+  if (pWriter->failed) return 0;
+  if (pWriter->len + n <= pWriter->size) return pWriter->buf + pWriter->len;
+
+  if (pWriter->fd >= 0) {
+    if (writeAllFd(pWriter->fd, pWriter->buf, pWriter->len)) {
+      pWriter->failed = 1;
+      return 0;
+    }
+    pWriter->len = 0;
+    if (n <= pWriter->size) return pWriter->buf;
+  }
+
+  for (newSize = pWriter->size ? pWriter->size : OJIWRITER_BUFSIZE; newSize < pWriter->len + n; newSize <<= 1) ;
+  if (!(newBuf = realloc(pWriter->buf, newSize))) {
+    pWriter->failed = 1;
+    return 0;
+  }
+  pWriter->buf = newBuf;
+  pWriter->size = newSize;
+  return pWriter->buf + pWriter->len;
+}
+
+void
+writeOji(pOJIWRITER pWriter, const char* bytes, size_t n) {
+char* p;
+  /* Large writes to fd bypass the buffer */
+  if (pWriter->fd >= 0 && n > pWriter->size && !pWriter->failed) {
+    if (writeAllFd(pWriter->fd, pWriter->buf, pWriter->len)
+     || writeAllFd(pWriter->fd, bytes, n)) {
+      pWriter->failed = 1;
+    }
+    pWriter->len = 0;
+    return;
+  }
+  if (!(p = reserveWriterOji(pWriter, n))) return;
+  memcpy(p, bytes, n);
+  pWriter->len += n;
+  return;
+}
+
+/* Write buffered bytes to fd, or null-terminate memory buffer; returns
+ * non-zero if any write or allocation failed
+ */
+int
+flushWriterOji(pOJIWRITER pWriter) {
+char* p;
+  if (pWriter->failed) return 1;
+  if (pWriter->fd >= 0) {
+    if (writeAllFd(pWriter->fd, pWriter->buf, pWriter->len)) { pWriter->failed = 1; }
+    pWriter->len = 0;
+  } else if ((p = reserveWriterOji(pWriter, 1))) {
+    *p = '\0';
+  }
+  return pWriter->failed;
+}
+
+void
+cleanupWriterOji(pOJIWRITER pWriter) {
+  if (!pWriter) return;
+  if (pWriter->buf) { free(pWriter->buf); }
+  pWriter->buf = 0;
+  pWriter->len = pWriter->size = 0;
+  return;
+}
+
+
+/**********************************************************************/
+/* Number formatting */
+
+/* Shortest text that reads back (strtod) as the same double,
+ * null-terminated; returns length.  pOut needs 32 bytes
+ * - integers below 2**53 use formatIntOji; other values use the fewest
+ *   significant digits that round-trip, and 17 always does
+ * - a normal double is within 1.2e-16 (relative) of any shorter decimal
+ *   that reads back as it, well inside half a 15-digit step, so %.15g
+ *   rounds to that decimal and drops its zeros:  searching from 15 digits
+ *   is enough.  Subnormals carry fewer bits, e.g. 5e-324, and search
+ *   from 1 digit
+ */
+int
+formatDoubleOji(double value, char* pOut) {
+int prec;
+int len;
+
+  if (value != value) { strcpy(pOut, "nan"); return 3; }
+  if (isinf(value)) { strcpy(pOut, value < 0 ? "-inf" : "inf"); return value < 0 ? 4 : 3; }
+  if (value == 0.0) { strcpy(pOut, signbit(value) ? "-0" : "0"); return signbit(value) ? 2 : 1; }
+
+  if (fabs(value) < 9007199254740992.0 && value == (double) (long long) value) {
+    return formatIntOji((long long) value, pOut);
+  }
+
+  for (prec = fabs(value) < DBL_MIN ? 1 : 15; prec<17; ++prec) {
+    len = sprintf(pOut, "%.*g", prec, value);
+    if (strtod(pOut, 0) == value) return len;
+  }
+  return sprintf(pOut, "%.17g", value);
+}
+
+
+/**********************************************************************/
+/* Line formatting */
+
+static const char* exportTypeNames[OJI_ENUMCOUNT] =
+  { "unknown", "null", "boolean", "scalar", "string", "integer" };
+
+/* Append one line for pOji; return 1 if verification lookup failed */
+static int
+exportOneOji(pAVLTREE pAvlRoot, pOJITEM pOji, pOJIWRITER pWriter, pOJIEXPORT pExport) {
+const char* typeName = (pOji->payloadType >= 0 && pOji->payloadType < OJI_ENUMCOUNT)
+                     ? exportTypeNames[pOji->payloadType] : "unknown";
+size_t lenKey = strlen(pOji->keyString);
+size_t lenText = pOji->sPayload ? strlen(pOji->sPayload) : 0;
+char* p0;
+char* p;
+int ndjson = pExport->format == OJIEXP_NDJSON;
+
+  if (!(p0 = p = reserveWriterOji(pWriter, lenKey + lenText + 80))) return 0;
+
+#define PUTS_EXP(S) { size_t n_ = strlen(S); memcpy(p, S, n_); p += n_; }
+  if (ndjson) { PUTS_EXP("{\"key\":\"") }
+  memcpy(p, pOji->keyString, lenKey); p += lenKey;
+  if (ndjson) { PUTS_EXP("\",\"type\":\"") } else { *p++ = '\t'; }
+  PUTS_EXP(typeName)
+  if (ndjson) { PUTS_EXP("\",\"value\":") } else { *p++ = '\t'; }
+
+  switch (pOji->payloadType) {
+  case OJI_NULL:
+    PUTS_EXP("null")
+    break;
+  case OJI_BOOLEAN:
+    PUTS_EXP(pOji->uPayload.aBool ? "true" : "false")
+    break;
+  case OJI_SCALAR:
+    if (ndjson && !isfinite(pOji->uPayload.aScalar)) {
+      PUTS_EXP("null")
+    } else {
+      p += formatDoubleOji(pOji->uPayload.aScalar, p);
+    }
+    break;
+  case OJI_INTEGER:
+    p += formatIntOji(pOji->uPayload.anInteger, p);
+    break;
+  case OJI_STRING:
+    if (ndjson) *p++ = '"';
+    memcpy(p, pOji->sPayload, lenText); p += lenText;
+    if (ndjson) *p++ = '"';
+    break;
+  default:
+    /* Unknown text is written as a JSON string, without escaping */
+    if (ndjson) *p++ = '"';
+    if (lenText) { memcpy(p, pOji->sPayload, lenText); p += lenText; }
+    if (ndjson) *p++ = '"';
+    break;
+  }
+
+  if (ndjson) *p++ = '}';
+  *p++ = '\n';
+#undef PUTS_EXP
+
+  pWriter->len += (size_t) (p - p0);
+
+  return (pExport->verify && orx_getOji(pAvlRoot, pOji->keyString) != pOji) ? 1 : 0;
+}
+
+
+/**********************************************************************/
+/* Parallel export:  one chunk of items per thread */
+
+typedef struct EXPCHUNKstr {
+  pAVLTREE pAvlRoot;
+  pOJITEM* items;
+  size_t nItems;
+  pOJIEXPORT pExport;
+  OJIWRITER writer;              // Memory buffer for this chunk
+  unsigned long verifyFailures;
+} EXPCHUNK, *pEXPCHUNK;
+
+static void*
+exportChunkOji(void* arg) {
+pEXPCHUNK pChunk = (pEXPCHUNK) arg;
+size_t i;
+  for (i=0; i<pChunk->nItems; ++i) {
+    pChunk->verifyFailures += exportOneOji(pChunk->pAvlRoot, pChunk->items[i], &pChunk->writer, pChunk->pExport);
+  }
+  return arg;
+}
+
+static int
+exportParallelOji(pAVLTREE pAvlRoot, pOJIWRITER pWriter, pOJIEXPORT pExport) {
+pOJITEM* items;
+pEXPCHUNK chunks;
+pthread_t* threads;
+int* started;
+pAVLTREE pAvl;
+size_t n = 0;
+size_t i;
+int nThreads = pExport->nThreads;
+int iThread;
+int rtn = 0;
+
+  for (pAvl = firstAvl(pAvlRoot); pAvl; pAvl = nextAvl(pAvl)) ++n;
+  if ((size_t) nThreads > n) nThreads = n ? (int) n : 1;
+
+  items = malloc(n * sizeof(pOJITEM) + 1);
+  chunks = calloc(nThreads, sizeof(EXPCHUNK));
+  threads = malloc(nThreads * sizeof(pthread_t));
+  started = calloc(nThreads, sizeof(int));
+  if (!items || !chunks || !threads || !started) {
+    free(items); free(chunks); free(threads); free(started);
+    return 2;
+  }
+
+  for (i=0, pAvl = firstAvl(pAvlRoot); pAvl; pAvl = nextAvl(pAvl)) {
+    items[i++] = (pOJITEM) pAvl->payload;
+  }
+
+  /* Split into nThreads contiguous key ranges */
+  for (iThread=0; iThread<nThreads; ++iThread) {
+  pEXPCHUNK pChunk = chunks + iThread;
+  size_t lo = n * iThread / nThreads;
+  size_t hi = n * (iThread + 1) / nThreads;
+    pChunk->pAvlRoot = pAvlRoot;
+    pChunk->items = items + lo;
+    pChunk->nItems = hi - lo;
+    pChunk->pExport = pExport;
+    initBufferWriterOji(&pChunk->writer);
+    started[iThread] = !pthread_create(threads + iThread, 0, exportChunkOji, pChunk);
+  }
+
+  /* Write chunks in order; format any whose thread did not start */
+  for (iThread=0; iThread<nThreads; ++iThread) {
+  pEXPCHUNK pChunk = chunks + iThread;
+    if (started[iThread]) {
+      pthread_join(threads[iThread], 0);
+    } else {
+      exportChunkOji(pChunk);
+    }
+    if (pChunk->writer.failed) { rtn = 3; }
+    writeOji(pWriter, pChunk->writer.buf, pChunk->writer.len);
+    pExport->verifyFailures += pChunk->verifyFailures;
+    cleanupWriterOji(&pChunk->writer);
+  }
+  pExport->itemCount += n;
+
+  free(items); free(chunks); free(threads); free(started);
+  return rtn;
+}
+
+
+/**********************************************************************/
+/* Export tree to writer; the caller flushes the writer
+ * - returns 0 on success
+ */
+int
+orx_exportOjiWriter(pAVLTREE pAvlRoot, pOJIWRITER pWriter, pOJIEXPORT pExport) {
+OJIEXPORT defaultExport;
+pAVLTREE pAvl;
+int rtn = 0;
+
+  if (!pWriter) return 1;
+  if (!pExport) {
+    memset(&defaultExport, 0, sizeof defaultExport);
+    pExport = &defaultExport;
+  }
+
+  if (pExport->nThreads > 1) {
+    rtn = exportParallelOji(pAvlRoot, pWriter, pExport);
+  } else {
+    for (pAvl = firstAvl(pAvlRoot); pAvl; pAvl = nextAvl(pAvl)) {
+      pExport->verifyFailures += exportOneOji(pAvlRoot, (pOJITEM) pAvl->payload, pWriter, pExport);
+      ++pExport->itemCount;
+    }
+  }
+  return rtn ? rtn : (pWriter->failed ? 4 : 0);
+}
+
+/* Export tree to file descriptor */
+int
+orx_exportOjiFd(pAVLTREE pAvlRoot, int fd, pOJIEXPORT pExport) {
+OJIWRITER writer;
+int rtn;
+  if (initFdWriterOji(&writer, fd)) return 4;
+  rtn = orx_exportOjiWriter(pAvlRoot, &writer, pExport);
+  if (flushWriterOji(&writer) && !rtn) rtn = 4;
+  cleanupWriterOji(&writer);
+  return rtn;
+}
+
+/* Export tree to new null-terminated buffer; the caller frees *ppBuffer */
+int
+orx_exportOjiBuffer(pAVLTREE pAvlRoot, char** ppBuffer, size_t* pLen, pOJIEXPORT pExport) {
+OJIWRITER writer;
+int rtn;
+  if (!ppBuffer) return 1;
+  *ppBuffer = 0;
+  if (initBufferWriterOji(&writer)) return 4;
+  rtn = orx_exportOjiWriter(pAvlRoot, &writer, pExport);
+  if (flushWriterOji(&writer) && !rtn) rtn = 4;
+  if (rtn) {
+    cleanupWriterOji(&writer);
+    return rtn;
+  }
+  *ppBuffer = writer.buf;
+  if (pLen) *pLen = writer.len;
+  return 0;
+}
+
+
+#ifdef DO_MAIN
+/**********************************************************************/
+/*** Test program ***/
+/*
+ * Usage:
+ *
+ *   ./test_orx_export minimal.json
+ *
+ * - Check number formatting, both formats, fd and memory output, and
+ *   that parallel output matches serial output
+ * - Time export and printOjiAvl of a synthetic 20000-record tree
+ *
+ * Compile and link:
+ *
+ *  % gcc -DDO_MAIN orx_export.c -o test_orx_export -pthread -lm
+ *
+ */
+#include "jsmn.c"
+#include "avltree.c"
+#define main MAIN_BUFFILE
+#include "buffer_file.c"
+#undef main
+#undef DO_MAIN
+#include "orx_parsejson.c"
+#define DO_MAIN
+
+#include "orx_test.h"
+
+/* Export with given options to buffer; null on failure */
+static char*
+exportWith(pAVLTREE pAvlRoot, OJIEXPFORMAT format, int nThreads, int verify, unsigned long* pFailures) {
+OJIEXPORT exp;
+char* buffer = 0;
+size_t len = 0;
+  memset(&exp, 0, sizeof exp);
+  exp.format = format;
+  exp.nThreads = nThreads;
+  exp.verify = verify;
+  CHECK(!orx_exportOjiBuffer(pAvlRoot, &buffer, &len, &exp));
+  CHECK(buffer && strlen(buffer) == len);
+  if (pFailures) *pFailures = exp.verifyFailures;
+  return buffer;
+}
+
+/* Fewest digits that round-trip, searched from 1; for formatDoubleOji */
+static int
+shortestDigitsExport(double value, char* pOut) {
+int prec;
+  for (prec=1; prec<17; ++prec) {
+    sprintf(pOut, "%.*g", prec, value);
+    if (strtod(pOut, 0) == value) break;
+  }
+  return sprintf(pOut, "%.*g", prec, value);
+}
+
+int
+main(int argc, char** argv) {
+static const double values[] =
+  { 0.1, 1.0/3.0, 120.0, -999.0, -1.23e-45, 5e-324, 1.7976931348623157e308
+  , 9007199254740993.0, 123456789012345678.0, 2.5e-3, -0.0, 1e21, 0.30000000000000004
+  };
+pAVLTREE pAvlRoot = 0;
+pAVLTREE pBigRoot = 0;
+char s[32];
+char t[32];
+char* lines;
+char* ndjson;
+char* other;
+char* bigJson;
+char* p;
+unsigned long failures;
+double v;
+double t0;
+double tExport;
+double tExport4;
+double tPrint;
+FILE* fNull;
+FILE* fTmp;
+void* pVoid2[2];
+jsmn_parser parser;
+jsmntok_t toks[16];
+size_t i;
+size_t n;
+
+  /* Number formatting */
+  CHECK(formatIntOji(0, s) == 1 && !strcmp(s, "0"));
+  CHECK(formatIntOji(-9223372036854775807LL - 1, s) == 20 && !strcmp(s, "-9223372036854775808"));
+  CHECK(formatIntOji(1234567, s) == 7 && !strcmp(s, "1234567"));
+  for (i=0; i<sizeof values / sizeof values[0]; ++i) {
+    formatDoubleOji(values[i], s);
+    sprintf(t, "%.17g", values[i]);
+    CHECK(strtod(s, 0) == values[i] && signbit(strtod(s, 0)) == signbit(values[i]));
+    CHECK(strlen(s) <= strlen(t));
+  }
+  formatDoubleOji(0.1, s); CHECK(!strcmp(s, "0.1"));
+  formatDoubleOji(-999.0, s); CHECK(!strcmp(s, "-999"));
+  formatDoubleOji(5e-324, s); CHECK(!strcmp(s, "5e-324"));
+  for (i=0, n=0; i<200000; ++i) {
+    v = (i & 1) ? ldexp((double) (i * 2654435761u), (int) (i % 2100) - 1100)
+                       : (double) (long long) (i * 40503u) * pow(10.0, (double) (i % 40) - 20);
+    formatDoubleOji(v, s);
+    shortestDigitsExport(v, t);
+    if (!isinf(v) && !(fabs(v) < 9007199254740992.0 && v == floor(v)) && strcmp(s, t)) ++n;
+  }
+  CHECK(n == 0);
+  formatDoubleOji(-1.23e-45, s); CHECK(!strcmp(s, "-1.23e-45"));
+  formatDoubleOji(2.5e-3, s); CHECK(!strcmp(s, "0.0025"));
+  formatDoubleOji(0.30000000000000004, s); CHECK(!strcmp(s, "0.30000000000000004"));
+  formatDoubleOji(1.7976931348623157e308, s); CHECK(!strcmp(s, "1.7976931348623157e+308"));
+
+  if (argc < 2 || readOjiAvl(argv[1], &pAvlRoot, 0, 0)) {
+    fprintf(stderr, "Usage:  %s minimal.json\n", argv[0]);
+    return 1;
+  }
+
+  /* Both formats */
+  lines = exportWith(pAvlRoot, OJIEXP_LINES, 1, 1, &failures);
+  CHECK(failures == 0);
+  CHECK(lines && strstr(lines, "json.array[2]\tinteger\t-999\n"));
+  CHECK(lines && strstr(lines, "json.object.string\tstring\tstring\n"));
+  CHECK(lines && strstr(lines, "json.object.large_negative\tscalar\t-1.23e-45\n"));
+  CHECK(lines && strstr(lines, "json.object.null\tnull\tnull\n"));
+
+  ndjson = exportWith(pAvlRoot, OJIEXP_NDJSON, 1, 0, 0);
+  CHECK(ndjson && strstr(ndjson, "{\"key\":\"json.object.true_bool\",\"type\":\"boolean\",\"value\":true}\n"));
+  for (n=0, p=ndjson; p && *p; ++n) {
+  char* pEnd = strchr(p, '\n');
+    jsmn_init(&parser);
+    CHECK(pEnd && jsmn_parse(&parser, p, pEnd - p, toks, 16) == 7);
+    p = pEnd ? pEnd + 1 : p + strlen(p);
+  }
+  CHECK(n == 17);
+
+  /* Parallel output matches serial output */
+  other = exportWith(pAvlRoot, OJIEXP_NDJSON, 4, 1, &failures);
+  CHECK(other && ndjson && !strcmp(other, ndjson) && failures == 0);
+  free(other);
+
+  /* Same bytes through a file descriptor */
+  if ((fTmp = tmpfile())) {
+  OJIEXPORT exp;
+    memset(&exp, 0, sizeof exp);
+    CHECK(!orx_exportOjiFd(pAvlRoot, fileno(fTmp), &exp));
+    n = (size_t) ftell(fTmp);
+    rewind(fTmp);
+    other = calloc(1, n + 1);
+    CHECK(other && fread(other, 1, n, fTmp) == n && lines && !strcmp(other, lines));
+    free(other);
+    fclose(fTmp);
+  }
+
+  free(lines);
+  free(ndjson);
+  cleanupAVL(&pAvlRoot);
+
+  /* Timing on a synthetic tree */
+  n = 20000;
+  bigJson = malloc(n * 96 + 16);
+  p = bigJson;
+  p += sprintf(p, "{\"records\":[");
+  for (i=0; i<n; ++i) {
+    p += sprintf(p, "%s{\"id\":%lu,\"t\":%.6f,\"name\":\"rec%lu\",\"ok\":%s}"
+                , i ? "," : "", (unsigned long) i, i * 0.125 + 1e-3
+                , (unsigned long) i, (i & 1) ? "true" : "false");
+  }
+  strcpy(p, "]}");
+  CHECK(!readOjiAvlBuffer((const uint8_t*) bigJson, strlen(bigJson), &pBigRoot, 0, 0));
+  free(bigJson);
+
+  fNull = fopen("/dev/null", "w");
+  t0 = ojiSeconds();
+  other = exportWith(pBigRoot, OJIEXP_LINES, 1, 0, 0);
+  tExport = ojiSeconds() - t0;
+  free(other);
+  t0 = ojiSeconds();
+  other = exportWith(pBigRoot, OJIEXP_LINES, 4, 0, 0);
+  tExport4 = ojiSeconds() - t0;
+  free(other);
+  pVoid2[0] = (void*) fNull;
+  pVoid2[1] = (void*) &pBigRoot;
+  t0 = ojiSeconds();
+  if (fNull) traverseFromRightAvl(pBigRoot, 0, printOjiAvl, pVoid2);
+  tPrint = ojiSeconds() - t0;
+  if (fNull) fclose(fNull);
+  cleanupAVL(&pBigRoot);
+
+  fprintf(stdout, "test_orx_export:  %s; %lu keys; export %.4fs, 4 threads %.4fs, printOjiAvl %.4fs\n"
+         , errors ? "FAILED" : "OK", (unsigned long) (n * 4 + 1), tExport, tExport4, tPrint);
+
+  return errors ? 1 : 0;
+}
+#endif // DO_MAIN
@@ -0,0 +1,67 @@
+////////////////////////////////////////////////////////////////////////
+// Fast export of flattened OJI trees
+//
+// Writes one line per OJITEM, in key order, in one of two formats:
+//
+//   OJIEXP_LINES:   key<TAB>type<TAB>value
+//                   e.g. "json.array[2]\tinteger\t-999"
+//   OJIEXP_NDJSON:  {"key":"json.array[2]","type":"integer","value":-999}
+//
+// - Output goes through an OJIWRITER, either to a file descriptor, via a
+//   fixed buffer flushed with write(2), or to a growable memory buffer
+// - Numbers are written in the shortest form that reads back as the
+//   same double; strings are written as their original JSON text
+// - Verification lookups (as done by printOjiAvl) are optional
+// - With nThreads > 1, the tree is split into nThreads key ranges, each
+//   formatted by its own thread, and the chunks are written in order
+//
+////////////////////////////////////////////////////////////////////////
+#ifndef __ORX_EXPORT_H__
+#define __ORX_EXPORT_H__
+
+#include <stddef.h>
+
+#include "orx_parsejson.h"
+
+typedef enum
+{ OJIEXP_LINES=0      // key, type and value separated by tabs
+, OJIEXP_NDJSON       // one JSON object per line
+} OJIEXPFORMAT;
+
+typedef struct OJIEXPORTstr {
+  OJIEXPFORMAT format;
+  int verify;                     // Non-zero to look up each key again
+  int nThreads;                   // >1 for parallel chunked formatting
+  unsigned long itemCount;        // Result:  lines written
+  unsigned long verifyFailures;   // Result:  failed verification lookups
+} OJIEXPORT, *pOJIEXPORT;
+
+////////////////////////////////////////////////////////////////////////
+// Buffered output
+// - fd >= 0:  bytes are collected in buf and written to fd when it fills
+// - fd < 0:  buf grows as needed; the caller takes buf (len bytes, plus
+//   a null terminator) after flushWriterOji
+typedef struct OJIWRITERstr {
+  char* buf;
+  size_t len;                     // Bytes in buf
+  size_t size;                    // Allocated size of buf
+  int fd;
+  int failed;                     // Set on allocation or write failure
+} OJIWRITER, *pOJIWRITER;
+
+#define OJIWRITER_BUFSIZE 65536
+
+int initFdWriterOji(pOJIWRITER pWriter, int fd);
+int initBufferWriterOji(pOJIWRITER pWriter);
+char* reserveWriterOji(pOJIWRITER pWriter, size_t n);
+void writeOji(pOJIWRITER pWriter, const char* bytes, size_t n);
+int flushWriterOji(pOJIWRITER pWriter);
+void cleanupWriterOji(pOJIWRITER pWriter);
+
+int formatDoubleOji(double value, char* pOut);
+
+int orx_exportOjiWriter(pAVLTREE pAvlRoot, pOJIWRITER pWriter, pOJIEXPORT pExport);
+int orx_exportOjiFd(pAVLTREE pAvlRoot, int fd, pOJIEXPORT pExport);
+int orx_exportOjiBuffer(pAVLTREE pAvlRoot, char** ppBuffer, size_t* pLen, pOJIEXPORT pExport);
+
+#endif // __ORX_EXPORT_H__
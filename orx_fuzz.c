@@ -0,0 +1,611 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "jsmn.h"
+#include "orx_fuzz.h"
+
+
+/**********************************************************************/
+/* Reference map:  one entry per leaf, in document order */
+typedef struct REFLEAFstr {
+  char* keyString;
+  char* text;              // JSON text of value, null-terminated
+  int lenText;
+  int isString;
+  size_t seq;              // Document order, so later values win
+} REFLEAF, *pREFLEAF;
+
+typedef struct REFMAPstr {
+  pREFLEAF leaves;
+  size_t n;
+  size_t limit;
+} REFMAP, *pREFMAP;
+
+static void
+cleanupRefMapOji(pREFMAP pRef) {
+size_t i;
+  for (i=0; i<pRef->n; ++i) {
+    free(pRef->leaves[i].keyString);
+    free(pRef->leaves[i].text);
+  }
+  free(pRef->leaves);
+  pRef->leaves = 0;
+  pRef->n = pRef->limit = 0;
+  return;
+}
+
+/* Append leaf; returns 0 on success */
+static int
+addRefLeafOji(pREFMAP pRef, const char* keyString, const char* text, int lenText, int isString) {
+pREFLEAF pLeaf;
+  if (pRef->n == pRef->limit) {
+  size_t limit = pRef->limit ? pRef->limit << 1 : 64;
+  pREFLEAF pNew = realloc(pRef->leaves, limit * sizeof(REFLEAF));
+    if (!pNew) return 1;
+    pRef->leaves = pNew;
+    pRef->limit = limit;
+  }
+  pLeaf = pRef->leaves + pRef->n;
+  if (!(pLeaf->keyString = strdup(keyString))) return 1;
+  if (!(pLeaf->text = malloc(lenText + 1))) {
+    free(pLeaf->keyString);
+    return 1;
+  }
+  memcpy(pLeaf->text, text, lenText);
+  pLeaf->text[lenText] = '\0';
+  pLeaf->lenText = lenText;
+  pLeaf->isString = isString;
+  pLeaf->seq = pRef->n++;
+  return 0;
+}
+
+/* Flatten token subtree at pToks[idx] under keyString, the simple way
+ * - returns index of the next token, or -1 for token structures the
+ *   flattener does not expect (e.g. non-strict jsmn oddities), or on
+ *   allocation failure
+ */
+static int
+refFlattenOji(pREFMAP pRef, const char* json, const jsmntok_t* pToks, int ntoks, int idx, const char* keyString) {
+const jsmntok_t* pTok;
+char* childKey;
+char sLength[32];
+int i;
+
+  if (idx < 0 || idx >= ntoks) return -1;
+  pTok = pToks + idx++;
+
+  switch (pTok->type) {
+
+  case JSMN_STRING:
+  case JSMN_PRIMITIVE:
+    if (pTok->size != 0) return -1;
+    if (addRefLeafOji(pRef, keyString, json + pTok->start, pTok->end - pTok->start, pTok->type == JSMN_STRING)) return -1;
+    return idx;
+
+  case JSMN_ARRAY:
+    if (!(childKey = malloc(strlen(keyString) + 32))) return -1;
+    sprintf(childKey, "%s.length", keyString);
+    sprintf(sLength, "%d", pTok->size);
+    if (addRefLeafOji(pRef, childKey, sLength, strlen(sLength), 0)) idx = -1;
+    for (i=0; idx >= 0 && i<pTok->size; ++i) {
+      sprintf(childKey, "%s[%d]", keyString, i);
+      idx = refFlattenOji(pRef, json, pToks, ntoks, idx, childKey);
+    }
+    free(childKey);
+    return idx;
+
+  case JSMN_OBJECT:
+    for (i=0; idx >= 0 && i<pTok->size; ++i) {
+      if (idx >= ntoks) return -1;
+      if (pToks[idx].type != JSMN_STRING && pToks[idx].type != JSMN_PRIMITIVE) return -1;
+      if (pToks[idx].size != 1) return -1;
+      if (!(childKey = malloc(strlen(keyString) + 2 + pToks[idx].end - pToks[idx].start))) return -1;
+      sprintf(childKey, "%s.%.*s", keyString, pToks[idx].end - pToks[idx].start, json + pToks[idx].start);
+      idx = refFlattenOji(pRef, json, pToks, ntoks, idx + 1, childKey);
+      free(childKey);
+    }
+    return idx;
+
+  default:
+    return -1;
+  }
+}
+
+/* Order by key, then document order */
+static int
+compareRefLeafOji(const void* p1, const void* p2) {
+const REFLEAF* pLeaf1 = (const REFLEAF*) p1;
+const REFLEAF* pLeaf2 = (const REFLEAF*) p2;
+int cmp = strcmp(pLeaf1->keyString, pLeaf2->keyString);
+  if (cmp) return cmp;
+  return pLeaf1->seq < pLeaf2->seq ? -1 : (pLeaf1->seq > pLeaf2->seq);
+}
+
+/* Sort, keeping only the last leaf of each key */
+static void
+uniqueRefMapOji(pREFMAP pRef) {
+size_t i;
+size_t n = 0;
+  if (!pRef->n) return;
+  qsort(pRef->leaves, pRef->n, sizeof(REFLEAF), compareRefLeafOji);
+  for (i=0; i<pRef->n; ++i) {
+    if (i+1 < pRef->n && !strcmp(pRef->leaves[i].keyString, pRef->leaves[i+1].keyString)) {
+      free(pRef->leaves[i].keyString);
+      free(pRef->leaves[i].text);
+      continue;
+    }
+    pRef->leaves[n++] = pRef->leaves[i];
+  }
+  pRef->n = n;
+  return;
+}
+
+
+/**********************************************************************/
+/* Load data, and check the result against the reference map
+ * - returns 0 if all checks pass, or if the input was skipped; else the
+ *   number of failed checks, each described on fErr (if not null)
+ */
+#define FUZZFAIL(MSG) { \
+  ++failures; \
+  if (fErr) fprintf(fErr, "checkLoadOji:  %s\n", MSG); \
+}
+
+int
+checkLoadOji(const uint8_t* data, size_t size, FILE* fErr) {
+REFMAP ref = { 0, 0, 0 };
+jsmntok_t* pToks = 0;
+jsmn_parser jp;
+int ntoks;
+int refOk = 0;
+pAVLTREE pAvlTree = 0;
+pAVLTREE pAvlDescent = 0;
+pAVLTREE pAvl;
+pAVLTREE pAvl2;
+pOJITEM pOji;
+OJIOPTS opts;
+int descent;
+int rtn;
+size_t i;
+int failures = 0;
+
+  if (memchr(data, '\0', size)) return 0;
+
+  /* Reference:  one parse with a token per byte, then simple flattening */
+  if (!(pToks = malloc((size + 1) * sizeof(jsmntok_t)))) return 0;
+  jsmn_init(&jp);
+  ntoks = jsmn_parse(&jp, (const char*) data, size, pToks, size + 1);
+  if (ntoks > 0) {
+    refOk = refFlattenOji(&ref, (const char*) data, pToks, ntoks, 0, "json") >= 0;
+    if (refOk) uniqueRefMapOji(&ref);
+  }
+
+  /* Library */
+  rtn = readOjiAvlBuffer(data, size, &pAvlTree, 0, 0);
+
+  if ((rtn == 0) != (ntoks > 0)) FUZZFAIL("load and reference parse disagree on success")
+  if (rtn && pAvlTree) FUZZFAIL("failed load left a tree")
+  if (verifyAvl(&pAvlTree) < 0) FUZZFAIL("AVL invariant violated")
+
+  if (refOk && !rtn) {
+
+    /* In-order scan matches sorted reference map */
+    for (i=0, pAvl=firstAvl(pAvlTree); pAvl && i<ref.n; pAvl=nextAvl(pAvl), ++i) {
+      pOji = (pOJITEM) pAvl->payload;
+      if (strcmp(pOji->keyString, ref.leaves[i].keyString)) {
+        FUZZFAIL("key differs from reference")
+        break;
+      }
+      if ((pOji->payloadType == OJI_STRING) != ref.leaves[i].isString
+       || strcmp(pOji->sPayload, ref.leaves[i].text)) {
+        FUZZFAIL("value differs from reference")
+      }
+    }
+    if (!failures && (pAvl || i != ref.n)) FUZZFAIL("key count differs from reference")
+
+    /* Lookups of every reference key */
+    for (i=0; i<ref.n; ++i) {
+      pOji = orx_getOji(pAvlTree, ref.leaves[i].keyString);
+      if (!pOji || strcmp(pOji->keyString, ref.leaves[i].keyString)) {
+        FUZZFAIL("lookup of reference key failed")
+        break;
+      }
+    }
+
+    /* Other descent modes build the same tree */
+    for (descent=OJI_DESCENT_LCP; descent<=OJI_DESCENT_MEMCMP; ++descent) {
+      memset(&opts, 0, sizeof opts);
+      opts.descent = (OJIDESCENT) descent;
+      if (readOjiAvlBuffer(data, size, &pAvlDescent, 0, &opts) || verifyAvl(&pAvlDescent) < 0) {
+        FUZZFAIL("load with other descent failed")
+      }
+      for (pAvl=firstAvl(pAvlTree), pAvl2=firstAvl(pAvlDescent); pAvl && pAvl2; pAvl=nextAvl(pAvl), pAvl2=nextAvl(pAvl2)) {
+        pOji = (pOJITEM) pAvl2->payload;
+        if (strcmp(((pOJITEM) pAvl->payload)->keyString, pOji->keyString)
+         || pOji != getLcpAvl(pAvlDescent, pOji, oji_lcpComparator, 0)) {
+          FUZZFAIL("other descent differs")
+          break;
+        }
+      }
+      if (pAvl || pAvl2) FUZZFAIL("other descent key count differs")
+      cleanupAVL(&pAvlDescent);
+    }
+  }
+
+  cleanupAVL(&pAvlTree);
+  cleanupRefMapOji(&ref);
+  free(pToks);
+  return failures;
+}
+
+
+/**********************************************************************/
+/* libFuzzer entry point */
+int
+LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  if (checkLoadOji(data, size, stderr)) abort();
+  return 0;
+}
+
+
+/**********************************************************************/
+/* Superlinear growth check:  best of three load times of generator(n);
+ * negative on failure
+ */
+static double
+timeLoadOji(ORXFUZZGEN generator, const void* arg, size_t n) {
+size_t len;
+char* json = generator(n, arg, &len);
+pAVLTREE pAvlTree = 0;
+double best = -1.0;
+double t0;
+int rep;
+
+  if (!json) return -1.0;
+  for (rep=0; rep<3; ++rep) {
+    t0 = ojiSeconds();
+    if (readOjiAvlBuffer((const uint8_t*) json, len, &pAvlTree, 0, 0)) {
+      best = -1.0;
+      break;
+    }
+    cleanupAVL(&pAvlTree);
+    t0 = ojiSeconds() - t0;
+    if (best < 0.0 || t0 < best) best = t0;
+  }
+  free(json);
+  return best;
+}
+
+/* Apparent exponent of load time in n, from sizes n and 4n
+ * - n is doubled first until a load takes at least a millisecond
+ * - *pSeconds, if not null, gets the time at the larger size
+ * - returns a negative value if a load fails
+ */
+double
+growthCheckOji(ORXFUZZGEN generator, const void* arg, size_t n, double* pSeconds) {
+double t1;
+double t4;
+int i;
+
+  if (n < 1) n = 1;
+  for (i=0; (t1 = timeLoadOji(generator, arg, n)) >= 0.0 && t1 < 1e-3 && i<16; ++i) {
+    n <<= 1;
+  }
+  if (t1 < 0.0) return -1.0;
+  if ((t4 = timeLoadOji(generator, arg, n << 2)) < 0.0) return -1.0;
+  if (pSeconds) *pSeconds = t4;
+  return log(t4 / t1) / log(4.0);
+}
+/**********************************************************************/
+/*** End of library functions ****************************************/
+/**********************************************************************/
+
+
+#if defined(DO_MAIN) || defined(ORX_FUZZER)
+#include "jsmn.c"
+#include "avltree.c"
+#define main MAIN_BUFFILE
+#include "buffer_file.c"
+#undef main
+#ifdef DO_MAIN
+#undef DO_MAIN
+#include "orx_parsejson.c"
+#include "synth_json.c"
+#define DO_MAIN
+#else
+#include "orx_parsejson.c"
+#include "synth_json.c"
+#endif
+#endif
+
+
+#ifdef DO_MAIN
+/**********************************************************************/
+/*** Test program ***/
+/*
+ * Usage:
+ *
+ *   ./test_orx_fuzz [-strict] [file.json ...]
+ *
+ * Compile and link:
+ *
+ *  % gcc -DDO_MAIN orx_fuzz.c -o test_orx_fuzz -lm
+ *
+ * libFuzzer build (see Makefile fuzz target):
+ *
+ *  % clang -g -O1 -fsanitize=fuzzer,address,undefined -DORX_FUZZER orx_fuzz.c -o fuzz_orx -lm
+ *
+ */
+static int errors = 0;
+
+/* Small inputs, including malformed and non-strict ones */
+static const char* corpus[] =
+{ "", " ", "{}", "[]", "[[]]", "{\"a\":{}}", "0", "-1.5e3", "\"s\"", "null"
+, "{\"a\":1,\"a\":2}", "{\"a\":[1],\"a.length\":5}", "[1,[2,[3,[4]]],{\"x\":null}]"
+, "{\"k\":\"a\\\"b\\\\c\\u0041\"}", "[1,2", "{\"a\":", "{\"a\" 1}", "{a:1,b:[true,false]}"
+, "[\"a\":1]", "{\"a\"}", "}", "[1]]", "[1e400,-0,1.0000000000000002]", "1 2", "{\"\":1}"
+, "[truex,nul,-]"
+};
+
+/* Families of inputs of size n */
+static char*
+genDeepArrays(size_t n, const void* arg, size_t* pLen) {
+char* json = malloc(2 * n + 2);
+  (void) arg;
+  if (!json) return json;
+  memset(json, '[', n);
+  json[n] = '0';
+  memset(json + n + 1, ']', n);
+  json[*pLen = 2 * n + 1] = '\0';
+  return json;
+}
+
+static char*
+genDeepObjects(size_t n, const void* arg, size_t* pLen) {
+char* json = malloc(6 * n + 2);
+size_t i;
+  (void) arg;
+  if (!json) return json;
+  for (i=0; i<n; ++i) { memcpy(json + 5 * i, "{\"k\":", 5); }
+  json[5 * n] = '0';
+  memset(json + 5 * n + 1, '}', n);
+  json[*pLen = 6 * n + 1] = '\0';
+  return json;
+}
+
+static char*
+genWideArray(size_t n, const void* arg, size_t* pLen) {
+char* json = malloc(12 * n + 3);
+char* p = json;
+size_t i;
+  (void) arg;
+  if (!json) return json;
+  *p++ = '[';
+  for (i=0; i<n; ++i) { p += sprintf(p, "%s%lu", i ? "," : "", (unsigned long) i); }
+  *p++ = ']';
+  *p = '\0';
+  *pLen = p - json;
+  return json;
+}
+
+static char*
+genArrayOfObjects(size_t n, const void* arg, size_t* pLen) {
+char* json = malloc(24 * n + 3);
+char* p = json;
+size_t i;
+  (void) arg;
+  if (!json) return json;
+  *p++ = '[';
+  for (i=0; i<n; ++i) { p += sprintf(p, "%s{\"a\":%lu}", i ? "," : "", (unsigned long) i); }
+  *p++ = ']';
+  *p = '\0';
+  *pLen = p - json;
+  return json;
+}
+
+/* 16 nested objects with names of n/16 characters, each with a leaf */
+static char*
+genLongKeys(size_t n, const void* arg, size_t* pLen) {
+size_t lenName = n / 16 + 1;
+char* json = malloc(16 * (lenName + 16) + 32);
+char* p = json;
+int i;
+  (void) arg;
+  if (!json) return json;
+  for (i=0; i<16; ++i) {
+    *p++ = '{';
+    p += sprintf(p, "\"v\":%d,\"", i);
+    memset(p, 'a' + i, lenName);
+    p += lenName;
+    p += sprintf(p, "\":");
+  }
+  *p++ = '0';
+  memset(p, '}', 16);
+  p += 16;
+  *p = '\0';
+  *pLen = p - json;
+  return json;
+}
+
+/* n copies of a document, in an array */
+static char*
+genRepeated(size_t n, const void* arg, size_t* pLen) {
+const char* doc = (const char*) arg;
+size_t lenDoc = strlen(doc);
+char* json = malloc(n * (lenDoc + 1) + 3);
+char* p = json;
+size_t i;
+  if (!json) return json;
+  *p++ = '[';
+  for (i=0; i<n; ++i) {
+    if (i) *p++ = ',';
+    memcpy(p, doc, lenDoc);
+    p += lenDoc;
+  }
+  *p++ = ']';
+  *p = '\0';
+  *pLen = p - json;
+  return json;
+}
+
+/* Report growth exponent; returns 1 if flagged */
+static int
+reportGrowthOji(const char* label, ORXFUZZGEN generator, const void* arg, size_t n) {
+double seconds = 0.0;
+double exponent = growthCheckOji(generator, arg, n, &seconds);
+  if (exponent < 0.0) {
+    fprintf(stdout, "growth %-20s  load failed\n", label);
+    ++errors;
+    return 0;
+  }
+  fprintf(stdout, "growth %-20s  exponent %.2f (%.4fs)%s\n", label, exponent, seconds
+         , exponent > ORXFUZZ_MAX_EXPONENT ? "  SUPERLINEAR" : "");
+  return exponent > ORXFUZZ_MAX_EXPONENT;
+}
+
+/* Deterministic mutations:  byte flips, inserts of JSON punctuation,
+ * deletes and truncation
+ */
+static unsigned long fuzzState = 88172645463325252UL;
+
+static unsigned long
+nextFuzz(void) {
+  fuzzState ^= fuzzState << 13;
+  fuzzState ^= fuzzState >> 7;
+  fuzzState ^= fuzzState << 17;
+  return fuzzState;
+}
+
+static int
+mutateOji(const char* seed, size_t lenSeed, int iterations) {
+static const char punct[] = "[]{}:,\"\\0123456789.-+eEtrunlfas ";
+char* buf = malloc(lenSeed + 64);
+size_t len;
+int nFailed = 0;
+int it;
+int k;
+size_t pos;
+
+  if (!buf) return 0;
+  for (it=0; it<iterations; ++it) {
+    memcpy(buf, seed, len = lenSeed);
+    for (k = 1 + (int) (nextFuzz() % 4); k > 0; --k) {
+      pos = len ? nextFuzz() % len : 0;
+      switch (nextFuzz() % 4) {
+      case 0:
+        if (len) buf[pos] = punct[nextFuzz() % (sizeof punct - 1)];
+        break;
+      case 1:
+        if (len + 1 < lenSeed + 64) {
+          memmove(buf + pos + 1, buf + pos, len - pos);
+          buf[pos] = punct[nextFuzz() % (sizeof punct - 1)];
+          ++len;
+        }
+        break;
+      case 2:
+        if (len) {
+          memmove(buf + pos, buf + pos + 1, len - pos - 1);
+          --len;
+        }
+        break;
+      default:
+        len = pos;
+        break;
+      }
+    }
+    /* Exact-size copy, so reads past the end are caught by sanitizers */
+    {
+    char* exact = malloc(len ? len : 1);
+      if (exact) {
+        memcpy(exact, buf, len);
+        if (checkLoadOji((const uint8_t*) exact, len, stderr)) ++nFailed;
+        free(exact);
+      }
+    }
+  }
+  free(buf);
+  return nFailed;
+}
+
+int
+main(int argc, char** argv) {
+int strict = 0;
+int flagged = 0;
+int i;
+uint8_t* json;
+size_t len;
+SYNTHJSON synth;
+char* doc;
+char label[64];
+size_t nInputs = 0;
+
+  for (i=1; i<argc; ++i) {
+    if (!strcmp(argv[i], "-strict")) {
+      strict = 1;
+      continue;
+    }
+    if (!(json = buffile_file_to_puint8(argv[i], &len, 0))) {
+      fprintf(stderr, "Cannot read %s\n", argv[i]);
+      ++errors;
+      continue;
+    }
+    if (checkLoadOji(json, len, stderr)) {
+      fprintf(stdout, "%s:  FAILED\n", argv[i]);
+      ++errors;
+    } else {
+      fprintf(stdout, "%s:  OK\n", argv[i]);
+    }
+    ++nInputs;
+    if (!memchr(json, '\0', len)) {
+      json[len] = '\0';
+      flagged += reportGrowthOji(argv[i], genRepeated, json, 1 + 4096 / (len + 1));
+    }
+    free(json);
+  }
+
+  /* Fixed corpus, and mutations of it */
+  for (i=0; i<(int) (sizeof corpus / sizeof corpus[0]); ++i) {
+    if (checkLoadOji((const uint8_t*) corpus[i], strlen(corpus[i]), stderr)) {
+      fprintf(stderr, "corpus[%d] %s:  FAILED\n", i, corpus[i]);
+      ++errors;
+    }
+    errors += mutateOji(corpus[i], strlen(corpus[i]), 50);
+    nInputs += 51;
+  }
+
+  /* Synthetic documents, and mutations of them */
+  memset(&synth, 0, sizeof synth);
+  for (i=0; i<20; ++i) {
+    synth.seed = 1000 + i;
+    synth.targetBytes = 256 + 200 * i;
+    if (!(doc = synthJson(&synth, &len))) continue;
+    if (checkLoadOji((const uint8_t*) doc, len, stderr)) {
+      fprintf(stderr, "synthJson seed %lu:  FAILED\n", synth.seed);
+      ++errors;
+    }
+    errors += mutateOji(doc, len, 20);
+    nInputs += 21;
+    free(doc);
+  }
+
+  /* Growth of load time with input size */
+  flagged += reportGrowthOji("deep arrays", genDeepArrays, 0, 1000);
+  flagged += reportGrowthOji("deep objects", genDeepObjects, 0, 1000);
+  flagged += reportGrowthOji("wide array", genWideArray, 0, 1000);
+  flagged += reportGrowthOji("array of objects", genArrayOfObjects, 0, 1000);
+  flagged += reportGrowthOji("long keys", genLongKeys, 0, 1000);
+  synth.seed = 7;
+  synth.targetBytes = 2048;
+  if ((doc = synthJson(&synth, &len))) {
+    sprintf(label, "synthJson x n");
+    flagged += reportGrowthOji(label, genRepeated, doc, 4);
+    free(doc);
+  }
+
+  fprintf(stdout, "test_orx_fuzz:  %s; %lu inputs checked; %d superlinear\n"
+         , errors || (strict && flagged) ? "FAILED" : "OK", (unsigned long) nInputs, flagged);
+  return errors || (strict && flagged) ? 1 : 0;
+}
+#endif // DO_MAIN
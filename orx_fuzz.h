@@ -0,0 +1,50 @@
+////////////////////////////////////////////////////////////////////////
+// Fuzzing and differential checks of JSON loading
+//
+// checkLoadOji loads one input with readOjiAvlBuffer, then checks:
+//
+//   - AVL invariants of the result (verifyAvl):  balance factors,
+//     pParent/ppSelf links and key order
+//   - the tree against a reference map, built from the same input by a
+//     separate, deliberately simple flattener (one jsmn_parse pass with
+//     enough tokens, sprintf-built keys, sorted array with last value
+//     winning for repeated keys):  same success or failure, same keys,
+//     and the same type and JSON text for each key, by in-order scan
+//     and by orx_getOji lookup
+//   - loads with the other OJIDESCENT modes against the first:  same
+//     keys in the same order, and getLcpAvl finds each of them
+//
+// growthCheckOji times loads of an input family at sizes n and 4n and
+// reports the apparent exponent of load time in n; exponents above
+// ORXFUZZ_MAX_EXPONENT are flagged as superlinear.
+//
+// Entry points:
+//
+//   - LLVMFuzzerTestOneInput, for libFuzzer (make fuzz, needs clang);
+//     aborts on a failed check
+//   - test_orx_fuzz file ...:  checks each file, e.g. AFL++ with
+//     afl-fuzz -i corpus -o findings ./test_orx_fuzz @@, then runs the
+//     growth checks; -strict also fails on superlinear growth
+//
+// Inputs containing null bytes are skipped, as keys are C strings.
+//
+////////////////////////////////////////////////////////////////////////
+#ifndef __ORX_FUZZ_H__
+#define __ORX_FUZZ_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "orx_parsejson.h"
+
+#define ORXFUZZ_MAX_EXPONENT 1.5
+
+int checkLoadOji(const uint8_t* data, size_t size, FILE* fErr);
+
+// Family of inputs of size n; returns malloc'ed JSON and its length
+typedef char* (*ORXFUZZGEN)(size_t n, const void* arg, size_t* pLen);
+double growthCheckOji(ORXFUZZGEN generator, const void* arg, size_t n, double* pSeconds);
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+#endif // __ORX_FUZZ_H__
@@ -0,0 +1,199 @@
+/**********************************************************************/
+/**********************************************************************/
+/*** Parser library, as one translation unit; see orx_lib.h */
+/**********************************************************************/
+/**********************************************************************/
+
+#ifdef DO_MAIN
+#undef DO_MAIN
+#define ORX_LIB_MAIN
+#endif
+
+#include "orx_lib.h"
+
+/* Call oji_comparator directly, rather than through AVLTREE.comparator */
+#define AVL_INLINE_COMPARATOR oji_comparator
+
+#include "jsmn.c"
+#include "avltree.c"
+#include "orx_alloc.c"
+#include "buffer_file.c"
+#include "orx_parsejson.c"
+
+/* Parser variant this library was built as */
+const char*
+orxLibVariant(void) {
+#if defined(JSMN_STRICT) && defined(JSMN_PARENT_LINKS)
+  return "strict_parent";
+#elif defined(JSMN_STRICT)
+  return "strict";
+#elif defined(JSMN_PARENT_LINKS)
+  return "parent";
+#else
+  return "permissive";
+#endif
+}
+/**********************************************************************/
+/*** End of library functions ****************************************/
+/**********************************************************************/
+
+
+#ifdef ORX_LIB_MAIN
+/**********************************************************************/
+/*** Test program ***/
+/*
+ * Usage:
+ *
+ *   ./test_orx_lib_<variant> [a.json ...]
+ *
+ * - Load each file, and print its key count
+ * - Check what the variant accepts and rejects
+ * - Benchmark tokenizing, loading and lookups on a large array of
+ *   records and on a synthetic document, in MB/s and ns per lookup
+ *
+ * Compile and link, e.g. for the strict_parent variant:
+ *
+ *  % gcc -O2 -DDO_MAIN -DJSMN_STRICT -DJSMN_PARENT_LINKS orx_lib.c -o test_orx_lib_strict_parent -lm
+ *
+ */
+#include "synth_json.c"
+
+#include "orx_test.h"
+
+/* Return code of loading a null-terminated document */
+static int
+loadTextLib(const char* json, pAVLTREE* ppAvlTree) {
+  return readOjiAvlBuffer((const uint8_t*) json, strlen(json), ppAvlTree, 0, 0);
+}
+
+static void
+testVariantLib(void) {
+pAVLTREE pAvlTree = 0;
+jsmntok_t toks[8];
+jsmn_parser jp;
+int64_t i64 = 0;
+int found;
+#ifdef JSMN_STRICT
+int strict = 1;
+#else
+int strict = 0;
+#endif
+
+  /* Valid JSON loads the same in every variant */
+  CHECK(!loadTextLib("{\"a\":[1,{\"b\":true}],\"c\":\"x\"}", &pAvlTree));
+  orx_getInt64Oji(pAvlTree, "json.a[0]", &i64, &found);
+  CHECK(found && i64 == 1);
+  cleanupAVL(&pAvlTree);
+
+  /* Unquoted keys and values load only when permissive */
+  CHECK(!loadTextLib("{a:1}", &pAvlTree) == !strict);
+  cleanupAVL(&pAvlTree);
+  CHECK(!loadTextLib("{\"a\":x}", &pAvlTree) == !strict);
+  cleanupAVL(&pAvlTree);
+
+  /* Tokens link to their parents */
+  jsmn_init(&jp);
+  CHECK(jsmn_parse(&jp, "{\"a\":[1,2]}", 11, toks, 8) == 5);
+#ifdef JSMN_PARENT_LINKS
+  CHECK(toks[0].parent == -1 && toks[1].parent == 0 && toks[2].parent == 1 && toks[4].parent == 2);
+#endif
+  return;
+}
+
+/* Array of n flat records; returns malloc'ed text */
+static char*
+recordsJsonLib(int n, size_t* pLen) {
+char* json = malloc((size_t) n * 128 + 16);
+size_t len = 0;
+int i;
+  if (!json) return 0;
+  json[len++] = '[';
+  for (i=0; i<n; ++i) {
+    len += sprintf(json + len, "%s{\"id\":%d,\"x\":%d.5,\"ok\":%s,\"tag\":\"t%d\"}"
+                  , i ? "," : "", i, i * 3, (i & 1) ? "true" : "false", i % 97);
+  }
+  json[len++] = ']';
+  json[len] = '\0';
+  *pLen = len;
+  return json;
+}
+
+/* Tokenize, load and look up every key; print MB/s and ns/lookup */
+static void
+benchCorpusLib(const char* name, const char* json, size_t len) {
+jsmn_parser jp;
+jsmntok_t* pToks;
+pAVLTREE pAvlTree = 0;
+pAVLTREE pAvl;
+size_t ntoks = len / 2 + 16;
+size_t nKeys = 0;
+double tParse;
+double tLoad;
+double tLookup;
+int parse_rtn;
+
+  if (!(pToks = malloc(ntoks * sizeof(jsmntok_t)))) {
+    ++errors;
+    return;
+  }
+  tParse = ojiSeconds();
+  jsmn_init(&jp);
+  parse_rtn = jsmn_parse(&jp, json, len, pToks, ntoks);
+  tParse = ojiSeconds() - tParse;
+  CHECK(parse_rtn > 0);
+  free(pToks);
+
+  tLoad = ojiSeconds();
+  CHECK(!readOjiAvlBuffer((const uint8_t*) json, len, &pAvlTree, 0, 0));
+  tLoad = ojiSeconds() - tLoad;
+
+  tLookup = ojiSeconds();
+  for (pAvl = firstAvl(pAvlTree); pAvl; pAvl = nextAvl(pAvl)) {
+    CHECK(orx_getOji(pAvlTree, ((pOJITEM) pAvl->payload)->keyString) == (pOJITEM) pAvl->payload);
+    ++nKeys;
+  }
+  tLookup = ojiSeconds() - tLookup;
+
+  fprintf(stdout, "%-13s %-8s %7.2fMB:  tokenize %8.1fMB/s; load %7.1fMB/s; lookup %6.1fns (%lu keys)\n"
+         , orxLibVariant(), name, len * 1e-6, len * 1e-6 / tParse, len * 1e-6 / tLoad
+         , nKeys ? tLookup * 1e9 / nKeys : 0.0, (unsigned long) nKeys);
+  cleanupAVL(&pAvlTree);
+  return;
+}
+
+int
+main(int argc, char** argv) {
+SYNTHJSON synth = { 11, 1 << 18, 0, 0 };
+pAVLTREE pAvlTree = 0;
+pAVLTREE pAvl;
+size_t len;
+char* json;
+int fileErrors;
+
+  while (--argc > 0) {
+    fileErrors = errors;
+    CHECK(!readOjiAvl(argv[argc], &pAvlTree, 0, 0));
+    for (len=0, pAvl = firstAvl(pAvlTree); pAvl; pAvl = nextAvl(pAvl)) ++len;
+    fprintf(stdout, "%s:  %s; %lu keys\n", argv[argc], errors > fileErrors ? "FAILED" : "OK", (unsigned long) len);
+    cleanupAVL(&pAvlTree);
+  }
+
+  testVariantLib();
+
+  if ((json = recordsJsonLib(5000, &len))) {
+    benchCorpusLib("records", json, len);
+    free(json);
+  } else {
+    ++errors;
+  }
+  if ((json = synthJson(&synth, &len))) {
+    benchCorpusLib("synth", json, len);
+    free(json);
+  } else {
+    ++errors;
+  }
+
+  fprintf(stdout, "test_orx_lib_%s:  %s\n", orxLibVariant(), errors ? "FAILED" : "OK");
+  return errors ? 1 : 0;
+}
+#endif // ORX_LIB_MAIN
@@ -0,0 +1,41 @@
+////////////////////////////////////////////////////////////////////////
+// Parser library:  jsmn, AVLTREE, allocators, buffered file reads and
+// OJI flattening and lookup, as one translation unit (orx_lib.c)
+//
+// Built as a unity build, so that at -O2 the compiler sees every call
+// site of the hot helpers, and may inline them:  newOji (via
+// newOjiShared) into leaf flattening, getAVL into orx_getOji, and
+// oji_comparator into AVLTREE descent (AVL_INLINE_COMPARATOR)
+//
+// The parser variant is chosen when the library is built, with the jsmn
+// configuration macros:
+// - JSMN_STRICT:  reject unquoted keys, and unquoted values that do
+//   not start like a number, true, false or null, e.g. {a:1} or
+//   {"a":x}; a primitive must be followed by a delimiter or whitespace,
+//   even at the end of the document; without it, jsmn is permissive
+// - JSMN_PARENT_LINKS:  each token records its parent, so closing an
+//   object or array is constant time; without it, jsmn scans back over
+//   the tokens so far, which is quadratic in the worst case, e.g. for a
+//   large array of objects
+// Since jsmntok_t has a parent member only with JSMN_PARENT_LINKS,
+// code that uses tokens must be compiled with the library's settings.
+//
+// The Makefile builds each variant as liborx_<variant>.a and .so:
+//
+//   variant          defines
+//   permissive       (none)
+//   strict           JSMN_STRICT
+//   parent           JSMN_PARENT_LINKS
+//   strict_parent    JSMN_STRICT JSMN_PARENT_LINKS
+//
+////////////////////////////////////////////////////////////////////////
+#ifndef __ORX_LIB_H__
+#define __ORX_LIB_H__
+
+#include "jsmn.h"
+#include "buffer_file.h"
+#include "orx_parsejson.h"
+
+const char* orxLibVariant(void);
+
+#endif // __ORX_LIB_H__
@@ -0,0 +1,813 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "jsmn.h"
+#include "buffer_file.h"
+#include "orx_ndjson.h"
+
+/* Default in-flight window, and file read size */
+#define OJIREC_WINDOW (4 << 20)
+#define OJIREC_READ_SIZE 65536
+
+
+/**********************************************************************/
+/* Batch of consecutive records, queued for a worker */
+typedef struct RECJOBstr {
+  struct RECJOBstr* pNext;
+  const uint8_t* data;     // Bytes of the records
+  size_t len;
+  size_t firstRecord;      // Number of first record
+  size_t nRecords;
+  size_t bounds[];         // Start and end, in data, of each record
+} RECJOB, *pRECJOB;
+
+/* State shared by splitter and workers */
+typedef struct RECPOOLstr {
+  pthread_mutex_t mutex;   // Guards all fields below, except as noted
+  pthread_cond_t cond;     // Signals queue and window changes
+  pRECJOB pHead;           // Queue of batches
+  pRECJOB pTail;
+  size_t inFlight;         // Bytes of batches queued or being parsed
+  size_t window;
+  int done;                // Splitter has queued everything
+  int abort;               // A record failed; stop
+  int rtn;                 // readOjiAvl-style code of first failure
+  pOJIRECOPTS pRecOpts;    // Caller's settings; results set at the end
+  OJIOPTS opts;            // Per-record load settings (read-only)
+  size_t badRecord;
+  size_t peak;
+} RECPOOL, *pRECPOOL;
+
+/* One worker thread, and the tree it merges records into */
+typedef struct RECWORKERstr {
+  pthread_t thread;
+  pRECPOOL pPool;
+  pAVLTREE pAvlTree;
+  int started;
+} RECWORKER, *pRECWORKER;
+
+
+/**********************************************************************/
+/* Find the next record, a top-level JSON value, at or after buf[pos]
+ * - records may be separated by any JSON whitespace, or by nothing
+ * - only strings and bracket depth are tracked; the record itself is
+ *   checked when it is parsed
+ * - returns 1 and sets [*pStart, *pEnd) if a record was found; 0 if
+ *   only whitespace is left; -1 if the record at *pStart is not complete
+ *   before len (unless atEof, when the rest is taken as the record)
+ */
+int
+nextRecordOji(const uint8_t* buf, size_t len, size_t pos, int atEof, size_t* pStart, size_t* pEnd) {
+size_t depth = 0;
+int inString = 0;
+uint8_t c;
+
+  while (pos < len && (buf[pos] == ' ' || buf[pos] == '\n' || buf[pos] == '\r' || buf[pos] == '\t')) { ++pos; }
+  *pStart = *pEnd = pos;
+  if (pos >= len) return 0;
+
+  switch (buf[pos]) {
+
+  case '{':
+  case '[':
+  case '"':
+    for ( ; pos < len; ++pos) {
+      c = buf[pos];
+      if (inString) {
+        if (c == '\\') { ++pos; }
+        else if (c == '"') { inString = 0; }
+        else { continue; }
+      } else if (c == '"') {
+        inString = 1;
+        continue;
+      } else if (c == '{' || c == '[') {
+        ++depth;
+        continue;
+      } else if (c == '}' || c == ']') {
+        --depth;
+      } else {
+        continue;
+      }
+      if (!depth && !inString) {
+        *pEnd = pos + 1;
+        return 1;
+      }
+    }
+    break;
+
+  case '}':
+  case ']':
+  case ',':
+  case ':':
+    /* Stray delimiter:  a record of its own, which will not parse */
+    *pEnd = pos + 1;
+    return 1;
+
+  default:
+    /* Primitive:  ends at whitespace or the next structural character */
+    for ( ; pos < len; ++pos) {
+      c = buf[pos];
+      if (c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '{' || c == '[' || c == '"'
+       || c == '}' || c == ']' || c == ',' || c == ':') {
+        *pEnd = pos;
+        return 1;
+      }
+    }
+    break;
+  }
+
+  if (atEof) {
+    *pEnd = len;
+    return 1;
+  }
+  return -1;
+} /* nextRecordOji(...) */
+
+
+/**********************************************************************/
+/* Note first failure, and stop the pool; call with mutex held */
+static void
+failRecordOji(pRECPOOL pPool, int rtn, size_t recordNo) {
+  if (!pPool->abort || recordNo < pPool->badRecord) {
+    pPool->rtn = rtn;
+    pPool->badRecord = recordNo;
+  }
+  pPool->abort = 1;
+  pthread_cond_broadcast(&pPool->cond);
+  return;
+}
+
+
+/**********************************************************************/
+/* Tokenize and flatten one record
+ * - returns 0 on success, else a readOjiAvl error code
+ */
+static int
+parseRecordOji(pRECWORKER pWorker, const uint8_t* data, size_t len, size_t recordNo
+              , jsmntok_t** ppToks, size_t* pTokcount) {
+pRECPOOL pPool = pWorker->pPool;
+pOJIRECOPTS pRecOpts = pPool->pRecOpts;
+pAVLTREE pRecordTree = 0;
+char keypfx[BUFSIZ];
+jsmn_parser jp;
+jsmntok_t* pNew;
+uint8_t* pCopy = 0;
+int parse_rtn;
+int rtn = 0;
+
+  /* JSMN_STRICT needs a delimiter after a top-level primitive */
+  if (len && data[0] != '{' && data[0] != '[' && data[0] != '"') {
+    if (!(pCopy = malloc(len + 1))) return 3;
+    memcpy(pCopy, data, len);
+    pCopy[len++] = '\n';
+    data = pCopy;
+  }
+
+  jsmn_init(&jp);
+  while (JSMN_ERROR_NOMEM == (parse_rtn = jsmn_parse(&jp, (const char*) data, len, *ppToks, *pTokcount))) {
+    if (!(pNew = realloc(*ppToks, sizeof(jsmntok_t) * (*pTokcount << 1)))) {
+      rtn = 3;
+      break;
+    }
+    *ppToks = pNew;
+    *pTokcount <<= 1;
+  }
+  if (!rtn) {
+    if (parse_rtn == JSMN_ERROR_INVAL) { rtn = 4; }
+    else if (parse_rtn == JSMN_ERROR_PART) { rtn = 5; }
+    else if (parse_rtn <= 0) { rtn = 6; }
+  }
+
+  if (!rtn && pRecOpts->record) {
+    strcpy(keypfx, "json");
+    if (!(rtn = jsmn_dump_to_avl(&pRecordTree, data, *ppToks, jp.toknext, keypfx, sizeof keypfx, &pPool->opts))) {
+      rtn = pRecOpts->record(pRecOpts->recordArg, recordNo, &pRecordTree) ? 9 : 0;
+    }
+    cleanupAVL(&pRecordTree);
+  } else if (!rtn) {
+    sprintf(keypfx, "json[%lu]", (unsigned long) recordNo);
+    rtn = jsmn_dump_to_avl(&pWorker->pAvlTree, data, *ppToks, jp.toknext, keypfx, sizeof keypfx, &pPool->opts);
+  }
+
+  if (pCopy) { free(pCopy); }
+  return rtn;
+} /* parseRecordOji(...) */
+
+
+/**********************************************************************/
+/* Worker thread:  take batches from the queue until it is done */
+static void*
+recordWorkerOji(void* pVoid) {
+pRECWORKER pWorker = (pRECWORKER) pVoid;
+pRECPOOL pPool = pWorker->pPool;
+size_t tokcount = 64;
+jsmntok_t* pToks = malloc(sizeof(jsmntok_t) * tokcount);
+pRECJOB pJob;
+size_t i;
+int rtn;
+
+  for (;;) {
+    pthread_mutex_lock(&pPool->mutex);
+    if (!pToks) { failRecordOji(pPool, 3, 0); }
+    while (!pPool->pHead && !pPool->done && !pPool->abort) {
+      pthread_cond_wait(&pPool->cond, &pPool->mutex);
+    }
+    if (pPool->abort || !(pJob = pPool->pHead)) {
+      pthread_mutex_unlock(&pPool->mutex);
+      break;
+    }
+    if (!(pPool->pHead = pJob->pNext)) { pPool->pTail = 0; }
+    pthread_mutex_unlock(&pPool->mutex);
+
+    /* Parse outside the lock */
+    for (i=0, rtn=0; i<pJob->nRecords && !rtn; ++i) {
+      rtn = parseRecordOji(pWorker, pJob->data + pJob->bounds[2*i]
+                          , pJob->bounds[2*i+1] - pJob->bounds[2*i]
+                          , pJob->firstRecord + i, &pToks, &tokcount);
+    }
+
+    pthread_mutex_lock(&pPool->mutex);
+    if (rtn) { failRecordOji(pPool, rtn, pJob->firstRecord + i - 1); }
+    pPool->inFlight -= pJob->len;
+    pthread_cond_broadcast(&pPool->cond);
+    pthread_mutex_unlock(&pPool->mutex);
+    free(pJob);
+  }
+
+  if (pToks) { free(pToks); }
+  return pVoid;
+} /* recordWorkerOji(void* pVoid) */
+
+
+/**********************************************************************/
+/* Queue a batch, first waiting for the window to allow it
+ * - returns 0 on success, else the pool's failure code (batch is freed)
+ */
+static int
+submitRecordsOji(pRECPOOL pPool, pRECJOB pJob) {
+int rtn;
+  pthread_mutex_lock(&pPool->mutex);
+  while (pPool->inFlight && pPool->inFlight + pJob->len > pPool->window && !pPool->abort) {
+    pthread_cond_wait(&pPool->cond, &pPool->mutex);
+  }
+  if (!(rtn = pPool->abort ? pPool->rtn : 0)) {
+    pJob->pNext = 0;
+    if (pPool->pTail) { pPool->pTail->pNext = pJob; } else { pPool->pHead = pJob; }
+    pPool->pTail = pJob;
+    pPool->inFlight += pJob->len;
+    if (pPool->inFlight > pPool->peak) { pPool->peak = pPool->inFlight; }
+    pthread_cond_signal(&pPool->cond);
+  }
+  pthread_mutex_unlock(&pPool->mutex);
+  if (rtn) { free(pJob); }
+  return rtn;
+}
+
+
+/**********************************************************************/
+/* Queue records bounds[0..2n) of buf as one batch
+ * - with copy, the batch holds a copy of its bytes; else it points
+ *   into buf, which must outlive the load
+ * - returns 0 on success, else a readOjiAvl error code
+ */
+static int
+queueBatchOji(pRECPOOL pPool, const uint8_t* buf, size_t* bounds, size_t n, int copy) {
+size_t batchStart = bounds[0];
+size_t len = bounds[2*n-1] - batchStart;
+pRECJOB pJob;
+size_t i;
+
+  if (!(pJob = malloc(sizeof(RECJOB) + 2 * n * sizeof(size_t) + (copy ? len : 0)))) return 3;
+  pJob->len = len;
+  pJob->firstRecord = pPool->pRecOpts->records;
+  pJob->nRecords = n;
+  for (i=0; i<2*n; ++i) { pJob->bounds[i] = bounds[i] - batchStart; }
+  if (copy) {
+    pJob->data = (const uint8_t*) (pJob->bounds + 2 * n);
+    memcpy((uint8_t*) pJob->data, buf + batchStart, len);
+  } else {
+    pJob->data = buf + batchStart;
+  }
+  pPool->pRecOpts->records += n;
+  return submitRecordsOji(pPool, pJob);
+}
+
+
+/**********************************************************************/
+/* Split buf[0..len) into batches of records, and queue them
+ * - a batch is at most OJIREC_BATCH_RECORDS records, and at most
+ *   OJIREC_BATCH_BYTES or the window, unless it is a single record
+ * - *pConsumed gets the length of the complete records (and following
+ *   whitespace); with atEof, that is all of buf
+ * - returns 0 on success, else a readOjiAvl error code
+ */
+static int
+splitRecordsOji(pRECPOOL pPool, const uint8_t* buf, size_t len, int atEof, int copy, size_t* pConsumed) {
+size_t batchBytes = pPool->window < OJIREC_BATCH_BYTES ? pPool->window : OJIREC_BATCH_BYTES;
+size_t bounds[2 * OJIREC_BATCH_RECORDS];
+size_t n = 0;
+size_t pos = 0;
+size_t start;
+size_t end;
+int found;
+int rtn = 0;
+
+  while (!rtn && 0 < (found = nextRecordOji(buf, len, pos, atEof, &start, &end))) {
+    /* Queue batch first if this record would overfill it */
+    if (n == OJIREC_BATCH_RECORDS || (n && end - bounds[0] > batchBytes)) {
+      rtn = queueBatchOji(pPool, buf, bounds, n, copy);
+      n = 0;
+    }
+    bounds[2*n] = start;
+    bounds[2*n+1] = end;
+    ++n;
+    pos = end;
+  }
+  if (found <= 0) { pos = start; }
+  if (!rtn && n) { rtn = queueBatchOji(pPool, buf, bounds, n, copy); }
+
+  *pConsumed = pos;
+  return rtn;
+} /* splitRecordsOji(...) */
+
+
+/**********************************************************************/
+/* Run a load:  start workers, split input with readSplit, then wait
+ * for workers and merge their trees
+ * - readSplit returns 0 on success, else a readOjiAvl error code
+ * - returns 0 on success, else a readOjiAvl error code; 9 if a record
+ *   callback stopped the load
+ */
+static int
+runRecordsOji(ppAVLTREE ppAvlTree, pOJIRECOPTS pRecOpts
+             , int (*readSplit)(pRECPOOL pPool, void* arg), void* arg) {
+RECPOOL pool;
+pRECWORKER workers;
+pAVLTREE* pRoots;
+pRECJOB pJob;
+int nThreads;
+int i;
+int rtn;
+
+  if (!pRecOpts || (!ppAvlTree && !pRecOpts->record)) return 1;
+
+  nThreads = pRecOpts->threads > 0 ? pRecOpts->threads : (int) sysconf(_SC_NPROCESSORS_ONLN);
+  if (nThreads < 1) { nThreads = 1; }
+  pRecOpts->records = pRecOpts->badRecord = pRecOpts->peakBytes = 0;
+
+  memset(&pool, 0, sizeof pool);
+  pool.window = pRecOpts->windowBytes ? pRecOpts->windowBytes : OJIREC_WINDOW;
+  pool.pRecOpts = pRecOpts;
+  if (pRecOpts->pOpts) { pool.opts = *pRecOpts->pOpts; }
+  pool.opts.pStats = 0;
+  pool.opts.pSink = 0;
+  pool.opts.pAlloc = 0;
+  pool.opts.pIntern = 0;
+
+  if (!(workers = calloc(nThreads, sizeof(RECWORKER)))) return 3;
+  if (!(pRoots = calloc(nThreads + 1, sizeof(pAVLTREE)))) {
+    free(workers);
+    return 3;
+  }
+  pthread_mutex_init(&pool.mutex, 0);
+  pthread_cond_init(&pool.cond, 0);
+
+  for (i=0, rtn=0; i<nThreads && !rtn; ++i) {
+    workers[i].pPool = &pool;
+    if (pthread_create(&workers[i].thread, 0, recordWorkerOji, workers + i)) { rtn = 3; }
+    else { workers[i].started = 1; }
+  }
+
+  if (!rtn) { rtn = readSplit(&pool, arg); }
+
+  /* Let workers drain the queue, or stop them on failure */
+  pthread_mutex_lock(&pool.mutex);
+  pool.done = 1;
+  if (rtn && !pool.abort) { failRecordOji(&pool, rtn, pRecOpts->records); }
+  pthread_cond_broadcast(&pool.cond);
+  pthread_mutex_unlock(&pool.mutex);
+  for (i=0; i<nThreads; ++i) {
+    if (workers[i].started) { pthread_join(workers[i].thread, 0); }
+  }
+  while ((pJob = pool.pHead)) {
+    pool.pHead = pJob->pNext;
+    free(pJob);
+  }
+
+  rtn = pool.abort ? pool.rtn : 0;
+  pRecOpts->badRecord = pool.badRecord;
+  pRecOpts->peakBytes = pool.peak;
+
+  /* Merge workers' trees after the caller's; on failure, discard them */
+  if (!rtn && !pRecOpts->record) {
+    pRoots[0] = *ppAvlTree;
+    for (i=0; i<nThreads; ++i) { pRoots[i+1] = workers[i].pAvlTree; }
+    mergeAvl(pRoots, nThreads + 1, ppAvlTree, AVL_MERGE_LAST_WINS);
+  } else {
+    for (i=0; i<nThreads; ++i) { cleanupAVL(&workers[i].pAvlTree); }
+  }
+
+  pthread_cond_destroy(&pool.cond);
+  pthread_mutex_destroy(&pool.mutex);
+  free(pRoots);
+  free(workers);
+  return rtn;
+} /* runRecordsOji(...) */
+
+
+/**********************************************************************/
+/* Splitters for a buffer, and for a file read in pieces */
+typedef struct RECBUFFERstr {
+  const uint8_t* data;
+  size_t len;
+} RECBUFFER, *pRECBUFFER;
+
+static int
+splitBufferOji(pRECPOOL pPool, void* arg) {
+pRECBUFFER pBuffer = (pRECBUFFER) arg;
+size_t consumed;
+  return splitRecordsOji(pPool, pBuffer->data, pBuffer->len, 1, 0, &consumed);
+}
+
+static int
+splitFileOji(pRECPOOL pPool, void* arg) {
+BUFFILESRC src;
+uint8_t* buf;
+uint8_t* newBuf;
+size_t size = OJIREC_READ_SIZE;
+size_t len = 0;
+size_t consumed;
+size_t n_read;
+int atEof = 0;
+int rtn = 0;
+
+  if (buffile_open(&src, (char*) arg)) return 2;
+  if (!(buf = malloc(size))) {
+    buffile_close(&src);
+    return 3;
+  }
+
+  while (!rtn && !atEof) {
+    /* Fill buffer after the incomplete record kept from last time */
+    n_read = buffile_read(&src, buf + len, size - len);
+    if (src.error) {
+      rtn = 2;
+      break;
+    }
+    len += n_read;
+    atEof = src.eof || !n_read;
+
+    if ((rtn = splitRecordsOji(pPool, buf, len, atEof, 1, &consumed))) break;
+    memmove(buf, buf + consumed, len - consumed);
+    len -= consumed;
+
+    /* A record larger than the buffer:  double it */
+    if (len == size) {
+      if (!(newBuf = realloc(buf, size << 1))) {
+        rtn = 3;
+        break;
+      }
+      buf = newBuf;
+      size <<= 1;
+    }
+  }
+
+  free(buf);
+  buffile_close(&src);
+  return rtn;
+} /* splitFileOji(pRECPOOL pPool, void* arg) */
+
+
+/**********************************************************************/
+/* Read a record stream from a file, or from memory; see orx_ndjson.h
+ * - pRecOpts is required; its results are set on return
+ * - ppAvlTree may be null if pRecOpts->record is set; on failure,
+ *   *ppAvlTree is unchanged
+ * - json_buffer need not be null-terminated; it is not modified
+ * - returns 0 on success, non-zero on failure (same codes as readOjiAvl,
+ *   and 9 if a record callback stopped the load)
+ */
+int
+readOjiRecords(char* filepath, ppAVLTREE ppAvlTree, pOJIRECOPTS pRecOpts) {
+  if (!filepath) return 2;
+  return runRecordsOji(ppAvlTree, pRecOpts, splitFileOji, (void*) filepath);
+}
+int
+readOjiRecordsBuffer(const uint8_t* json_buffer, size_t json_len, ppAVLTREE ppAvlTree, pOJIRECOPTS pRecOpts) {
+RECBUFFER buffer;
+  if (!json_buffer) return 2;
+  buffer.data = json_buffer;
+  buffer.len = json_len;
+  return runRecordsOji(ppAvlTree, pRecOpts, splitBufferOji, (void*) &buffer);
+}
+/**********************************************************************/
+/*** End of library functions ****************************************/
+/**********************************************************************/
+
+
+#ifdef DO_MAIN
+/**********************************************************************/
+/*** Test program ***/
+/*
+ * Usage:
+ *
+ *   ./test_orx_ndjson [file.ndjson ...]
+ *
+ * - Load each file as a record stream, and print its record count
+ * - Check record splitting, merged keys against the same records as one
+ *   JSON array, callbacks, the in-flight window, failures, and file
+ *   reads with records spanning read boundaries
+ * - Benchmark records per second by thread count
+ *
+ * Compile and link:
+ *
+ *  % gcc -DDO_MAIN orx_ndjson.c -o test_orx_ndjson -pthread -lm
+ *
+ */
+#include "jsmn.c"
+#include "avltree.c"
+#define main MAIN_BUFFILE
+#include "buffer_file.c"
+#undef main
+#undef DO_MAIN
+#include "orx_parsejson.c"
+#define DO_MAIN
+
+#include "orx_test.h"
+
+/* n records, as NDJSON or as one array; returns malloc'ed text */
+static char*
+makeRecordsOji(size_t n, int asArray, size_t* pLen) {
+size_t size = 160 * n + 64;
+char* text = malloc(size);
+size_t len = 0;
+size_t i;
+  if (!text) return 0;
+  if (asArray) { text[len++] = '['; }
+  for (i=0; i<n; ++i) {
+    if (asArray && i) { text[len++] = ','; }
+    switch (i % 5) {
+    case 0:
+    case 1:
+      len += sprintf(text + len, "{\"id\":%lu,\"name\":\"rec %lu\",\"v\":[%lu,%.3f],\"ok\":%s}"
+                    , (unsigned long) i, (unsigned long) i, (unsigned long) i * 3, i * 0.25, (i & 1) ? "true" : "null");
+      break;
+    case 2:
+      /* Pretty-printed, with brackets and escapes inside strings */
+      len += sprintf(text + len, "{\n  \"s\": \"}{][\\\"\\\\\",\n  \"deep\": {\"a\": [[%lu], {}]}\n}", (unsigned long) i);
+      break;
+    case 3:
+      len += sprintf(text + len, "[%lu,\"x\",false]", (unsigned long) i);
+      break;
+    default:
+      /* Top-level primitive, and a string */
+      len += sprintf(text + len, (i & 1) ? "%lu" : "\"s%lu\"", (unsigned long) i);
+      break;
+    }
+    if (!asArray) { text[len++] = (i % 7) ? '\n' : ' '; }
+  }
+  if (asArray) { text[len++] = ']'; }
+  text[len] = '\0';
+  *pLen = len;
+  return text;
+}
+
+/* Same keys and payloads, in the same order; pRoot2 is the records as
+ * one array, so has "json.length" as well
+ */
+static int
+sameTreesOji(pAVLTREE pRoot1, pAVLTREE pRoot2) {
+pAVLTREE p1 = firstAvl(pRoot1);
+pAVLTREE p2 = firstAvl(pRoot2);
+  if (p2 && !strcmp(((pOJITEM) p2->payload)->keyString, "json.length")) { p2 = nextAvl(p2); }
+  for ( ; p1 && p2; p1 = nextAvl(p1), p2 = nextAvl(p2)) {
+    if (strcmp(((pOJITEM) p1->payload)->keyString, ((pOJITEM) p2->payload)->keyString)) return 0;
+    if (strcmp(((pOJITEM) p1->payload)->sPayload, ((pOJITEM) p2->payload)->sPayload)) return 0;
+  }
+  return !p1 && !p2;
+}
+
+/* Record callback:  count records and leaves; stop at stopAt */
+typedef struct COUNTARGstr {
+  pthread_mutex_t mutex;
+  size_t records;
+  size_t leaves;
+  size_t recordNoSum;
+  size_t stopAt;
+  int keysOk;
+} COUNTARG, *pCOUNTARG;
+
+static int
+countRecordOji(void* recordArg, size_t recordNo, ppAVLTREE ppRecordTree) {
+pCOUNTARG pCount = (pCOUNTARG) recordArg;
+pAVLTREE pAvl;
+size_t leaves = 0;
+int keysOk = 1;
+  for (pAvl = firstAvl(*ppRecordTree); pAvl; pAvl = nextAvl(pAvl)) {
+    ++leaves;
+    keysOk &= !strncmp(((pOJITEM) pAvl->payload)->keyString, "json", 4);
+  }
+  pthread_mutex_lock(&pCount->mutex);
+  ++pCount->records;
+  pCount->leaves += leaves;
+  pCount->recordNoSum += recordNo;
+  pCount->keysOk &= keysOk;
+  pthread_mutex_unlock(&pCount->mutex);
+  return pCount->stopAt && recordNo == pCount->stopAt;
+}
+
+static void
+testSplitOji(void) {
+const char* text = " {\"a\":\"}\"}[1,[2]]\n\"q\\\"\" 12 true\n{\"b\"";
+const uint8_t* buf = (const uint8_t*) text;
+size_t len = strlen(text);
+size_t start;
+size_t end;
+  CHECK(nextRecordOji(buf, len, 0, 0, &start, &end) == 1 && start == 1 && end == 10);
+  CHECK(nextRecordOji(buf, len, end, 0, &start, &end) == 1 && start == 10 && end == 17);
+  CHECK(nextRecordOji(buf, len, end, 0, &start, &end) == 1 && start == 18 && end == 23);
+  CHECK(nextRecordOji(buf, len, end, 0, &start, &end) == 1 && !memcmp(buf + start, "12", end - start));
+  CHECK(nextRecordOji(buf, len, end, 0, &start, &end) == 1 && !memcmp(buf + start, "true", end - start));
+  CHECK(nextRecordOji(buf, len, end, 0, &start, &end) == -1 && buf[start] == '{');
+  CHECK(nextRecordOji(buf, len, start, 1, &start, &end) == 1 && end == len);
+  CHECK(nextRecordOji(buf, 3, 1, 0, &start, &end) == -1);
+  CHECK(nextRecordOji((const uint8_t*) " \n\t", 3, 0, 1, &start, &end) == 0 && start == 3);
+  return;
+}
+
+static void
+testMergeOji(void) {
+OJIRECOPTS recOpts;
+pAVLTREE pRecords = 0;
+pAVLTREE pArray = 0;
+COUNTARG count;
+size_t n = 5000;
+size_t len;
+size_t lenArray;
+char* ndjson = makeRecordsOji(n, 0, &len);
+char* array = makeRecordsOji(n, 1, &lenArray);
+char tmpName[] = "/tmp/test_orx_ndjsonXXXXXX";
+FILE* fTmp;
+int fd;
+int threads;
+size_t bigLen = 3 * OJIREC_READ_SIZE;
+char* big;
+
+  if (!ndjson || !array) { ++errors; return; }
+  CHECK(!readOjiAvlBuffer((uint8_t*) array, lenArray, &pArray, 0, 0));
+
+  /* Merged keys match the same records as one array, for any threads
+   * and window
+   */
+  for (threads=1; threads<=4; threads+=3) {
+    memset(&recOpts, 0, sizeof recOpts);
+    recOpts.threads = threads;
+    recOpts.windowBytes = threads == 1 ? 0 : 1000;
+    CHECK(!readOjiRecordsBuffer((uint8_t*) ndjson, len, &pRecords, &recOpts));
+    CHECK(recOpts.records == n && verifyAvl(&pRecords) >= 0 && sameTreesOji(pRecords, pArray));
+    CHECK(threads == 1 || recOpts.peakBytes <= 1000);
+    cleanupAVL(&pRecords);
+  }
+
+  /* Merged after existing keys */
+  CHECK(!readOjiAvlBuffer((uint8_t*) "{\"x\":1}", 7, &pRecords, 0, 0));
+  memset(&recOpts, 0, sizeof recOpts);
+  recOpts.threads = 3;
+  CHECK(!readOjiRecordsBuffer((uint8_t*) "{\"a\":1}\n{\"a\":2}", 15, &pRecords, &recOpts));
+  CHECK(orx_getOji(pRecords, "json.x") && orx_getOji(pRecords, "json[1].a") && verifyAvl(&pRecords) >= 0);
+  cleanupAVL(&pRecords);
+
+  /* Callback:  every record once, tree keyed "json..." */
+  memset(&count, 0, sizeof count);
+  pthread_mutex_init(&count.mutex, 0);
+  count.keysOk = 1;
+  memset(&recOpts, 0, sizeof recOpts);
+  recOpts.threads = 4;
+  recOpts.windowBytes = 4096;
+  recOpts.record = countRecordOji;
+  recOpts.recordArg = &count;
+  CHECK(!readOjiRecordsBuffer((uint8_t*) ndjson, len, 0, &recOpts));
+  CHECK(count.records == n && count.recordNoSum == n * (n - 1) / 2 && count.keysOk);
+  CHECK(recOpts.peakBytes <= 4096);
+  {
+  size_t arrayLeaves = (size_t) -1;    // Less "json.length"
+  pAVLTREE pAvl;
+    for (pAvl = firstAvl(pArray); pAvl; pAvl = nextAvl(pAvl)) ++arrayLeaves;
+    CHECK(count.leaves == arrayLeaves);
+  }
+
+  /* Callback stops the load */
+  count.stopAt = 1000;
+  CHECK(readOjiRecordsBuffer((uint8_t*) ndjson, len, 0, &recOpts) == 9 && recOpts.badRecord == 1000);
+
+  /* Bad record:  load fails, names it, and leaves tree unchanged */
+  {
+  const char* bad = "{\"a\":1}\n{\"a\":2}\n{\"a\":1]\n{\"a\":4}\n";
+    memset(&recOpts, 0, sizeof recOpts);
+    recOpts.threads = 2;
+    CHECK(readOjiRecordsBuffer((uint8_t*) bad, strlen(bad), &pRecords, &recOpts) == 4 && recOpts.badRecord == 2 && !pRecords);
+    CHECK(readOjiRecordsBuffer((uint8_t*) "{\"a\":1}\n{\"a\"", 12, &pRecords, &recOpts) == 5 && recOpts.badRecord == 1);
+  }
+
+  /* File:  records across read boundaries, and one larger than a read */
+  if ((fd = mkstemp(tmpName)) < 0 || !(fTmp = fdopen(fd, "w"))) { ++errors; return; }
+  fwrite(ndjson, 1, len, fTmp);
+  if ((big = malloc(bigLen + 1))) {
+    memset(big, 'b', bigLen);
+    big[bigLen] = '\0';
+    fprintf(fTmp, "\n{\"big\":\"%s\"}\n", big);
+    free(big);
+  }
+  fclose(fTmp);
+  memset(&recOpts, 0, sizeof recOpts);
+  recOpts.threads = 4;
+  recOpts.windowBytes = 8192;
+  CHECK(!readOjiRecords(tmpName, &pRecords, &recOpts) && recOpts.records == n + 1);
+  {
+  char key[32];
+  pOJITEM pOji;
+    sprintf(key, "json[%lu].big", (unsigned long) n);
+    CHECK((pOji = orx_getOji(pRecords, key)) && strlen(pOji->sPayload) == bigLen);
+    cleanupAVL(&pRecords);
+  }
+  CHECK(readOjiRecords("/nonexistent/file.ndjson", &pRecords, &recOpts) == 2);
+  unlink(tmpName);
+
+  pthread_mutex_destroy(&count.mutex);
+  cleanupAVL(&pArray);
+  free(ndjson);
+  free(array);
+  return;
+}
+
+/* Records per second, one document versus record stream by threads */
+static void
+benchRecordsOji(void) {
+OJIRECOPTS recOpts;
+pAVLTREE pAvlTree = 0;
+COUNTARG count;
+size_t n = 10000;
+size_t len;
+size_t lenArray;
+char* ndjson = makeRecordsOji(n, 0, &len);
+char* array = makeRecordsOji(n, 1, &lenArray);
+double t;
+int threads;
+
+  if (!ndjson || !array) { ++errors; return; }
+  t = ojiSeconds();
+  CHECK(!readOjiAvlBuffer((uint8_t*) array, lenArray, &pAvlTree, 0, 0));
+  t = ojiSeconds() - t;
+  cleanupAVL(&pAvlTree);
+  fprintf(stdout, "%lu records, %ld CPUs; one array document:  %.0f records/s\n"
+         , (unsigned long) n, sysconf(_SC_NPROCESSORS_ONLN), n / t);
+
+  memset(&count, 0, sizeof count);
+  pthread_mutex_init(&count.mutex, 0);
+  for (threads=1; threads<=8; threads<<=1) {
+    memset(&recOpts, 0, sizeof recOpts);
+    recOpts.threads = threads;
+    t = ojiSeconds();
+    CHECK(!readOjiRecordsBuffer((uint8_t*) ndjson, len, &pAvlTree, &recOpts));
+    t = ojiSeconds() - t;
+    cleanupAVL(&pAvlTree);
+    fprintf(stdout, "  %d thread%s:  merged %.0f records/s", threads, threads > 1 ? "s" : " ", n / t);
+    recOpts.record = countRecordOji;
+    recOpts.recordArg = &count;
+    recOpts.windowBytes = 1 << 16;
+    t = ojiSeconds();
+    CHECK(!readOjiRecordsBuffer((uint8_t*) ndjson, len, 0, &recOpts));
+    t = ojiSeconds() - t;
+    fprintf(stdout, ", callback %.0f records/s (peak %lu bytes in flight)\n", n / t, (unsigned long) recOpts.peakBytes);
+  }
+  pthread_mutex_destroy(&count.mutex);
+  free(ndjson);
+  free(array);
+  return;
+}
+
+int
+main(int argc, char** argv) {
+OJIRECOPTS recOpts;
+pAVLTREE pAvlTree = 0;
+int fileErrors;
+
+  while (--argc > 0) {
+    fileErrors = errors;
+    memset(&recOpts, 0, sizeof recOpts);
+    CHECK(!readOjiRecords(argv[argc], &pAvlTree, &recOpts));
+    fprintf(stdout, "%s:  %s; %lu records\n", argv[argc], errors > fileErrors ? "FAILED" : "OK", (unsigned long) recOpts.records);
+    cleanupAVL(&pAvlTree);
+  }
+
+  testSplitOji();
+  testMergeOji();
+  benchRecordsOji();
+
+  fprintf(stdout, "test_orx_ndjson:  %s\n", errors ? "FAILED" : "OK");
+  return errors ? 1 : 0;
+}
+#endif // DO_MAIN
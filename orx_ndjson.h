@@ -0,0 +1,63 @@
+////////////////////////////////////////////////////////////////////////
+// Record streams:  newline-delimited JSON (NDJSON), or concatenated JSON
+// documents, parsed record by record on a pool of threads
+//
+// readOjiAvl reads a file as one document.  readOjiRecords instead
+// splits the input at record boundaries (the end of each top-level
+// value; newlines are not required) and hands batches of records to
+// worker threads, each of which tokenizes and flattens its records:
+//
+// - with a record callback, each record is flattened into its own tree,
+//   with keys "json", "json.a", ..., passed to the callback with its
+//   record number, and freed when the callback returns
+// - without one, record n is flattened with keys "json[n]", "json[n].a",
+//   ...; each worker keeps its own tree, and the workers' trees are
+//   merged (mergeAvl) into *ppAvlTree at the end; the keys are those of
+//   the same records loaded as one JSON array, less "json.length"
+//
+// Record bytes queued or being parsed are limited to windowBytes:  the
+// splitter waits for workers to catch up, so with a callback, peak
+// memory does not grow with the input.  Files are read through
+// BUFFILESRC (buffer_file.h), so compressed files are accepted too.
+//
+// Records are processed out of order and concurrently; the callback
+// must be thread-safe.
+//
+////////////////////////////////////////////////////////////////////////
+#ifndef __ORX_NDJSON_H__
+#define __ORX_NDJSON_H__
+
+#include <stdint.h>
+
+#include "orx_parsejson.h"
+
+/* Records per batch, and bytes per batch (or windowBytes if less) */
+#ifndef OJIREC_BATCH_RECORDS
+#define OJIREC_BATCH_RECORDS 256
+#endif
+#ifndef OJIREC_BATCH_BYTES
+#define OJIREC_BATCH_BYTES 65536
+#endif
+
+typedef struct OJIRECOPTSstr {
+  int threads;             // Worker threads; 0 for one per online CPU
+  size_t windowBytes;      // Most record bytes in flight; 0 for 4MB
+  /* Per-record callback, or null to merge records into *ppAvlTree
+   * - *ppRecordTree may be taken over (set to null); else it is freed
+   * - returns 0 to continue, non-zero to stop the load
+   */
+  int (*record)(void* recordArg, size_t recordNo, ppAVLTREE ppRecordTree);
+  void* recordArg;
+  pOJIOPTS pOpts;          // Key filters and descent; pStats, pSink,
+                           //   pAlloc and pIntern are not used; may be null
+  /* Results */
+  size_t records;          // Records split off and queued
+  size_t badRecord;        // Number of first record that failed, if any
+  size_t peakBytes;        // Most record bytes in flight at once
+} OJIRECOPTS, *pOJIRECOPTS;
+
+int nextRecordOji(const uint8_t* buf, size_t len, size_t pos, int atEof, size_t* pStart, size_t* pEnd);
+int readOjiRecords(char* filepath, ppAVLTREE ppAvlTree, pOJIRECOPTS pRecOpts);
+int readOjiRecordsBuffer(const uint8_t* json_buffer, size_t json_len, ppAVLTREE ppAvlTree, pOJIRECOPTS pRecOpts);
+
+#endif // __ORX_NDJSON_H__
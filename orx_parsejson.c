@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 
 #include "jsmn.h"
 #include "buffer_file.h"
@@ -19,17 +20,71 @@ oji_comparator(const void* payload1, const void* payload2) {
   return strcmp(((pOJITEM)payload1)->keyString,((pOJITEM)payload2)->keyString);
 }
 
+/* Same order, for LCP-aware descent:  compare from byte *pLcp on, and
+ * set *pLcp to the length of the common prefix
+ * - both ->keyLen must be set; compares eight bytes at a time up to the
+ *   shorter terminator, then byte by byte
+ */
+int
+oji_lcpComparator(const void* payload1, const void* payload2, size_t* pLcp) {
+pOJITEM pOji1 = (pOJITEM) payload1;
+pOJITEM pOji2 = (pOJITEM) payload2;
+size_t i = *pLcp;
+size_t end = (pOji1->keyLen < pOji2->keyLen ? pOji1->keyLen : pOji2->keyLen) + 1;
+const unsigned char* s1 = (const unsigned char*) pOji1->keyString;
+const unsigned char* s2 = (const unsigned char*) pOji2->keyString;
+uint64_t w1;
+uint64_t w2;
+
+  for ( ; i + 64 <= end && !memcmp(s1 + i, s2 + i, 64); i += 64) ;
+  for ( ; i + 8 <= end; i += 8) {
+    memcpy(&w1, s1 + i, 8);
+    memcpy(&w2, s2 + i, 8);
+    if (w1 != w2) {
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+      i += __builtin_ctzll(w1 ^ w2) >> 3;
+      *pLcp = i;
+      return (int) s1[i] - (int) s2[i];
+#else
+      break;
+#endif
+    }
+  }
+  for ( ; i < end && s1[i] == s2[i]; ++i) ;
+  *pLcp = i;
+  return i < end ? (int) s1[i] - (int) s2[i] : 0;
+}
+
+/* Same order, with memcmp over ->keyLen bytes; falls back to strcmp if
+ * either keyLen is OJI_KEYLEN_UNSET
+ */
+int
+oji_lenComparator(const void* payload1, const void* payload2) {
+pOJITEM pOji1 = (pOJITEM) payload1;
+pOJITEM pOji2 = (pOJITEM) payload2;
+int comp;
+  if (pOji1->keyLen == OJI_KEYLEN_UNSET || pOji2->keyLen == OJI_KEYLEN_UNSET) {
+    return strcmp(pOji1->keyString, pOji2->keyString);
+  }
+  comp = memcmp(pOji1->keyString, pOji2->keyString
+               , pOji1->keyLen < pOji2->keyLen ? pOji1->keyLen : pOji2->keyLen);
+  if (comp) return comp;
+  return pOji1->keyLen < pOji2->keyLen ? -1 : (pOji1->keyLen > pOji2->keyLen ? 1 : 0);
+}
+
 
 /**********************************************************************/
 /* Free one OJITEM */
 void
 cleanupOji(void* pPayload) {
 pOJITEM pOji = (pOJITEM) pPayload;
+pORXALLOC pAlloc;
   if (pOji) {
     if (pOji->strKeyMalloced && pOji->keyString) { free(pOji->keyString); }
     if (pOji->strPayloadMalloced && pOji->sPayload) { free(pOji->sPayload); }
+    pAlloc = pOji->pAlloc;
     memset(pOji,0,sizeof(OJITEM));
-    free(pOji);
+    orx_free(pAlloc, pOji);
   }
   return;
 }
@@ -41,6 +96,14 @@ pOJITEM pOji = (pOJITEM) pPayload;
  */
 pOJITEM
 newOji(pOJITEM pSource, char* keyPrefix, int lenStrJson) {
+  return newOjiAlloc(pSource, keyPrefix, lenStrJson, (pORXALLOC) 0);
+}
+
+/* Same as newOjiAlloc; if sharedPayload is not null, point ->sPayload at
+ * it instead of copying lenStrJson characters from pSource->sPayload
+ */
+static pOJITEM
+newOjiShared(pOJITEM pSource, char* keyPrefix, int lenStrJson, pORXALLOC pAlloc, const char* sharedPayload) {
 pOJITEM rtn;
 int lenKeyPfx = (keyPrefix && *keyPrefix) ? strlen(keyPrefix) : 0;
 int lenKeySfx;
@@ -60,28 +123,34 @@ int szof;
   /* Get size required for OJITEM, for keyString, and for payload string */
   szof = sizeof(OJITEM)
        + (lenKeyTotal + 1)
-       + ((lenStrJson > 0 ? lenStrJson : 0) + 1)
+       + (sharedPayload ? 0 : ((lenStrJson > 0 ? lenStrJson : 0) + 1))
        ;
 
   /* Allocate the space */
-  rtn = malloc(szof);
+  rtn = orx_malloc(pAlloc, szof);
   if (!rtn) return rtn;
 
-  /* Copy data from pSource */
+  /* Copy data from pSource; keep allocator for cleanupOji */
   memcpy((void*)rtn,(void*)pSource,sizeof(OJITEM));
+  rtn->pAlloc = pAlloc;
 
   /* Point ->keyString string at end of OJITEM; copy key prefix & suffix */
   rtn->keyString = (char*)(rtn + 1);
   if (lenKeyPfx > 0) { strncpy(rtn->keyString, keyPrefix, lenKeyPfx); }
   strncpy(rtn->keyString + lenKeyPfx, pSource->keyString, lenKeySfx);
   rtn->keyString[lenKeyTotal] = '\0';
+  rtn->keyLen = (uint32_t) lenKeyTotal;
 
   /* Point ->sPayload at first character after ->keyString terminator, 
-   * and copy payload string, plus null terminator
+   * and copy payload string, plus null terminator; or at shared copy
    */
-  rtn->sPayload = rtn->keyString + lenKeyTotal + 1;
-  strncpy(rtn->sPayload, pSource->sPayload, lenStrJson);
-  rtn->sPayload[lenStrJson] = '\0';
+  if (sharedPayload) {
+    rtn->sPayload = (char*) sharedPayload;
+  } else {
+    rtn->sPayload = rtn->keyString + lenKeyTotal + 1;
+    strncpy(rtn->sPayload, pSource->sPayload, lenStrJson);
+    rtn->sPayload[lenStrJson] = '\0';
+  }
 
   /* Point union string pointer at sPayload */
   if (rtn->payloadType == OJI_STRING) { rtn->uPayload.aString = rtn->sPayload; }
@@ -96,23 +165,212 @@ int szof;
   rtn->avltree.payload = (void*)rtn;
 
   return rtn;
-} /* newOji(pOJITEM pSource, char* keyPrefix, int lenStrJson) */
+} /* newOjiShared(pOJITEM pSource, char* keyPrefix, int lenStrJson, pORXALLOC pAlloc, ...) */
+
+/* Same as newOji, allocating from pAlloc (null for malloc) */
+pOJITEM
+newOjiAlloc(pOJITEM pSource, char* keyPrefix, int lenStrJson, pORXALLOC pAlloc) {
+  return newOjiShared(pSource, keyPrefix, lenStrJson, pAlloc, (const char*) 0);
+}
+
+
+/**********************************************************************/
+/* String interning table; see OJIINTERN in orx_parsejson.h */
+typedef struct OJIINTERNSTRstr {
+  struct OJIINTERNSTRstr* pNext;
+  uint64_t hash;
+  size_t len;
+  char text[];             // len characters, and terminator
+} OJIINTERNSTR, *pOJIINTERNSTR;
+
+/* FNV-1a */
+static uint64_t
+hashInternOji(const char* text, size_t len) {
+uint64_t hash = 0xcbf29ce484222325ULL;
+size_t i;
+  for (i=0; i<len; ++i) {
+    hash ^= (uint8_t) text[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+void
+initInternOji(pOJIINTERN pIntern, pORXALLOC pAlloc) {
+  if (!pIntern) return;
+  memset(pIntern, 0, sizeof(OJIINTERN));
+  pIntern->pAlloc = pAlloc;
+  return;
+}
+
+/* Double the buckets, or make the first 256; returns 0 on success */
+static int
+growInternOji(pOJIINTERN pIntern) {
+size_t nBuckets = pIntern->nBuckets ? pIntern->nBuckets << 1 : 256;
+pOJIINTERNSTR* ppBuckets = orx_malloc(pIntern->pAlloc, nBuckets * sizeof(pOJIINTERNSTR));
+pOJIINTERNSTR pStr;
+size_t i;
+
+  if (!ppBuckets) return 1;
+  memset(ppBuckets, 0, nBuckets * sizeof(pOJIINTERNSTR));
+  for (i=0; i<pIntern->nBuckets; ++i) {
+    while ((pStr = pIntern->ppBuckets[i])) {
+      pIntern->ppBuckets[i] = pStr->pNext;
+      pStr->pNext = ppBuckets[pStr->hash & (nBuckets - 1)];
+      ppBuckets[pStr->hash & (nBuckets - 1)] = pStr;
+    }
+  }
+  if (pIntern->ppBuckets) {
+    orx_free(pIntern->pAlloc, pIntern->ppBuckets);
+    pIntern->bytesHeld -= pIntern->nBuckets * sizeof(pOJIINTERNSTR);
+  }
+  pIntern->ppBuckets = ppBuckets;
+  pIntern->nBuckets = nBuckets;
+  pIntern->bytesHeld += nBuckets * sizeof(pOJIINTERNSTR);
+  return 0;
+}
+
+/* Shared, null-terminated copy of len characters of text, added to the
+ * table if not already there; returns null if it could not be added
+ */
+const char*
+internOji(pOJIINTERN pIntern, const char* text, size_t len) {
+uint64_t hash;
+pOJIINTERNSTR pStr;
+pOJIINTERNSTR* ppBucket;
+
+  if (!pIntern || !text) return 0;
+  ++pIntern->lookups;
+  hash = hashInternOji(text, len);
+
+  if (pIntern->nBuckets) {
+    for (pStr = pIntern->ppBuckets[hash & (pIntern->nBuckets - 1)]; pStr; pStr = pStr->pNext) {
+      if (pStr->hash == hash && pStr->len == len && !memcmp(pStr->text, text, len)) {
+        pIntern->bytesSaved += len + 1;
+        return pStr->text;
+      }
+    }
+  }
+
+  /* Not found:  keep load factor at most 1 */
+  if (pIntern->count >= pIntern->nBuckets && growInternOji(pIntern) && !pIntern->nBuckets) return 0;
+  if (!(pStr = orx_malloc(pIntern->pAlloc, sizeof(OJIINTERNSTR) + len + 1))) return 0;
+  pStr->hash = hash;
+  pStr->len = len;
+  memcpy(pStr->text, text, len);
+  pStr->text[len] = '\0';
+  ppBucket = pIntern->ppBuckets + (hash & (pIntern->nBuckets - 1));
+  pStr->pNext = *ppBucket;
+  *ppBucket = pStr;
+  ++pIntern->count;
+  pIntern->bytesHeld += sizeof(OJIINTERNSTR) + len + 1;
+  return pStr->text;
+} /* internOji(pOJIINTERN pIntern, const char* text, size_t len) */
+
+/* Free all strings; trees loaded with the table must be freed first */
+void
+cleanupInternOji(pOJIINTERN pIntern) {
+pOJIINTERNSTR pStr;
+size_t i;
+  if (!pIntern) return;
+  for (i=0; i<pIntern->nBuckets; ++i) {
+    while ((pStr = pIntern->ppBuckets[i])) {
+      pIntern->ppBuckets[i] = pStr->pNext;
+      orx_free(pIntern->pAlloc, pStr);
+    }
+  }
+  orx_free(pIntern->pAlloc, pIntern->ppBuckets);
+  initInternOji(pIntern, pIntern->pAlloc);
+  return;
+}
 
 
 ////////////////////////////////////////////////////////////////////////
 // Routines to get data from OJI/AVL tree
 // - modeled after SPICE GIPOOL, GDPOOL, GCPOOL
 
+// - Search key length, only if the tree was built for oji_lenComparator
+//   (OJI_DESCENT_MEMCMP); strcmp-ordered trees never read it
+static uint32_t
+searchKeyLenOji(pAVLTREE pAvlRoot, const char* searchKeyString) {
+  return (pAvlRoot && pAvlRoot->comparator == oji_lenComparator)
+       ? (uint32_t) strlen(searchKeyString) : OJI_KEYLEN_UNSET;
+}
+
 // - Type-agnostic OJI tree search; returns pointer to (AVLTREE).payload
 pOJITEM
 orx_getOji(pAVLTREE pAvlRoot, char* searchKeyString) {
 OJITEM oji;
   // Load search string into local OJI, for getAVL to use comparator
   oji.keyString = searchKeyString;
+  oji.keyLen = searchKeyLenOji(pAvlRoot, searchKeyString);
   // getAVL returns void*, either to payload matching keystring or to NULL
   return (pOJITEM) getAVL( pAvlRoot, &oji, (int*)0);
 }
 
+// - Same as orx_getOji, and add lookup depth to pStats histogram
+pOJITEM
+orx_getOjiStats(pAVLTREE pAvlRoot, char* searchKeyString, pOJISTATS pStats) {
+OJITEM oji;
+int count = 0;
+pOJITEM pOji;
+  oji.keyString = searchKeyString;
+  oji.keyLen = searchKeyLenOji(pAvlRoot, searchKeyString);
+  pOji = (pOJITEM) getAVL( pAvlRoot, &oji, pStats ? &count : (int*)0);
+  OJISTAT(pStats, countLookupAvl(&pStats->avl, count));
+  return pOji;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// Copy a found value to pOut, for orx_getAnyOji and the other trees'
+// getters; returns 1 if copied, for *pFound, else 0
+// - payloadType, and pPayload pointing to the node's uPayload union;
+//   every tree's union begins with aBool, aScalar and anInteger
+// - pText is the payload text, for OJI_STRING
+// - pOut, requestedOjiType and stringOutSize as for orx_getAnyOji
+int
+orx_copyOutOji(OJIENUM payloadType, const void* pPayload, const char* pText
+              , void *pOut, OJIENUM requestedOjiType, int stringOutSize) {
+char* pStringOut = (char*) pOut;
+
+  // - Fail if payloadType is not compatible with requested OJI type
+  //   - integers widen to double
+  if (payloadType != requestedOjiType
+   && !(requestedOjiType == OJI_SCALAR && payloadType == OJI_INTEGER)) return 0;
+
+  switch (requestedOjiType) {
+
+  default: return 0;
+
+  case OJI_NULL:
+    /* Nothing to do */
+    break;
+
+  case OJI_BOOLEAN:
+    *((OJIBOOL*) pOut) = *((const OJIBOOL*) pPayload);
+    break;
+
+  case OJI_SCALAR:
+    *((double*) pOut) = payloadType == OJI_INTEGER
+                      ? (double) *((const int64_t*) pPayload) : *((const double*) pPayload);
+    break;
+
+  case OJI_INTEGER:
+    *((int64_t*) pOut) = *((const int64_t*) pPayload);
+    break;
+
+  case OJI_STRING:
+    if (stringOutSize < 1) return 0;
+    strncpy(pStringOut, pText ? pText : "<missing>", stringOutSize);
+    pStringOut[stringOutSize-1] = '\0';
+    break;
+  }
+
+  // - Found even if no items will be transferred
+  return 1;
+}
+
 
 ////////////////////////////////////////////////////////////////////////
 // Get one value from OJI/AVL tree
@@ -127,7 +385,8 @@ OJITEM oji;
 //   - pFound is a pointer to indicate whether the key was found in the AVLTREE
 //   - requestedOjiType is the type of value expected, and the type of the array pointed to by (void*)pOut
 //     - OJI_BOOLEAN:  pOut points to OJIBOOL
-//     - OJI_SCALAR:  pOut points to double (OJITEM->payloadType may be OJI_SCALAR or OJI_VECTOR)
+//     - OJI_SCALAR:  pOut points to double (OJITEM->payloadType may be OJI_SCALAR or OJI_INTEGER)
+//     - OJI_INTEGER:  pOut points to int64_t
 //     - OJI_STRING:  pOut points to first char of first element in array of char[stringOutSize]
 //     - OJI_NULL:  pOut is ignore; pFound is set if value is in tree
 //   - stringOutSize is length of string(s) pointed to by pOut
@@ -137,11 +396,6 @@ orx_getAnyOji(pAVLTREE pAvlRoot, char* searchKeyString
              , OJIENUM requestedOjiType, int stringOutSize) {
 pOJITEM pOji;
 
-double* pDoubleOut   = (double*)   pOut;
-int* pIntOut         = (int*)      pOut;
-OJIBOOL* pBooleanOut = (OJIBOOL*)  pOut;
-char* pStringOut     = (char*)     pOut;
-
   // Set found boolean for failure
   if (!pFound) return;
   *pFound = 0;
@@ -149,42 +403,11 @@ char* pStringOut     = (char*)     pOut;
   if (!searchKeyString) return;
   if (!pOut) return;
 
-  // Search for matching key string, return on failures:
-  pOji = orx_getOji(pAvlRoot, searchKeyString);
-
-  // - Fail if no match for key string
-  if (!pOji) return;
-
-  // - Fail if payload->payloadType is not compatible with requested OJI type
-  if (pOji->payloadType != requestedOjiType) return;
-    
-
-  // Set ending and next pointers
-  switch (pOji->payloadType) {
-
-  default: return;
-
-  case OJI_NULL:
-    /* Nothing to do */
-    break;
-
-  case OJI_BOOLEAN:
-    *((OJIBOOL*) pOut) = pOji->uPayload.aBool;
-    break;
-
-  case OJI_SCALAR:
-    *((double*) pOut) = pOji->uPayload.aScalar;
-    break;
-
-  case OJI_STRING:
-    strncpy(pStringOut, pOji->uPayload.aString ? pOji->uPayload.aString : "<missing>", stringOutSize);
-    pStringOut[stringOutSize-1] = '\0';
-    break;
-  }
-
-  // - Set found to true even if no items will be transferred
-  *pFound = 1;
+  // Search for matching key string; fail if no match
+  if (!(pOji = orx_getOji(pAvlRoot, searchKeyString))) return;
 
+  *pFound = orx_copyOutOji(pOji->payloadType, &pOji->uPayload, pOji->uPayload.aString
+                          , pOut, requestedOjiType, stringOutSize);
   return;
 } /* orx_getAnyOji(...) */
 
@@ -202,6 +425,24 @@ orx_getDoubleOji(pAVLTREE pAvlRoot, char* searchKeyString, double *pOut, int *pF
   return;
 }
 void
+orx_getInt64Oji(pAVLTREE pAvlRoot, char* searchKeyString, int64_t *pOut, int *pFound) {
+  orx_getAnyOji(pAvlRoot, searchKeyString, (void*)pOut, pFound, OJI_INTEGER, 0);
+  return;
+}
+void
+orx_getInt32Oji(pAVLTREE pAvlRoot, char* searchKeyString, int32_t *pOut, int *pFound) {
+int64_t value = 0;
+  orx_getAnyOji(pAvlRoot, searchKeyString, (void*)&value, pFound, OJI_INTEGER, 0);
+  /* - not found if out of int32_t range */
+  if (!pFound || !*pFound || !pOut) return;
+  if (value < INT32_MIN || value > INT32_MAX) {
+    *pFound = 0;
+    return;
+  }
+  *pOut = (int32_t) value;
+  return;
+}
+void
 orx_getBooleanOji(pAVLTREE pAvlRoot, char* searchKeyString, OJIBOOL *pOut, int *pFound) {
   orx_getAnyOji(pAvlRoot, searchKeyString, (void*)pOut, pFound, OJI_BOOLEAN, 0);
   return;
@@ -212,6 +453,17 @@ orx_getStringOji(pAVLTREE pAvlRoot, char* searchKeyString, int stringOutSize, ch
   return;
 }
 
+// - Zero-copy string lookup:  returns the payload string itself, valid
+//   while its OJITEM (and, if interned, its OJIINTERN table) lives
+//   - returns null, with *pFound clear, if the key is not an OJI_STRING
+const char*
+orx_getStringRefOji(pAVLTREE pAvlRoot, char* searchKeyString, int *pFound) {
+pOJITEM pOji = searchKeyString ? orx_getOji(pAvlRoot, searchKeyString) : (pOJITEM) 0;
+int found = pOji && pOji->payloadType == OJI_STRING && pOji->uPayload.aString;
+  if (pFound) { *pFound = found; }
+  return found ? pOji->uPayload.aString : (const char*) 0;
+}
+
  
 /*************************/
 /* Print contents of OJI */
@@ -229,6 +481,9 @@ char* pfx = pfxArg ? pfxArg : "";
   case OJI_SCALAR:
     fprintf(fOut, "%sSCALAR=%lg", pfx, pOji->uPayload.aScalar);
     break;
+  case OJI_INTEGER:
+    fprintf(fOut, "%sINTEGER=%lld", pfx, (long long) pOji->uPayload.anInteger);
+    break;
   case OJI_STRING:
     fprintf(fOut, "%sSTRING=<%s>", pfx, pOji->uPayload.aString);
     break;
@@ -243,6 +498,59 @@ char* pfx = pfxArg ? pfxArg : "";
 } /* printOjiPayload(pOJITEM pOji, FILE* fOut, char* pfxArg) */
 
 
+/******************************/
+/* Print contents of OJISTATS */
+void
+printOjiStats(pOJISTATS pStats, FILE* fOut) {
+static char* typeNames[OJI_ENUMCOUNT] =
+  { "unknown", "null", "boolean", "scalar", "string", "integer" };
+int i;
+int iLast;
+
+  if (!pStats) return;
+  if (!fOut) return;
+
+  fprintf(fOut, "bytes read=%lu; read=%.6fs; tokenize=%.6fs; dump=%.6fs\n"
+         , (unsigned long) pStats->bytesRead
+         , pStats->readSeconds, pStats->tokenizeSeconds, pStats->dumpSeconds
+         );
+  fprintf(fOut, "tokens=%lu; parse passes=%lu; skipped=%lu\n"
+         , pStats->tokenCount, pStats->parsePasses, pStats->skippedTokens
+         );
+  fprintf(fOut, "leaves:");
+  for (i=0; i<OJI_ENUMCOUNT; ++i) {
+    fprintf(fOut, " %s=%lu", typeNames[i], pStats->leafCount[i]);
+  }
+  fprintf(fOut, "\nmalloc=%lu; realloc=%lu; bytes=%lu\n"
+         , pStats->mallocCount, pStats->reallocCount
+         , (unsigned long) pStats->allocBytes
+         );
+  fprintf(fOut, "inserts=%lu; replacements=%lu; rotations=%lu\n"
+         , pStats->avl.inserts, pStats->avl.replacements, pStats->avl.rotations
+         );
+  if (pStats->avl.lookups) {
+    /* Lookup depth histogram, up to last non-zero bin */
+    for (iLast=AVL_DEPTH_HIST_SIZE-1; iLast>0 && !pStats->avl.depthHist[iLast]; --iLast) ;
+    fprintf(fOut, "lookups=%lu; depth histogram:", pStats->avl.lookups);
+    for (i=0; i<=iLast; ++i) {
+      fprintf(fOut, " %lu", pStats->avl.depthHist[i]);
+    }
+    fprintf(fOut, "\n");
+  }
+  return;
+} /* printOjiStats(pOJISTATS pStats, FILE* fOut) */
+
+
+/**********************************************************************/
+/* Monotonic wall-clock seconds, for OJISTATS timing and benchmarks */
+double
+ojiSeconds(void) {
+struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + (1e-9 * ts.tv_nsec);
+}
+
+
 /**********************************************************************/
 /* Copy one OJITEM and insert it into a destination AVLTREE
  * - Callback routine for traverseFromRightAvl to copy a whole tree
@@ -323,6 +631,11 @@ int lenPayloadPlus1;
       found &= localOji.uPayload.aScalar == pOji->uPayload.aScalar ? 1 : 0;
       break;
 
+    case OJI_INTEGER:
+      orx_getInt64Oji(pOjiAvlRoot, pOji->keyString, &localOji.uPayload.anInteger, &found);
+      found &= localOji.uPayload.anInteger == pOji->uPayload.anInteger ? 1 : 0;
+      break;
+
     case OJI_NULL:
       orx_getNullOji(pOjiAvlRoot, pOji->keyString, &found);
       break;
@@ -352,215 +665,477 @@ int lenPayloadPlus1;
 
 
 ////////////////////////////////////////////////////////////////////////
+// Decode the type and value of one leaf
+// - pOji->sPayload points to the JSON text of the value, lenStrJson
+//   characters, which need not be null-terminated
+// - isString is non-zero for a JSMN_STRING, zero for a JSMN_PRIMITIVE
+// - a number of 64 or more characters is copied for sscanf with pAlloc
+//   (null for malloc), and counted in pStats (may be null)
+// - returns 0 on success, or 1 if that copy could not be allocated;
+//   payloadType is then OJI_UNKNOWN
+static int
+decodeLeafOjiAlloc(pOJITEM pOji, int isString, int lenStrJson, pORXALLOC pAlloc, pOJISTATS pStats) {
+char sLocal[64];
+char* sNumber;
+
+  if (isString) {
+
+    pOji->payloadType = OJI_STRING;
+    pOji->uPayload.aString = pOji->sPayload;
+
+  } else {
+    switch (*pOji->sPayload) {
+
+    case 'n':                             // null
+      pOji->payloadType = OJI_NULL;
+      break;
+
+    case 't':                             // true
+    case 'f':                             // false
+      pOji->payloadType = OJI_BOOLEAN;
+      pOji->uPayload.aBool = (*pOji->sPayload=='t') ? OJI_TRUE : OJI_FALSE;
+      break;
+
+    default:                              // a number
+      if (lenStrJson > 0 && parseIntOji(pOji->sPayload, lenStrJson, &pOji->uPayload.anInteger) == lenStrJson) {
+        pOji->payloadType = OJI_INTEGER;
+        break;
+      }
+      /* - sscanf needs a terminated copy */
+      pOji->payloadType = OJI_UNKNOWN;
+      if (lenStrJson < 0) break;
+      if (lenStrJson < (int) sizeof sLocal) {
+        sNumber = sLocal;
+      } else {
+        if (!(sNumber = orx_malloc(pAlloc, lenStrJson + 1))) return 1;
+        OJISTAT(pStats, ++pStats->mallocCount; pStats->allocBytes += lenStrJson + 1);
+      }
+      memcpy(sNumber, pOji->sPayload, lenStrJson);
+      sNumber[lenStrJson] = '\0';
+      if ( 1 == sscanf(sNumber, "%lf", &pOji->uPayload.aScalar)) {
+        pOji->payloadType = OJI_SCALAR;
+      }
+      if (sNumber != sLocal) { orx_free(pAlloc, sNumber); }
+    } /* switch (*pOji->sPayload) */
+  }
+  return 0;
+} /* decodeLeafOjiAlloc(pOJITEM pOji, int isString, int lenStrJson, ...) */
+
+// - Same, with malloc for long numbers
+void
+decodeLeafOji(pOJITEM pOji, int isString, int lenStrJson) {
+  decodeLeafOjiAlloc(pOji, isString, lenStrJson, (pORXALLOC) 0, (pOJISTATS) 0);
+  return;
+}
+
 
+////////////////////////////////////////////////////////////////////////
+// Integer literal at start of s[0..len), i.e. [-]digits not followed by
+// a fraction, exponent, or more digits than fit in int64_t
+// - negative zero is not an integer, so that -0 decodes as -0.0
+// - returns the number of characters parsed, or 0 if s does not start
+//   with such a literal; *pValue is set only on success
 int
-jsmn_dump_to_avl( ppAVLTREE ppAvlTree
-                , const uint8_t* json_buffer
-                , jsmntok_t* pToks
-                , size_t count
-                , char* pKeypfx
-                , size_t keyPfxSize
-                ) {
-size_t keypfxpos = pKeypfx ? strlen(pKeypfx) : 0;
-size_t keypfxroom = keyPfxSize - keypfxpos;
-char* pKeypfxend = pKeypfx + keypfxpos;
-int i;
-int j;
-char* pLclKeypfx = pKeypfx;
-char* pLclKeypfxend = pKeypfxend;
-OJITEM localOji;
-pOJITEM pOji = 0;
+parseIntOji(const char* s, size_t len, int64_t* pValue) {
+const char* p = s;
+const char* end = s + len;
+uint64_t u = 0;
+uint64_t limit = (uint64_t) INT64_MAX;
+unsigned digit;
+
+  if (p < end && *p == '-') {
+    ++p;
+    ++limit;
+  }
+  if (p == end || *p < '0' || *p > '9') return 0;
 
-  if (count == 0) { return 0; }
-  if (keyPfxSize == 0) { return 0; }
-  if (!pKeypfx) { return 0; }
+  for ( ; p < end && (digit = (unsigned) (*p - '0')) <= 9; ++p) {
+    if (u > (limit - digit) / 10) return 0;
+    u = 10 * u + digit;
+  }
+  if (p < end && (*p == '.' || *p == 'e' || *p == 'E')) return 0;
+  if (*s == '-' && u == 0) return 0;
+
+  *pValue = (*s == '-') ? (int64_t) (0 - u) : (int64_t) u;
+  return (int) (p - s);
+}
 
-  if (pToks->type == JSMN_STRING || pToks->type == JSMN_PRIMITIVE) {
 
-    localOji.keyString = pKeypfx;
-    localOji.sPayload = (uint8_t*) json_buffer + pToks->start;
-    localOji.strKeyMalloced =
-    localOji.strPayloadMalloced = 0;
+////////////////////////////////////////////////////////////////////////
+// Number of JSMN tokens in the subtree rooted at pToks[0]
+// - an object's size counts its keys, and each key token has size 1 for
+//   its value, so pending counts can be tracked without parent links
+int
+countTokensOji(const jsmntok_t* pToks) {
+int i = 0;
+int pending = 1;
+  while (pending > 0) {
+    pending += pToks[i++].size - 1;
+  }
+  return i;
+}
 
-    if (pToks->type == JSMN_STRING) {
 
-      localOji.payloadType = OJI_STRING;
-      localOji.uPayload.aString = localOji.sPayload;
+////////////////////////////////////////////////////////////////////////
+// Decimal text of integer, null-terminated; returns length
+// - digits are generated two at a time from a table; no printf
+static const char ojiDigitPairs[201] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+  "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
 
-    } else {
-      switch (*localOji.sPayload) {
+int
+formatIntOji(long long value, char* pOut) {
+char tmp[24];
+char* p = tmp + sizeof tmp;
+unsigned long long u = value < 0 ? 0ULL - (unsigned long long) value : (unsigned long long) value;
+int len;
+
+  while (u >= 100) {
+    p -= 2;
+    memcpy(p, ojiDigitPairs + 2 * (u % 100), 2);
+    u /= 100;
+  }
+  if (u >= 10) {
+    p -= 2;
+    memcpy(p, ojiDigitPairs + 2 * u, 2);
+  } else {
+    *--p = (char) ('0' + u);
+  }
+  if (value < 0) *--p = '-';
 
-      case 'n':                             // null
-        localOji.payloadType = OJI_NULL;
-        break;
+  len = (int) (tmp + sizeof tmp - p);
+  memcpy(pOut, p, len);
+  pOut[len] = '\0';
+  return len;
+}
 
-      case 't':                             // true
-      case 'f':                             // false
-        localOji.payloadType = OJI_BOOLEAN;
-        localOji.uPayload.aBool = (*localOji.sPayload=='t') ? OJI_TRUE : OJI_FALSE;
-        break;
 
-      default:                              // a number
-        if ( 1 == sscanf(localOji.sPayload, "%lf", &localOji.uPayload.aScalar)) {
-          localOji.payloadType = OJI_SCALAR;
-        } else {
-          localOji.payloadType = OJI_UNKNOWN;
-        }
-      } /* switch (*localOji.sPayload) */
+////////////////////////////////////////////////////////////////////////
+// Key path stack, shared by the whole flattening recursion
+// - buf holds the key of the current token; each level appends its
+//   suffix at len, and truncates back to len when done
+// - buf starts as the caller's buffer, and moves to the heap only if a
+//   key outgrows it; it then doubles, so heap traffic is O(log(key length))
+//   per document instead of per container
+typedef struct OJIPATHstr {
+  char* buf;
+  size_t len;              // strlen(buf)
+  size_t size;             // Allocated size of buf
+  char* callerBuf;         // Initial buf, owned by the caller
+  pORXALLOC pAlloc;        // Allocator of OJITEMs
+  pORXALLOC pKeyAlloc;     // Allocator of buf, once it leaves callerBuf
+  pOJISTATS pStats;
+  int failed;              // Set if buf could not grow, or a leaf could
+                           // not be allocated:  keys are missing
+} OJIPATH, *pOJIPATH;
+
+/* Make room for n more characters, plus terminator; returns 0 on success */
+static int
+growPathOji(pOJIPATH pPath, size_t n) {
+size_t newSize = pPath->size ? pPath->size : 64;
+char* newBuf;
+
+  if (pPath->len + n + 1 <= pPath->size) return 0;
+  while (pPath->len + n + 1 > newSize) newSize <<= 1;
+
+  if (pPath->buf == pPath->callerBuf) {
+    if ((newBuf = orx_malloc(pPath->pKeyAlloc, newSize)) && pPath->buf) {
+      memcpy(newBuf, pPath->buf, pPath->len + 1);
     }
+    OJISTAT(pPath->pStats, ++pPath->pStats->mallocCount; pPath->pStats->allocBytes += newSize);
+  } else {
+    newBuf = orx_realloc(pPath->pKeyAlloc, pPath->buf, pPath->size, newSize);
+    OJISTAT(pPath->pStats, ++pPath->pStats->reallocCount; pPath->pStats->allocBytes += newSize);
+  }
+  if (!newBuf) {
+    pPath->failed = 1;
+    return 1;
+  }
+  pPath->buf = newBuf;
+  pPath->size = newSize;
+  return 0;
+}
+
+/* Add one leaf, keyed by current path, to the sink or the tree */
+static void
+dumpLeafOji(ppAVLTREE ppAvlTree, pOJIPATH pPath, const char* text, int lenText, int isString, pOJIOPTS pOpts) {
+pOJISINK pSink = pOpts ? pOpts->pSink : (pOJISINK) 0;
+pOJISTATS pStats = pPath->pStats;
+OJITEM localOji;
+pOJITEM pOji;
+const char* shared = 0;
+
+  localOji.keyString = pPath->buf;
+  localOji.sPayload = (char*) text;
+  localOji.strKeyMalloced =
+  localOji.strPayloadMalloced = 0;
+
+  if (decodeLeafOjiAlloc(&localOji, isString, lenText, pPath->pAlloc, pStats)) {
+    pPath->failed = 1;
+    return;
+  }
+
+  OJISTAT(pStats, ++pStats->leafCount[localOji.payloadType]);
+
+  /* Pass leaf to handler, if there is one, instead of the AVLTREE */
+  if (pSink && pSink->leaf) {
+    if (pSink->leaf(pSink, &localOji, lenText) < 0) pPath->failed = 1;
+    return;
+  }
+
+  /* Share string payload through the interning table, if there is one */
+  if (pOpts && pOpts->pIntern && localOji.payloadType == OJI_STRING) {
+    shared = internOji(pOpts->pIntern, text, (size_t) lenText);
+  }
 
-    /* Allocate a new OJITEM and copy the payload from localOji to it */
-    if ((pOji = newOji(&localOji, 0, pToks->end - pToks->start))) {
-      /* - if successful, insert the new item into the AVLTREE */
-      insertAvl(ppAvlTree, &pOji->avltree);
-      return 1;
+  /* Allocate a new OJITEM and copy the payload from localOji to it */
+  if ((pOji = newOjiShared(&localOji, 0, lenText, pPath->pAlloc, shared))) {
+    OJISTAT(pStats, ++pStats->mallocCount;
+                    pStats->allocBytes += sizeof(OJITEM) + pPath->len + 1 + (shared ? 0 : lenText + 1));
+    /* - if successful, insert the new item into the AVLTREE */
+    switch (pOpts ? pOpts->descent : OJI_DESCENT_STRCMP) {
+    case OJI_DESCENT_LCP:
+      insertLcpAvl(ppAvlTree, &pOji->avltree, oji_lcpComparator, pStats ? &pStats->avl : (pAVLSTATS) 0);
+      break;
+    case OJI_DESCENT_MEMCMP:
+      pOji->avltree.comparator = oji_lenComparator;
+      /* fall through */
+    default:
+      insertStatsAvl(ppAvlTree, &pOji->avltree, pStats ? &pStats->avl : (pAVLSTATS) 0);
+      break;
     }
+  } else {
+    pPath->failed = 1;
+  }
+  return;
+}
 
+/* Non-zero if key is prefix, or is below it ("." or "[" follows) */
+static int
+isAtOrBelowOji(const char* key, size_t lenKey, const char* prefix) {
+size_t lenPrefix = strlen(prefix);
+  if (lenKey < lenPrefix || memcmp(key, prefix, lenPrefix)) return 0;
+  return lenKey == lenPrefix || key[lenPrefix] == '.' || key[lenPrefix] == '[';
+}
 
-  } else if (pToks->type == JSMN_ARRAY || pToks->type == JSMN_OBJECT) {
-  int lenAdd;
-  char* pSfx;
+/* Apply OJIOPTS key filters to the current path
+ * - returns 1 to keep the key; 0 to drop it; for containers, -1 to
+ *   descend without keeping, i.e. it is above an included prefix
+ */
+static int
+filterPathOji(pOJIPATH pPath, pOJIOPTS pOpts, int isContainer) {
+const char** ppPrefix;
+int above = 0;
 
-    /* Loop over tokens contained in container pTok[0]
-     * - Start at -1 for array to store arry .length field
-     */
-    j = 0;
-    for (i = -1; i < pToks->size; i++) {
+  for (ppPrefix = pOpts->excludePrefixes; ppPrefix && *ppPrefix; ++ppPrefix) {
+    if (isAtOrBelowOji(pPath->buf, pPath->len, *ppPrefix)) return 0;
+  }
 
-      /* Determine length of suffix to append to keypfx */
+  if ((ppPrefix = pOpts->includePrefixes)) {
+    for ( ; *ppPrefix; ++ppPrefix) {
+      if (isAtOrBelowOji(pPath->buf, pPath->len, *ppPrefix)) break;
+      if (isContainer && isAtOrBelowOji(*ppPrefix, strlen(*ppPrefix), pPath->buf)) above = 1;
+    }
+    if (!*ppPrefix) return above ? -1 : 0;
+  }
 
-      if (pToks->type == JSMN_ARRAY) {
+  if (pOpts->keyFilter && !pOpts->keyFilter(pOpts->filterArg, pPath->buf, isContainer)) return 0;
+  return 1;
+}
 
-        /* Array:  add index "[i]" or .length - assume 30 characters max */
-        lenAdd = 30;
+#define OJI_HAS_FILTER(P) \
+  ((P) && ((P)->includePrefixes || (P)->excludePrefixes || (P)->keyFilter))
+
+/* Flatten the token subtree at pToks[0], keyed by the current path;
+ * returns the number of tokens consumed
+ */
+static int
+dumpPathOji(ppAVLTREE ppAvlTree, const uint8_t* json_buffer, jsmntok_t* pToks, size_t count, pOJIPATH pPath, pOJIOPTS pOpts) {
+pOJISINK pSink = pOpts ? pOpts->pSink : (pOJISINK) 0;
+size_t base = pPath->len;
+char sLength[24];
+int keep = 1;
+int lenName;
+int lenIndex;
+int i;
+int j;
 
-      } else {                 /* JSMN_OBJECT */
+  if (count == 0) { return 0; }
 
-        /* Skip -1 case:  length not required for JSMN_OBJECT */
-        if (i < 0) continue;
+  /* Skip filtered-out subtree without building keys or decoding leaves */
+  if (OJI_HAS_FILTER(pOpts) && !(keep = filterPathOji(pPath, pOpts, pToks->type == JSMN_ARRAY || pToks->type == JSMN_OBJECT))) {
+    j = countTokensOji(pToks);
+    OJISTAT(pPath->pStats, pPath->pStats->skippedTokens += j);
+    return j;
+  }
 
-        /* Object:  add name ".<name>" - 1 for dot plus length of name */
-        lenAdd = 1 + pToks[1+j].end - pToks[1+j].start;
+  if (pToks->type == JSMN_STRING || pToks->type == JSMN_PRIMITIVE) {
+    dumpLeafOji(ppAvlTree, pPath, (const char*) json_buffer + pToks->start
+               , pToks->end - pToks->start, pToks->type == JSMN_STRING, pOpts);
+    return 1;
+  }
 
-        /* Save starting address of name */
-        pSfx = (uint8_t*) json_buffer + pToks[1+j].start;
+  if (pToks->type != JSMN_ARRAY && pToks->type != JSMN_OBJECT) { return 0; }
 
-        /* Increment index into JSMN tokens */
-        ++j;
+  /* Offer whole container to handler, unless it is only above an
+   * included prefix; it may consume it
+   */
+  if (pSink && pSink->container && keep > 0) {
+    if ((j = pSink->container(pSink, pPath->buf, json_buffer, (const void*) pToks)) > 0) {
+      return j;
+    }
+  }
+
+  /* Array:  .length leaf first */
+  if (pToks->type == JSMN_ARRAY && !growPathOji(pPath, 7)) {
+    memcpy(pPath->buf + base, ".length", 8);
+    pPath->len = base + 7;
+    if (!OJI_HAS_FILTER(pOpts) || filterPathOji(pPath, pOpts, 0) > 0) {
+      dumpLeafOji(ppAvlTree, pPath, sLength, formatIntOji(pToks->size, sLength), 0, pOpts);
+    }
+  }
+
+  /* Elements or members:  append "[i]" or ".name" to path, recurse */
+  for (j = i = 0; i < pToks->size && (size_t) (1 + j) < count; ++i) {
+
+    if (pToks->type == JSMN_ARRAY) {
+      if (growPathOji(pPath, 22)) {
+        j += countTokensOji(pToks + 1 + j);
+        continue;
       }
+      pPath->buf[base] = '[';
+      lenIndex = formatIntOji(i, pPath->buf + base + 1);
+      memcpy(pPath->buf + base + 1 + lenIndex, "]", 2);
+      pPath->len = base + 2 + lenIndex;
 
-      /* Ensure pLclKeypfx points to a buffer large enough to append
-       * lenAdd characters; double buffer as needed
-       */
-      while (pLclKeypfx && lenAdd >= keypfxroom) {
-        
-        if (pLclKeypfx==pKeypfx) {
-          /* pLclKeypfx points to buffer argument; malloc new space ... */
-          if ((pLclKeypfx=malloc(keyPfxSize <<= 1))) {
-            /* ... and copy buffer argument */
-            strncpy(pLclKeypfx, pKeypfx, keypfxpos+1);
-          }
-
-        } else {
-        char* pSave;
-          /* pLclKeypfx points to malloced space; realloc double the size */
-          pSave = pLclKeypfx;
-          if (!(pLclKeypfx=realloc( pLclKeypfx, keyPfxSize <<= 1))) {
-            free(pSave);
-          }
-        }
-        pLclKeypfxend = pLclKeypfx + keypfxpos;
-        keypfxroom = keyPfxSize - keypfxpos;
-      } /* while (pLclKeypfx && lenAdd >= keypfxroom) */
-
-      if (i == -1) {
-        strcpy(pLclKeypfxend, ".length");
-      } else if (pToks->type == JSMN_ARRAY) {
-        sprintf(pLclKeypfxend,"[%d]", i);
-      } else {
-        sprintf(pLclKeypfxend,".%.*s", lenAdd-1, pSfx);
+    } else {
+      lenName = pToks[1+j].end - pToks[1+j].start;
+      if (growPathOji(pPath, 1 + lenName)) {
+        j += 1 + countTokensOji(pToks + 2 + j);
+        continue;
       }
+      pPath->buf[base] = '.';
+      memcpy(pPath->buf + base + 1, json_buffer + pToks[1+j].start, lenName);
+      pPath->buf[base + 1 + lenName] = '\0';
+      pPath->len = base + 1 + lenName;
+      ++j;
+    }
 
-      if (i == -1) {
-      char sBuffer30[30];
-      jsmntok_t tmpTok;
+    j += dumpPathOji(ppAvlTree, json_buffer, pToks + 1 + j, count - 1 - j, pPath, pOpts);
+  }
 
-        sprintf(sBuffer30, "%d", pToks->size);
+  pPath->buf[pPath->len = base] = '\0';
+  return j + 1;
+}
 
-        tmpTok.type = JSMN_PRIMITIVE;
-        tmpTok.start = 0;
-        tmpTok.end = strlen(sBuffer30);
-        /* Ignore .size and .parent */
+/* Flatten tokens, with keys starting with the null-terminated text in
+ * pKeypfx, a buffer of keyPfxSize bytes; leaves pKeypfx as it was
+ * - returns 0 on success, or 8 if a key, OJITEM or long number copy
+ *   could not be allocated, or a sink leaf handler failed, and the keys
+ *   below it are missing
+ */
+int
+jsmn_dump_to_avl( ppAVLTREE ppAvlTree
+                , const uint8_t* json_buffer
+                , jsmntok_t* pToks
+                , size_t count
+                , char* pKeypfx
+                , size_t keyPfxSize
+                , pOJIOPTS pOpts
+                ) {
+OJIPATH path;
 
-        jsmn_dump_to_avl( ppAvlTree
-                        , sBuffer30
-                        , &tmpTok
-                        , 1
-                        , pLclKeypfx
-                        , strlen(pLclKeypfx)
-                        );
-        continue;
-      } else {
+  if (count == 0) { return 0; }
+  if (keyPfxSize == 0) { return 0; }
+  if (!pKeypfx) { return 0; }
 
-        j += jsmn_dump_to_avl( ppAvlTree
-                             , json_buffer
-                             , pToks+1+j
-                             , count-j
-                             , pLclKeypfx
-                             , keyPfxSize
-                             );
+  path.buf = path.callerBuf = pKeypfx;
+  path.len = strlen(pKeypfx);
+  path.size = keyPfxSize;
+  path.pAlloc = path.pKeyAlloc = pOpts ? pOpts->pAlloc : (pORXALLOC) 0;
+  path.pStats = pOpts ? pOpts->pStats : (pOJISTATS) 0;
+  path.failed = 0;
 
-      }
-    } // for (j=i=0; ... )
-    if (pLclKeypfx!=pKeypfx) {
-      free(pLclKeypfx);
-    }
-    if (pKeypfx) {
-      *pKeypfxend = '\0';
-    }
-    return j+1;
-  } /* else if (pToks->type == JSMN_ARRAY && pToks->type == JSMN_OBJECT) */
-  return 0;
+  dumpPathOji(ppAvlTree, json_buffer, pToks, count, &path, pOpts);
+
+  if (path.buf != path.callerBuf) {
+    orx_free(path.pKeyAlloc, path.buf);
+  }
+  return path.failed ? 8 : 0;
 } /* jsmn_dump_to_avl(...) */
 
 
 /**********************************************************************/
+/* Read JSON file into OJI AVL tree
+ * - returns 0 on success, non-zero on failure
+ */
 int
 readOjiAvl(char* filepath, ppAVLTREE ppAvlTree, char* pfx, FILE *fOut) {
+  return readOjiAvlStats(filepath, ppAvlTree, pfx, fOut, (pOJISTATS) 0);
+}
+
+
+/**********************************************************************/
+/* Same as readOjiAvl, and accumulate load statistics into *pStats
+ * - pStats may be null, which disables all timing and counting
+ * - if both pStats and fOut are non-null, print the statistics to fOut
+ */
+int
+readOjiAvlStats(char* filepath, ppAVLTREE ppAvlTree, char* pfx, FILE *fOut, pOJISTATS pStats) {
+OJIOPTS opts;
+  memset(&opts, 0, sizeof opts);
+  opts.pStats = pStats;
+  return readOjiAvlOpts(filepath, ppAvlTree, pfx, fOut, &opts);
+}
+
+
+/**********************************************************************/
+/* Same as readOjiAvl, with load settings from *pOpts (may be null)
+ * - ppAvlTree may be null if pOpts->pSink is set
+ * - if both pOpts->pStats and fOut are non-null, print the statistics
+ */
+int
+readOjiAvlOpts(char* filepath, ppAVLTREE ppAvlTree, char* pfx, FILE *fOut, pOJIOPTS pOpts) {
+pOJISTATS pStats = pOpts ? pOpts->pStats : (pOJISTATS) 0;
 size_t json_len;
-uint8_t* json_buffer;
-size_t tokcount = 64;
-jsmntok_t* pToks;
-jsmn_parser jp;
+uint8_t* json_buffer = 0;
 int rtn = 0;
-int parse_rtn;
-char keypfx[BUFSIZ] = { "json" };
+BUFFILE buffile;
+double t0 = pStats ? ojiSeconds() : 0.0;
 
 # define PRTERR(S,RTN) fprintf(stderr, "%s\n", S); rtn = RTN
 
-  if (!rtn && !ppAvlTree) {
+  buffile_init_alloc(&buffile, 0, pOpts ? pOpts->pAlloc : (pORXALLOC) 0);
+
+  if (!rtn && !ppAvlTree && !(pOpts && pOpts->pSink)) {
     PRTERR("readOjiAvl(...) null ppAVLTREE pointer", 1);
   }
-  if (!rtn && !(json_buffer=buffile_file_to_puint8( filepath, &json_len, 0))) {
+  if (!rtn && !(json_buffer=buffile_file_to_puint8( filepath, &json_len, &buffile))) {
     PRTERR("readOjiAvl(...) failed to read file into memory buffer", 2);
   }
-  if (!rtn && !(pToks = realloc(0, sizeof(jsmntok_t) * tokcount))) {
-    PRTERR("readOjiAvl(...) failed to allocate tokens", 3);
+  OJISTAT(pStats, pStats->bytesRead += json_buffer ? json_len : 0;
+                  pStats->reallocCount += buffile.reallocs;
+                  pStats->allocBytes += buffile.limit;
+                  pStats->readSeconds += ojiSeconds() - t0);
+
+  if (!rtn) {
+    rtn = readOjiAvlBuffer(json_buffer, json_len, ppAvlTree, pfx, pOpts);
   }
 
-  jsmn_init(&jp);
+  if (json_buffer) { orx_free(buffile.pAlloc, json_buffer); }
 
-  while (!rtn && JSMN_ERROR_NOMEM == (parse_rtn = jsmn_parse(&jp, json_buffer, json_len, pToks, tokcount))) {
-  void* old_pToks;
-    old_pToks = pToks;
-    pToks = realloc( old_pToks, sizeof(jsmntok_t) * (tokcount <<= 1));
-    if (!pToks) {
-      free(old_pToks);
-      PRTERR("readOjiAvl(...) failed to allocate tokens", 3);
-      rtn = 4;
-      continue;
-    }
-  }
+  if (fOut && pStats) { printOjiStats(pStats, fOut); }
+
+  return rtn;
+} // int readOjiAvlOpts(char* filepath, ppAVLTREE ppAvlTree, char* pfx , FILE *fOut, pOJIOPTS pOpts) {
+
+
+/**********************************************************************/
+/* Check jsmn_parse result; returns 0 on success, else a readOjiAvl code */
+static int
+parseErrorOji(int parse_rtn) {
+int rtn = 0;
 
   if (!rtn && parse_rtn == JSMN_ERROR_INVAL) {
     PRTERR("readOjiAvl(...) jsmn_parse() error; e.g. invalid character", 4);
@@ -574,15 +1149,134 @@ char keypfx[BUFSIZ] = { "json" };
   if (!rtn && parse_rtn < 0) {
     PRTERR("readOjiAvl(...) jsmn_parse() error; unknown cause", 7);
   }
+  return rtn;
+}
+
+
+/**********************************************************************/
+/* Check jsmn_parse result, and add JSMN tokens to an OJI AVL tree
+ * - parse_rtn is the final value returned by jsmn_parse
+ * - ntoks is the number of tokens parsed, i.e. jsmn_parser.toknext
+ * - pfx is never used by the library, here or in readOjiAvl*; keys
+ *   always start with "json"
+ * - returns 0 on success, non-zero on failure (same codes as readOjiAvl)
+ */
+int
+dumpTokensOjiAvl(ppAVLTREE ppAvlTree, const uint8_t* json_buffer, jsmntok_t* pToks, unsigned int ntoks, int parse_rtn, char* pfx, pOJIOPTS pOpts) {
+pOJISTATS pStats = pOpts ? pOpts->pStats : (pOJISTATS) 0;
+int rtn = parseErrorOji(parse_rtn);
+char keypfx[BUFSIZ] = { "json" };
+double t0 = pStats ? ojiSeconds() : 0.0;
 
+  (void) pfx;
   if (!rtn) {
-    jsmn_dump_to_avl(ppAvlTree, json_buffer, pToks, jp.toknext, keypfx, BUFSIZ);
+    OJISTAT(pStats, pStats->tokenCount += ntoks);
+    if (jsmn_dump_to_avl(ppAvlTree, json_buffer, pToks, ntoks, keypfx, BUFSIZ, pOpts)) {
+      PRTERR("readOjiAvl(...) failed to allocate key, OJITEM or sink leaf; tree is incomplete", 8);
+    }
+    OJISTAT(pStats, pStats->dumpSeconds += ojiSeconds() - t0);
   }
 
-  if (json_buffer) { free(json_buffer); }
-  if (pToks) { free(pToks); }
-  return 0;
-} // int readOjiAvl(char* filepath, ppAVLTREE ppAvlTree, char* pfx , FILE *fOut) {
+  return rtn;
+} // int dumpTokensOjiAvl(ppAVLTREE ppAvlTree, ...)
+
+
+/**********************************************************************/
+/* As dumpTokensOjiAvl, with the key path built in a caller-owned buffer
+ * - *ppKeyBuf (*pKeySize bytes, or null) is grown with pKeyAlloc as
+ *   needed, and kept for the next call; free it with orx_free(pKeyAlloc)
+ * - for repeated loads without per-load key buffer allocation
+ */
+int
+dumpTokensOjiKeyBuf(ppAVLTREE ppAvlTree, const uint8_t* json_buffer, jsmntok_t* pToks, unsigned int ntoks, int parse_rtn, char** ppKeyBuf, size_t* pKeySize, pORXALLOC pKeyAlloc, pOJIOPTS pOpts) {
+pOJISTATS pStats = pOpts ? pOpts->pStats : (pOJISTATS) 0;
+int rtn = parseErrorOji(parse_rtn);
+double t0 = pStats ? ojiSeconds() : 0.0;
+OJIPATH path;
+
+  if (!rtn) {
+    path.buf = *ppKeyBuf;
+    path.len = 0;
+    path.size = path.buf ? *pKeySize : 0;
+    path.callerBuf = 0;
+    path.pAlloc = pOpts ? pOpts->pAlloc : (pORXALLOC) 0;
+    path.pKeyAlloc = pKeyAlloc;
+    path.pStats = pStats;
+    path.failed = 0;
+
+    if (growPathOji(&path, 4)) {
+      PRTERR("readOjiAvl(...) failed to allocate key buffer", 8);
+    } else {
+      memcpy(path.buf, "json", 5);
+      path.len = 4;
+      OJISTAT(pStats, pStats->tokenCount += ntoks);
+      dumpPathOji(ppAvlTree, json_buffer, pToks, ntoks, &path, pOpts);
+      if (path.failed) {
+        PRTERR("readOjiAvl(...) failed to allocate key, OJITEM or sink leaf; tree is incomplete", 8);
+      }
+      OJISTAT(pStats, pStats->dumpSeconds += ojiSeconds() - t0);
+    }
+    *ppKeyBuf = path.buf;
+    *pKeySize = path.size;
+  }
+
+  return rtn;
+} // int dumpTokensOjiKeyBuf(ppAVLTREE ppAvlTree, ...)
+
+
+/**********************************************************************/
+/* Tokenize an in-memory JSON buffer, and add its items to an OJI AVL tree
+ * - json_buffer need not be null-terminated; it is not modified
+ * - pOpts may be null; ppAvlTree may be null if pOpts->pSink is set
+ * - returns 0 on success, non-zero on failure (same codes as readOjiAvl)
+ */
+int
+readOjiAvlBuffer(const uint8_t* json_buffer, size_t json_len, ppAVLTREE ppAvlTree, char* pfx, pOJIOPTS pOpts) {
+pOJISTATS pStats = pOpts ? pOpts->pStats : (pOJISTATS) 0;
+pORXALLOC pAlloc = pOpts ? pOpts->pAlloc : (pORXALLOC) 0;
+size_t tokcount = 64;
+jsmntok_t* pToks = 0;
+jsmn_parser jp;
+int rtn = 0;
+int parse_rtn;
+double t0 = pStats ? ojiSeconds() : 0.0;
+
+  if (!rtn && !ppAvlTree && !(pOpts && pOpts->pSink)) {
+    PRTERR("readOjiAvl(...) null ppAVLTREE pointer", 1);
+  }
+  if (!rtn && !json_buffer) {
+    PRTERR("readOjiAvl(...) null JSON buffer", 2);
+  }
+  if (!rtn && !(pToks = orx_malloc(pAlloc, sizeof(jsmntok_t) * tokcount))) {
+    PRTERR("readOjiAvl(...) failed to allocate tokens", 3);
+  }
+  OJISTAT(pStats, ++pStats->mallocCount; pStats->allocBytes += sizeof(jsmntok_t) * tokcount);
+
+  jsmn_init(&jp);
+
+  while (!rtn && JSMN_ERROR_NOMEM == (parse_rtn = jsmn_parse(&jp, (const char*) json_buffer, json_len, pToks, tokcount))) {
+  void* old_pToks;
+    OJISTAT(pStats, ++pStats->parsePasses);
+    old_pToks = pToks;
+    pToks = orx_realloc(pAlloc, old_pToks, sizeof(jsmntok_t) * tokcount, sizeof(jsmntok_t) * (tokcount << 1));
+    tokcount <<= 1;
+    OJISTAT(pStats, ++pStats->reallocCount; pStats->allocBytes += sizeof(jsmntok_t) * tokcount);
+    if (!pToks) {
+      orx_free(pAlloc, old_pToks);
+      PRTERR("readOjiAvl(...) failed to allocate tokens", 3);
+      continue;
+    }
+  }
+  OJISTAT(pStats, if (!rtn) { ++pStats->parsePasses; }
+                  pStats->tokenizeSeconds += ojiSeconds() - t0);
+
+  if (!rtn) {
+    rtn = dumpTokensOjiAvl(ppAvlTree, json_buffer, pToks, jp.toknext, parse_rtn, pfx, pOpts);
+  }
+
+  if (pToks) { orx_free(pAlloc, pToks); }
+  return rtn;
+} // int readOjiAvlBuffer(const uint8_t* json_buffer, size_t json_len, ...)
 /**********************************************************************/
 /*** End of library functions ****************************************/
 /**********************************************************************/
@@ -603,11 +1297,690 @@ char keypfx[BUFSIZ] = { "json" };
  */
 #ifdef DO_MAIN
 
+#include <math.h>
+
 #include "jsmn.c"
 #include "avltree.c"
 #define main MAIN_BUFFILE
 #include "buffer_file.c"
 #undef main
+#include "orx_alloc.c"
+
+/* Return height of tree, or -1 if AVL links or balance are wrong */
+static int
+checkOjiAvl(pAVLTREE pRoot) {
+int hLeft;
+int hRight;
+  if (!pRoot) return 0;
+  if (pRoot->pLeft && (pRoot->pLeft->pParent != pRoot || pRoot->pLeft->ppSelf != &pRoot->pLeft)) return -1;
+  if (pRoot->pRight && (pRoot->pRight->pParent != pRoot || pRoot->pRight->ppSelf != &pRoot->pRight)) return -1;
+  if ((hLeft = checkOjiAvl(pRoot->pLeft)) < 0) return -1;
+  if ((hRight = checkOjiAvl(pRoot->pRight)) < 0) return -1;
+  if (pRoot->balance != hLeft - hRight || pRoot->balance < -1 || pRoot->balance > 1) return -1;
+  return 1 + (hLeft > hRight ? hLeft : hRight);
+}
+
+/* Overlay defaults, mission and run documents with mergeAvl */
+static int
+testMergeOji(void) {
+static const char* docs[3] =
+{ "{\"a\":1,\"b\":\"default\",\"c\":[1,2],\"d\":false}"
+, "{\"b\":\"mission\",\"e\":null}"
+, "{\"a\":3,\"f\":true}"
+};
+pAVLTREE pRoots[3] = { 0, 0, 0 };
+pAVLTREE pMerged = 0;
+double aScalar = 0.0;
+int found;
+char aString[32];
+int i;
+int n;
+int errors = 0;
+
+  for (i=0; i<3; ++i) {
+    if (readOjiAvlBuffer((const uint8_t*) docs[i], strlen(docs[i]), pRoots + i, 0, 0)) ++errors;
+  }
+
+  /* Later documents win */
+  n = mergeAvl(pRoots, 3, &pMerged, AVL_MERGE_LAST_WINS);
+  if (n != 8 || pRoots[0] || pRoots[1] || pRoots[2]) ++errors;
+  if (checkOjiAvl(pMerged) < 0 || pMerged->pParent || pMerged->ppSelf != &pMerged) ++errors;
+  orx_getDoubleOji(pMerged, "json.a", &aScalar, &found);
+  if (!found || aScalar != 3.0) ++errors;
+  orx_getStringOji(pMerged, "json.b", sizeof aString, aString, &found);
+  if (!found || strcmp(aString, "mission")) ++errors;
+  orx_getDoubleOji(pMerged, "json.c[1]", &aScalar, &found);
+  if (!found || aScalar != 2.0) ++errors;
+  orx_getNullOji(pMerged, "json.e", &found);
+  if (!found) ++errors;
+  cleanupAVL(&pMerged);
+
+  /* Earlier documents win */
+  for (i=0; i<3; ++i) {
+    if (readOjiAvlBuffer((const uint8_t*) docs[i], strlen(docs[i]), pRoots + i, 0, 0)) ++errors;
+  }
+  n = mergeAvl(pRoots, 3, &pMerged, AVL_MERGE_FIRST_WINS);
+  if (n != 8 || checkOjiAvl(pMerged) < 0) ++errors;
+  orx_getDoubleOji(pMerged, "json.a", &aScalar, &found);
+  if (!found || aScalar != 1.0) ++errors;
+  orx_getStringOji(pMerged, "json.b", sizeof aString, aString, &found);
+  if (!found || strcmp(aString, "default")) ++errors;
+  cleanupAVL(&pMerged);
+
+  if (errors) fprintf(stderr, "testMergeOji:  %d errors\n", errors);
+  return errors;
+}
+
+/* Predicate for testFilterOji:  drop keys ending in "_internal" */
+static int
+notInternalOji(void* arg, const char* keyString, int isContainer) {
+size_t len = strlen(keyString);
+  (void) arg;
+  (void) isContainer;
+  return len < 9 || strcmp(keyString + len - 9, "_internal");
+}
+
+/* Load only selected subtrees of a report */
+static int
+testFilterOji(void) {
+static const char* doc =
+  "{\"header\":{\"id\":7,\"secret\":{\"k\":1},\"note_internal\":\"x\"}"
+  ",\"headers\":1"
+  ",\"data\":{\"big\":[1,2,3,4,5,6,7,8,9,10],\"keep\":[10,20],\"other\":{\"z\":0}}"
+  ",\"trailer\":[{\"a\":1}]}";
+static const char* include[] = { "json.header", "json.data.keep", 0 };
+static const char* exclude[] = { "json.header.secret", 0 };
+pAVLTREE pAvlTree = 0;
+OJIOPTS opts;
+OJISTATS stats;
+double aScalar = 0.0;
+int found;
+int errors = 0;
+
+  memset(&opts, 0, sizeof opts);
+  memset(&stats, 0, sizeof stats);
+  opts.pStats = &stats;
+  opts.includePrefixes = include;
+  opts.excludePrefixes = exclude;
+  opts.keyFilter = notInternalOji;
+  if (readOjiAvlBuffer((const uint8_t*) doc, strlen(doc), &pAvlTree, 0, &opts)) ++errors;
+
+  /* json.header.id, json.data.keep.length, [0] and [1] */
+  if (checkOjiAvl(pAvlTree) < 0 || stats.avl.inserts != 4) ++errors;
+  orx_getDoubleOji(pAvlTree, "json.header.id", &aScalar, &found);
+  if (!found || aScalar != 7.0) ++errors;
+  orx_getDoubleOji(pAvlTree, "json.data.keep[1]", &aScalar, &found);
+  if (!found || aScalar != 20.0) ++errors;
+  orx_getDoubleOji(pAvlTree, "json.data.keep.length", &aScalar, &found);
+  if (!found || aScalar != 2.0) ++errors;
+  if (orx_getOji(pAvlTree, "json.header.secret.k")) ++errors;
+  if (orx_getOji(pAvlTree, "json.header.note_internal")) ++errors;
+  if (orx_getOji(pAvlTree, "json.headers")) ++errors;
+  if (orx_getOji(pAvlTree, "json.data.big.length")) ++errors;
+
+  /* Skipped value tokens:  secret (3), note_internal (1), headers (1),
+   * big (11), other (3), trailer (4)
+   */
+  if (stats.skippedTokens != 3 + 1 + 1 + 11 + 3 + 4) ++errors;
+  if (stats.leafCount[OJI_INTEGER] != 4) ++errors;
+  cleanupAVL(&pAvlTree);
+
+  if (errors) fprintf(stderr, "testFilterOji:  %d errors\n", errors);
+  return errors;
+}
+
+/* Integer literals:  exact int64 payloads, typed getters and widening */
+static int
+testIntegerOji(void) {
+static const char* doc =
+  "{\"big\":9007199254740993,\"min\":-9223372036854775808,\"max\":9223372036854775807"
+  ",\"over\":9223372036854775808,\"i32\":-2147483648,\"wide\":2147483648"
+  ",\"real\":3.0,\"exp\":1e3,\"neg0\":-0}";
+pAVLTREE pAvlTree = 0;
+int64_t i64 = 0;
+int32_t i32 = 0;
+double aScalar = 0.0;
+int found;
+int errors = 0;
+
+  if (parseIntOji("123,", 4, &i64) != 3 || i64 != 123) ++errors;
+  if (parseIntOji("12345", 2, &i64) != 2 || i64 != 12) ++errors;
+  if (parseIntOji("-12.5", 5, &i64) || parseIntOji("7E2", 3, &i64) || parseIntOji("-", 1, &i64)) ++errors;
+  if (parseIntOji("99999999999999999999", 20, &i64) || parseIntOji("-0", 2, &i64)) ++errors;
+
+  if (readOjiAvlBuffer((const uint8_t*) doc, strlen(doc), &pAvlTree, 0, 0)) ++errors;
+
+  /* 2**53 + 1 is exact as int64, rounded as double */
+  orx_getInt64Oji(pAvlTree, "json.big", &i64, &found);
+  if (!found || i64 != 9007199254740993LL) ++errors;
+  orx_getDoubleOji(pAvlTree, "json.big", &aScalar, &found);
+  if (!found || aScalar != 9007199254740992.0) ++errors;
+  orx_getInt64Oji(pAvlTree, "json.min", &i64, &found);
+  if (!found || i64 != INT64_MIN) ++errors;
+  orx_getInt64Oji(pAvlTree, "json.max", &i64, &found);
+  if (!found || i64 != INT64_MAX) ++errors;
+
+  /* Out of int64 range, fraction or exponent:  double only */
+  orx_getInt64Oji(pAvlTree, "json.over", &i64, &found);
+  if (found) ++errors;
+  orx_getDoubleOji(pAvlTree, "json.over", &aScalar, &found);
+  if (!found || aScalar != 9223372036854775808.0) ++errors;
+  orx_getInt64Oji(pAvlTree, "json.real", &i64, &found);
+  if (found) ++errors;
+  orx_getDoubleOji(pAvlTree, "json.exp", &aScalar, &found);
+  if (!found || aScalar != 1000.0) ++errors;
+  orx_getInt64Oji(pAvlTree, "json.neg0", &i64, &found);
+  if (found) ++errors;
+  orx_getDoubleOji(pAvlTree, "json.neg0", &aScalar, &found);
+  if (!found || aScalar != 0.0 || !signbit(aScalar)) ++errors;
+
+  /* int32 range */
+  orx_getInt32Oji(pAvlTree, "json.i32", &i32, &found);
+  if (!found || i32 != INT32_MIN) ++errors;
+  orx_getInt32Oji(pAvlTree, "json.wide", &i32, &found);
+  if (found) ++errors;
+  cleanupAVL(&pAvlTree);
+
+  if (errors) fprintf(stderr, "testIntegerOji:  %d errors\n", errors);
+  return errors;
+}
+
+/* Counting allocator over malloc; arg points to live allocation count */
+static void* countAllocate(pORXALLOC pAlloc, size_t size) {
+void* ptr = malloc(size);
+  if (ptr) { ++*(long*) pAlloc->arg; }
+  return ptr;
+}
+static void* countReallocate(pORXALLOC pAlloc, void* ptr, size_t oldSize, size_t newSize) {
+void* newPtr = realloc(ptr, newSize);
+  (void) oldSize;
+  if (newPtr && !ptr) { ++*(long*) pAlloc->arg; }
+  return newPtr;
+}
+static void countRelease(pORXALLOC pAlloc, void* ptr) {
+  --*(long*) pAlloc->arg;
+  free(ptr);
+}
+
+/* Load through a counting allocator and through an arena, and check
+ * that every allocation goes through the allocator
+ */
+static int
+testAllocOji(char* filepath) {
+ORXALLOC counting = { countAllocate, countReallocate, countRelease, 0 };
+ORXARENA arena;
+OJIOPTS opts;
+pAVLTREE pTree = 0;
+pAVLTREE pArenaTree = 0;
+pAVLTREE pAvl;
+pAVLTREE pArenaAvl;
+long live = 0;
+int errors = 0;
+
+  counting.arg = (void*) &live;
+  memset(&opts, 0, sizeof opts);
+
+  /* Counting allocator:  only OJITEMs are live after the load */
+  opts.pAlloc = &counting;
+  if (readOjiAvlOpts(filepath, &pTree, 0, 0, &opts)) ++errors;
+  for (pAvl = firstAvl(pTree); pAvl; pAvl = nextAvl(pAvl)) {
+    if (((pOJITEM) pAvl->payload)->pAlloc != &counting) ++errors;
+    --live;
+  }
+  if (live != 0) ++errors;
+  for (pAvl = firstAvl(pTree); pAvl; pAvl = nextAvl(pAvl)) ++live;
+
+  /* Arena:  same tree; all memory freed as a whole */
+  opts.pAlloc = initArenaOrx(&arena, 4096, &counting);
+  if (readOjiAvlOpts(filepath, &pArenaTree, 0, 0, &opts)) ++errors;
+  for (pAvl = firstAvl(pTree), pArenaAvl = firstAvl(pArenaTree); pAvl && pArenaAvl
+      ; pAvl = nextAvl(pAvl), pArenaAvl = nextAvl(pArenaAvl)) {
+    if (oji_comparator(pAvl->payload, pArenaAvl->payload)) ++errors;
+  }
+  if (pAvl || pArenaAvl) ++errors;
+  if (!arena.bytesUsed || arena.bytesUsed > arena.bytesReserved) ++errors;
+
+  cleanupAVL(&pArenaTree);
+  cleanupArenaOrx(&arena);
+  cleanupAVL(&pTree);
+  if (live != 0) ++errors;
+
+  if (errors) fprintf(stderr, "testAllocOji:  %d errors\n", errors);
+  return errors;
+}
+
+/* Allocator over malloc that fails once *(long*) arg allocations have
+ * been made; arg counts down
+ */
+static void* budgetAllocate(pORXALLOC pAlloc, size_t size) {
+  if (*(long*) pAlloc->arg <= 0) return (void*) 0;
+  --*(long*) pAlloc->arg;
+  return malloc(size);
+}
+static void* budgetReallocate(pORXALLOC pAlloc, void* ptr, size_t oldSize, size_t newSize) {
+  (void) oldSize;
+  if (*(long*) pAlloc->arg <= 0) return (void*) 0;
+  --*(long*) pAlloc->arg;
+  return realloc(ptr, newSize);
+}
+static void budgetRelease(pORXALLOC pAlloc, void* ptr) {
+  (void) pAlloc;
+  free(ptr);
+}
+
+/* Sink leaf handler that fails once *(long*) arg leaves are taken */
+static int
+budgetLeafOji(pOJISINK pSink, pOJITEM pLocalOji, int lenStrJson) {
+  (void) pLocalOji;
+  (void) lenStrJson;
+  if (*(long*) pSink->arg <= 0) return -1;
+  --*(long*) pSink->arg;
+  return 1;
+}
+
+/* Failed OJITEM, key and sink leaf allocations fail the load with code 8 */
+static int
+testAllocFailOji(void) {
+static const char* doc =
+  "{\"a\":1,\"b\":[true,\"x\"],\"a_key_longer_than_sixty_four_characters_to_outgrow_the_first_buffer\":2}";
+static const char* longNumber =
+  "[0.25000000000000000000000000000000000000000000000000000000000000000000]";
+ORXALLOC budget = { budgetAllocate, budgetReallocate, budgetRelease, 0 };
+OJISINK sink = { budgetLeafOji, 0, 0 };
+OJIOPTS opts;
+pAVLTREE pAvlTree = 0;
+jsmn_parser jp;
+jsmntok_t toks[16];
+char manyTokens[2 * 100 + 2];
+char* keyBuf = 0;
+size_t keySize = 0;
+long left;
+double aScalar = 0.0;
+int found;
+int parse_rtn;
+int rtn;
+int i;
+int errors = 0;
+
+  budget.arg = (void*) &left;
+  memset(&opts, 0, sizeof opts);
+  opts.pAlloc = &budget;
+
+  /* Tokens, then 5 OJITEMs:  each shortfall fails the load */
+  for (i=0; i<7; ++i) {
+    left = i;
+    rtn = readOjiAvlBuffer((const uint8_t*) doc, strlen(doc), &pAvlTree, 0, &opts);
+    if (rtn != (i == 0 ? 3 : i < 6 ? 8 : 0)) ++errors;
+    cleanupAVL(&pAvlTree);
+  }
+
+  /* More than the first 64 tokens:  failed growth is a token failure */
+  for (i=0; i<100; ++i) { manyTokens[2*i] = i ? ',' : '['; manyTokens[2*i + 1] = '0'; }
+  strcpy(manyTokens + 2 * 100, "]");
+  left = 1;
+  rtn = readOjiAvlBuffer((const uint8_t*) manyTokens, strlen(manyTokens), &pAvlTree, 0, &opts);
+  if (rtn != 3 || pAvlTree) ++errors;
+  cleanupAVL(&pAvlTree);
+
+  /* Tokens, OJITEM for .length, copy of the long number, its OJITEM */
+  for (i=3; i<5; ++i) {
+    left = i;
+    rtn = readOjiAvlBuffer((const uint8_t*) longNumber, strlen(longNumber), &pAvlTree, 0, &opts);
+    if (rtn != (i < 4 ? 8 : 0)) ++errors;
+    orx_getDoubleOji(pAvlTree, "json[0]", &aScalar, &found);
+    if (found != (i == 4) || (found && aScalar != 0.25)) ++errors;
+    cleanupAVL(&pAvlTree);
+  }
+
+  /* Sink with room for all 5 leaves (b.length is one), or fewer */
+  opts.pAlloc = 0;
+  opts.pSink = &sink;
+  sink.arg = (void*) &left;
+  for (i=0; i<6; ++i) {
+    left = i;
+    rtn = readOjiAvlBuffer((const uint8_t*) doc, strlen(doc), 0, 0, &opts);
+    if (rtn != (i < 5 ? 8 : 0)) ++errors;
+  }
+
+  /* Key buffer:  first 64 bytes, then growth for the long key */
+  jsmn_init(&jp);
+  parse_rtn = jsmn_parse(&jp, doc, strlen(doc), toks, 16);
+  for (i=0; i<3; ++i) {
+    left = i;
+    rtn = dumpTokensOjiKeyBuf(&pAvlTree, (const uint8_t*) doc, toks, jp.toknext, parse_rtn
+                             , &keyBuf, &keySize, &budget, (pOJIOPTS) 0);
+    if (rtn != (i < 2 ? 8 : 0)) ++errors;
+    cleanupAVL(&pAvlTree);
+    free(keyBuf);
+    keyBuf = 0;
+    keySize = 0;
+  }
+
+  if (errors) fprintf(stderr, "testAllocFailOji:  %d errors\n", errors);
+  return errors;
+}
+
+/* Interned string payloads:  same tree, shared copies, zero-copy getter */
+static int
+testInternOji(void) {
+static const char* docs[2] =
+{ "{\"frame\":\"J2000\",\"units\":[\"km\",\"km/s\",\"km\"],\"id\":\"ORX-1\",\"n\":7,\"esc\":\"a\\\"b\""
+  ",\"obs\":[{\"frame\":\"J2000\",\"inst\":\"OCAMS\"},{\"frame\":\"ECLIPJ2000\",\"inst\":\"OCAMS\"}]}"
+, "{\"frame\":\"ECLIPJ2000\",\"units\":\"km\",\"empty\":\"\",\"also\":\"\"}"
+};
+ORXALLOC counting = { countAllocate, countReallocate, countRelease, 0 };
+OJIINTERN intern;
+OJIOPTS opts;
+pAVLTREE pPlain = 0;
+pAVLTREE pShared = 0;
+pAVLTREE pShared2 = 0;
+pAVLTREE pCopy = 0;
+pAVLTREE p1;
+pAVLTREE p2;
+const char* pRef;
+char aString[32];
+long live = 0;
+int found;
+int errors = 0;
+
+  counting.arg = (void*) &live;
+  initInternOji(&intern, &counting);
+  memset(&opts, 0, sizeof opts);
+  opts.pIntern = &intern;
+
+  /* Same keys and payloads as without interning */
+  if (readOjiAvlBuffer((const uint8_t*) docs[0], strlen(docs[0]), &pPlain, 0, 0)) ++errors;
+  if (readOjiAvlBuffer((const uint8_t*) docs[0], strlen(docs[0]), &pShared, 0, &opts)) ++errors;
+  for (p1 = firstAvl(pPlain), p2 = firstAvl(pShared); p1 && p2; p1 = nextAvl(p1), p2 = nextAvl(p2)) {
+    if (oji_comparator(p1->payload, p2->payload)) ++errors;
+    if (strcmp(((pOJITEM) p1->payload)->sPayload, ((pOJITEM) p2->payload)->sPayload)) ++errors;
+    if (((pOJITEM) p1->payload)->payloadType != ((pOJITEM) p2->payload)->payloadType) ++errors;
+  }
+  if (p1 || p2) ++errors;
+
+  /* J2000, km, km/s, ORX-1, a\"b, OCAMS, ECLIPJ2000 */
+  if (intern.count != 7 || intern.lookups != 10) ++errors;
+  if (intern.bytesSaved != sizeof "J2000" + sizeof "km" + sizeof "OCAMS") ++errors;
+
+  /* Equal strings share one copy; other types are not interned */
+  pRef = orx_getStringRefOji(pShared, "json.frame", &found);
+  if (!found || !pRef || strcmp(pRef, "J2000")) ++errors;
+  if (pRef != orx_getStringRefOji(pShared, "json.obs[0].frame", &found)) ++errors;
+  if (orx_getStringRefOji(pShared, "json.units[0]", &found) != orx_getStringRefOji(pShared, "json.units[2]", &found)) ++errors;
+  if (orx_getStringRefOji(pPlain, "json.units[0]", &found) == orx_getStringRefOji(pPlain, "json.units[2]", &found)) ++errors;
+  if (orx_getStringRefOji(pShared, "json.n", &found) || found) ++errors;
+  if (orx_getStringRefOji(pShared, "json.nosuchkey", &found) || found) ++errors;
+  orx_getStringOji(pShared, "json.esc", sizeof aString, aString, &found);
+  if (!found || strcmp(aString, "a\\\"b")) ++errors;
+
+  /* One table across loads */
+  if (readOjiAvlBuffer((const uint8_t*) docs[1], strlen(docs[1]), &pShared2, 0, &opts)) ++errors;
+  if (intern.count != 8) ++errors;
+  if (orx_getStringRefOji(pShared2, "json.frame", &found) != orx_getStringRefOji(pShared, "json.obs[1].frame", &found)) ++errors;
+  if (orx_getStringRefOji(pShared2, "json.empty", &found) != orx_getStringRefOji(pShared2, "json.also", &found)
+   || !found || *orx_getStringRefOji(pShared2, "json.also", &found)) ++errors;
+
+  /* Copies are private, so outlive the table */
+  pCopy = copyWholeOjiAvlTree(pShared);
+  cleanupAVL(&pShared);
+  cleanupAVL(&pShared2);
+  cleanupInternOji(&intern);
+  if (live != 0 || intern.count || intern.nBuckets) ++errors;
+  pRef = orx_getStringRefOji(pCopy, "json.obs[1].inst", &found);
+  if (!found || strcmp(pRef, "OCAMS")) ++errors;
+
+  cleanupAVL(&pCopy);
+  cleanupAVL(&pPlain);
+
+  if (errors) fprintf(stderr, "testInternOji:  %d errors\n", errors);
+  return errors;
+}
+
+/* Report-like corpus:  observation records whose frames, units, targets
+ * and instruments come from short lists
+ */
+static char*
+reportJsonOji(int nRecords) {
+static const char* frames[4] = { "J2000", "ECLIPJ2000", "IAU_BENNU", "ORX_SPACECRAFT" };
+static const char* units[3] = { "km", "km/s", "deg" };
+static const char* insts[5] = { "ORX_OCAMS_MAPCAM", "ORX_OCAMS_POLYCAM", "ORX_OCAMS_SAMCAM", "ORX_OLA_HIGH", "ORX_OTES" };
+char* json = malloc(nRecords * 384 + 64);
+char* p = json;
+int i;
+
+  if (!json) return 0;
+  p += sprintf(p, "{\"observations\":[");
+  for (i=0; i<nRecords; ++i) {
+    p += sprintf(p, "%s{\"id\":\"OBS-%06d\",\"target\":\"BENNU\",\"frame\":\"%s\",\"instrument\":\"%s\""
+                    ",\"position\":{\"units\":\"%s\",\"xyz\":[%d.5,%d.25,%d.125]}"
+                    ",\"velocity\":{\"units\":\"%s\",\"frame\":\"%s\",\"xyz\":[0.%d,0.%d,0.%d]}"
+                    ",\"status\":\"%s\",\"quality\":%d}"
+                , i ? "," : "", i, frames[i % 4], insts[i % 5]
+                , units[i % 2 ? 0 : 2], i, i + 1, i + 2
+                , units[1], frames[(i / 7) % 4], i, i + 3, i + 5
+                , (i % 11) ? "NOMINAL" : "DEGRADED", i % 100);
+  }
+  sprintf(p, "]}");
+  return json;
+}
+
+/* Bytes of OJITEMs, with keys and private payload copies */
+static size_t
+treeBytesOji(pAVLTREE pTree) {
+pAVLTREE pAvl;
+pOJITEM pOji;
+size_t bytes = 0;
+  for (pAvl = firstAvl(pTree); pAvl; pAvl = nextAvl(pAvl)) {
+    pOji = (pOJITEM) pAvl->payload;
+    bytes += sizeof(OJITEM) + pOji->keyLen + 1;
+    if (pOji->sPayload == pOji->keyString + pOji->keyLen + 1) { bytes += strlen(pOji->sPayload) + 1; }
+  }
+  return bytes;
+}
+
+/* Report memory saved by interning on the report-like corpus */
+static int
+benchInternOji(void) {
+char* json = reportJsonOji(2000);
+OJIINTERN intern;
+OJIOPTS opts;
+pAVLTREE pTree = 0;
+size_t plainBytes;
+size_t sharedBytes;
+double t0;
+double tPlain;
+double tShared;
+const char* pRef;
+char aString[64];
+int found;
+int i;
+int errors = 0;
+
+  if (!json) return 1;
+  memset(&opts, 0, sizeof opts);
+
+  /* Tree bytes without and with interning */
+  t0 = ojiSeconds();
+  if (readOjiAvlBuffer((const uint8_t*) json, strlen(json), &pTree, 0, &opts)) ++errors;
+  tPlain = ojiSeconds() - t0;
+  plainBytes = treeBytesOji(pTree);
+  cleanupAVL(&pTree);
+
+  initInternOji(&intern, 0);
+  opts.pIntern = &intern;
+  t0 = ojiSeconds();
+  if (readOjiAvlBuffer((const uint8_t*) json, strlen(json), &pTree, 0, &opts)) ++errors;
+  tShared = ojiSeconds() - t0;
+  sharedBytes = treeBytesOji(pTree) + intern.bytesHeld;
+
+  fprintf(stdout, "intern report corpus:  %lu strings, %lu distinct; copies saved %lu bytes, table %lu bytes"
+                  "; tree %lu -> %lu bytes (%.1f%% saved); load %.6fs -> %.6fs\n"
+         , (unsigned long) intern.lookups, (unsigned long) intern.count
+         , (unsigned long) intern.bytesSaved, (unsigned long) intern.bytesHeld
+         , (unsigned long) plainBytes, (unsigned long) sharedBytes
+         , 100.0 * ((double) plainBytes - (double) sharedBytes) / plainBytes, tPlain, tShared);
+
+  /* Zero-copy versus copying getter */
+  t0 = ojiSeconds();
+  for (i=0; i<200000; ++i) {
+    orx_getStringOji(pTree, "json.observations[1234].instrument", sizeof aString, aString, &found);
+  }
+  tPlain = ojiSeconds() - t0;
+  t0 = ojiSeconds();
+  for (i=0; i<200000; ++i) {
+    pRef = orx_getStringRefOji(pTree, "json.observations[1234].instrument", &found);
+  }
+  tShared = ojiSeconds() - t0;
+  if (!found || strcmp(pRef, aString)) ++errors;
+  fprintf(stdout, "intern getters:  orx_getStringOji %.1fns; orx_getStringRefOji %.1fns\n"
+         , tPlain * 5e3, tShared * 5e3);
+
+  cleanupAVL(&pTree);
+  cleanupInternOji(&intern);
+  free(json);
+  if (errors) fprintf(stderr, "benchInternOji:  %d errors\n", errors);
+  return errors;
+}
+
+/* Time flattening of deeply nested documents */
+static int
+benchNestedOji(void) {
+static const char* kinds[3] = { "arrays", "objects", "wide" };
+int depth = 4000;
+int kind;
+int i;
+char* json;
+char* p;
+pAVLTREE pTree;
+OJISTATS stats;
+int errors = 0;
+
+  if (!(json = malloc(depth * 64 + 64))) return 1;
+
+  for (kind=0; kind<3; ++kind) {
+    p = json;
+    for (i=0; i<depth; ++i) {
+      switch (kind) {
+      case 0: *p++ = '['; break;
+      case 1: p += sprintf(p, "{\"level%d\":", i); break;
+      default: p += sprintf(p, "[0,1,2,3,4,5,6,7,8,{\"n%d\":true,\"x\":", i); break;
+      }
+    }
+    *p++ = '1';
+    for (i=0; i<depth; ++i) {
+      p += sprintf(p, "%s", kind == 0 ? "]" : (kind == 1 ? "}" : "}]"));
+    }
+    *p = '\0';
+
+    pTree = 0;
+    memset(&stats, 0, sizeof stats);
+    if (readOjiAvlBuffer((const uint8_t*) json, strlen(json), &pTree, 0, 0)) ++errors;
+    cleanupAVL(&pTree);
+    if (readOjiAvlBuffer((const uint8_t*) json, strlen(json), &pTree, 0, &(OJIOPTS){ .pStats = &stats })) ++errors;
+    fprintf(stdout, "nested %s, depth %d:  %lu keys; dump=%.6fs; malloc=%lu; realloc=%lu\n"
+           , kinds[kind], depth, stats.avl.inserts, stats.dumpSeconds
+           , stats.mallocCount - stats.avl.inserts - 1, stats.reallocCount - (stats.parsePasses - 1));
+    cleanupAVL(&pTree);
+  }
+  free(json);
+  return errors;
+}
+
+/* Deep-path corpus:  ~20000 leaves whose keys share long prefixes */
+static char*
+deepPathJsonOji(void) {
+char* json = malloc(4 << 20);
+char* p = json;
+int i;
+int j;
+  if (!json) return json;
+  p += sprintf(p, "{\"report\":{\"spacecraft\":{\"instrument_suite\":{\"instruments\":[");
+  for (i=0; i<50; ++i) {
+    p += sprintf(p, "%s{\"name\":\"instrument%d\",\"channels\":[", i ? "," : "", i);
+    for (j=0; j<40; ++j) {
+      p += sprintf(p, "%s{\"calibration\":{\"coefficients\":[%d,1,2,3,4,5,6,7],\"temperature\":%d.5}}"
+                  , j ? "," : "", j, i);
+    }
+    p += sprintf(p, "]}");
+  }
+  sprintf(p, "]}}}}");
+  return json;
+}
+
+/* Lookup every key of pAvlTree in pLookupTree; returns seconds */
+static double
+lookupAllOji(pAVLTREE pAvlTree, pAVLTREE pLookupTree, int lcp, int* pErrors) {
+double t0 = ojiSeconds();
+pAVLTREE pAvl;
+OJITEM oji;
+void* pFound;
+  for (pAvl = firstAvl(pAvlTree); pAvl; pAvl = nextAvl(pAvl)) {
+    oji.keyString = ((pOJITEM) pAvl->payload)->keyString;
+    oji.keyLen = ((pOJITEM) pAvl->payload)->keyLen;
+    pFound = lcp ? getLcpAvl(pLookupTree, &oji, oji_lcpComparator, 0) : getAVL(pLookupTree, &oji, 0);
+    if (!pFound || strcmp(((pOJITEM) pFound)->keyString, oji.keyString)) ++*pErrors;
+  }
+  return ojiSeconds() - t0;
+}
+
+/* Time inserts and lookups with each OJIDESCENT */
+static int
+benchDescentOji(void) {
+static const char* names[3] = { "strcmp", "lcp", "memcmp" };
+pAVLTREE pTrees[3] = { 0, 0, 0 };
+char* jsons[2];
+char* p;
+int depth = 4000;
+int corpus;
+int descent;
+int i;
+OJIOPTS opts;
+OJISTATS stats;
+pAVLTREE p1;
+pAVLTREE p2;
+double tLookup;
+int errors = 0;
+
+  jsons[0] = deepPathJsonOji();
+  if (!(jsons[1] = p = malloc(depth * 64 + 64)) || !jsons[0]) return 1;
+  for (i=0; i<depth; ++i) { p += sprintf(p, "[0,1,2,3,4,5,6,7,8,{\"n%d\":true,\"x\":", i); }
+  *p++ = '1';
+  for (i=0; i<depth; ++i) { p += sprintf(p, "}]"); }
+  *p = '\0';
+
+  for (corpus=0; corpus<2; ++corpus) {
+    for (descent=OJI_DESCENT_STRCMP; descent<=OJI_DESCENT_MEMCMP; ++descent) {
+      memset(&opts, 0, sizeof opts);
+      memset(&stats, 0, sizeof stats);
+      opts.pStats = &stats;
+      opts.descent = (OJIDESCENT) descent;
+      if (readOjiAvlBuffer((const uint8_t*) jsons[corpus], strlen(jsons[corpus]), pTrees + descent, 0, &opts)) ++errors;
+      if (verifyAvl(pTrees + descent) < 0) ++errors;
+      tLookup = lookupAllOji(pTrees[descent], pTrees[descent], descent == OJI_DESCENT_LCP, &errors);
+      for (p1 = firstAvl(pTrees[descent]); p1; p1 = nextAvl(p1)) {
+        if (orx_getOji(pTrees[descent], ((pOJITEM) p1->payload)->keyString) != (pOJITEM) p1->payload) ++errors;
+      }
+      if (orx_getOji(pTrees[descent], "json.no_such_key")) ++errors;
+      fprintf(stdout, "descent %-6s %s:  %lu keys; dump=%.6fs; lookups=%.6fs\n"
+             , names[descent], corpus ? "nested wide" : "deep paths "
+             , stats.avl.inserts, stats.dumpSeconds, tLookup);
+    }
+
+    /* Same keys in the same order */
+    for (descent=1; descent<3; ++descent) {
+      for (p1 = firstAvl(pTrees[0]), p2 = firstAvl(pTrees[descent]); p1 && p2; p1 = nextAvl(p1), p2 = nextAvl(p2)) {
+        if (strcmp(((pOJITEM) p1->payload)->keyString, ((pOJITEM) p2->payload)->keyString)) ++errors;
+      }
+      if (p1 || p2) ++errors;
+    }
+    for (descent=0; descent<3; ++descent) { cleanupAVL(pTrees + descent); }
+  }
+
+  free(jsons[0]);
+  free(jsons[1]);
+  if (errors) fprintf(stderr, "benchDescentOji:  %d errors\n", errors);
+  return errors;
+}
 
 int
 main(int argc, char** argv) {
@@ -617,12 +1990,23 @@ pAVLTREE pOjiAvlTree = (pAVLTREE) NULL;
 pAVLTREE pOjiAvlTreeCopy = (pAVLTREE) NULL;
 
 void* pVoid2[2] = { (void*) stdout, (void*) &pOjiAvlTree };
+OJISTATS stats;
+int rtn = 0;
 
   while (--argc) {
-    readOjiAvl(argv[argc], &pOjiAvlTree, 0, stdout);
+    memset(&stats, 0, sizeof stats);
+    if (readOjiAvlStats(argv[argc], &pOjiAvlTree, 0, 0, &stats)) { rtn = 1; }
+    if (testAllocOji(argv[argc])) { rtn = 1; }
 
     traverseFromRightAvl(pOjiAvlTree, 0, printOjiAvl, pVoid2);
 
+    /* Sample lookup depths, then print load statistics */
+    orx_getOjiStats(pOjiAvlTree, "json.array.length", &stats);
+    orx_getOjiStats(pOjiAvlTree, "json.object.zero", &stats);
+    orx_getOjiStats(pOjiAvlTree, "json.no_such_key", &stats);
+    fprintf(stdout,"\n#######################################################################\n");
+    printOjiStats(&stats, stdout);
+
     pOjiAvlTreeCopy = copyWholeOjiAvlTree(pOjiAvlTree);
     fprintf(stdout,"\n#######################################################################\n");
 
@@ -636,6 +2020,15 @@ void* pVoid2[2] = { (void*) stdout, (void*) &pOjiAvlTree };
     cleanupAVL(&pOjiAvlTreeCopy);
   }
 
-  return 0;
+  if (testMergeOji()) { rtn = 1; }
+  if (testFilterOji()) { rtn = 1; }
+  if (testIntegerOji()) { rtn = 1; }
+  if (testInternOji()) { rtn = 1; }
+  if (testAllocFailOji()) { rtn = 1; }
+  if (benchInternOji()) { rtn = 1; }
+  if (benchNestedOji()) { rtn = 1; }
+  if (benchDescentOji()) { rtn = 1; }
+
+  return rtn;
 }
 #endif // DO_MAIN
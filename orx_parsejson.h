@@ -14,8 +14,10 @@
 #include "stdio.h"
 #include "stdlib.h"
 #include "string.h"
+#include <stdint.h>
 
 #include "avltree.h"
+#include "orx_alloc.h"
 
 
 ////////////////////////////////////////////////////////////////////////
@@ -25,6 +27,8 @@ typedef enum
 , OJI_BOOLEAN  // JSMN_PRIMITIVE; true or false
 , OJI_SCALAR   // JSMN_PRIMITIVE; [-]N[.M[e[-+]EXPONENT] floating point
 , OJI_STRING   // JSMN_STRING; "a null-terminated string in quotes"
+, OJI_INTEGER  // JSMN_PRIMITIVE; [-]N integer literal, within int64_t range
+, OJI_ENUMCOUNT  // Number of OJIENUM values above; not a payload type
 } OJIENUM;
 
 typedef enum     // Boolean
@@ -38,16 +42,22 @@ typedef struct OJITEMstr {
   int strKeyMalloced;      // Set if the pointer is direct malloc() result
   int strPayloadMalloced;  // Set if the pointer is direct malloc() result
   OJIENUM payloadType;     // Payload type (see OJIENUM above)
+  uint32_t keyLen;         // strlen(keyString), for oji_lenComparator;
+                           // OJI_KEYLEN_UNSET in a search key if unknown
+  pORXALLOC pAlloc;        // Allocator of this OJITEM; null for malloc
 
   union {                  // uPayload: union containing values
     OJIBOOL aBool;         // - single boolean; 0=false
     double aScalar;        // - single number
+    int64_t anInteger;     // - single integer
     char* aString;         // - single string pointer (Note 1)
   } uPayload;
 
   AVLTREE avltree;         // for AVL tree of multiple instances
 } OJITEM, *pOJITEM;
 
+#define OJI_KEYLEN_UNSET UINT32_MAX
+
 // Note 1:  the payload string (OJITEMstr.sPayload) and the key string
 // (OJITEMstr.keyString) will be allocated with the struct OJITEMstr,
 // and these pointers set.  the strKeyMalloced and strPayloadMalloced
@@ -58,17 +68,157 @@ typedef struct OJITEMstr {
 // to, and with, the OJITEMstr, along with space for null terminators,
 // so freeing the pOJITEM will free the space for these strings.
 
+////////////////////////////////////////////////////////////////////////
+// Optional load statistics, filled in by readOjiAvlStats
+// - all counters accumulate, so one OJISTATS may span several loads;
+//   zero it (memset) before the first use
+// - a null pOJISTATS disables all counting
+typedef struct OJISTATSstr {
+  size_t bytesRead;                      // JSON file bytes read
+  double readSeconds;                    // time in buffile_file_to_puint8
+  double tokenizeSeconds;                // time in jsmn_parse passes
+  double dumpSeconds;                    // time flattening tokens into tree
+  unsigned long tokenCount;              // JSMN tokens produced
+  unsigned long parsePasses;             // jsmn_parse calls (token doubling)
+  unsigned long skippedTokens;           // tokens dropped by key filters
+  unsigned long leafCount[OJI_ENUMCOUNT];  // OJITEMs by OJIENUM payloadType
+  unsigned long mallocCount;             // malloc calls
+  unsigned long reallocCount;            // realloc calls
+  size_t allocBytes;                     // total bytes requested
+  AVLSTATS avl;                          // insertAvl and lookup counters
+} OJISTATS, *pOJISTATS;
+
+// Statistics statement wrapper; compiled out with -DAVL_NO_STATS
+#define OJISTAT(P,STMT) AVLSTAT(P,STMT)
+
+void printOjiStats(pOJISTATS pStats, FILE* fOut);
+
+////////////////////////////////////////////////////////////////////////
+// Leaf handler, to send flattened leaves somewhere other than an OJI AVL
+// tree; called once per JSON leaf (and per array .length) with
+// - pLocalOji->keyString:  full key, e.g. "json.a.b[3]", null-terminated
+// - pLocalOji->sPayload:  JSON text of value, NOT null-terminated
+// - pLocalOji->payloadType and ->uPayload:  decoded value
+// - lenStrJson:  length of JSON text at pLocalOji->sPayload
+// The handler must copy anything it keeps, and returns a negative value
+// if it could not (e.g. failed allocation); the load then carries on,
+// and returns 8 to flag the destination as incomplete
+// - a null leaf handler inserts leaves into the OJI AVL tree as usual
+//
+// The optional container handler is offered each array and object before
+// it is flattened, with keyString holding the container's key and pToks
+// pointing to its (const jsmntok_t) token
+// - it returns the number of tokens it consumed (see countTokensOji), so
+//   flattening skips them, or 0 to let flattening proceed as usual
+typedef struct OJISINKstr {
+  int (*leaf)(struct OJISINKstr* pSink, pOJITEM pLocalOji, int lenStrJson);
+  int (*container)(struct OJISINKstr* pSink, const char* keyString, const uint8_t* json_buffer, const void* pToks);
+  void* arg;               // Handler data, e.g. destination container
+} OJISINK, *pOJISINK;
+
+////////////////////////////////////////////////////////////////////////
+// String interning table, for OJIOPTS.pIntern
+// - OJI_STRING leaves loaded with a table point ->sPayload (and
+//   ->uPayload.aString) at one shared, immutable copy of each distinct
+//   string, held by the table, instead of a private copy after the key;
+//   other payload types, and leaves passed to an OJISINK, are unchanged
+// - the table must outlive the trees loaded with it:  cleanupAVL them,
+//   then cleanupInternOji; one table may serve several loads
+// - not thread-safe; use one table per thread, or per load
+typedef struct OJIINTERNstr {
+  struct OJIINTERNSTRstr** ppBuckets;
+  size_t nBuckets;         // 0, or a power of 2
+  size_t count;            // Distinct strings held
+  pORXALLOC pAlloc;        // Allocator of buckets and strings; null for malloc
+  size_t lookups;          // Statistics:  strings offered to internOji
+  size_t bytesHeld;        // Statistics:  bytes allocated by the table
+  size_t bytesSaved;       // Statistics:  bytes of private copies not made
+} OJIINTERN, *pOJIINTERN;
+
+void initInternOji(pOJIINTERN pIntern, pORXALLOC pAlloc);
+const char* internOji(pOJIINTERN pIntern, const char* text, size_t len);
+void cleanupInternOji(pOJIINTERN pIntern);
+
+////////////////////////////////////////////////////////////////////////
+// Optional load settings for the *Opts and *Buffer entry points
+// - a zeroed (memset) OJIOPTS, or a null pOJIOPTS, gives the behavior
+//   of readOjiAvl
+//
+// Key filters:  only keys that pass all filters are loaded
+// - includePrefixes:  null-terminated list of keys, e.g. "json.header";
+//   a key passes if it is one of them, or is below one of them ("." or
+//   "[" follows the prefix); a null list passes every key
+// - excludePrefixes:  likewise; keys at or below any of these fail
+// - keyFilter:  called with each container and leaf key that passed the
+//   lists; returns non-zero to keep the key
+// A container that fails, and is not an ancestor of an included prefix,
+// is skipped at the token level:  no keys are built, no numbers are
+// decoded and nothing is allocated for anything in it
+//
+// Descent:  how inserts compare keys on the way down the AVLTREE; all
+// give the same order, and the same tree
+// - OJI_DESCENT_STRCMP:  oji_comparator (strcmp) from the first byte
+// - OJI_DESCENT_LCP:  oji_lcpComparator, skipping the prefix common to
+//   the nearest smaller and larger keys already passed (insertLcpAvl)
+// - OJI_DESCENT_MEMCMP:  nodes get oji_lenComparator, i.e. memcmp of
+//   OJITEM.keyLen bytes, also used by later lookups with getAVL
+typedef enum
+{ OJI_DESCENT_STRCMP=0
+, OJI_DESCENT_LCP
+, OJI_DESCENT_MEMCMP
+} OJIDESCENT;
+
+typedef struct OJIOPTSstr {
+  pOJISTATS pStats;        // Load statistics; null disables counting
+  pOJISINK pSink;          // Leaf handler; null inserts OJITEMs into tree
+  pORXALLOC pAlloc;        // Allocator for buffers and OJITEMs; null for malloc
+  const char** includePrefixes;  // Null-terminated; null loads all keys
+  const char** excludePrefixes;  // Null-terminated; null excludes none
+  int (*keyFilter)(void* filterArg, const char* keyString, int isContainer);
+  void* filterArg;
+  OJIDESCENT descent;      // Insert key comparisons; see above
+  pOJIINTERN pIntern;      // Shared string payloads; null for private copies
+} OJIOPTS, *pOJIOPTS;
+
+int oji_comparator(const void* payload1, const void* payload2);
+int oji_lcpComparator(const void* payload1, const void* payload2, size_t* pLcp);
+int oji_lenComparator(const void* payload1, const void* payload2);
+void cleanupOji(void* pPayload);
 pOJITEM newOji(pOJITEM pSource, char* keyPrefix, int lenStrJson);
+pOJITEM newOjiAlloc(pOJITEM pSource, char* keyPrefix, int lenStrJson, pORXALLOC pAlloc);
+void decodeLeafOji(pOJITEM pOji, int isString, int lenStrJson);
+int parseIntOji(const char* s, size_t len, int64_t* pValue);
+int formatIntOji(long long value, char* pOut);
 void printOjiPayload(pOJITEM pOji, FILE* fOut, char* pfxArg);
 void printOjiAvl(pAVLTREE pAvl, int level, void** args);
 
+pOJITEM orx_getOji(pAVLTREE pAvlRoot, char* searchKeyString);
+pOJITEM orx_getOjiStats(pAVLTREE pAvlRoot, char* searchKeyString, pOJISTATS pStats);
+
+int orx_copyOutOji(OJIENUM payloadType, const void* pPayload, const char* pText, void *pOut, OJIENUM requestedOjiType, int stringOutSize);
 void orx_getAnyOji(pAVLTREE pAvlRoot, char* searchKeyString, void *pOut, int *pFound, OJIENUM requestedOjiType, int stringOutSize);
 
 void orx_getNullOji(pAVLTREE pAvlRoot, char* searchKeyString, int* pFound);
 void orx_getDoubleOji(pAVLTREE pAvlRoot, char* searchKeyString, double* pOut, int* pFound);
+void orx_getInt64Oji(pAVLTREE pAvlRoot, char* searchKeyString, int64_t* pOut, int* pFound);
+void orx_getInt32Oji(pAVLTREE pAvlRoot, char* searchKeyString, int32_t* pOut, int* pFound);
 void orx_getBooleanOji(pAVLTREE pAvlRoot, char* searchKeyString, OJIBOOL* pOut, int* pFound);
 void orx_getStringOji(pAVLTREE pAvlRoot, char* searchKeyString, int stringOutSize, char* pOut, int* pFound);
+const char* orx_getStringRefOji(pAVLTREE pAvlRoot, char* searchKeyString, int* pFound);
+
+double ojiSeconds(void);
 
 int readOjiAvl(char* filepath, ppAVLTREE ppAvlTree, char* pfx, FILE *fOut);
+int readOjiAvlStats(char* filepath, ppAVLTREE ppAvlTree, char* pfx, FILE *fOut, pOJISTATS pStats);
+int readOjiAvlOpts(char* filepath, ppAVLTREE ppAvlTree, char* pfx, FILE *fOut, pOJIOPTS pOpts);
+int readOjiAvlBuffer(const uint8_t* json_buffer, size_t json_len, ppAVLTREE ppAvlTree, char* pfx, pOJIOPTS pOpts);
+
+// Token-level entry point; declared only where jsmn.h is also included
+#ifdef __JSMN_H_
+int countTokensOji(const jsmntok_t* pToks);
+int dumpTokensOjiAvl(ppAVLTREE ppAvlTree, const uint8_t* json_buffer, jsmntok_t* pToks, unsigned int ntoks, int parse_rtn, char* pfx, pOJIOPTS pOpts);
+int dumpTokensOjiKeyBuf(ppAVLTREE ppAvlTree, const uint8_t* json_buffer, jsmntok_t* pToks, unsigned int ntoks, int parse_rtn, char** ppKeyBuf, size_t* pKeySize, pORXALLOC pKeyAlloc, pOJIOPTS pOpts);
+int jsmn_dump_to_avl(ppAVLTREE ppAvlTree, const uint8_t* json_buffer, jsmntok_t* pToks, size_t count, char* pKeypfx, size_t keyPfxSize, pOJIOPTS pOpts);
+#endif
 
 #endif // __ORX_PARSEJSON_H__
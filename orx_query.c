@@ -0,0 +1,488 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "orx_query.h"
+
+
+/**********************************************************************/
+/* One pattern segment, following the literal key prefix */
+typedef enum
+{ QSEG_NAME        // .name
+, QSEG_ANYNAME     // .*
+, QSEG_SLICE       // [*], [n], [lo:hi]
+} QSEGTYPE;
+
+typedef struct QSEGstr {
+  QSEGTYPE type;
+  const char* name;        // QSEG_NAME:  points into ORXQUERY.text
+  int lenName;
+  long lo;                 // QSEG_SLICE:  first index
+  long hi;                 // QSEG_SLICE:  last index + 1, or -1 for no limit
+} QSEG, *pQSEG;
+
+/* Compiled query */
+struct ORXQUERYstr {
+  char* text;              // Copy of query string
+  char* prefix;            // Literal key prefix, before first wildcard
+  int lenPrefix;
+  int nSegs;               // Pattern segments after prefix
+  QSEG* segs;
+};
+
+/* Number of matches held on the stack before sorting needs malloc */
+#define QUERY_LOCAL_ITEMS 256
+
+
+/**********************************************************************/
+/* Free a compiled query */
+void
+orx_freeQuery(pORXQUERY pQuery) {
+  if (!pQuery) return;
+  if (pQuery->text) { free(pQuery->text); }
+  if (pQuery->prefix) { free(pQuery->prefix); }
+  if (pQuery->segs) { free(pQuery->segs); }
+  free(pQuery);
+  return;
+}
+
+
+/**********************************************************************/
+/* Parse an unsigned decimal index; return number of digits, or -1 if
+ * the index would exceed LONG_MAX
+ */
+static int
+queryDigits(const char* p, long* pValue) {
+int n = 0;
+int digit;
+  *pValue = 0;
+  while (p[n] >= '0' && p[n] <= '9') {
+    digit = p[n++] - '0';
+    if (*pValue > (LONG_MAX - digit) / 10) return -1;
+    *pValue = (*pValue * 10) + digit;
+  }
+  return n;
+}
+
+
+/**********************************************************************/
+/* Compile query string; return null on syntax error */
+pORXQUERY
+orx_compileQuery(const char* queryString) {
+pORXQUERY pQuery;
+QSEG* pAll;
+int nAll = 0;
+int iFirstWild = -1;
+int i;
+int n;
+size_t lenPfx;
+char* p;
+char* pPfx;
+
+  if (!queryString || !*queryString) return 0;
+  if (!(pQuery = calloc(1, sizeof(ORXQUERY)))) return 0;
+
+# define QUERY_FAIL { orx_freeQuery(pQuery); return 0; }
+
+  /* One segment per character is an upper bound */
+  if (!(pQuery->text = strdup(queryString))) QUERY_FAIL
+  if (!(pQuery->segs = calloc(strlen(queryString) + 1, sizeof(QSEG)))) QUERY_FAIL
+  pAll = pQuery->segs;
+
+  /* Root name, e.g. "json" */
+  p = pQuery->text;
+  n = strcspn(p, ".[");
+  if (n == 0) QUERY_FAIL
+  pAll[nAll].type = QSEG_NAME;
+  pAll[nAll].name = p;
+  pAll[nAll++].lenName = n;
+  p += n;
+
+  while (*p) {
+  pQSEG pSeg = pAll + nAll;
+
+    if (*p == '.') {
+      ++p;
+      n = strcspn(p, ".[");
+      if (n == 0) QUERY_FAIL
+      if (n == 1 && *p == '*') {
+        pSeg->type = QSEG_ANYNAME;
+      } else {
+        pSeg->type = QSEG_NAME;
+        pSeg->name = p;
+        pSeg->lenName = n;
+      }
+      p += n;
+
+    } else if (*p == '[') {
+      ++p;
+      pSeg->type = QSEG_SLICE;
+      pSeg->lo = 0;
+      pSeg->hi = -1;
+      if (*p == '*') {
+        ++p;
+      } else {
+        if ((n = queryDigits(p, &pSeg->lo)) < 0) QUERY_FAIL
+        p += n;
+        if (*p == ':') {
+          ++p;
+          if ((n = queryDigits(p, &pSeg->hi)) < 0) QUERY_FAIL
+          if (!n) { pSeg->hi = -1; }
+          p += n;
+        } else if (n) {
+          /* Literal index:  slice of one */
+          pSeg->hi = pSeg->lo + 1;
+        } else {
+          QUERY_FAIL
+        }
+      }
+      if (*p != ']') QUERY_FAIL
+      ++p;
+
+    } else {
+      QUERY_FAIL
+    }
+
+    /* First wildcard ends the literal prefix */
+    if (iFirstWild < 0
+     && (pSeg->type == QSEG_ANYNAME
+     || (pSeg->type == QSEG_SLICE && pSeg->hi != pSeg->lo + 1))) {
+      iFirstWild = nAll;
+    }
+    ++nAll;
+  }
+  if (iFirstWild < 0) iFirstWild = nAll;
+
+  /* Render literal segments as key prefix */
+  lenPfx = 0;
+  for (i=0; i<iFirstWild; ++i) {
+    lenPfx += (pAll[i].type == QSEG_NAME) ? (1 + pAll[i].lenName) : 24;
+  }
+  if (!(pQuery->prefix = pPfx = malloc(lenPfx + 1))) QUERY_FAIL
+  for (i=0; i<iFirstWild; ++i) {
+    if (pAll[i].type == QSEG_NAME) {
+      if (i) { *pPfx++ = '.'; }
+      memcpy(pPfx, pAll[i].name, pAll[i].lenName);
+      pPfx += pAll[i].lenName;
+    } else {
+      pPfx += sprintf(pPfx, "[%ld]", pAll[i].lo);
+    }
+  }
+  *pPfx = '\0';
+  pQuery->lenPrefix = pPfx - pQuery->prefix;
+
+  /* Keep only pattern segments */
+  pQuery->nSegs = nAll - iFirstWild;
+  memmove(pQuery->segs, pAll + iFirstWild, pQuery->nSegs * sizeof(QSEG));
+
+  return pQuery;
+} /* orx_compileQuery(const char* queryString) */
+
+
+/**********************************************************************/
+/* Match remainder of key, after literal prefix, against pattern */
+static int
+matchQuery(pORXQUERY pQuery, const char* s) {
+int iSeg;
+long idx;
+int n;
+pQSEG pSeg;
+
+  for (iSeg=0; iSeg<pQuery->nSegs; ++iSeg) {
+    pSeg = pQuery->segs + iSeg;
+    switch (pSeg->type) {
+
+    case QSEG_NAME:
+      if (*s++ != '.') return 0;
+      if (strncmp(s, pSeg->name, pSeg->lenName)) return 0;
+      s += pSeg->lenName;
+      if (*s && *s != '.' && *s != '[') return 0;
+      break;
+
+    case QSEG_ANYNAME:
+      if (*s++ != '.') return 0;
+      if (!(n = strcspn(s, ".["))) return 0;
+      s += n;
+      break;
+
+    case QSEG_SLICE:
+      if (*s++ != '[') return 0;
+      if ((n = queryDigits(s, &idx)) <= 0) return 0;
+      s += n;
+      if (*s++ != ']') return 0;
+      if (idx < pSeg->lo) return 0;
+      if (pSeg->hi >= 0 && idx >= pSeg->hi) return 0;
+      break;
+    }
+  }
+  /* Leaf keys only */
+  return *s ? 0 : 1;
+} /* matchQuery(pORXQUERY pQuery, const char* s) */
+
+
+/**********************************************************************/
+/* Visit matching OJITEMs in key (strcmp) order
+ * - handler may be null, to count matches only
+ * - returns number of matches, or -1 if pQuery is null
+ */
+int
+orx_queryVisitOji(pAVLTREE pAvlRoot, pORXQUERY pQuery, void (*handler)(pOJITEM, void*), void* arg) {
+OJITEM oji;
+pAVLTREE pAvl;
+pOJITEM pOji;
+int count = 0;
+
+  if (!pQuery) return -1;
+
+  /* Ordered range scan over keys starting with the literal prefix */
+  oji.keyString = pQuery->prefix;
+  oji.keyLen = (uint32_t) strlen(pQuery->prefix);
+  for (pAvl = lowerBoundAvl(pAvlRoot, &oji); pAvl; pAvl = nextAvl(pAvl)) {
+    pOji = (pOJITEM) pAvl->payload;
+    if (strncmp(pOji->keyString, pQuery->prefix, pQuery->lenPrefix)) break;
+    if (!matchQuery(pQuery, pOji->keyString + pQuery->lenPrefix)) continue;
+    ++count;
+    if (handler) { handler(pOji, arg); }
+  }
+  return count;
+} /* orx_queryVisitOji(...) */
+
+
+/**********************************************************************/
+/* Natural key order:  as strcmp, except that bracketed indices of
+ * different lengths compare by length, i.e. numerically
+ */
+static int
+naturalCompare(const char* a, const char* b) {
+size_t la;
+size_t lb;
+  for (;;) {
+    if (*a != *b) return (unsigned char) *a - (unsigned char) *b;
+    if (!*a) return 0;
+    if (*a == '[') {
+      la = strspn(a+1, "0123456789");
+      lb = strspn(b+1, "0123456789");
+      if (la && lb && la != lb) return la < lb ? -1 : 1;
+    }
+    ++a;
+    ++b;
+  }
+}
+static int
+naturalCompareOji(const void* p1, const void* p2) {
+  return naturalCompare((*(pOJITEM*)p1)->keyString, (*(pOJITEM*)p2)->keyString);
+}
+
+
+/**********************************************************************/
+/* Collect matches of one type (or any, if wantType < 0) in natural order
+ * - OJI_SCALAR also collects OJI_INTEGER, for widening to double
+ */
+typedef struct QUERYLISTstr {
+  int wantType;
+  int n;
+  int limit;
+  int failed;
+  pOJITEM* items;
+  pOJITEM local[QUERY_LOCAL_ITEMS];
+} QUERYLIST, *pQUERYLIST;
+
+static void
+addQueryList(pOJITEM pOji, void* arg) {
+pQUERYLIST pList = (pQUERYLIST) arg;
+pOJITEM* pNew;
+  if (pList->wantType >= 0 && pOji->payloadType != (OJIENUM) pList->wantType
+   && !(pList->wantType == OJI_SCALAR && pOji->payloadType == OJI_INTEGER)) return;
+  if (pList->n == pList->limit) {
+    pNew = malloc(2 * pList->limit * sizeof(pOJITEM));
+    if (!pNew) { pList->failed = 1; return; }
+    memcpy(pNew, pList->items, pList->n * sizeof(pOJITEM));
+    if (pList->items != pList->local) { free(pList->items); }
+    pList->items = pNew;
+    pList->limit *= 2;
+  }
+  pList->items[pList->n++] = pOji;
+  return;
+}
+
+static int
+collectQuery(pAVLTREE pAvlRoot, pORXQUERY pQuery, int wantType, pQUERYLIST pList) {
+  pList->wantType = wantType;
+  pList->n = 0;
+  pList->limit = QUERY_LOCAL_ITEMS;
+  pList->failed = 0;
+  pList->items = pList->local;
+  if (orx_queryVisitOji(pAvlRoot, pQuery, addQueryList, pList) < 0) return -1;
+  if (pList->failed) return -1;
+  qsort(pList->items, pList->n, sizeof(pOJITEM), naturalCompareOji);
+  return pList->n;
+}
+
+static void
+freeQueryList(pQUERYLIST pList) {
+  if (pList->items != pList->local) { free(pList->items); }
+  return;
+}
+
+
+/**********************************************************************/
+/* Write up to maxOut matching OJITEM pointers to pOut, in natural order
+ * - returns total number of matches (may exceed maxOut), or -1 on error
+ */
+int
+orx_queryOji(pAVLTREE pAvlRoot, pORXQUERY pQuery, pOJITEM* pOut, int maxOut) {
+QUERYLIST list;
+int n = collectQuery(pAvlRoot, pQuery, -1, &list);
+int i;
+  for (i=0; pOut && i<n && i<maxOut; ++i) { pOut[i] = list.items[i]; }
+  freeQueryList(&list);
+  return n;
+}
+
+
+/**********************************************************************/
+/* Typed extraction, in natural order, of matches of one OJIENUM type
+ * - writes up to maxOut values to pOut
+ * - returns total number of matches of that type, or -1 on error
+ */
+int
+orx_queryDoubleOji(pAVLTREE pAvlRoot, pORXQUERY pQuery, double* pOut, int maxOut) {
+QUERYLIST list;
+int n = collectQuery(pAvlRoot, pQuery, OJI_SCALAR, &list);
+int i;
+  for (i=0; pOut && i<n && i<maxOut; ++i) {
+    pOut[i] = list.items[i]->payloadType == OJI_INTEGER
+            ? (double) list.items[i]->uPayload.anInteger : list.items[i]->uPayload.aScalar;
+  }
+  freeQueryList(&list);
+  return n;
+}
+int
+orx_queryBooleanOji(pAVLTREE pAvlRoot, pORXQUERY pQuery, OJIBOOL* pOut, int maxOut) {
+QUERYLIST list;
+int n = collectQuery(pAvlRoot, pQuery, OJI_BOOLEAN, &list);
+int i;
+  for (i=0; pOut && i<n && i<maxOut; ++i) { pOut[i] = list.items[i]->uPayload.aBool; }
+  freeQueryList(&list);
+  return n;
+}
+// - pOut points to first char of an array of char[maxOut][stringOutSize]
+int
+orx_queryStringOji(pAVLTREE pAvlRoot, pORXQUERY pQuery, int stringOutSize, char* pOut, int maxOut) {
+QUERYLIST list;
+int n = collectQuery(pAvlRoot, pQuery, OJI_STRING, &list);
+int i;
+char* pStringOut;
+  for (i=0; pOut && stringOutSize > 0 && i<n && i<maxOut; ++i) {
+    pStringOut = pOut + ((size_t) i * stringOutSize);
+    strncpy(pStringOut, list.items[i]->uPayload.aString, stringOutSize);
+    pStringOut[stringOutSize-1] = '\0';
+  }
+  freeQueryList(&list);
+  return n;
+}
+/**********************************************************************/
+/*** End of library functions ****************************************/
+/**********************************************************************/
+
+
+#ifdef DO_MAIN
+/**********************************************************************/
+/*** Test program ***/
+/*
+ * Usage:
+ *
+ *   ./test_orx_query minimal.json
+ *
+ * Compile and link:
+ *
+ *  % gcc -DDO_MAIN orx_query.c -o test_orx_query
+ *
+ */
+#include "jsmn.c"
+#include "avltree.c"
+#define main MAIN_BUFFILE
+#include "buffer_file.c"
+#undef main
+#undef DO_MAIN
+#include "orx_parsejson.c"
+#define DO_MAIN
+
+#include "orx_test.h"
+
+int
+main(int argc, char** argv) {
+pAVLTREE pOjiAvlTree = 0;
+pORXQUERY pQuery;
+pOJITEM items[32];
+double d[32];
+char s[4][16];
+char json[4096];
+char* p;
+int i;
+int n;
+
+  /* Queries on minimal.json */
+  if (argc < 2 || readOjiAvl(argv[1], &pOjiAvlTree, 0, 0)) return 1;
+
+  pQuery = orx_compileQuery("json.array[*]");
+  CHECK(orx_queryOji(pOjiAvlTree, pQuery, items, 32) == 8);
+  CHECK(!strcmp(items[7]->keyString, "json.array[7]"));
+  CHECK(orx_queryDoubleOji(pOjiAvlTree, pQuery, d, 32) == 4);
+  CHECK(d[0] == 0.0 && d[1] == -999.0 && d[2] == 120.0);
+  CHECK(orx_queryStringOji(pOjiAvlTree, pQuery, 16, s[0], 4) == 1 && !strcmp(s[0], "string"));
+  orx_freeQuery(pQuery);
+
+  pQuery = orx_compileQuery("json.array[1:3]");
+  CHECK(orx_queryDoubleOji(pOjiAvlTree, pQuery, d, 32) == 2 && d[1] == -999.0);
+  orx_freeQuery(pQuery);
+
+  pQuery = orx_compileQuery("json.object.*");
+  CHECK(orx_queryOji(pOjiAvlTree, pQuery, items, 32) == 8);
+  CHECK(!strcmp(items[0]->keyString, "json.object.false_bool"));
+  orx_freeQuery(pQuery);
+
+  pQuery = orx_compileQuery("json.object.zero");
+  CHECK(orx_queryDoubleOji(pOjiAvlTree, pQuery, d, 32) == 1 && d[0] == 0.0);
+  orx_freeQuery(pQuery);
+
+  CHECK(!orx_compileQuery("json..x"));
+  CHECK(!orx_compileQuery("json[x]"));
+  CHECK(!orx_compileQuery("json.a[1"));
+  CHECK(!orx_compileQuery("json.a[99999999999999999999]"));
+  CHECK(!orx_compileQuery("json.a[1:99999999999999999999]"));
+  CHECK(!orx_compileQuery("json.a[99999999999999999999:]"));
+  cleanupAVL(&pOjiAvlTree);
+
+  /* Natural order over more than ten elements, with other fields mixed in */
+  p = json + sprintf(json, "{\"m\":[");
+  for (i=0; i<25; ++i) {
+    p += sprintf(p, "%s{\"range\":%d,\"rangeX\":-1,\"id\":\"r%d\"}", i ? "," : "", i * 10, i);
+  }
+  sprintf(p, "],\"n\":[[1,2],[3,4]]}");
+  CHECK(!readOjiAvlBuffer((uint8_t*) json, strlen(json), &pOjiAvlTree, 0, 0));
+
+  pQuery = orx_compileQuery("json.m[*].range");
+  CHECK((n = orx_queryDoubleOji(pOjiAvlTree, pQuery, d, 32)) == 25);
+  for (i=0; i<n; ++i) { CHECK(d[i] == i * 10.0); }
+  orx_freeQuery(pQuery);
+
+  pQuery = orx_compileQuery("json.m[8:12].range");
+  CHECK(orx_queryDoubleOji(pOjiAvlTree, pQuery, d, 32) == 4 && d[0] == 80.0 && d[3] == 110.0);
+  orx_freeQuery(pQuery);
+
+  pQuery = orx_compileQuery("json.m[20:].id");
+  CHECK(orx_queryStringOji(pOjiAvlTree, pQuery, 16, s[0], 4) == 5 && !strcmp(s[3], "r23"));
+  orx_freeQuery(pQuery);
+
+  pQuery = orx_compileQuery("json.n[*][1]");
+  CHECK(orx_queryDoubleOji(pOjiAvlTree, pQuery, d, 32) == 2 && d[0] == 2.0 && d[1] == 4.0);
+  orx_freeQuery(pQuery);
+
+  cleanupAVL(&pOjiAvlTree);
+
+  fprintf(stdout, "test_orx_query:  %s\n", errors ? "FAILED" : "OK");
+  return errors ? 1 : 0;
+}
+#endif // DO_MAIN
@@ -0,0 +1,38 @@
+////////////////////////////////////////////////////////////////////////
+// Compiled path queries over flattened OJI keys
+//
+// Query syntax follows the flattened key syntax, plus wildcards:
+//
+//   json.measurements[*].range   every element of an array
+//   json.measurements[2:5].range elements 2, 3 and 4 (half-open slice)
+//   json.measurements[:3]        elements 0 to 2; [3:] is 3 to the end
+//   json.object.*                every member name of an object
+//
+// - The literal part of a query before its first wildcard becomes a key
+//   prefix; evaluation is one ordered range scan over keys with that
+//   prefix (lowerBoundAvl then nextAvl), with no per-index lookups
+// - Only leaf keys are matched, i.e. wildcards do not descend further
+//   than the query does
+// - Results of orx_queryOji and the typed getters are in natural order:
+//   array indices compare numerically, so [2] comes before [10]
+//
+////////////////////////////////////////////////////////////////////////
+#ifndef __ORX_QUERY_H__
+#define __ORX_QUERY_H__
+
+#include "orx_parsejson.h"
+
+typedef struct ORXQUERYstr ORXQUERY, *pORXQUERY;
+
+pORXQUERY orx_compileQuery(const char* queryString);
+void orx_freeQuery(pORXQUERY pQuery);
+
+int orx_queryVisitOji(pAVLTREE pAvlRoot, pORXQUERY pQuery, void (*handler)(pOJITEM, void*), void* arg);
+int orx_queryOji(pAVLTREE pAvlRoot, pORXQUERY pQuery, pOJITEM* pOut, int maxOut);
+
+// Typed extraction; only matches of the requested type are counted
+int orx_queryDoubleOji(pAVLTREE pAvlRoot, pORXQUERY pQuery, double* pOut, int maxOut);
+int orx_queryBooleanOji(pAVLTREE pAvlRoot, pORXQUERY pQuery, OJIBOOL* pOut, int maxOut);
+int orx_queryStringOji(pAVLTREE pAvlRoot, pORXQUERY pQuery, int stringOutSize, char* pOut, int maxOut);
+
+#endif // __ORX_QUERY_H__
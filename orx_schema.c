@@ -0,0 +1,602 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
+
+#include "jsmn.h"
+#include "orx_schema.h"
+
+
+/**********************************************************************/
+/* Sort helper:  a field's keyString and table index, so that qsort
+ * needs no state outside the array, and schemas compile concurrently
+ */
+typedef struct OJIFIELDSORTstr {
+  const char* keyString;
+  int index;
+} OJIFIELDSORT, *pOJIFIELDSORT;
+
+static int
+compareFieldSortOji(const void* p1, const void* p2) {
+  return strcmp(((const OJIFIELDSORT*)p1)->keyString, ((const OJIFIELDSORT*)p2)->keyString);
+}
+
+
+/**********************************************************************/
+/* Compile schema:  copy and sort field table
+ * - returns 0 on success; 1 on allocation failure; 2 on null or
+ *   duplicate keyString
+ */
+int
+compileSchemaOji(pOJISCHEMA pSchema, const OJIFIELD* fields, int nFields) {
+pOJIFIELDSORT pSort;
+int* order;
+int i;
+
+  if (!pSchema) return 1;
+  pSchema->fields = 0;
+  pSchema->tableIndex = 0;
+  pSchema->nFields = 0;
+
+  for (i=0; i<nFields; ++i) {
+    if (!fields[i].keyString) return 2;
+  }
+
+  if (!(pSort = malloc((nFields ? nFields : 1) * sizeof(OJIFIELDSORT)))) return 1;
+  if (!(order = malloc((nFields ? nFields : 1) * sizeof(int)))) {
+    free(pSort);
+    return 1;
+  }
+  if (!(pSchema->fields = malloc((nFields ? nFields : 1) * sizeof(OJIFIELD)))) {
+    free(pSort);
+    free(order);
+    return 1;
+  }
+
+  for (i=0; i<nFields; ++i) {
+    pSort[i].keyString = fields[i].keyString;
+    pSort[i].index = i;
+  }
+  qsort(pSort, nFields, sizeof(OJIFIELDSORT), compareFieldSortOji);
+  for (i=0; i<nFields; ++i) { order[i] = pSort[i].index; }
+  free(pSort);
+
+  for (i=0; i<nFields; ++i) {
+    pSchema->fields[i] = fields[order[i]];
+    if (i && !strcmp(pSchema->fields[i-1].keyString, pSchema->fields[i].keyString)) {
+      free(order);
+      cleanupSchemaOji(pSchema);
+      return 2;
+    }
+  }
+
+  pSchema->tableIndex = order;
+  pSchema->nFields = nFields;
+  return 0;
+}
+
+void
+cleanupSchemaOji(pOJISCHEMA pSchema) {
+  if (!pSchema) return;
+  if (pSchema->fields) { free(pSchema->fields); }
+  if (pSchema->tableIndex) { free(pSchema->tableIndex); }
+  pSchema->fields = 0;
+  pSchema->tableIndex = 0;
+  pSchema->nFields = 0;
+  return;
+}
+
+
+/**********************************************************************/
+/* Compare fieldKey with the string key[0..lenKey) followed by c, or
+ * by nothing if c is zero; only the first lenKey(+1) characters of
+ * fieldKey matter if prefixOnly is set
+ */
+static int
+compareKeyOji(const char* fieldKey, const char* key, size_t lenKey, char c, int prefixOnly) {
+int cmp = strncmp(fieldKey, key, lenKey);
+  if (cmp) return cmp;
+  fieldKey += lenKey;
+  if (c) {
+    if (*fieldKey != c) return (unsigned char) *fieldKey - (unsigned char) c;
+    ++fieldKey;
+  }
+  return (prefixOnly || !*fieldKey) ? 0 : 1;
+}
+
+/* Index of first field not less than key + c, with prefix comparison */
+static int
+lowerBoundSchemaOji(pOJISCHEMA pSchema, const char* key, size_t lenKey, char c) {
+int lo = 0;
+int hi = pSchema->nFields;
+int mid;
+  while (lo < hi) {
+    mid = (lo + hi) >> 1;
+    if (compareKeyOji(pSchema->fields[mid].keyString, key, lenKey, c, 0) < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+/* Index of field with keyString key, or -1 */
+static int
+findFieldOji(pOJISCHEMA pSchema, const char* key, size_t lenKey) {
+int i = lowerBoundSchemaOji(pSchema, key, lenKey, 0);
+  if (i < pSchema->nFields && !compareKeyOji(pSchema->fields[i].keyString, key, lenKey, 0, 0)) {
+    return i;
+  }
+  return -1;
+}
+
+/* Non-zero if any field key starts with key + c */
+static int
+hasPrefixOji(pOJISCHEMA pSchema, const char* key, size_t lenKey, char c) {
+int i = lowerBoundSchemaOji(pSchema, key, lenKey, c);
+  return i < pSchema->nFields && !compareKeyOji(pSchema->fields[i].keyString, key, lenKey, c, 1);
+}
+
+
+/**********************************************************************/
+/* Integer value of a leaf; returns 0 on success
+ * - exact for OJI_INTEGER; otherwise the decoded double must be integral
+ */
+static int
+leafIntegerOji(pOJITEM pLocalOji, long long* pValue) {
+double d;
+
+  if (pLocalOji->payloadType == OJI_INTEGER) {
+    *pValue = pLocalOji->uPayload.anInteger;
+    return 0;
+  }
+  if (pLocalOji->payloadType != OJI_SCALAR) return 1;
+
+  d = pLocalOji->uPayload.aScalar;
+  if (d != floor(d) || d < -9223372036854775808.0 || d >= 9223372036854775808.0) return 1;
+  *pValue = (long long) d;
+  return 0;
+}
+
+
+/**********************************************************************/
+/* OJISINK leaf handler:  fill member of schema field with this key */
+static int
+schemaLeafOji(pOJISINK pSink, pOJITEM pLocalOji, int lenStrJson) {
+pOJISCHEMAFILL pFill = (pOJISCHEMAFILL) pSink->arg;
+pOJISCHEMA pSchema = pFill->pSchema;
+int i = findFieldOji(pSchema, pLocalOji->keyString, strlen(pLocalOji->keyString));
+pOJIFIELD pField;
+unsigned char* pStatus;
+char* pMember;
+long long value;
+
+  if (i < 0) return 0;
+
+  pField = pSchema->fields + i;
+  pStatus = pFill->status + pSchema->tableIndex[i];
+  pMember = (char*) pFill->pStruct + pField->offset;
+
+  if (pLocalOji->payloadType == OJI_NULL) {
+    *pStatus = OJIFLD_NULL;
+    return 0;
+  }
+
+  *pStatus = OJIFLD_MISTYPED;
+
+  switch (pField->type) {
+
+  case OJIFLD_DOUBLE:
+    if (pLocalOji->payloadType == OJI_INTEGER) {
+      *(double*) pMember = (double) pLocalOji->uPayload.anInteger;
+    } else if (pLocalOji->payloadType == OJI_SCALAR) {
+      *(double*) pMember = pLocalOji->uPayload.aScalar;
+    } else {
+      break;
+    }
+    *pStatus = OJIFLD_FOUND;
+    break;
+
+  case OJIFLD_INT32:
+    if (leafIntegerOji(pLocalOji, &value)) break;
+    if (value < INT32_MIN || value > INT32_MAX) break;
+    *(int32_t*) pMember = (int32_t) value;
+    *pStatus = OJIFLD_FOUND;
+    break;
+
+  case OJIFLD_INT64:
+    if (leafIntegerOji(pLocalOji, &value)) break;
+    *(int64_t*) pMember = (int64_t) value;
+    *pStatus = OJIFLD_FOUND;
+    break;
+
+  case OJIFLD_BOOLEAN:
+    if (pLocalOji->payloadType != OJI_BOOLEAN) break;
+    *(OJIBOOL*) pMember = pLocalOji->uPayload.aBool;
+    *pStatus = OJIFLD_FOUND;
+    break;
+
+  case OJIFLD_STRING:
+    if (pLocalOji->payloadType != OJI_STRING || pField->size < 1) break;
+    if ((size_t) lenStrJson < pField->size) {
+      memcpy(pMember, pLocalOji->uPayload.aString, lenStrJson);
+      pMember[lenStrJson] = '\0';
+      *pStatus = OJIFLD_FOUND;
+    } else {
+      memcpy(pMember, pLocalOji->uPayload.aString, pField->size - 1);
+      pMember[pField->size - 1] = '\0';
+      *pStatus = OJIFLD_TRUNCATED;
+    }
+    break;
+  }
+  return 0;
+}
+
+
+/**********************************************************************/
+/* OJISINK container handler:  skip containers that lead to no field */
+static int
+schemaContainerOji(pOJISINK pSink, const char* keyString, const uint8_t* json_buffer, const void* pVoidToks) {
+pOJISCHEMAFILL pFill = (pOJISCHEMAFILL) pSink->arg;
+pOJISCHEMA pSchema = pFill->pSchema;
+const jsmntok_t* pToks = (const jsmntok_t*) pVoidToks;
+size_t lenKey = strlen(keyString);
+int i;
+
+  (void) json_buffer;
+
+  /* A field that names a container is mistyped */
+  if ((i = findFieldOji(pSchema, keyString, lenKey)) >= 0) {
+    pFill->status[pSchema->tableIndex[i]] = OJIFLD_MISTYPED;
+  }
+
+  if (hasPrefixOji(pSchema, keyString, lenKey, '.')) return 0;
+  if (pToks->type == JSMN_ARRAY && hasPrefixOji(pSchema, keyString, lenKey, '[')) return 0;
+
+  return countTokensOji(pToks);
+}
+
+
+/**********************************************************************/
+/* Set up pSink to fill *pStruct per pSchema, with results in *pFill
+ * - zero (memset) *pFill before its first use; later calls with the
+ *   same schema reuse its status array
+ * - returns 0 on success, 1 on allocation failure
+ */
+int
+initSchemaSinkOji(pOJISINK pSink, pOJISCHEMAFILL pFill, pOJISCHEMA pSchema, void* pStruct) {
+  if (!pSink || !pFill || !pSchema) return 1;
+
+  if (pFill->status && pFill->pSchema != pSchema) {
+    cleanupSchemaFillOji(pFill);
+  }
+  if (!pFill->status) {
+    if (!(pFill->status = malloc(pSchema->nFields ? pSchema->nFields : 1))) return 1;
+  }
+  memset(pFill->status, OJIFLD_MISSING, pSchema->nFields);
+
+  pFill->pSchema = pSchema;
+  pFill->pStruct = pStruct;
+  pFill->nFound = pFill->nMissing = pFill->nMistyped = 0;
+
+  pSink->leaf = schemaLeafOji;
+  pSink->container = schemaContainerOji;
+  pSink->arg = (void*) pFill;
+  return 0;
+}
+
+/* Count field results after flattening; returns nMissing + nMistyped */
+int
+finishSchemaFillOji(pOJISCHEMAFILL pFill) {
+pOJISCHEMA pSchema = pFill->pSchema;
+int i;
+
+  pFill->nFound = pFill->nMissing = pFill->nMistyped = 0;
+  for (i=0; i<pSchema->nFields; ++i) {
+    switch (pFill->status[pSchema->tableIndex[i]]) {
+    case OJIFLD_FOUND:
+      ++pFill->nFound;
+      break;
+    case OJIFLD_MISSING:
+    case OJIFLD_NULL:
+      if (pSchema->fields[i].required) ++pFill->nMissing;
+      break;
+    default:
+      ++pFill->nMistyped;
+      break;
+    }
+  }
+  return pFill->nMissing + pFill->nMistyped;
+}
+
+void
+cleanupSchemaFillOji(pOJISCHEMAFILL pFill) {
+  if (!pFill) return;
+  if (pFill->status) { free(pFill->status); }
+  pFill->status = 0;
+  pFill->pSchema = 0;
+  return;
+}
+
+
+/**********************************************************************/
+/* Print one line per field that was not filled, in schema table order */
+void
+printSchemaFillOji(pOJISCHEMAFILL pFill, FILE* fOut) {
+static const char* statusNames[] = { "missing", "found", "null", "mistyped", "truncated" };
+pOJISCHEMA pSchema = pFill->pSchema;
+int i;
+int status;
+
+  for (i=0; i<pSchema->nFields; ++i) {
+    status = pFill->status[pSchema->tableIndex[i]];
+    if (status == OJIFLD_FOUND) continue;
+    fprintf(fOut, "%s:  %s%s\n"
+           , pSchema->fields[i].keyString, statusNames[status]
+           , pSchema->fields[i].required ? " (required)" : "");
+  }
+  return;
+}
+
+
+/**********************************************************************/
+/* Tokenize in-memory JSON and fill *pStruct per pSchema; no tree is built
+ * - returns 0 if all fields were filled or are optional and missing;
+ *   >0 the number of missing required plus mistyped fields, with
+ *   details in *pFill; <0 the negated readOjiAvlBuffer error
+ */
+int
+orx_fillSchemaOjiBuffer(pOJISCHEMA pSchema, const uint8_t* json_buffer, size_t json_len, void* pStruct, pOJISCHEMAFILL pFill, pOJISTATS pStats) {
+OJISINK sink;
+OJIOPTS opts;
+pAVLTREE pAvlTree = 0;
+int rtn;
+
+  if (initSchemaSinkOji(&sink, pFill, pSchema, pStruct)) return -1;
+
+  memset(&opts, 0, sizeof opts);
+  opts.pStats = pStats;
+  opts.pSink = &sink;
+
+  if ((rtn = readOjiAvlBuffer(json_buffer, json_len, &pAvlTree, 0, &opts))) {
+    cleanupAVL(&pAvlTree);
+    return -rtn;
+  }
+  cleanupAVL(&pAvlTree);
+  return finishSchemaFillOji(pFill);
+}
+/**********************************************************************/
+/*** End of library functions ****************************************/
+/**********************************************************************/
+
+
+#ifdef DO_MAIN
+/**********************************************************************/
+/*** Test program ***/
+/*
+ * Usage:
+ *
+ *   ./test_orx_schema file.json [file2.json ...]
+ *
+ * Compile and link:
+ *
+ *  % gcc -DDO_MAIN orx_schema.c -o test_orx_schema -lm
+ *
+ */
+#include "jsmn.c"
+#include "avltree.c"
+#define main MAIN_BUFFILE
+#include "buffer_file.c"
+#undef main
+#undef DO_MAIN
+#include "orx_parsejson.c"
+#define DO_MAIN
+
+#include <pthread.h>
+
+#include "orx_test.h"
+
+/* Fields of minimal.json */
+typedef struct MINIMALstr {
+  double oneTwenty;
+  int32_t minus999;
+  int64_t zero;
+  OJIBOOL trueBool;
+  char string[8];
+  char shortString[4];
+  int32_t arrayLength;
+  double notThere;
+  double isNull;
+  double isBoolean;
+  int32_t notInteger;
+  double isObject;
+} MINIMAL;
+
+static OJIFIELD minimalFields[] =
+{ { "json.object.one_hundred_twenty", OJIFLD_DOUBLE, offsetof(MINIMAL,oneTwenty), 0, 1 }
+, { "json.object.minus999", OJIFLD_INT32, offsetof(MINIMAL,minus999), 0, 1 }
+, { "json.object.zero", OJIFLD_INT64, offsetof(MINIMAL,zero), 0, 1 }
+, { "json.object.true_bool", OJIFLD_BOOLEAN, offsetof(MINIMAL,trueBool), 0, 1 }
+, { "json.array[0]", OJIFLD_STRING, offsetof(MINIMAL,string), 8, 1 }
+, { "json.object.string", OJIFLD_STRING, offsetof(MINIMAL,shortString), 4, 0 }
+, { "json.array.length", OJIFLD_INT32, offsetof(MINIMAL,arrayLength), 0, 1 }
+, { "json.object.not_there", OJIFLD_DOUBLE, offsetof(MINIMAL,notThere), 0, 1 }
+, { "json.object.null", OJIFLD_DOUBLE, offsetof(MINIMAL,isNull), 0, 0 }
+, { "json.array[0]x", OJIFLD_DOUBLE, offsetof(MINIMAL,notThere), 0, 0 }
+, { "json.object.false_bool", OJIFLD_DOUBLE, offsetof(MINIMAL,isBoolean), 0, 0 }
+, { "json.array[4]", OJIFLD_INT32, offsetof(MINIMAL,notInteger), 0, 0 }
+, { "json.object", OJIFLD_DOUBLE, offsetof(MINIMAL,isObject), 0, 0 }
+};
+#define N_MINIMAL (sizeof minimalFields / sizeof minimalFields[0])
+
+/* Fixed-format report, with a few fields of interest among many */
+typedef struct REPORTstr {
+  int64_t id;
+  double range;
+  double rangeRate;
+  char frame[16];
+  OJIBOOL valid;
+} REPORT;
+
+static OJIFIELD reportFields[] =
+{ { "json.header.id", OJIFLD_INT64, offsetof(REPORT,id), 0, 1 }
+, { "json.solution.range", OJIFLD_DOUBLE, offsetof(REPORT,range), 0, 1 }
+, { "json.solution.range_rate", OJIFLD_DOUBLE, offsetof(REPORT,rangeRate), 0, 1 }
+, { "json.solution.frame", OJIFLD_STRING, offsetof(REPORT,frame), 16, 1 }
+, { "json.solution.valid", OJIFLD_BOOLEAN, offsetof(REPORT,valid), 0, 1 }
+};
+
+static char*
+makeReport(size_t* pLen) {
+char* json = malloc(1 << 20);
+char* p = json;
+int i;
+  p += sprintf(p, "{\"header\":{\"id\":9007199254740993,\"source\":\"test\"}");
+  p += sprintf(p, ",\"solution\":{\"range\":12345.5,\"range_rate\":-0.25,\"frame\":\"J2000\",\"valid\":true}");
+  p += sprintf(p, ",\"residuals\":[");
+  for (i=0; i<1000; ++i) {
+    p += sprintf(p, "%s{\"t\":%d.5,\"r\":%d,\"w\":[1,2,3]}", i ? "," : "", i, i % 17);
+  }
+  p += sprintf(p, "]}");
+  *pLen = p - json;
+  return json;
+}
+
+static int
+benchSchemaOji(void) {
+size_t len;
+char* json = makeReport(&len);
+OJISCHEMA schema;
+OJISCHEMAFILL fill;
+OJISTATS treeStats;
+OJISTATS schemaStats;
+OJIOPTS opts;
+REPORT report;
+pAVLTREE pAvlTree = 0;
+int i;
+int nErr = errors;
+
+  CHECK(!compileSchemaOji(&schema, reportFields, sizeof reportFields / sizeof reportFields[0]));
+  memset(&fill, 0, sizeof fill);
+  memset(&treeStats, 0, sizeof treeStats);
+  memset(&schemaStats, 0, sizeof schemaStats);
+  memset(&opts, 0, sizeof opts);
+  opts.pStats = &treeStats;
+
+  for (i=0; i<10; ++i) {
+    CHECK(!readOjiAvlBuffer((uint8_t*) json, len, &pAvlTree, 0, &opts));
+    cleanupAVL(&pAvlTree);
+    memset(&report, 0, sizeof report);
+    CHECK(!orx_fillSchemaOjiBuffer(&schema, (uint8_t*) json, len, &report, &fill, &schemaStats));
+  }
+
+  CHECK(report.id == 9007199254740993LL);
+  CHECK(report.range == 12345.5 && report.rangeRate == -0.25);
+  CHECK(!strcmp(report.frame, "J2000") && report.valid == OJI_TRUE);
+  CHECK(fill.nFound == 5);
+  CHECK(schemaStats.mallocCount < treeStats.mallocCount);
+  CHECK(schemaStats.avl.inserts == 0);
+
+  fprintf(stdout, "report, %lu bytes x10:  tokenize=%.4fs; tree dump=%.4fs (%lu mallocs); schema dump=%.4fs (%lu mallocs)\n"
+         , (unsigned long) len, schemaStats.tokenizeSeconds
+         , treeStats.dumpSeconds, treeStats.mallocCount
+         , schemaStats.dumpSeconds, schemaStats.mallocCount);
+
+  cleanupSchemaFillOji(&fill);
+  cleanupSchemaOji(&schema);
+  free(json);
+  return errors - nErr;
+}
+
+/* Thread:  compile both tables repeatedly, and count misordered schemas
+ * in *(int*) pVoid
+ */
+static void*
+compileThreadOji(void* pVoid) {
+OJISCHEMA schema;
+const OJIFIELD* fields;
+int nFields;
+int n;
+int i;
+  for (n=0; n<2000; ++n) {
+    fields = (n & 1) ? reportFields : minimalFields;
+    nFields = (n & 1) ? (int) (sizeof reportFields / sizeof reportFields[0]) : (int) N_MINIMAL;
+    if (compileSchemaOji(&schema, fields, nFields)) { ++*(int*) pVoid; continue; }
+    for (i=0; i<nFields; ++i) {
+      if (schema.fields[i].keyString != fields[schema.tableIndex[i]].keyString
+       || (i && strcmp(schema.fields[i-1].keyString, schema.fields[i].keyString) >= 0)) {
+        ++*(int*) pVoid;
+      }
+    }
+    cleanupSchemaOji(&schema);
+  }
+  return pVoid;
+}
+
+int
+main(int argc, char** argv) {
+pthread_t threads[4];
+int threadErrors[4] = { 0, 0, 0, 0 };
+int i;
+OJISCHEMA schema;
+OJISCHEMAFILL fill;
+OJIFIELD dups[2] = { { "json.a", OJIFLD_DOUBLE, 0, 0, 0 }, { "json.a", OJIFLD_INT32, 0, 0, 0 } };
+MINIMAL minimal;
+uint8_t* json;
+size_t len;
+
+  CHECK(compileSchemaOji(&schema, dups, 2) == 2);
+  CHECK(!compileSchemaOji(&schema, minimalFields, N_MINIMAL));
+  memset(&fill, 0, sizeof fill);
+
+  while (--argc > 0) {
+    if (!(json = buffile_file_to_puint8(argv[argc], &len, 0))) {
+      fprintf(stderr, "Cannot read %s\n", argv[argc]);
+      ++errors;
+      continue;
+    }
+    memset(&minimal, 0, sizeof minimal);
+    minimal.isNull = minimal.isBoolean = -1.0;
+    minimal.notInteger = -1;
+
+    /* 1 missing required; 3 mistyped, 1 truncated */
+    CHECK(orx_fillSchemaOjiBuffer(&schema, json, len, &minimal, &fill, 0) == 5);
+    CHECK(fill.nMissing == 1 && fill.nMistyped == 4 && fill.nFound == 6);
+
+    CHECK(minimal.oneTwenty == 120.0 && minimal.minus999 == -999 && minimal.zero == 0);
+    CHECK(minimal.trueBool == OJI_TRUE && !strcmp(minimal.string, "string"));
+    CHECK(!strcmp(minimal.shortString, "str") && fill.status[5] == OJIFLD_TRUNCATED);
+    CHECK(minimal.arrayLength == 8);
+    CHECK(fill.status[7] == OJIFLD_MISSING && fill.status[8] == OJIFLD_NULL && minimal.isNull == -1.0);
+    CHECK(fill.status[9] == OJIFLD_MISSING);
+    CHECK(fill.status[10] == OJIFLD_MISTYPED && minimal.isBoolean == -1.0);
+    CHECK(fill.status[11] == OJIFLD_MISTYPED && minimal.notInteger == -1);
+    CHECK(fill.status[12] == OJIFLD_MISTYPED);
+    if (errors) printSchemaFillOji(&fill, stderr);
+
+    fprintf(stdout, "%s:  %s; %d of %d fields\n", argv[argc], errors ? "FAILED" : "OK"
+           , fill.nFound, (int) N_MINIMAL);
+    free(json);
+  }
+
+  cleanupSchemaFillOji(&fill);
+  cleanupSchemaOji(&schema);
+
+  /* Schemas compile concurrently */
+  for (i=0; i<4; ++i) {
+    CHECK(!pthread_create(threads + i, 0, compileThreadOji, threadErrors + i));
+  }
+  for (i=0; i<4; ++i) {
+    pthread_join(threads[i], 0);
+    CHECK(threadErrors[i] == 0);
+  }
+
+  benchSchemaOji();
+
+  fprintf(stdout, "test_orx_schema:  %s\n", errors ? "FAILED" : "OK");
+  return errors ? 1 : 0;
+}
+#endif // DO_MAIN
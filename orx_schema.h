@@ -0,0 +1,88 @@
+////////////////////////////////////////////////////////////////////////
+// Schema-driven extraction of flattened JSON into a caller's C struct
+//
+// A schema is a table of fields, each a flattened key, a C type, and
+// the offset of the member to fill, e.g.
+//
+//   typedef struct { double range; int id; char frame[16]; } REPORT;
+//   OJIFIELD fields[] =
+//   { { "json.range", OJIFLD_DOUBLE, offsetof(REPORT,range), 0, 1 }
+//   , { "json.id", OJIFLD_INT32, offsetof(REPORT,id), 0, 1 }
+//   , { "json.frame", OJIFLD_STRING, offsetof(REPORT,frame), 16, 0 }
+//   };
+//
+// compileSchemaOji sorts the table once; orx_fillSchemaOjiBuffer, or
+// the OJISINK from initSchemaSinkOji, then fills the struct while the
+// tokens are flattened:
+//
+//   - no OJITEMs or AVL tree are built
+//   - containers whose keys do not lead to any schema field are skipped
+//     whole, so their leaves are neither keyed nor decoded
+//   - each field gets a status; required fields that are absent or null
+//     count as missing, and values of the wrong JSON type, integers out
+//     of range, containers, and strings that do not fit count as mistyped
+//
+// Member types:  OJIFLD_DOUBLE double, OJIFLD_INT32 int32_t,
+// OJIFLD_INT64 int64_t, OJIFLD_BOOLEAN OJIBOOL, OJIFLD_STRING char[size]
+// (null-terminated JSON string text, escapes not decoded).  Members of
+// fields that are not found are left unchanged.
+//
+////////////////////////////////////////////////////////////////////////
+#ifndef __ORX_SCHEMA_H__
+#define __ORX_SCHEMA_H__
+
+#include <stddef.h>
+
+#include "orx_parsejson.h"
+
+typedef enum
+{ OJIFLD_DOUBLE=0
+, OJIFLD_INT32
+, OJIFLD_INT64
+, OJIFLD_BOOLEAN
+, OJIFLD_STRING
+} OJIFLDTYPE;
+
+typedef struct OJIFIELDstr {
+  const char* keyString;   // Flattened key, e.g. "json.object.zero"
+  OJIFLDTYPE type;
+  size_t offset;           // offsetof() the member in the caller's struct
+  size_t size;             // OJIFLD_STRING:  size of char array member
+  int required;            // Non-zero if absence is an error
+} OJIFIELD, *pOJIFIELD;
+
+typedef enum
+{ OJIFLD_MISSING=0       // Not in the JSON
+, OJIFLD_FOUND           // Member filled
+, OJIFLD_NULL            // JSON null; member unchanged
+, OJIFLD_MISTYPED        // Wrong JSON type, or out of range; member unchanged
+, OJIFLD_TRUNCATED       // String did not fit; member holds its start
+} OJIFLDSTATUS;
+
+typedef struct OJISCHEMAstr {
+  OJIFIELD* fields;        // Copy of table, sorted by keyString
+  int* tableIndex;         // [sorted index] => index in caller's table
+  int nFields;
+} OJISCHEMA, *pOJISCHEMA;
+
+// Result of one fill; status[] is indexed as the caller's table
+typedef struct OJISCHEMAFILLstr {
+  pOJISCHEMA pSchema;
+  void* pStruct;           // Destination
+  unsigned char* status;   // [nFields] OJIFLDSTATUS
+  int nFound;
+  int nMissing;            // Required fields missing or null
+  int nMistyped;           // Fields mistyped or truncated
+} OJISCHEMAFILL, *pOJISCHEMAFILL;
+
+int compileSchemaOji(pOJISCHEMA pSchema, const OJIFIELD* fields, int nFields);
+void cleanupSchemaOji(pOJISCHEMA pSchema);
+
+int initSchemaSinkOji(pOJISINK pSink, pOJISCHEMAFILL pFill, pOJISCHEMA pSchema, void* pStruct);
+int finishSchemaFillOji(pOJISCHEMAFILL pFill);
+void cleanupSchemaFillOji(pOJISCHEMAFILL pFill);
+void printSchemaFillOji(pOJISCHEMAFILL pFill, FILE* fOut);
+
+int orx_fillSchemaOjiBuffer(pOJISCHEMA pSchema, const uint8_t* json_buffer, size_t json_len, void* pStruct, pOJISCHEMAFILL pFill, pOJISTATS pStats);
+
+#endif // __ORX_SCHEMA_H__
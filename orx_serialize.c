@@ -0,0 +1,385 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "orx_serialize.h"
+
+
+/**********************************************************************/
+/**********************************************************************/
+/*** JSON serializer for OJI trees; see orx_serialize.h */
+/**********************************************************************/
+/**********************************************************************/
+
+typedef struct SERIALIZEstr {
+  pAVLTREE pAvlRoot;
+  pOJIWRITER pWriter;
+  char* path;              // Key of the value being written
+  size_t pathLen;
+  size_t pathSize;
+  int failed;
+} SERIALIZE, *pSERIALIZE;
+
+/* Make room for n more characters, plus terminator, in path */
+static int
+growPathSer(pSERIALIZE pSer, size_t n) {
+char* newPath;
+size_t newSize = pSer->pathSize;
+  if (pSer->pathLen + n + 1 <= pSer->pathSize) return 0;
+  while (pSer->pathLen + n + 1 > newSize) newSize <<= 1;
+  if (!(newPath = realloc(pSer->path, newSize))) {
+    pSer->failed = 1;
+    return 1;
+  }
+  pSer->path = newPath;
+  pSer->pathSize = newSize;
+  return 0;
+}
+
+/* Lookups with pSer->path as key */
+static pOJITEM
+getSer(pSERIALIZE pSer) {
+  return orx_getOji(pSer->pAvlRoot, pSer->path);
+}
+
+static pAVLTREE
+lowerBoundSer(pSERIALIZE pSer) {
+OJITEM oji;
+  oji.keyString = pSer->path;
+  oji.keyLen = (uint32_t) strlen(pSer->path);
+  return lowerBoundAvl(pSer->pAvlRoot, &oji);
+}
+
+/* True if key of pAvl starts with the first len characters of path */
+static int
+hasPrefixSer(pSERIALIZE pSer, pAVLTREE pAvl, size_t len) {
+  return pAvl && !strncmp(((pOJITEM) pAvl->payload)->keyString, pSer->path, len);
+}
+
+#define PUTS_SER(P,S) writeOji((P)->pWriter, S, strlen(S))
+
+static void
+leafSer(pSERIALIZE pSer, pOJITEM pOji) {
+char s[32];
+  if (pOji->payloadType == OJI_STRING) {
+    PUTS_SER(pSer, "\"");
+    PUTS_SER(pSer, pOji->sPayload ? pOji->sPayload : "");
+    PUTS_SER(pSer, "\"");
+  } else if (pOji->sPayload) {
+    PUTS_SER(pSer, pOji->sPayload);
+  } else if (pOji->payloadType == OJI_SCALAR) {
+    formatDoubleOji(pOji->uPayload.aScalar, s);
+    PUTS_SER(pSer, s);
+  } else if (pOji->payloadType == OJI_INTEGER) {
+    formatIntOji(pOji->uPayload.anInteger, s);
+    PUTS_SER(pSer, s);
+  } else if (pOji->payloadType == OJI_BOOLEAN) {
+    PUTS_SER(pSer, pOji->uPayload.aBool ? "true" : "false");
+  } else {
+    PUTS_SER(pSer, "null");
+  }
+  return;
+}
+
+/* Array length of path, or -1 if path is not an array */
+static long
+arrayLengthSer(pSERIALIZE pSer) {
+size_t len = pSer->pathLen;
+pAVLTREE pAvl;
+pOJITEM pLength;
+long length;
+
+  if (growPathSer(pSer, 8)) return -1;
+
+  strcpy(pSer->path + len, ".length");
+  pLength = getSer(pSer);
+  if (!pLength || pLength->payloadType != OJI_INTEGER || pLength->uPayload.anInteger < 0) {
+    pSer->path[len] = '\0';
+    return -1;
+  }
+  length = (long) pLength->uPayload.anInteger;
+
+  /* .length must be the only "path." key */
+  pSer->path[len + 1] = '\0';
+  pAvl = lowerBoundSer(pSer);
+  if (!pAvl || pAvl->payload != (void*) pLength || hasPrefixSer(pSer, nextAvl(pAvl), len + 1)) {
+    length = -1;
+  }
+
+  /* A non-empty array has element [0] */
+  if (length > 0) {
+    strcpy(pSer->path + len, "[0");
+    pAvl = lowerBoundSer(pSer);
+    if (!hasPrefixSer(pSer, pAvl, len + 2)) length = -1;
+  }
+
+  pSer->path[len] = '\0';
+  return length;
+}
+
+static void
+valueSer(pSERIALIZE pSer) {
+size_t len = pSer->pathLen;
+pOJITEM pOji;
+pAVLTREE pAvl;
+const char* key;
+size_t lenName;
+char end;
+long length;
+long i;
+int first = 1;
+
+  if (pSer->failed || pSer->pWriter->failed) return;
+
+  /* Leaf */
+  if ((pOji = getSer(pSer))) {
+    leafSer(pSer, pOji);
+    return;
+  }
+
+  /* Array:  one lookup per element */
+  if ((length = arrayLengthSer(pSer)) >= 0) {
+    PUTS_SER(pSer, "[");
+    for (i=0; i<length && !pSer->failed; ++i) {
+      if (growPathSer(pSer, 24)) return;
+      pSer->path[len] = '[';
+      pSer->pathLen = len + 1 + formatIntOji(i, pSer->path + len + 1);
+      strcpy(pSer->path + pSer->pathLen++, "]");
+      if (i) PUTS_SER(pSer, ",");
+      valueSer(pSer);
+      pSer->path[pSer->pathLen = len] = '\0';
+    }
+    PUTS_SER(pSer, "]");
+    return;
+  }
+
+  /* Object:  one ordered scan of "path." keys */
+  PUTS_SER(pSer, "{");
+  if (growPathSer(pSer, 1)) return;
+  strcpy(pSer->path + len, ".");
+  pAvl = lowerBoundSer(pSer);
+
+  /* A key belongs to member "name" when "path.name" is followed by
+   * '\0', '.' or '['.  Other members' keys may sort in between, e.g.
+   * "path.a-b" between "path.a" and "path.a.x", so a member's keys are
+   * up to three runs:  "path.name", the "path.name." keys, and the
+   * "path.name[" keys (array elements, written with its .length).  The
+   * member is written at its first key, and each run is skipped whole
+   */
+  while (hasPrefixSer(pSer, pAvl, len + 1) && !pSer->failed) {
+    key = ((pOJITEM) pAvl->payload)->keyString;
+    lenName = strcspn(key + len + 1, ".[");
+    end = key[len + 1 + lenName];
+    if (growPathSer(pSer, lenName + 2)) return;
+    memcpy(pSer->path + len + 1, key + len + 1, lenName);
+    pSer->path[len + 1 + lenName] = '\0';
+
+    if (end == '\0' || (end == '.' && !getSer(pSer))) {
+      if (!first) PUTS_SER(pSer, ",");
+      first = 0;
+      PUTS_SER(pSer, "\"");
+      writeOji(pSer->pWriter, key + len + 1, lenName);
+      PUTS_SER(pSer, "\":");
+
+      pSer->pathLen = len + 1 + lenName;
+      valueSer(pSer);
+      pSer->pathLen = len;
+    }
+
+    if (end == '\0') {
+      pAvl = nextAvl(pAvl);
+    } else {
+      /* Past all "path.name." or "path.name[" keys */
+      strcpy(pSer->path + len + 1 + lenName, end == '.' ? "/" : "\\");
+      pAvl = lowerBoundSer(pSer);
+    }
+    pSer->path[len + 1] = '\0';
+  }
+
+  pSer->path[len] = '\0';
+  PUTS_SER(pSer, "}");
+  return;
+}
+#undef PUTS_SER
+
+
+/**********************************************************************/
+/* Write JSON of key rootKey (null for "json") and everything under it
+ * - returns 0 on success, non-zero if out of memory or a write failed
+ */
+int
+orx_serializeOjiWriter(pAVLTREE pAvlRoot, const char* rootKey, pOJIWRITER pWriter) {
+SERIALIZE ser;
+size_t lenRoot;
+
+  if (!pWriter) return 1;
+  if (!rootKey) rootKey = "json";
+  lenRoot = strlen(rootKey);
+
+  ser.pAvlRoot = pAvlRoot;
+  ser.pWriter = pWriter;
+  ser.failed = 0;
+  ser.pathLen = lenRoot;
+  ser.pathSize = 256;
+  while (ser.pathSize < lenRoot + 1) ser.pathSize <<= 1;
+  if (!(ser.path = malloc(ser.pathSize))) return 2;
+  strcpy(ser.path, rootKey);
+
+  valueSer(&ser);
+
+  free(ser.path);
+  return ser.failed ? 2 : (pWriter->failed ? 3 : 0);
+}
+
+/* Write JSON to new null-terminated buffer; the caller frees *ppBuffer */
+int
+orx_serializeOjiBuffer(pAVLTREE pAvlRoot, const char* rootKey, char** ppBuffer, size_t* pLen) {
+OJIWRITER writer;
+int rtn;
+  if (!ppBuffer) return 1;
+  *ppBuffer = 0;
+  if (initBufferWriterOji(&writer)) return 3;
+  rtn = orx_serializeOjiWriter(pAvlRoot, rootKey, &writer);
+  if (flushWriterOji(&writer) && !rtn) rtn = 3;
+  if (rtn) {
+    cleanupWriterOji(&writer);
+    return rtn;
+  }
+  *ppBuffer = writer.buf;
+  if (pLen) *pLen = writer.len;
+  return 0;
+}
+
+
+#ifdef DO_MAIN
+/**********************************************************************/
+/*** Test program ***/
+/*
+ * Usage:
+ *
+ *   ./test_orx_serialize a.json [b.json ...]
+ *
+ * - Round trip each file, and a synthetic corpus, through
+ *   parse => serialize => parse, and check that both trees hold the same
+ *   keys, types and value text, and that serializing again gives the
+ *   same JSON
+ *
+ * Compile and link:
+ *
+ *  % gcc -DDO_MAIN orx_serialize.c -o test_orx_serialize -pthread -lm
+ *
+ */
+#include "jsmn.c"
+#include "avltree.c"
+#include "synth_json.c"
+#define main MAIN_BUFFILE
+#include "buffer_file.c"
+#undef main
+#undef DO_MAIN
+#include "orx_parsejson.c"
+#include "orx_export.c"
+#define DO_MAIN
+
+#include "orx_test.h"
+
+/* Return non-zero if trees differ in keys, types or value text */
+static int
+compareTrees(pAVLTREE pRoot1, pAVLTREE pRoot2) {
+pAVLTREE p1 = firstAvl(pRoot1);
+pAVLTREE p2 = firstAvl(pRoot2);
+pOJITEM pOji1;
+pOJITEM pOji2;
+  for ( ; p1 && p2; p1 = nextAvl(p1), p2 = nextAvl(p2)) {
+    pOji1 = (pOJITEM) p1->payload;
+    pOji2 = (pOJITEM) p2->payload;
+    if (strcmp(pOji1->keyString, pOji2->keyString)
+     || pOji1->payloadType != pOji2->payloadType
+     || strcmp(pOji1->sPayload, pOji2->sPayload)) {
+      fprintf(stderr, "Mismatch:  %s=%s vs %s=%s\n"
+             , pOji1->keyString, pOji1->sPayload, pOji2->keyString, pOji2->sPayload);
+      return 1;
+    }
+  }
+  return (p1 || p2) ? 1 : 0;
+}
+
+/* Round trip one document; return number of keys */
+static size_t
+roundTrip(const char* label, const char* json, size_t len) {
+pAVLTREE pRoot1 = 0;
+pAVLTREE pRoot2 = 0;
+pAVLTREE pAvl;
+char* json2 = 0;
+char* json3 = 0;
+size_t len2 = 0;
+size_t n = 0;
+int errors0 = errors;
+
+  CHECK(!readOjiAvlBuffer((const uint8_t*) json, len, &pRoot1, 0, 0));
+  CHECK(!orx_serializeOjiBuffer(pRoot1, 0, &json2, &len2));
+  CHECK(json2 && !readOjiAvlBuffer((const uint8_t*) json2, len2, &pRoot2, 0, 0));
+  CHECK(!compareTrees(pRoot1, pRoot2));
+  CHECK(!orx_serializeOjiBuffer(pRoot2, 0, &json3, 0));
+  CHECK(json2 && json3 && !strcmp(json2, json3));
+
+  for (pAvl = firstAvl(pRoot1); pAvl; pAvl = nextAvl(pAvl)) ++n;
+  if (errors > errors0) fprintf(stderr, "%s:  round trip failed\n", label);
+
+  free(json2);
+  free(json3);
+  cleanupAVL(&pRoot1);
+  cleanupAVL(&pRoot2);
+  return n;
+}
+
+int
+main(int argc, char** argv) {
+pAVLTREE pAvlRoot = 0;
+SYNTHJSON synth;
+char* json;
+char label[64];
+size_t len;
+size_t nKeys = 0;
+int i;
+
+  /* Files, e.g. minimal.json; also serialize one subtree */
+  for (i=1; i<argc; ++i) {
+    if (!(json = (char*) buffile_file_to_puint8(argv[i], &len, 0))) {
+      fprintf(stderr, "Cannot read %s\n", argv[i]);
+      ++errors;
+      continue;
+    }
+    roundTrip(argv[i], json, len);
+    free(json);
+
+    if (!readOjiAvl(argv[i], &pAvlRoot, 0, 0) && orx_getOji(pAvlRoot, "json.object.zero")) {
+      CHECK(!orx_serializeOjiBuffer(pAvlRoot, "json.array", &json, 0));
+      CHECK(json && !strcmp(json, "[\"string\",0,-999,1.2e2,-01.23e-45,true,false,null]"));
+      free(json);
+    }
+    cleanupAVL(&pAvlRoot);
+  }
+
+  /* Member names that sort between a name and its "name." keys */
+  json = "{\"a\":1,\"a-b\":2,\"a b\":{\"c\":3},\"id\":[1,2],\"id-2\":5}";
+  CHECK(roundTrip("interleaved names", json, strlen(json)) > 0);
+  json = "{\"x\":{\"k\":1},\"x-y\":[true],\"x y\":{\"k\":[2]},\"x\\u0001\":0}";
+  CHECK(roundTrip("interleaved objects", json, strlen(json)) > 0);
+
+  /* Synthetic corpus */
+  memset(&synth, 0, sizeof synth);
+  synth.targetBytes = 50000;
+  for (i=1; i<=20; ++i) {
+    synth.seed = i;
+    synth.maxDepth = 2 + i % 8;
+    if (!(json = synthJson(&synth, &len))) { ++errors; continue; }
+    sprintf(label, "synthetic seed %d", i);
+    nKeys += roundTrip(label, json, len);
+    free(json);
+  }
+
+  fprintf(stdout, "test_orx_serialize:  %s; %lu synthetic keys\n"
+         , errors ? "FAILED" : "OK", (unsigned long) nKeys);
+  return errors ? 1 : 0;
+}
+#endif // DO_MAIN
@@ -0,0 +1,30 @@
+////////////////////////////////////////////////////////////////////////
+// Rebuild compact JSON from a flattened OJI tree
+//
+// The serializer walks the keys under rootKey (null for "json") and
+// writes nested JSON in one streaming pass through an OJIWRITER (see
+// orx_export.h), with no allocation per node:
+//
+//   - a key with a value is written as its original JSON text
+//   - a key K with a K.length scalar, no other K.* children, and K[0]
+//     (unless the length is 0) is an array of K.length elements, found
+//     by lookups of K[0], K[1], ...
+//   - any other key is an object, whose members are found by one
+//     ordered scan of the keys starting "K."
+//
+// Objects are written with members in key order, not document order.
+// Flattening cannot represent member names containing '.' or '[', empty
+// objects as member values (they leave no keys), or an object whose only
+// member is {"length":0}; those do not round-trip.
+//
+////////////////////////////////////////////////////////////////////////
+#ifndef __ORX_SERIALIZE_H__
+#define __ORX_SERIALIZE_H__
+
+#include "orx_parsejson.h"
+#include "orx_export.h"
+
+int orx_serializeOjiWriter(pAVLTREE pAvlRoot, const char* rootKey, pOJIWRITER pWriter);
+int orx_serializeOjiBuffer(pAVLTREE pAvlRoot, const char* rootKey, char** ppBuffer, size_t* pLen);
+
+#endif // __ORX_SERIALIZE_H__
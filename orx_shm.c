@@ -0,0 +1,843 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "orx_shm.h"
+
+
+/**********************************************************************/
+/**********************************************************************/
+/*** OJI tree in shared memory; see orx_shm.h */
+/**********************************************************************/
+/**********************************************************************/
+
+#define ALIGN_SHM(N) (((N) + 7) & ~(uint64_t) 7)
+
+/* Node at offset, or null for offset 0 or one outside the mapping */
+#define NODE_SHM(PSHM, OFF) \
+  (((OFF) && (OFF) <= (PSHM)->mapBytes - sizeof(OJISHMNODE)) \
+  ? (pOJISHMNODE) ((PSHM)->pBase + (OFF)) : (pOJISHMNODE) 0)
+
+
+/***************************************/
+/* Text of OJITEM payload kept in a node, or null */
+static const char*
+textOjiShm(pOJITEM pOji) {
+  if (pOji->payloadType != OJI_STRING && pOji->payloadType != OJI_UNKNOWN) return 0;
+  return pOji->sPayload;
+}
+
+
+/***************************************/
+/* Bytes in segment for node copied from OJITEM */
+static uint64_t
+nodeSizeShm(pOJITEM pOji) {
+const char* pText = textOjiShm(pOji);
+  return ALIGN_SHM(sizeof(OJISHMNODE) + strlen(pOji->keyString) + 1 + (pText ? strlen(pText) + 1 : 0));
+}
+
+
+/**********************************************************************/
+/* Write balanced subtree of sorted items[lo..hi) at *pNext, in preorder
+ * - returns offset of subtree root, or 0 if empty
+ */
+static uint64_t
+buildOjiShm(uint8_t* pBase, pOJITEM* items, size_t lo, size_t hi, uint64_t* pNext) {
+size_t mid;
+uint64_t offset;
+pOJISHMNODE pNode;
+pOJITEM pOji;
+const char* pText;
+
+  if (lo >= hi) return 0;
+  mid = lo + ((hi - lo) >> 1);
+  pOji = items[mid];
+  offset = *pNext;
+  *pNext += nodeSizeShm(pOji);
+
+  pNode = (pOJISHMNODE) (pBase + offset);
+  pNode->keyLen = (uint32_t) strlen(pOji->keyString);
+  pNode->payloadType = (uint8_t) pOji->payloadType;
+  pNode->uPayload.anInteger = 0;
+  if (pOji->payloadType == OJI_SCALAR) { pNode->uPayload.aScalar = pOji->uPayload.aScalar; }
+  if (pOji->payloadType == OJI_INTEGER) { pNode->uPayload.anInteger = pOji->uPayload.anInteger; }
+  if (pOji->payloadType == OJI_BOOLEAN) { pNode->uPayload.aBool = pOji->uPayload.aBool; }
+  memcpy(pNode->keyString, pOji->keyString, pNode->keyLen + 1);
+
+  pNode->hasText = 0;
+  pNode->textLen = 0;
+  if ((pText = textOjiShm(pOji))) {
+    pNode->hasText = 1;
+    pNode->textLen = (uint32_t) strlen(pText);
+    memcpy(pNode->keyString + pNode->keyLen + 1, pText, pNode->textLen + 1);
+  }
+
+  pNode->leftOffset = buildOjiShm(pBase, items, lo, mid, pNext);
+  pNode->rightOffset = buildOjiShm(pBase, items, mid + 1, hi, pNext);
+  return offset;
+} /* buildOjiShm(...) */
+
+
+/**********************************************************************/
+/* Name of the data segment of a generation:  "<name>.<generation>"; pOut
+ * needs DATANAME_SHM bytes
+ */
+#define DATANAME_SHM (sizeof ((pOJISHM) 0)->name + 24)
+
+static void
+dataNameShm(char* pOut, const char* name, uint64_t generation) {
+  sprintf(pOut, "%s.%llu", name, (unsigned long long) generation);
+  return;
+}
+
+/* Map the index segment under name read-write, creating it if create is
+ * set; returns null if it cannot be, or is not an index
+ */
+static pOJISHMINDEX
+mapIndexShm(const char* name, int create) {
+pOJISHMINDEX pIndex;
+struct stat st;
+int fd;
+
+  if ((fd = shm_open(name, create ? O_CREAT | O_RDWR : O_RDWR, 0644)) < 0) return 0;
+  if (fstat(fd, &st)
+   || ((size_t) st.st_size < sizeof(OJISHMINDEX) && (!create || ftruncate(fd, sizeof(OJISHMINDEX))))
+   || (pIndex = mmap(0, sizeof(OJISHMINDEX), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+    close(fd);
+    return 0;
+  }
+  close(fd);
+
+  /* - new index:  no generation published yet */
+  if (create && !pIndex->magic) {
+    pIndex->version = OJISHM_VERSION;
+    __atomic_store_n(&pIndex->magic, OJISHM_INDEX_MAGIC, __ATOMIC_RELEASE);
+  }
+  if (pIndex->magic != OJISHM_INDEX_MAGIC || pIndex->version != OJISHM_VERSION) {
+    munmap(pIndex, sizeof(OJISHMINDEX));
+    return 0;
+  }
+  return pIndex;
+}
+
+/* Mark a generation's data segment superseded, and unlink it; readers
+ * that have it mapped keep it until they detach or refresh
+ */
+static void
+retireDataShm(const char* name, uint64_t generation) {
+char dataName[DATANAME_SHM];
+pOJISHMHEADER pHeader;
+struct stat st;
+int fd;
+
+  dataNameShm(dataName, name, generation);
+  if ((fd = shm_open(dataName, O_RDWR, 0)) < 0) return;
+  if (!fstat(fd, &st) && (size_t) st.st_size >= sizeof(OJISHMHEADER)
+   && (pHeader = mmap(0, sizeof(OJISHMHEADER), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) != MAP_FAILED) {
+    __atomic_store_n(&pHeader->state, OJISHM_SUPERSEDED, __ATOMIC_RELEASE);
+    munmap(pHeader, sizeof(OJISHMHEADER));
+  }
+  close(fd);
+  shm_unlink(dataName);
+  return;
+}
+
+
+/**********************************************************************/
+/* Build a new segment under name from an OJI AVL tree
+ * - the AVL tree is not changed, and may be cleaned up afterwards
+ * - the new generation's data segment is built and made READY first,
+ *   then the index is switched to it; only then is the previous
+ *   generation marked superseded and unlinked, so readers attaching
+ *   meanwhile get the old segment, and a failed publish leaves it
+ *   current.  Readers that have it mapped keep it until they detach or
+ *   refresh
+ * - only one process may publish under a given name at a time
+ * - *pGeneration, if not null, gets the new segment's generation
+ * - returns 0 on success; 1 for bad arguments; 2 if a segment could
+ *   not be created or mapped; 3 if an allocation failed
+ */
+int
+publishOjiShm(const char* name, pAVLTREE pAvlRoot, uint64_t* pGeneration) {
+pOJITEM* items = 0;
+pAVLTREE pAvl;
+size_t count = 0;
+size_t i;
+uint64_t bytes = ALIGN_SHM(sizeof(OJISHMHEADER));
+uint64_t next;
+uint64_t generation;
+uint64_t oldGeneration;
+pOJISHMINDEX pIndex;
+pOJISHMHEADER pHeader;
+char dataName[DATANAME_SHM];
+int fd;
+
+  if (!name || !*name || strlen(name) >= sizeof ((pOJISHM) 0)->name) return 1;
+
+  /* Sorted items, and segment size */
+  for (pAvl = firstAvl(pAvlRoot); pAvl; pAvl = nextAvl(pAvl)) {
+    if (pAvl->payload) ++count;
+  }
+  if (count && !(items = malloc(count * sizeof(pOJITEM)))) return 3;
+  for (i = 0, pAvl = firstAvl(pAvlRoot); pAvl; pAvl = nextAvl(pAvl)) {
+    if (!pAvl->payload) continue;
+    items[i] = (pOJITEM) pAvl->payload;
+    bytes += nodeSizeShm(items[i++]);
+  }
+
+  /* Index under name, created by the first publish */
+  if (!(pIndex = mapIndexShm(name, 1))) {
+    fprintf(stderr, "publishOjiShm(%s) failed to map index\n", name);
+    free(items);
+    return 2;
+  }
+  oldGeneration = __atomic_load_n(&pIndex->generation, __ATOMIC_ACQUIRE);
+  generation = oldGeneration + 1;
+
+  /* Create and fill new data segment; valid once state is READY
+   * - a segment left under its name by a failed publish is not current
+   */
+  dataNameShm(dataName, name, generation);
+  shm_unlink(dataName);
+  fd = shm_open(dataName, O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0 || ftruncate(fd, (off_t) bytes)
+   || (pHeader = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+    fprintf(stderr, "publishOjiShm(%s) failed to create segment\n", name);
+    if (fd >= 0) { close(fd); shm_unlink(dataName); }
+    munmap(pIndex, sizeof(OJISHMINDEX));
+    if (!oldGeneration) shm_unlink(name);
+    free(items);
+    return 2;
+  }
+  close(fd);
+
+  next = ALIGN_SHM(sizeof(OJISHMHEADER));
+  pHeader->rootOffset = buildOjiShm((uint8_t*) pHeader, items, 0, count, &next);
+  pHeader->magic = OJISHM_MAGIC;
+  pHeader->version = OJISHM_VERSION;
+  pHeader->generation = generation;
+  pHeader->segmentBytes = bytes;
+  pHeader->count = count;
+  __atomic_store_n(&pHeader->state, OJISHM_READY, __ATOMIC_RELEASE);
+  munmap(pHeader, bytes);
+
+  /* Switch readers to the new generation, then retire the old one */
+  __atomic_store_n(&pIndex->generation, generation, __ATOMIC_RELEASE);
+  munmap(pIndex, sizeof(OJISHMINDEX));
+  if (oldGeneration) retireDataShm(name, oldGeneration);
+
+  free(items);
+  if (pGeneration) *pGeneration = generation;
+  return 0;
+} /* publishOjiShm(...) */
+
+
+/**********************************************************************/
+/* Read JSON file and publish it under name; arguments as for
+ * readOjiAvlOpts and publishOjiShm
+ * - returns 0 on success, else a readOjiAvl or publishOjiShm error code
+ */
+int
+readOjiShm(const char* name, char* filepath, char* pfx, pOJIOPTS pOpts, uint64_t* pGeneration) {
+pAVLTREE pAvlTree = 0;
+int rtn;
+  if ((rtn = readOjiAvlOpts(filepath, &pAvlTree, pfx, 0, pOpts))) return rtn;
+  rtn = publishOjiShm(name, pAvlTree, pGeneration);
+  cleanupAVL(&pAvlTree);
+  return rtn;
+}
+
+
+/**********************************************************************/
+/* Remove name; segments already mapped stay valid, and are marked
+ * superseded, so readers move to whatever is published under name next
+ * - returns 0 on success
+ */
+int
+unlinkOjiShm(const char* name) {
+pOJISHMINDEX pIndex;
+uint64_t generation;
+  if (!name || !*name || strlen(name) >= sizeof ((pOJISHM) 0)->name) return 1;
+  if (!(pIndex = mapIndexShm(name, 0))) return 2;
+  generation = __atomic_load_n(&pIndex->generation, __ATOMIC_ACQUIRE);
+  munmap(pIndex, sizeof(OJISHMINDEX));
+  if (shm_unlink(name)) return 2;
+  if (generation) retireDataShm(name, generation);
+  return 0;
+}
+
+
+/**********************************************************************/
+/* Current generation under name:  0 if none is published yet; -1 if
+ * there is no such index; -2 if it is not an index
+ */
+static int64_t
+currentGenerationShm(const char* name) {
+const OJISHMINDEX* pIndex;
+struct stat st;
+int64_t generation;
+int fd;
+
+  if ((fd = shm_open(name, O_RDONLY, 0)) < 0) return -1;
+  if (fstat(fd, &st)) {
+    close(fd);
+    return -1;
+  }
+  if ((size_t) st.st_size < sizeof(OJISHMINDEX)) {
+    close(fd);
+    return 0;
+  }
+  pIndex = mmap(0, sizeof(OJISHMINDEX), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (pIndex == MAP_FAILED) return -1;
+
+  if (!__atomic_load_n(&pIndex->magic, __ATOMIC_ACQUIRE)) { generation = 0; }
+  else if (pIndex->magic != OJISHM_INDEX_MAGIC || pIndex->version != OJISHM_VERSION) { generation = -2; }
+  else { generation = (int64_t) __atomic_load_n(&pIndex->generation, __ATOMIC_ACQUIRE); }
+  munmap((void*) pIndex, sizeof(OJISHMINDEX));
+  return generation;
+}
+
+/* Map one generation's data segment read-only; codes as attachOjiShm */
+static int
+attachDataShm(const char* name, uint64_t generation, pOJISHM pShm) {
+char dataName[DATANAME_SHM];
+const OJISHMHEADER* pHeader;
+struct stat st;
+int fd;
+int rtn = 0;
+
+  dataNameShm(dataName, name, generation);
+  if ((fd = shm_open(dataName, O_RDONLY, 0)) < 0) return 2;
+  if (fstat(fd, &st)) {
+    close(fd);
+    return 2;
+  }
+  if ((size_t) st.st_size < sizeof(OJISHMHEADER)) {
+    close(fd);
+    return 4;
+  }
+  pHeader = mmap(0, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (pHeader == MAP_FAILED) return 2;
+
+  if (__atomic_load_n(&pHeader->state, __ATOMIC_ACQUIRE) != OJISHM_READY) { rtn = 4; }
+  else if (pHeader->magic != OJISHM_MAGIC || pHeader->version != OJISHM_VERSION
+        || pHeader->segmentBytes != (uint64_t) st.st_size
+        || pHeader->generation != generation) { rtn = 3; }
+  if (rtn) {
+    munmap((void*) pHeader, (size_t) st.st_size);
+    return rtn;
+  }
+
+  pShm->pBase = (const uint8_t*) pHeader;
+  pShm->mapBytes = (size_t) st.st_size;
+  pShm->generation = pHeader->generation;
+  strcpy(pShm->name, name);
+  return 0;
+}
+
+
+/**********************************************************************/
+/* Map the segment published under name, read-only
+ * - returns 0 on success; 1 for bad arguments; 2 if there is no such
+ *   segment or it cannot be mapped; 3 if it is not a valid segment; 4
+ *   if none is published yet, or it is being replaced (try again)
+ * - a segment superseded between reading the index and mapping it is
+ *   retried with the index's new generation
+ */
+int
+attachOjiShm(const char* name, pOJISHM pShm) {
+int64_t generation;
+int64_t again;
+int tries = 0;
+int rtn;
+
+  if (!pShm) return 1;
+  memset(pShm, 0, sizeof *pShm);
+  if (!name || strlen(name) >= sizeof pShm->name) return 1;
+
+  for (generation = currentGenerationShm(name); ; generation = again) {
+    if (generation == -1) return 2;
+    if (generation < 0) return 3;
+    if (generation == 0) return 4;
+    if (!(rtn = attachDataShm(name, (uint64_t) generation, pShm))) return 0;
+    if ((again = currentGenerationShm(name)) == generation) return rtn;
+    if (++tries == 4) return 4;
+  }
+} /* attachOjiShm(const char* name, pOJISHM pShm) */
+
+
+/**********************************************************************/
+/* Move a reader onto the newest segment under its name, if its own has
+ * been superseded
+ * - returns 0 if the mapped segment is current; 1 if remapped; -1 if it
+ *   is superseded but no newer segment can be attached yet (the old one
+ *   stays mapped)
+ */
+int
+refreshOjiShm(pOJISHM pShm) {
+OJISHM fresh;
+  if (!pShm || !pShm->pBase) return -1;
+  if (__atomic_load_n(&((const OJISHMHEADER*) pShm->pBase)->state, __ATOMIC_ACQUIRE) != OJISHM_SUPERSEDED) return 0;
+  if (attachOjiShm(pShm->name, &fresh)) return -1;
+  detachOjiShm(pShm);
+  *pShm = fresh;
+  return 1;
+}
+
+
+/**********************************************************************/
+/* Unmap segment; nodes from it are no longer valid */
+void
+detachOjiShm(pOJISHM pShm) {
+  if (!pShm) return;
+  if (pShm->pBase) munmap((void*) pShm->pBase, pShm->mapBytes);
+  pShm->pBase = 0;
+  pShm->mapBytes = 0;
+  return;
+}
+
+
+/**********************************************************************/
+/* Find node matching key, or return NULL */
+pOJISHMNODE
+getOjiShm(pOJISHM pShm, const char* searchKeyString) {
+pOJISHMNODE pNode;
+int cmp;
+  if (!pShm || !pShm->pBase || !searchKeyString) return 0;
+  pNode = NODE_SHM(pShm, ((const OJISHMHEADER*) pShm->pBase)->rootOffset);
+  while (pNode) {
+    if (!(cmp = strcmp(searchKeyString, pNode->keyString))) return pNode;
+    pNode = NODE_SHM(pShm, cmp < 0 ? pNode->leftOffset : pNode->rightOffset);
+  }
+  return 0;
+}
+
+
+/**********************************************************************/
+/* Traverse tree in key order, calling handler per node with its depth */
+static void
+traverseOneOjiShm(pOJISHM pShm, uint64_t offset, int level, void (*handler)(pOJISHMNODE, int, void**), void** args) {
+pOJISHMNODE pNode = NODE_SHM(pShm, offset);
+  if (!pNode) return;
+  traverseOneOjiShm(pShm, pNode->leftOffset, level+1, handler, args);
+  handler(pNode, level, args);
+  traverseOneOjiShm(pShm, pNode->rightOffset, level+1, handler, args);
+  return;
+}
+void
+traverseOjiShm(pOJISHM pShm, void (*handler)(pOJISHMNODE, int, void**), void** args) {
+  if (!pShm || !pShm->pBase || !handler) return;
+  traverseOneOjiShm(pShm, ((const OJISHMHEADER*) pShm->pBase)->rootOffset, 0, handler, args);
+  return;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// Get one value from shared tree; arguments as for orx_getAnyOji
+void
+orx_getAnyOjiShm(pOJISHM pShm, char* searchKeyString
+                , void *pOut, int *pFound
+                , OJIENUM requestedOjiType, int stringOutSize) {
+pOJISHMNODE pNode;
+
+  if (!pFound) return;
+  *pFound = 0;
+
+  if (!searchKeyString) return;
+  if (!pOut) return;
+
+  if (!(pNode = getOjiShm(pShm, searchKeyString))) return;
+  *pFound = orx_copyOutOji(pNode->payloadType, &pNode->uPayload, OJISHM_TEXT(pNode)
+                          , pOut, requestedOjiType, stringOutSize);
+  return;
+} /* orx_getAnyOjiShm(...) */
+
+
+// Convenience wrappers for orx_getAnyOjiShm
+void
+orx_getNullOjiShm(pOJISHM pShm, char* searchKeyString, int *pFound) {
+void* pOut = (void*) 1;
+  orx_getAnyOjiShm(pShm, searchKeyString, pOut, pFound, OJI_NULL, 0);
+  return;
+}
+void
+orx_getDoubleOjiShm(pOJISHM pShm, char* searchKeyString, double *pOut, int *pFound) {
+  orx_getAnyOjiShm(pShm, searchKeyString, (void*)pOut, pFound, OJI_SCALAR, 0);
+  return;
+}
+void
+orx_getInt64OjiShm(pOJISHM pShm, char* searchKeyString, int64_t *pOut, int *pFound) {
+  orx_getAnyOjiShm(pShm, searchKeyString, (void*)pOut, pFound, OJI_INTEGER, 0);
+  return;
+}
+void
+orx_getBooleanOjiShm(pOJISHM pShm, char* searchKeyString, OJIBOOL *pOut, int *pFound) {
+  orx_getAnyOjiShm(pShm, searchKeyString, (void*)pOut, pFound, OJI_BOOLEAN, 0);
+  return;
+}
+void
+orx_getStringOjiShm(pOJISHM pShm, char* searchKeyString, int stringOutSize, char *pOut, int *pFound) {
+  orx_getAnyOjiShm(pShm, searchKeyString, (void*)pOut, pFound, OJI_STRING, stringOutSize);
+  return;
+}
+/**********************************************************************/
+/*** End of library functions ****************************************/
+/**********************************************************************/
+
+
+#ifdef DO_MAIN
+/**********************************************************************/
+/*** Test program ***/
+/*
+ * Usage:
+ *
+ *   ./test_orx_shm a.json [b.json ...]
+ *
+ * - Publish each file, attach it, and compare key order and all values
+ *   against readOjiAvl, in this process and in a forked reader
+ * - Check that readers cannot write the segment, and that a rebuilt
+ *   segment is detected and remapped
+ * - Compare per-process cost, attach versus readOjiAvlBuffer, on a
+ *   synthetic corpus
+ *
+ * Compile and link:
+ *
+ *  % gcc -DDO_MAIN orx_shm.c -o test_orx_shm -pthread -lm
+ *
+ */
+#include <signal.h>
+#include <sys/wait.h>
+#include "jsmn.c"
+#include "avltree.c"
+#include "synth_json.c"
+#define main MAIN_BUFFILE
+#include "buffer_file.c"
+#undef main
+#undef DO_MAIN
+#include "orx_parsejson.c"
+#define DO_MAIN
+
+#include "orx_test.h"
+
+/* Every node, in order, matches the next OJITEM of the AVL tree */
+static void
+compareOneShm(pOJISHMNODE pNode, int level, void** args) {
+pAVLTREE* ppNext = (pAVLTREE*) args[0];
+pOJITEM pOji = *ppNext ? (pOJITEM) (*ppNext)->payload : (pOJITEM) 0;
+char* pText = OJISHM_TEXT(pNode);
+  (void) level;
+  ++*(size_t*) args[1];
+  CHECK(pOji && !strcmp(pOji->keyString, pNode->keyString));
+  if (!pOji) return;
+  CHECK(pOji->payloadType == pNode->payloadType);
+  CHECK(!pText || !strcmp(pText, pOji->sPayload));
+  *ppNext = nextAvl(*ppNext);
+  return;
+}
+
+/* Values through the getters; returns number of mismatches */
+static int
+compareValuesShm(pAVLTREE pAvlRoot, pOJISHM pShm) {
+pAVLTREE pAvl;
+pOJITEM pOji;
+double d;
+int64_t i64;
+OJIBOOL b;
+char s[256];
+int found;
+int bad = 0;
+
+  for (pAvl = firstAvl(pAvlRoot); pAvl; pAvl = nextAvl(pAvl)) {
+    pOji = (pOJITEM) pAvl->payload;
+    switch (pOji->payloadType) {
+    case OJI_NULL:
+      orx_getNullOjiShm(pShm, pOji->keyString, &found);
+      bad += !found;
+      break;
+    case OJI_BOOLEAN:
+      orx_getBooleanOjiShm(pShm, pOji->keyString, &b, &found);
+      bad += !found || b != pOji->uPayload.aBool;
+      break;
+    case OJI_SCALAR:
+      orx_getDoubleOjiShm(pShm, pOji->keyString, &d, &found);
+      bad += !found || d != pOji->uPayload.aScalar;
+      break;
+    case OJI_INTEGER:
+      orx_getInt64OjiShm(pShm, pOji->keyString, &i64, &found);
+      bad += !found || i64 != pOji->uPayload.anInteger;
+      orx_getDoubleOjiShm(pShm, pOji->keyString, &d, &found);
+      bad += !found || d != (double) pOji->uPayload.anInteger;
+      break;
+    case OJI_STRING:
+      orx_getStringOjiShm(pShm, pOji->keyString, sizeof s, s, &found);
+      bad += !found || strncmp(s, pOji->sPayload, sizeof s - 1);
+      break;
+    default:
+      bad += !getOjiShm(pShm, pOji->keyString);
+      break;
+    }
+  }
+  orx_getDoubleOjiShm(pShm, "json.no_such_key", &d, &found);
+  bad += found;
+  return bad;
+}
+
+/* Publish, attach and compare here and in a forked reader */
+static void
+compareLoadsShm(const char* name, const char* json, size_t len) {
+pAVLTREE pAvlTree = 0;
+pAVLTREE pNext;
+OJISHM shm;
+void* args[2];
+size_t n = 0;
+uint64_t generation = 0;
+pid_t pid;
+int status;
+
+  CHECK(!readOjiAvlBuffer((const uint8_t*) json, len, &pAvlTree, 0, 0));
+  CHECK(!publishOjiShm(name, pAvlTree, &generation));
+  CHECK(!attachOjiShm(name, &shm) && shm.generation == generation);
+  pNext = firstAvl(pAvlTree);
+  args[0] = (void*) &pNext;
+  args[1] = (void*) &n;
+  traverseOjiShm(&shm, compareOneShm, args);
+  CHECK(!pNext && n == ((const OJISHMHEADER*) shm.pBase)->count);
+  CHECK(!compareValuesShm(pAvlTree, &shm));
+  detachOjiShm(&shm);
+
+  /* Another process attaches by name and reads the same values */
+  fflush(stdout);
+  if (!(pid = fork())) {
+    if (attachOjiShm(name, &shm)) _exit(2);
+    _exit(compareValuesShm(pAvlTree, &shm) ? 1 : 0);
+  }
+  CHECK(pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && !WEXITSTATUS(status));
+
+  cleanupAVL(&pAvlTree);
+  return;
+}
+
+/* Readers are read-only, and see a rebuilt segment after refreshing */
+static void
+testGenerationsShm(const char* name) {
+const char* json1 = "{\"a\":1,\"b\":{\"c\":\"one\"}}";
+const char* json2 = "{\"a\":2,\"b\":{\"c\":\"two\",\"d\":true}}";
+pAVLTREE pAvlTree = 0;
+OJISHM reader;
+OJISHM writer;
+int64_t i64;
+OJIBOOL b;
+char s[16];
+int found;
+uint64_t generation = 0;
+pid_t pid;
+int status;
+
+  CHECK(!readOjiAvlBuffer((const uint8_t*) json1, strlen(json1), &pAvlTree, 0, 0));
+  CHECK(!publishOjiShm(name, pAvlTree, &generation) && generation == 1);
+  cleanupAVL(&pAvlTree);
+  CHECK(!attachOjiShm(name, &reader) && reader.generation == 1);
+  CHECK(!refreshOjiShm(&reader));
+
+  /* Writing a reader's mapping faults */
+  fflush(stdout);
+  if (!(pid = fork())) {
+    signal(SIGSEGV, SIG_DFL);
+    ((uint8_t*) reader.pBase)[sizeof(OJISHMHEADER)] = 0;
+    _exit(0);
+  }
+  CHECK(pid > 0 && waitpid(pid, &status, 0) == pid && WIFSIGNALED(status));
+
+  /* Rebuild:  old mapping still readable, refresh moves to new */
+  CHECK(!readOjiAvlBuffer((const uint8_t*) json2, strlen(json2), &pAvlTree, 0, 0));
+  CHECK(!publishOjiShm(name, pAvlTree, &generation) && generation == 2);
+  cleanupAVL(&pAvlTree);
+  orx_getInt64OjiShm(&reader, "json.a", &i64, &found);
+  CHECK(found && i64 == 1);
+  orx_getStringOjiShm(&reader, "json.b.c", sizeof s, s, &found);
+  CHECK(found && !strcmp(s, "one"));
+  CHECK(refreshOjiShm(&reader) == 1 && reader.generation == 2);
+  orx_getInt64OjiShm(&reader, "json.a", &i64, &found);
+  CHECK(found && i64 == 2);
+  orx_getBooleanOjiShm(&reader, "json.b.d", &b, &found);
+  CHECK(found && b);
+  CHECK(!refreshOjiShm(&reader));
+
+  /* Unlinked:  reader keeps its segment until a new one is published */
+  CHECK(!unlinkOjiShm(name));
+  CHECK(attachOjiShm(name, &writer) == 2);
+  CHECK(refreshOjiShm(&reader) == -1 && reader.generation == 2);
+  orx_getInt64OjiShm(&reader, "json.a", &i64, &found);
+  CHECK(found && i64 == 2);
+  CHECK(!readOjiAvlBuffer((const uint8_t*) json1, strlen(json1), &pAvlTree, 0, 0));
+  CHECK(!publishOjiShm(name, pAvlTree, &generation) && generation == 1);
+  cleanupAVL(&pAvlTree);
+  CHECK(refreshOjiShm(&reader) == 1 && reader.generation == 1);
+  orx_getInt64OjiShm(&reader, "json.a", &i64, &found);
+  CHECK(found && i64 == 1);
+  detachOjiShm(&reader);
+  CHECK(!unlinkOjiShm(name));
+  return;
+}
+
+/* Readers attaching while another process republishes always find a
+ * READY segment, and old generations are unlinked
+ */
+static void
+testRepublishShm(const char* name) {
+char json[32];
+char dataName[DATANAME_SHM];
+pAVLTREE pAvlTree = 0;
+OJISHM shm;
+int64_t i64;
+int found;
+int attached = 0;
+int bad = 0;
+int rtn;
+int i;
+pid_t pid;
+int status;
+
+  CHECK(!readOjiAvlBuffer((const uint8_t*) "{\"a\":0}", 7, &pAvlTree, 0, 0));
+  CHECK(!publishOjiShm(name, pAvlTree, 0));
+  cleanupAVL(&pAvlTree);
+
+  fflush(stdout);
+  if (!(pid = fork())) {
+    for (i=1; i<=300; ++i) {
+      sprintf(json, "{\"a\":%d}", i);
+      if (readOjiAvlBuffer((const uint8_t*) json, strlen(json), &pAvlTree, 0, 0)) _exit(1);
+      if (publishOjiShm(name, pAvlTree, 0)) _exit(1);
+      cleanupAVL(&pAvlTree);
+    }
+    _exit(0);
+  }
+  CHECK(pid > 0);
+  while (pid > 0 && !waitpid(pid, &status, WNOHANG)) {
+    if ((rtn = attachOjiShm(name, &shm))) {
+      bad += rtn != 4;
+      continue;
+    }
+    ++attached;
+    orx_getInt64OjiShm(&shm, "json.a", &i64, &found);
+    bad += !found || (uint64_t) i64 + 1 != shm.generation;
+    detachOjiShm(&shm);
+  }
+  CHECK(pid > 0 && WIFEXITED(status) && !WEXITSTATUS(status));
+  CHECK(!bad && attached > 0);
+
+  CHECK(!attachOjiShm(name, &shm) && shm.generation == 301);
+  detachOjiShm(&shm);
+  dataNameShm(dataName, name, 300);
+  CHECK(shm_open(dataName, O_RDONLY, 0) < 0);
+  CHECK(!unlinkOjiShm(name));
+  dataNameShm(dataName, name, 301);
+  CHECK(shm_open(dataName, O_RDONLY, 0) < 0);
+  return;
+}
+
+/* Per-process cost:  parse into own tree, or attach shared segment */
+static void
+benchShm(const char* name, const char* json, size_t len) {
+pAVLTREE pAvlTree = 0;
+pAVLTREE pAvl;
+OJISHM shm;
+size_t n = 0;
+size_t avlBytes = 0;
+pOJITEM pOji;
+double tParse;
+double tPublish;
+double tAttach;
+double tAvlGet;
+double tShmGet;
+int misses = 0;
+
+  tParse = ojiSeconds();
+  CHECK(!readOjiAvlBuffer((const uint8_t*) json, len, &pAvlTree, 0, 0));
+  tParse = ojiSeconds() - tParse;
+  tPublish = ojiSeconds();
+  CHECK(!publishOjiShm(name, pAvlTree, 0));
+  tPublish = ojiSeconds() - tPublish;
+  tAttach = ojiSeconds();
+  CHECK(!attachOjiShm(name, &shm));
+  tAttach = ojiSeconds() - tAttach;
+
+  for (pAvl = firstAvl(pAvlTree); pAvl; pAvl = nextAvl(pAvl)) {
+    pOji = (pOJITEM) pAvl->payload;
+    avlBytes += sizeof(OJITEM) + strlen(pOji->keyString) + strlen(pOji->sPayload) + 2;
+    ++n;
+  }
+  tAvlGet = ojiSeconds();
+  for (pAvl = firstAvl(pAvlTree); pAvl; pAvl = nextAvl(pAvl)) {
+    misses += !orx_getOji(pAvlTree, ((pOJITEM) pAvl->payload)->keyString);
+  }
+  tAvlGet = ojiSeconds() - tAvlGet;
+  tShmGet = ojiSeconds();
+  for (pAvl = firstAvl(pAvlTree); pAvl; pAvl = nextAvl(pAvl)) {
+    misses += !getOjiShm(&shm, ((pOJITEM) pAvl->payload)->keyString);
+  }
+  tShmGet = ojiSeconds() - tShmGet;
+  CHECK(!misses);
+
+  fprintf(stdout, "synth %lu keys; per process:  readOjiAvlBuffer %.4fs, %.1f bytes/key"
+                  "; attach %.6fs, 0 bytes/key (segment %.1f bytes/key, publish %.4fs)"
+                  "; lookup AVL %.0fns, shm %.0fns\n"
+         , (unsigned long) n, tParse, n ? (double) avlBytes / n : 0.0
+         , tAttach, n ? (double) shm.mapBytes / n : 0.0, tPublish
+         , n ? 1e9 * tAvlGet / n : 0.0, n ? 1e9 * tShmGet / n : 0.0);
+
+  detachOjiShm(&shm);
+  unlinkOjiShm(name);
+  cleanupAVL(&pAvlTree);
+  return;
+}
+
+int
+main(int argc, char** argv) {
+SYNTHJSON synth;
+char name[64];
+uint8_t* file;
+char* json;
+size_t len;
+int fileErrors;
+
+  sprintf(name, "/test_orx_shm.%ld", (long) getpid());
+
+  while (--argc > 0) {
+    fileErrors = errors;
+    if (!(file = buffile_file_to_puint8(argv[argc], &len, 0))) {
+      fprintf(stderr, "Cannot read %s\n", argv[argc]);
+      ++errors;
+      continue;
+    }
+    compareLoadsShm(name, (const char*) file, len);
+    fprintf(stdout, "%s:  %s\n", argv[argc], errors > fileErrors ? "FAILED" : "OK");
+    free(file);
+  }
+  unlinkOjiShm(name);
+
+  testGenerationsShm(name);
+  testRepublishShm(name);
+
+  memset(&synth, 0, sizeof synth);
+  synth.seed = 42;
+  synth.targetBytes = 1 << 18;
+  if ((json = synthJson(&synth, &len))) {
+    compareLoadsShm(name, json, len);
+    unlinkOjiShm(name);
+    benchShm(name, json, len);
+    free(json);
+  } else {
+    ++errors;
+  }
+
+  fprintf(stdout, "test_orx_shm:  %s\n", errors ? "FAILED" : "OK");
+  return errors ? 1 : 0;
+}
+#endif // DO_MAIN
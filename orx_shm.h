@@ -0,0 +1,121 @@
+////////////////////////////////////////////////////////////////////////
+// OJI tree in POSIX shared memory, shared read-only between processes
+//
+// Each process that calls readOjiAvl on the same document holds its own
+// copy of the tree.  Instead, one process can build the tree once into a
+// named shared-memory segment (shm_open), and any number of processes
+// attach it read-only and look values up in place:
+//
+// - nodes link to each other by byte offset from the start of the
+//   segment, not by pointer, so the segment can be mapped at any address
+// - the tree is built balanced from the sorted keys of an OJI AVL tree,
+//   and is never changed once published; nodes hold the key, the decoded
+//   payload and, for strings and unknowns, the payload text
+// - the name holds a small index segment with the current generation;
+//   each generation's tree is its own segment, named "<name>.<generation>"
+// - publishing under a name already in use builds a new segment, with
+//   the next generation number, switches the index to it once it is
+//   READY, and then marks the old one superseded and unlinks it; the
+//   old segment stays valid for readers that have it mapped until they
+//   detach, and refreshOjiShm remaps a reader onto the new one
+//
+// Writer (one per name):
+//
+//   readOjiShm("/ref", "ref.json", 0, 0, &generation);
+//   ...
+//   unlinkOjiShm("/ref");
+//
+// Readers:
+//
+//   OJISHM shm;
+//   attachOjiShm("/ref", &shm);
+//   orx_getDoubleOjiShm(&shm, "json.a.b", &d, &found);
+//   refreshOjiShm(&shm);     // e.g. once per request
+//   detachOjiShm(&shm);
+//
+// Link with -lrt on C libraries older than glibc 2.34.
+//
+////////////////////////////////////////////////////////////////////////
+#ifndef __ORX_SHM_H__
+#define __ORX_SHM_H__
+
+#include <stdint.h>
+
+#include "orx_parsejson.h"
+
+#define OJISHM_MAGIC       0x4F4A4953u   // "OJIS"
+#define OJISHM_INDEX_MAGIC 0x4F4A4949u   // "OJII"
+#define OJISHM_VERSION     2
+
+typedef enum
+{ OJISHM_BUILDING=0        // Being written; not yet valid
+, OJISHM_READY             // Valid, and current under its name
+, OJISHM_SUPERSEDED        // Valid, but a newer generation is published
+} OJISHMSTATE;
+
+/* Index segment, under the published name */
+typedef struct OJISHMINDEXstr {
+  uint32_t magic;          // OJISHM_INDEX_MAGIC; 0 while being created
+  uint32_t version;        // OJISHM_VERSION
+  uint64_t generation;     // Current data segment; 0 if none yet; read
+                           //   and written atomically
+} OJISHMINDEX, *pOJISHMINDEX;
+
+/* Data segment header, at offset 0 */
+typedef struct OJISHMHEADERstr {
+  uint32_t magic;          // OJISHM_MAGIC
+  uint32_t version;        // OJISHM_VERSION
+  uint32_t state;          // OJISHMSTATE; read and written atomically
+  uint32_t unused;
+  uint64_t generation;     // 1 for the first segment under a name
+  uint64_t segmentBytes;   // Size of segment
+  uint64_t count;          // Number of nodes
+  uint64_t rootOffset;     // Offset of root node; 0 if empty
+} OJISHMHEADER, *pOJISHMHEADER;
+
+/* Node; 8-byte aligned, offset 0 is a null link */
+typedef struct OJISHMNODEstr {
+  uint64_t leftOffset;
+  uint64_t rightOffset;
+  union {                  // uPayload:  as in OJITEM, less string pointer
+    OJIBOOL aBool;
+    double aScalar;
+    int64_t anInteger;
+  } uPayload;
+  uint32_t keyLen;         // strlen(keyString)
+  uint32_t textLen;        // Length of payload text, if kept
+  uint8_t payloadType;     // OJIENUM
+  uint8_t hasText;         // Set if payload text follows key
+  char keyString[];        // Key, '\0', then payload text and '\0' if any
+} OJISHMNODE, *pOJISHMNODE;
+
+/* A reader's (or writer's) mapping of a segment */
+typedef struct OJISHMstr {
+  const uint8_t* pBase;    // Start of mapping; null if not attached
+  size_t mapBytes;
+  uint64_t generation;     // Generation of the mapped segment
+  char name[256];          // Name attached to, for refreshOjiShm
+} OJISHM, *pOJISHM;
+
+/* Payload text of a node, or null */
+#define OJISHM_TEXT(P) ((P)->hasText ? ((P)->keyString + (P)->keyLen + 1) : (char*)0)
+
+int publishOjiShm(const char* name, pAVLTREE pAvlRoot, uint64_t* pGeneration);
+int readOjiShm(const char* name, char* filepath, char* pfx, pOJIOPTS pOpts, uint64_t* pGeneration);
+int unlinkOjiShm(const char* name);
+
+int attachOjiShm(const char* name, pOJISHM pShm);
+int refreshOjiShm(pOJISHM pShm);
+void detachOjiShm(pOJISHM pShm);
+
+pOJISHMNODE getOjiShm(pOJISHM pShm, const char* searchKeyString);
+void traverseOjiShm(pOJISHM pShm, void (*handler)(pOJISHMNODE, int, void**), void** args);
+
+void orx_getAnyOjiShm(pOJISHM pShm, char* searchKeyString, void *pOut, int *pFound, OJIENUM requestedOjiType, int stringOutSize);
+void orx_getNullOjiShm(pOJISHM pShm, char* searchKeyString, int* pFound);
+void orx_getDoubleOjiShm(pOJISHM pShm, char* searchKeyString, double* pOut, int* pFound);
+void orx_getInt64OjiShm(pOJISHM pShm, char* searchKeyString, int64_t* pOut, int* pFound);
+void orx_getBooleanOjiShm(pOJISHM pShm, char* searchKeyString, OJIBOOL* pOut, int* pFound);
+void orx_getStringOjiShm(pOJISHM pShm, char* searchKeyString, int stringOutSize, char* pOut, int* pFound);
+
+#endif // __ORX_SHM_H__
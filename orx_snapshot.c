@@ -0,0 +1,307 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "orx_snapshot.h"
+
+
+/**********************************************************************/
+/**********************************************************************/
+/*** Persistent OJI trees; see orx_snapshot.h */
+/**********************************************************************/
+/**********************************************************************/
+
+/**********************************************************************/
+/* Initialize an empty tree of OJITEMs */
+void
+initOjiPavl(pPAVLTREE pTree) {
+  initPavl(pTree, oji_comparator, cleanupOji);
+  return;
+}
+
+
+/**********************************************************************/
+/* Move all OJITEMs from an OJI AVL tree into a persistent tree
+ * - into an empty tree, in O(n); else one insertPavl per OJITEM, with
+ *   moved OJITEMs replacing those with equal keys
+ * - *ppAvlRoot is set to null; the OJITEMs now belong to pTree
+ * - returns 0 on success; non-zero if out of memory, in which case
+ *   *ppAvlRoot is left unchanged if nothing was moved, and any OJITEMs
+ *   that could not be inserted are freed otherwise
+ */
+int
+moveOjiAvlToPavl(ppAVLTREE ppAvlRoot, pPAVLTREE pTree) {
+pAVLTREE pAvl;
+void** payloads;
+size_t n = 0;
+size_t i;
+
+  if (!ppAvlRoot || !pTree) return 1;
+  if (!*ppAvlRoot) return 0;
+
+  /* Collect payloads in key order; the AVL links are not used after */
+  for (pAvl = firstAvl(*ppAvlRoot); pAvl; pAvl = nextAvl(pAvl)) ++n;
+  if (!(payloads = malloc(n * sizeof(void*)))) return 2;
+  for (i = 0, pAvl = firstAvl(*ppAvlRoot); pAvl; pAvl = nextAvl(pAvl)) {
+    payloads[i++] = pAvl->payload;
+  }
+
+  if (!pTree->pRoot) {
+    if (buildSortedPavl(pTree, payloads, n)) {
+      free(payloads);
+      return 3;
+    }
+    *ppAvlRoot = 0;
+    free(payloads);
+    return 0;
+  }
+
+  *ppAvlRoot = 0;
+  for (i=0; i<n; ++i) {
+    if (insertPavl(pTree, payloads[i]) < 0) break;
+  }
+  if (i < n) {
+    for ( ; i<n; ++i) cleanupOji(payloads[i]);
+    free(payloads);
+    return 4;
+  }
+  free(payloads);
+  return 0;
+}
+
+
+/**********************************************************************/
+/* Read JSON file, and add its OJITEMs to a persistent tree
+ * - arguments as for readOjiAvlOpts; returns its non-zero codes, or
+ *   10 plus the moveOjiAvlToPavl code
+ */
+int
+readOjiPavl(char* filepath, pPAVLTREE pTree, char* pfx, pOJIOPTS pOpts) {
+pAVLTREE pAvlRoot = 0;
+int rtn;
+
+  if (!pTree) return 1;
+
+  if ((rtn = readOjiAvlOpts(filepath, &pAvlRoot, pfx, 0, pOpts))) {
+    cleanupAVL(&pAvlRoot);
+    return rtn;
+  }
+  if ((rtn = moveOjiAvlToPavl(&pAvlRoot, pTree))) {
+    cleanupAVL(&pAvlRoot);
+    return 10 + rtn;
+  }
+  return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// Get data from persistent tree; arguments as for orx_getOji*
+pOJITEM
+orx_getOjiPavl(pPAVLTREE pTree, char* searchKeyString) {
+OJITEM oji;
+  oji.keyString = searchKeyString;
+  return (pOJITEM) getPavl(pTree, &oji);
+}
+
+void
+orx_getAnyOjiPavl(pPAVLTREE pTree, char* searchKeyString
+                 , void *pOut, int *pFound
+                 , OJIENUM requestedOjiType, int stringOutSize) {
+pOJITEM pOji;
+
+  if (!pFound) return;
+  *pFound = 0;
+
+  if (!searchKeyString) return;
+  if (!pOut) return;
+
+  if (!(pOji = orx_getOjiPavl(pTree, searchKeyString))) return;
+  *pFound = orx_copyOutOji(pOji->payloadType, &pOji->uPayload, pOji->uPayload.aString
+                          , pOut, requestedOjiType, stringOutSize);
+  return;
+} /* orx_getAnyOjiPavl(...) */
+
+
+// Convenience wrappers for orx_getAnyOjiPavl
+void
+orx_getNullOjiPavl(pPAVLTREE pTree, char* searchKeyString, int *pFound) {
+void* pOut = (void*) 1;
+  orx_getAnyOjiPavl(pTree, searchKeyString, pOut, pFound, OJI_NULL, 0);
+  return;
+}
+void
+orx_getDoubleOjiPavl(pPAVLTREE pTree, char* searchKeyString, double *pOut, int *pFound) {
+  orx_getAnyOjiPavl(pTree, searchKeyString, (void*)pOut, pFound, OJI_SCALAR, 0);
+  return;
+}
+void
+orx_getInt64OjiPavl(pPAVLTREE pTree, char* searchKeyString, int64_t *pOut, int *pFound) {
+  orx_getAnyOjiPavl(pTree, searchKeyString, (void*)pOut, pFound, OJI_INTEGER, 0);
+  return;
+}
+void
+orx_getBooleanOjiPavl(pPAVLTREE pTree, char* searchKeyString, OJIBOOL *pOut, int *pFound) {
+  orx_getAnyOjiPavl(pTree, searchKeyString, (void*)pOut, pFound, OJI_BOOLEAN, 0);
+  return;
+}
+void
+orx_getStringOjiPavl(pPAVLTREE pTree, char* searchKeyString, int stringOutSize, char *pOut, int *pFound) {
+  orx_getAnyOjiPavl(pTree, searchKeyString, (void*)pOut, pFound, OJI_STRING, stringOutSize);
+  return;
+}
+
+
+#ifdef DO_MAIN
+/**********************************************************************/
+/*** Test program ***/
+/*
+ * Usage:
+ *
+ *   ./test_orx_snapshot a.json [b.json ...]
+ *
+ * - Load each file into a persistent tree, snapshot it, apply overrides
+ *   to one version, and check that the other is unchanged, that the
+ *   override copied only one path, and that both versions stay balanced
+ * - Releasing the versions in either order is left to e.g. valgrind or
+ *   -fsanitize=address to check
+ *
+ * Compile and link:
+ *
+ *  % gcc -DDO_MAIN orx_snapshot.c -o test_orx_snapshot
+ *
+ */
+#include "jsmn.c"
+#include "avltree.c"
+#include "pavltree.c"
+#define main MAIN_BUFFILE
+#include "buffer_file.c"
+#undef main
+#undef DO_MAIN
+#include "orx_parsejson.c"
+#define DO_MAIN
+
+/* Return height of subtree, or -1 if out of order or unbalanced */
+static int
+checkPavl(pPAVLNODE pNode, const char* lo, const char* hi) {
+const char* key;
+int hl;
+int hr;
+  if (!pNode) return 0;
+  key = ((pOJITEM) pNode->pBox->payload)->keyString;
+  if ((lo && strcmp(lo, key) >= 0) || (hi && strcmp(key, hi) >= 0)) return -1;
+  if ((hl = checkPavl(pNode->pLeft, lo, key)) < 0) return -1;
+  if ((hr = checkPavl(pNode->pRight, key, hi)) < 0) return -1;
+  if (hl - hr > 1 || hr - hl > 1) return -1;
+  if (pNode->height != 1 + (hl > hr ? hl : hr)) return -1;
+  return pNode->height;
+}
+
+/* Count nodes not shared with any other version */
+static size_t
+countOwnedPavl(pPAVLNODE pNode) {
+  if (!pNode || pNode->refCount != 1) return 0;
+  return 1 + countOwnedPavl(pNode->pLeft) + countOwnedPavl(pNode->pRight);
+}
+
+/* Load buffer into version, and check load and invariants */
+static int
+loadPavl(const char* json, pPAVLTREE pTree) {
+pAVLTREE pAvlRoot = 0;
+  if (readOjiAvlBuffer((const uint8_t*) json, strlen(json), &pAvlRoot, 0, 0)) return 1;
+  if (moveOjiAvlToPavl(&pAvlRoot, pTree) || pAvlRoot) return 1;
+  return checkPavl(pTree->pRoot, 0, 0) < 0;
+}
+
+int
+main(int argc, char** argv) {
+PAVLTREE tree;
+PAVLTREE snapshot;
+PAVLTREE rollback;
+char* bigJson;
+char* p;
+char s[BUFSIZ];
+double d;
+OJIBOOL b;
+size_t n;
+size_t owned;
+int found;
+int errors;
+int i;
+
+  while (--argc) {
+    errors = 0;
+    initOjiPavl(&tree);
+    if (readOjiPavl(argv[argc], &tree, 0, 0)) { ++errors; }
+    if (checkPavl(tree.pRoot, 0, 0) < 0) { ++errors; }
+    n = tree.count;
+
+    /* Snapshot, then override two values and add a key */
+    snapshotPavl(&tree, &snapshot);
+    if (loadPavl("{\"object\":{\"zero\":42,\"string\":\"override\",\"extra\":true}}", &tree)) { ++errors; }
+    if (tree.count != n + 1 || snapshot.count != n) { ++errors; }
+
+    orx_getDoubleOjiPavl(&tree, "json.object.zero", &d, &found);
+    if (!found || d != 42.0) { ++errors; }
+    orx_getStringOjiPavl(&tree, "json.object.string", sizeof s, s, &found);
+    if (!found || strcmp(s, "override")) { ++errors; }
+    orx_getBooleanOjiPavl(&tree, "json.object.extra", &b, &found);
+    if (!found || b != OJI_TRUE) { ++errors; }
+
+    orx_getDoubleOjiPavl(&snapshot, "json.object.zero", &d, &found);
+    if (!found || d != 0.0) { ++errors; }
+    orx_getStringOjiPavl(&snapshot, "json.object.string", sizeof s, s, &found);
+    if (!found || strcmp(s, "string")) { ++errors; }
+    orx_getBooleanOjiPavl(&snapshot, "json.object.extra", &b, &found);
+    if (found) { ++errors; }
+    orx_getNullOjiPavl(&snapshot, "json.object.null", &found);
+    if (!found) { ++errors; }
+    if (checkPavl(snapshot.pRoot, 0, 0) < 0) { ++errors; }
+
+    /* Roll back:  release the overridden version, keep the snapshot */
+    releasePavl(&tree);
+    orx_getDoubleOjiPavl(&snapshot, "json.object.zero", &d, &found);
+    if (!found || d != 0.0) { ++errors; }
+    releasePavl(&snapshot);
+
+    fprintf(stdout, "%s:  %s; %lu keys\n", argv[argc], errors ? "FAILED" : "OK", (unsigned long) n);
+    if (errors) return 1;
+  }
+
+  /* Override one key of a large tree:  only one path is copied */
+  errors = 0;
+  n = 20000;
+  bigJson = malloc(n * 24 + 16);
+  p = bigJson;
+  *p++ = '{';
+  for (i=0; i<(int)n; ++i) p += sprintf(p, "%s\"k%06d\":%d", i ? "," : "", i, i);
+  strcpy(p, "}");
+
+  initOjiPavl(&tree);
+  if (loadPavl(bigJson, &tree)) { ++errors; }
+  free(bigJson);
+
+  snapshotPavl(&tree, &snapshot);
+  snapshotPavl(&tree, &rollback);
+  if (loadPavl("{\"k012345\":-1}", &tree)) { ++errors; }
+  owned = countOwnedPavl(tree.pRoot);
+  if (owned < 1 || owned > (size_t) tree.pRoot->height) { ++errors; }
+
+  orx_getDoubleOjiPavl(&tree, "json.k012345", &d, &found);
+  if (!found || d != -1.0) { ++errors; }
+  orx_getDoubleOjiPavl(&snapshot, "json.k012345", &d, &found);
+  if (!found || d != 12345.0) { ++errors; }
+
+  /* Release in a different order than taken */
+  releasePavl(&snapshot);
+  orx_getDoubleOjiPavl(&rollback, "json.k012345", &d, &found);
+  if (!found || d != 12345.0) { ++errors; }
+  releasePavl(&tree);
+  if (checkPavl(rollback.pRoot, 0, 0) < 0 || rollback.count != n) { ++errors; }
+  releasePavl(&rollback);
+
+  fprintf(stdout, "test_orx_snapshot:  %s; %lu keys; %lu nodes copied by one override\n"
+         , errors ? "FAILED" : "OK", (unsigned long) n, (unsigned long) owned);
+
+  return errors ? 1 : 0;
+}
+#endif // DO_MAIN
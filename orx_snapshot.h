@@ -0,0 +1,37 @@
+////////////////////////////////////////////////////////////////////////
+// Structurally shared snapshots of OJI trees
+//
+// OJITEMs are held in a persistent AVL tree (pavltree.h) instead of an
+// AVLTREE:
+//
+//   - snapshotPavl() copies a version in O(1), so a snapshot can be taken
+//     before overrides are applied and released to roll them back, or
+//     kept and used in place of the overridden version
+//   - an override copies only the O(log n) nodes on the path to its key;
+//     all other nodes, and every OJITEM, are shared between versions
+//   - OJITEMs are freed with cleanupOji() when the last version holding
+//     them is released
+//
+// OJITEMs are moved, not copied, from an OJI AVL tree built by
+// readOjiAvl* or readOjiAvlBuffer; the AVL tree is left empty.
+//
+////////////////////////////////////////////////////////////////////////
+#ifndef __ORX_SNAPSHOT_H__
+#define __ORX_SNAPSHOT_H__
+
+#include "orx_parsejson.h"
+#include "pavltree.h"
+
+void initOjiPavl(pPAVLTREE pTree);
+int moveOjiAvlToPavl(ppAVLTREE ppAvlRoot, pPAVLTREE pTree);
+int readOjiPavl(char* filepath, pPAVLTREE pTree, char* pfx, pOJIOPTS pOpts);
+
+pOJITEM orx_getOjiPavl(pPAVLTREE pTree, char* searchKeyString);
+void orx_getAnyOjiPavl(pPAVLTREE pTree, char* searchKeyString, void *pOut, int *pFound, OJIENUM requestedOjiType, int stringOutSize);
+void orx_getNullOjiPavl(pPAVLTREE pTree, char* searchKeyString, int* pFound);
+void orx_getDoubleOjiPavl(pPAVLTREE pTree, char* searchKeyString, double* pOut, int* pFound);
+void orx_getInt64OjiPavl(pPAVLTREE pTree, char* searchKeyString, int64_t* pOut, int* pFound);
+void orx_getBooleanOjiPavl(pPAVLTREE pTree, char* searchKeyString, OJIBOOL* pOut, int* pFound);
+void orx_getStringOjiPavl(pPAVLTREE pTree, char* searchKeyString, int stringOutSize, char* pOut, int* pFound);
+
+#endif // __ORX_SNAPSHOT_H__
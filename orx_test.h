@@ -0,0 +1,18 @@
+////////////////////////////////////////////////////////////////////////
+// Check macro for the DO_MAIN test programs
+//
+// CHECK(COND) is a statement:  if COND is false it prints COND and its
+// line to stderr, and counts the failure in errors, which main reports
+//
+////////////////////////////////////////////////////////////////////////
+#ifndef __ORX_TEST_H__
+#define __ORX_TEST_H__
+
+#include <stdio.h>
+
+static int errors = 0;
+
+#define CHECK(COND) \
+  do { if (!(COND)) { fprintf(stderr, "Failed:  %s (line %d)\n", #COND, __LINE__); ++errors; } } while (0)
+
+#endif // __ORX_TEST_H__
@@ -0,0 +1,280 @@
+#include <stdlib.h>
+
+#include "pavltree.h"
+
+/*****************************************************************/
+/* Persistent AVL tree; see pavltree.h
+ * - A node with refCount 1, reached from a version's root through
+ *   nodes that all have refCount 1, belongs to that version alone and
+ *   may be changed in place; any other node is copied before a change
+ * - Insertion only rotates nodes on the insertion path, which have
+ *   been copied or are owned by then
+ */
+
+static int heightPavl(pPAVLNODE pNode) {
+  return pNode ? pNode->height : 0;
+}
+
+static void fixHeightPavl(pPAVLNODE pNode) {
+int hLeft = heightPavl(pNode->pLeft);
+int hRight = heightPavl(pNode->pRight);
+  pNode->height = 1 + (hLeft > hRight ? hLeft : hRight);
+  return;
+}
+
+/************************************/
+/* New node holding references given */
+static pPAVLNODE newNodePavl(pPAVLBOX pBox, pPAVLNODE pLeft, pPAVLNODE pRight) {
+pPAVLNODE pNode = malloc(sizeof(PAVLNODE));
+  if (!pNode) return pNode;
+  pNode->pLeft = pLeft;
+  pNode->pRight = pRight;
+  pNode->pBox = pBox;
+  pNode->refCount = 1;
+  ++pBox->refCount;
+  fixHeightPavl(pNode);
+  return pNode;
+}
+
+/***************************************************************/
+/* Drop one reference to a node; free it, and its payload if no
+ * other node holds that, when the last reference goes
+ */
+static void releaseNodePavl(pPAVLNODE pNode, void (*cleanupPayload)(void*)) {
+pPAVLNODE pRight;
+  while (pNode && --pNode->refCount == 0) {
+    releaseNodePavl(pNode->pLeft, cleanupPayload);
+    if (--pNode->pBox->refCount == 0) {
+      if (cleanupPayload) { cleanupPayload(pNode->pBox->payload); }
+      free(pNode->pBox);
+    }
+    pRight = pNode->pRight;
+    free(pNode);
+    pNode = pRight;
+  }
+  return;
+}
+
+/*****************************************************************/
+/* Return a node the caller may change in place, in place of pNode:
+ * pNode itself if it is not shared, else a copy of it; the copy
+ * takes over the caller's reference.  Returns null if out of memory
+ */
+static pPAVLNODE ownNodePavl(pPAVLNODE pNode) {
+pPAVLNODE pCopy;
+  if (pNode->refCount == 1) return pNode;
+  pCopy = newNodePavl(pNode->pBox, pNode->pLeft, pNode->pRight);
+  if (!pCopy) return pCopy;
+  if (pCopy->pLeft) { ++pCopy->pLeft->refCount; }
+  if (pCopy->pRight) { ++pCopy->pRight->refCount; }
+  --pNode->refCount;
+  return pCopy;
+}
+
+/***************************/
+/* Rotations of owned nodes */
+static pPAVLNODE rotateRightPavl(pPAVLNODE pRoot) {
+pPAVLNODE pPivot = pRoot->pLeft;
+  pRoot->pLeft = pPivot->pRight;
+  pPivot->pRight = pRoot;
+  fixHeightPavl(pRoot);
+  fixHeightPavl(pPivot);
+  return pPivot;
+}
+
+static pPAVLNODE rotateLeftPavl(pPAVLNODE pRoot) {
+pPAVLNODE pPivot = pRoot->pRight;
+  pRoot->pRight = pPivot->pLeft;
+  pPivot->pLeft = pRoot;
+  fixHeightPavl(pRoot);
+  fixHeightPavl(pPivot);
+  return pPivot;
+}
+
+static pPAVLNODE rebalancePavl(pPAVLNODE pRoot) {
+int balance;
+  fixHeightPavl(pRoot);
+  balance = heightPavl(pRoot->pLeft) - heightPavl(pRoot->pRight);
+  if (balance > 1) {
+    if (heightPavl(pRoot->pLeft->pLeft) < heightPavl(pRoot->pLeft->pRight)) {
+      /* Convert Left-Right case to Left-Left case */
+      pRoot->pLeft = rotateLeftPavl(pRoot->pLeft);
+    }
+    return rotateRightPavl(pRoot);
+  }
+  if (balance < -1) {
+    if (heightPavl(pRoot->pRight->pRight) < heightPavl(pRoot->pRight->pLeft)) {
+      /* Convert Right-Left case to Right-Right case */
+      pRoot->pRight = rotateRightPavl(pRoot->pRight);
+    }
+    return rotateLeftPavl(pRoot);
+  }
+  return pRoot;
+}
+
+/*****************************************************************/
+/* Insert pBox into subtree; return new subtree root, which replaces
+ * pNode in the caller.  *pRtn is 1 for a new key, 0 for a replaced
+ * payload, -1 if out of memory (subtree contents are then unchanged)
+ */
+static pPAVLNODE insertNodePavl(pPAVLTREE pTree, pPAVLNODE pNode, pPAVLBOX pBox, int* pRtn) {
+pPAVLNODE pOwned;
+int comp;
+
+  if (!pNode) {
+    pOwned = newNodePavl(pBox, 0, 0);
+    *pRtn = pOwned ? 1 : -1;
+    return pOwned;
+  }
+
+  comp = pTree->comparator(pBox->payload, pNode->pBox->payload);
+
+  if (!(pOwned = ownNodePavl(pNode))) {
+    *pRtn = -1;
+    return pNode;
+  }
+
+  if (comp == 0) {
+    /* Replace payload; old payload goes with its last holder */
+    if (--pOwned->pBox->refCount == 0) {
+      if (pTree->cleanupPayload) { pTree->cleanupPayload(pOwned->pBox->payload); }
+      free(pOwned->pBox);
+    }
+    pOwned->pBox = pBox;
+    ++pBox->refCount;
+    *pRtn = 0;
+    return pOwned;
+  }
+
+  if (comp < 0) {
+    pOwned->pLeft = insertNodePavl(pTree, pOwned->pLeft, pBox, pRtn);
+  } else {
+    pOwned->pRight = insertNodePavl(pTree, pOwned->pRight, pBox, pRtn);
+  }
+
+  return *pRtn == 1 ? rebalancePavl(pOwned) : pOwned;
+}
+
+/*****************************************************************/
+/* Build balanced subtree from sorted payloads; null if out of memory */
+static pPAVLNODE buildNodePavl(void** payloads, size_t n) {
+pPAVLNODE pLeft;
+pPAVLNODE pRight;
+pPAVLNODE pNode;
+pPAVLBOX pBox;
+size_t nLeft = (n - 1) / 2;
+
+  if (!n) return 0;
+
+  pLeft = buildNodePavl(payloads, nLeft);
+  pRight = buildNodePavl(payloads + nLeft + 1, n - nLeft - 1);
+  pNode = 0;
+  if ((pBox = malloc(sizeof(PAVLBOX)))) {
+    pBox->refCount = 0;
+    pBox->payload = payloads[nLeft];
+    pNode = newNodePavl(pBox, pLeft, pRight);
+  }
+
+  if (!pNode || (nLeft && !pLeft) || (n - nLeft - 1 && !pRight)) {
+    /* Out of memory; free nodes, but leave payloads to the caller */
+    if (pNode) {
+      releaseNodePavl(pNode, 0);
+    } else {
+      free(pBox);
+      releaseNodePavl(pLeft, 0);
+      releaseNodePavl(pRight, 0);
+    }
+    return 0;
+  }
+  return pNode;
+}
+
+
+/*****************************************************************/
+/* Public routines */
+
+void initPavl(pPAVLTREE pTree, int (*comparator)(const void*, const void*), void (*cleanupPayload)(void*)) {
+  if (!pTree) return;
+  pTree->pRoot = 0;
+  pTree->count = 0;
+  pTree->comparator = comparator;
+  pTree->cleanupPayload = cleanupPayload;
+  return;
+}
+
+/* O(1) snapshot; both versions must eventually be released */
+void snapshotPavl(pPAVLTREE pSource, pPAVLTREE pSnapshot) {
+  if (!pSource || !pSnapshot) return;
+  *pSnapshot = *pSource;
+  if (pSnapshot->pRoot) { ++pSnapshot->pRoot->refCount; }
+  return;
+}
+
+/* Insert or replace; returns 1 if key is new, 0 if replaced, -1 if
+ * out of memory, in which case the caller still owns payload
+ */
+int insertPavl(pPAVLTREE pTree, void* payload) {
+pPAVLBOX pBox;
+int rtn = -1;
+
+  if (!pTree || !pTree->comparator) return -1;
+  if (!(pBox = malloc(sizeof(PAVLBOX)))) return -1;
+  pBox->refCount = 0;
+  pBox->payload = payload;
+
+  pTree->pRoot = insertNodePavl(pTree, pTree->pRoot, pBox, &rtn);
+
+  if (rtn < 0) { free(pBox); return rtn; }
+  if (rtn > 0) { ++pTree->count; }
+  return rtn;
+}
+
+/* Build empty tree from n payloads in strictly ascending key order, in
+ * O(n); returns 0 on success, -1 if not empty or out of memory
+ */
+int buildSortedPavl(pPAVLTREE pTree, void** payloads, size_t n) {
+  if (!pTree || pTree->pRoot) return -1;
+  if (!n) return 0;
+  if (!(pTree->pRoot = buildNodePavl(payloads, n))) return -1;
+  pTree->count = n;
+  return 0;
+}
+
+/* Find payload matching key, or return NULL */
+void* getPavl(pPAVLTREE pTree, void* pPayloadWithKey) {
+pPAVLNODE pNode = pTree ? pTree->pRoot : 0;
+int comp;
+  while (pNode) {
+    comp = pTree->comparator(pPayloadWithKey, pNode->pBox->payload);
+    if (!comp) return pNode->pBox->payload;
+    pNode = comp < 0 ? pNode->pLeft : pNode->pRight;
+  }
+  return 0;
+}
+
+/* In-order traversal */
+static void traverseNodePavl(pPAVLNODE pNode, void (*handler)(void*, void*), void* arg) {
+  while (pNode) {
+    traverseNodePavl(pNode->pLeft, handler, arg);
+    handler(pNode->pBox->payload, arg);
+    pNode = pNode->pRight;
+  }
+  return;
+}
+
+void traversePavl(pPAVLTREE pTree, void (*handler)(void* payload, void* arg), void* arg) {
+  if (!pTree || !handler) return;
+  traverseNodePavl(pTree->pRoot, handler, arg);
+  return;
+}
+
+/* Release this version; nodes and payloads shared with other versions
+ * survive until those are released too
+ */
+void releasePavl(pPAVLTREE pTree) {
+  if (!pTree) return;
+  releaseNodePavl(pTree->pRoot, pTree->cleanupPayload);
+  pTree->pRoot = 0;
+  pTree->count = 0;
+  return;
+}
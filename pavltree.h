@@ -0,0 +1,42 @@
+#ifndef __PAVLTREE_H__
+#define __PAVLTREE_H__
+/* Persistent (path-copying) AVL tree
+ * - A PAVLTREE is one version; snapshotPavl makes another version that
+ *   shares every node, in O(1)
+ * - insertPavl copies only the nodes on the path it changes, O(log n),
+ *   unless they belong to no other version, in which case they are
+ *   changed in place
+ * - Nodes are reference counted; a payload is shared by all copies of
+ *   its node, and cleanupPayload is called when the last copy is freed
+ */
+
+typedef struct PAVLBOXstr {
+  unsigned long refCount;  // Number of nodes holding this payload
+  void* payload;
+} PAVLBOX, *pPAVLBOX;
+
+typedef struct PAVLNODEstr {
+  struct PAVLNODEstr* pLeft;
+  struct PAVLNODEstr* pRight;
+  pPAVLBOX pBox;
+  unsigned long refCount;  // Number of parents and versions holding node
+  int height;              // 1 for a leaf
+} PAVLNODE, *pPAVLNODE;
+
+typedef struct PAVLTREEstr {
+  pPAVLNODE pRoot;
+  size_t count;            // Number of payloads in this version
+
+  /* Comparator and cleanup as for AVLTREE */
+  int (*comparator)(const void* payload1, const void* payload2);
+  void (*cleanupPayload)(void* payload);
+} PAVLTREE, *pPAVLTREE;
+
+void initPavl(pPAVLTREE pTree, int (*comparator)(const void*, const void*), void (*cleanupPayload)(void*));
+void snapshotPavl(pPAVLTREE pSource, pPAVLTREE pSnapshot);
+int insertPavl(pPAVLTREE pTree, void* payload);
+int buildSortedPavl(pPAVLTREE pTree, void** payloads, size_t n);
+void* getPavl(pPAVLTREE pTree, void* pPayloadWithKey);
+void traversePavl(pPAVLTREE pTree, void (*handler)(void* payload, void* arg), void* arg);
+void releasePavl(pPAVLTREE pTree);
+#endif
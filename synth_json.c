@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "synth_json.h"
+
+
+/**********************************************************************/
+/**********************************************************************/
+/*** Synthetic JSON corpus generator; see synth_json.h */
+/**********************************************************************/
+/**********************************************************************/
+
+typedef struct SYNTHSTATEstr {
+  char* buf;
+  size_t len;
+  size_t size;
+  int failed;
+  unsigned long long rng;
+  int maxDepth;
+  int maxWidth;
+} SYNTHSTATE, *pSYNTHSTATE;
+
+/* xorshift64* */
+static unsigned long
+nextSynth(pSYNTHSTATE pState) {
+  pState->rng ^= pState->rng >> 12;
+  pState->rng ^= pState->rng << 25;
+  pState->rng ^= pState->rng >> 27;
+  return (unsigned long) ((pState->rng * 2685821657736338717ULL) >> 33);
+}
+
+/* Append n bytes */
+static void
+putSynth(pSYNTHSTATE pState, const char* s, size_t n) {
+char* newBuf;
+  if (pState->failed) return;
+  if (pState->len + n + 1 > pState->size) {
+    while (pState->len + n + 1 > pState->size) pState->size <<= 1;
+    if (!(newBuf = realloc(pState->buf, pState->size))) {
+      pState->failed = 1;
+      return;
+    }
+    pState->buf = newBuf;
+  }
+  memcpy(pState->buf + pState->len, s, n);
+  pState->len += n;
+  pState->buf[pState->len] = '\0';
+  return;
+}
+
+#define PUTS_SYNTH(P,S) putSynth(P, S, strlen(S))
+
+static void
+stringSynth(pSYNTHSTATE pState) {
+static const char* pieces[] =
+  { "alpha", "beta", "gamma", " ", "_", "0", "42", "\\\"", "\\\\", "\\n", "\\t"
+  , "\\/", "\\u00e9", "x", "Z", "-", ":", ",", "{", "]"
+  };
+int n = 1 + (int) (nextSynth(pState) % 6);
+const char* piece;
+  PUTS_SYNTH(pState, "\"");
+  while (n--) {
+    piece = pieces[nextSynth(pState) % (sizeof pieces / sizeof pieces[0])];
+    PUTS_SYNTH(pState, piece);
+  }
+  PUTS_SYNTH(pState, "\"");
+  return;
+}
+
+static void
+numberSynth(pSYNTHSTATE pState) {
+char s[64];
+unsigned long r = nextSynth(pState);
+  switch (r % 5) {
+  case 0: sprintf(s, "%ld", (long) (nextSynth(pState) % 2000001) - 1000000); break;
+  case 1: sprintf(s, "%.6f", (double) ((long) (nextSynth(pState) % 2000001) - 1000000) / 997.0); break;
+  case 2: sprintf(s, "%.3e", (double) nextSynth(pState) * 1e-20); break;
+  case 3: sprintf(s, "-%lu.%02luE+%lu", nextSynth(pState) % 10, nextSynth(pState) % 100, nextSynth(pState) % 30); break;
+  default: sprintf(s, "%lu", nextSynth(pState) % 10); break;
+  }
+  PUTS_SYNTH(pState, s);
+  return;
+}
+
+static void valueSynth(pSYNTHSTATE pState, int depth);
+
+/* Object with nMembers unique names; nMembers > 0 */
+static void
+objectSynth(pSYNTHSTATE pState, int depth, int nMembers) {
+char s[32];
+int i;
+  PUTS_SYNTH(pState, "{");
+  for (i=0; i<nMembers && !pState->failed; ++i) {
+    sprintf(s, "%s\"m%d_%lu\":", i ? "," : "", i, nextSynth(pState) % 1000);
+    PUTS_SYNTH(pState, s);
+    valueSynth(pState, depth + 1);
+  }
+  PUTS_SYNTH(pState, "}");
+  return;
+}
+
+static void
+arraySynth(pSYNTHSTATE pState, int depth) {
+int n = (int) (nextSynth(pState) % (pState->maxWidth + 1));
+int i;
+  PUTS_SYNTH(pState, "[");
+  for (i=0; i<n; ++i) {
+    if (i) PUTS_SYNTH(pState, ",");
+    valueSynth(pState, depth + 1);
+  }
+  PUTS_SYNTH(pState, "]");
+  return;
+}
+
+static void
+valueSynth(pSYNTHSTATE pState, int depth) {
+unsigned long r = nextSynth(pState) % (depth < pState->maxDepth ? 10 : 6);
+  switch (r) {
+  case 0: PUTS_SYNTH(pState, "null"); break;
+  case 1:
+    if (nextSynth(pState) & 1) { PUTS_SYNTH(pState, "true"); } else { PUTS_SYNTH(pState, "false"); }
+    break;
+  case 2: case 3: numberSynth(pState); break;
+  case 4: case 5: stringSynth(pState); break;
+  case 6: case 7: arraySynth(pState, depth); break;
+  default:
+    objectSynth(pState, depth, 1 + (int) (nextSynth(pState) % pState->maxWidth));
+    break;
+  }
+  return;
+}
+
+
+/**********************************************************************/
+/* Generate document; returns null if out of memory */
+char*
+synthJson(pSYNTHJSON pSynth, size_t* pLen) {
+SYNTHSTATE state;
+char s[32];
+int i;
+
+  if (!pSynth) return 0;
+
+  state.size = 4096;
+  state.len = 0;
+  state.failed = 0;
+  state.rng = 0x9E3779B97F4A7C15ULL ^ (unsigned long long) pSynth->seed;
+  if (!state.rng) state.rng = 1;
+  state.maxDepth = pSynth->maxDepth > 0 ? pSynth->maxDepth : 6;
+  state.maxWidth = pSynth->maxWidth > 0 ? pSynth->maxWidth : 8;
+  if (!(state.buf = malloc(state.size))) return 0;
+
+  /* Top-level object grows until the target size is reached */
+  PUTS_SYNTH(&state, "{");
+  for (i=0; !i || (state.len < pSynth->targetBytes && !state.failed); ++i) {
+    sprintf(s, "%s\"top%d\":", i ? "," : "", i);
+    PUTS_SYNTH(&state, s);
+    valueSynth(&state, 1);
+  }
+  PUTS_SYNTH(&state, "}");
+
+  if (state.failed) {
+    free(state.buf);
+    return 0;
+  }
+  if (pLen) *pLen = state.len;
+  return state.buf;
+}
@@ -0,0 +1,30 @@
+////////////////////////////////////////////////////////////////////////
+// Synthetic JSON corpus generator, for tests and benchmarks
+//
+// synthJson() returns a malloc'ed, null-terminated JSON document of
+// roughly targetBytes bytes, the same for the same seed, with nested
+// objects and arrays (including empty and nested arrays), numbers in
+// integer, fixed and exponent forms, strings with escapes, booleans and
+// nulls.
+//
+// Documents avoid what the flattened key syntax cannot represent, so
+// they round-trip through an OJI tree:  member names contain no '.' or
+// '[', no member is named "length", names are unique within an object,
+// and there are no empty objects.
+//
+////////////////////////////////////////////////////////////////////////
+#ifndef __SYNTH_JSON_H__
+#define __SYNTH_JSON_H__
+
+#include <stddef.h>
+
+typedef struct SYNTHJSONstr {
+  unsigned long seed;
+  size_t targetBytes;     // Approximate size of document
+  int maxDepth;           // Deepest nesting; 0 for default (6)
+  int maxWidth;           // Most members or elements; 0 for default (8)
+} SYNTHJSON, *pSYNTHJSON;
+
+char* synthJson(pSYNTHJSON pSynth, size_t* pLen);
+
+#endif // __SYNTH_JSON_H__